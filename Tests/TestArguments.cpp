@@ -3,40 +3,100 @@
 #include "wpp/String.h"
 #include "wpp/ParseUtils.h"
 #include "wpp/TraceItems.h"
+#include "wpp/Trace.h"
 
-#define CHECK_ARGUMENT_COUNT(str, value)                                \
-    do {                                                                \
-        constexpr const auto result = countArgs(std::string_view(str)); \
+#define CHECK_FIELD_COUNT(str, value)                                     \
+    do {                                                                  \
+        constexpr const auto result = countFields(std::string_view(str)); \
         STATIC_REQUIRE(result.status == ArgumentParseStatus::Success);  \
         STATIC_REQUIRE(result.count == value);                          \
     } while (0)
 
-#define CHECK_COUNT_FAILS(str, statusValue)                             \
-    do {                                                                \
-        constexpr const auto result = countArgs(std::string_view(str)); \
-        STATIC_REQUIRE(result.status == statusValue);                   \
+#define CHECK_COUNT_FAILS(str, statusValue)                               \
+    do {                                                                  \
+        constexpr const auto result = countFields(std::string_view(str)); \
+        STATIC_REQUIRE(result.status == statusValue);                     \
     } while (0)
 
-TEST_CASE("Argument count", "[Args]") {
+TEST_CASE("Field count", "[Args]") {
     using namespace ::wpp::internal;
     using namespace ::wpp;
 
-    CHECK_ARGUMENT_COUNT("", 0);
-    CHECK_ARGUMENT_COUNT("hello", 0);
-    CHECK_ARGUMENT_COUNT("{}", 1);
-    CHECK_ARGUMENT_COUNT("hello {}", 1);
-    CHECK_ARGUMENT_COUNT("hello {} {} {}", 3);
-    CHECK_ARGUMENT_COUNT("hello {} {} {}", 3);
+    CHECK_FIELD_COUNT("", 0);
+    CHECK_FIELD_COUNT("hello", 0);
+    CHECK_FIELD_COUNT("{}", 1);
+    CHECK_FIELD_COUNT("hello {}", 1);
+    CHECK_FIELD_COUNT("hello {} {} {}", 3);
+    CHECK_FIELD_COUNT("hello {} {} {}", 3);
 
-    CHECK_ARGUMENT_COUNT("hello {{}}", 0);
-    CHECK_ARGUMENT_COUNT("hello {{{}}}", 1);
-    CHECK_ARGUMENT_COUNT("hello {{ asd }} {}", 1);
+    CHECK_FIELD_COUNT("hello {{}}", 0);
+    CHECK_FIELD_COUNT("hello {{{}}}", 1);
+    CHECK_FIELD_COUNT("hello {{ asd }} {}", 1);
 
     CHECK_COUNT_FAILS("{", ArgumentParseStatus::ExcessOpens);
     CHECK_COUNT_FAILS("}", ArgumentParseStatus::ExcessCloses);
     CHECK_COUNT_FAILS("{}}", ArgumentParseStatus::ExcessCloses);
     CHECK_COUNT_FAILS("{{}", ArgumentParseStatus::ExcessCloses);
-    CHECK_COUNT_FAILS("{asd}", ArgumentParseStatus::MissingColonInFormat);
+    CHECK_COUNT_FAILS("{a-b}", ArgumentParseStatus::InvalidFieldName);
+    CHECK_COUNT_FAILS("{0x}", ArgumentParseStatus::InvalidFieldName);
+    CHECK_COUNT_FAILS("{0.name}", ArgumentParseStatus::InvalidFieldName);
+    CHECK_COUNT_FAILS("{name!r}", ArgumentParseStatus::InvalidFieldName);
+    CHECK_COUNT_FAILS("{ name}", ArgumentParseStatus::InvalidFieldName);
+
+    CHECK_FIELD_COUNT("{0} {1:x} {0}", 3);
+    CHECK_FIELD_COUNT("{name} {_other:>8} {name}", 3);
+
+    CHECK_FIELD_COUNT("{:08x} {:>10} {:.3f} {:*^12.4s} {:+,d}", 5);
+    CHECK_COUNT_FAILS("{:8.x}", ArgumentParseStatus::InvalidFormatSpec);
+    CHECK_COUNT_FAILS("{:x8}", ArgumentParseStatus::InvalidFormatSpec);
+    CHECK_COUNT_FAILS("{:+-d}", ArgumentParseStatus::InvalidFormatSpec);
+    CHECK_COUNT_FAILS("{:{<5}", ArgumentParseStatus::InvalidFormatSpec);
+}
+
+TEST_CASE("Format specifications", "[Args]") {
+    using namespace ::wpp::internal;
+
+    constexpr const auto empty = parseFormatSpec("");
+    STATIC_REQUIRE(empty.isValid);
+    STATIC_REQUIRE(empty.type.empty());
+    STATIC_REQUIRE_FALSE(empty.hasNumericOptions());
+
+    constexpr const auto padded = parseFormatSpec("08x");
+    STATIC_REQUIRE(padded.isValid);
+    STATIC_REQUIRE(padded.zeroPadding);
+    STATIC_REQUIRE(padded.width == 8);
+    STATIC_REQUIRE(padded.type == "x");
+    STATIC_REQUIRE(padded.hasNumericOptions());
+
+    constexpr const auto full = parseFormatSpec("*^+#012,.3f");
+    STATIC_REQUIRE(full.isValid);
+    STATIC_REQUIRE(full.fill == '*');
+    STATIC_REQUIRE(full.align == '^');
+    STATIC_REQUIRE(full.sign == '+');
+    STATIC_REQUIRE(full.alternate);
+    STATIC_REQUIRE(full.zeroPadding);
+    STATIC_REQUIRE(full.width == 12);
+    STATIC_REQUIRE(full.grouping == ',');
+    STATIC_REQUIRE(full.hasPrecision);
+    STATIC_REQUIRE(full.precision == 3);
+    STATIC_REQUIRE(full.type == "f");
+
+    // A type starting with a character which is not followed by an alignment is not a fill
+    constexpr const auto hexDump = parseFormatSpec(">20xd");
+    STATIC_REQUIRE(hexDump.isValid);
+    STATIC_REQUIRE(hexDump.fill == '\0');
+    STATIC_REQUIRE(hexDump.align == '>');
+    STATIC_REQUIRE(hexDump.width == 20);
+    STATIC_REQUIRE(hexDump.type == "xd");
+
+    constexpr const auto fill = parseFormatSpec("x<5");
+    STATIC_REQUIRE(fill.isValid);
+    STATIC_REQUIRE(fill.fill == 'x');
+    STATIC_REQUIRE(fill.align == '<');
+    STATIC_REQUIRE(fill.type.empty());
+
+    STATIC_REQUIRE_FALSE(parseFormatSpec(".f").isValid);
+    STATIC_REQUIRE_FALSE(parseFormatSpec("x.3").isValid);
 }
 
 #define CHECK_STATUS(str, statusValue)                            \
@@ -105,20 +165,20 @@ TEST_CASE("Argument types", "[Args]") {
     CHECK_TYPE("{}", wchar_t*, WStringItem);
     CHECK_TYPE("{:s}", wchar_t*, WStringItem);
     CHECK_TYPE("{:p}", wchar_t*, PointerItem);
-    CHECK_TYPE("{:x}", wchar_t*, HexBufferItem);
-    CHECK_TYPE("{:xd}", wchar_t*, HexDumpItem);
+    CHECK_TYPE("{:x}", wchar_t*, WHexBufferItem);
+    CHECK_TYPE("{:xd}", wchar_t*, WHexDumpItem);
 
     CHECK_TYPE("{}", wchar_t[], WStringItem);
     CHECK_TYPE("{:s}", wchar_t[], WStringItem);
     CHECK_TYPE("{:p}", wchar_t[], PointerItem);
-    CHECK_TYPE("{:x}", wchar_t[], HexBufferItem);
-    CHECK_TYPE("{:xd}", wchar_t[], HexDumpItem);
+    CHECK_TYPE("{:x}", wchar_t[], WHexBufferItem);
+    CHECK_TYPE("{:xd}", wchar_t[], WHexDumpItem);
     
     CHECK_TYPE("{}", wchar_t[10], WStringItem);
     CHECK_TYPE("{:s}", wchar_t[10], WStringItem);
     CHECK_TYPE("{:p}", wchar_t[10], PointerItem);
-    CHECK_TYPE("{:x}", wchar_t[10], HexBufferItem);
-    CHECK_TYPE("{:xd}", wchar_t[10], HexDumpItem);
+    CHECK_TYPE("{:x}", wchar_t[10], WHexBufferItem);
+    CHECK_TYPE("{:xd}", wchar_t[10], WHexDumpItem);
 
     CHECK_TYPE("{}", GUID, GuidItem);
     
@@ -152,3 +212,194 @@ TEST_CASE("Argument types", "[Args]") {
     CHECK_TYPE("{:g}", long double, LongDoubleItem);
     CHECK_TYPE("{:G}", long double, LongDoubleItem);
 }
+
+#define CHECK_OPTIONS(str, ArgType, expected)                                                \
+    do {                                                                                    \
+        __WPP_STRING_MAKER(FormatType, str);                                                \
+        using FormatInfo = decltype(getFormatInfo<FormatType>());                           \
+        STATIC_REQUIRE(FormatInfo::status() == ArgumentParseStatus::Success);               \
+        STATIC_REQUIRE(ArgChecker<FormatInfo, std::tuple<ArgType>>::value ==                \
+                       ArgCheckResult::expected);                                           \
+    } while (0)
+
+TEST_CASE("Format specification options", "[Args]") {
+    using namespace ::wpp::internal;
+    using namespace ::wpp;
+
+    // Only the type selects the trace item
+    CHECK_TYPE("{:08x}", int, Int32Item);
+    CHECK_TYPE("{:*^+#12,o}", int, Int32Item);
+    CHECK_TYPE("{:>10}", char*, StringItem);
+    CHECK_TYPE("{:.3s}", char*, StringItem);
+    CHECK_TYPE("{:<40xd}", char*, HexDumpItem);
+    CHECK_TYPE("{:.3f}", double, DoubleItem);
+    CHECK_TYPE("{:>016zx}", size_t, SizeTItem);
+    CHECK_BAD_FORMAT("{:08e}", int);
+
+    CHECK_OPTIONS("{:08x}", int, Success);
+    CHECK_OPTIONS("{:+,}", int, Success);
+    CHECK_OPTIONS("{:.3}", int, UnsupportedFormatOptions);
+    CHECK_OPTIONS("{:+.3e}", double, Success);
+    CHECK_OPTIONS("{:>10.4}", const char*, Success);
+    CHECK_OPTIONS("{:+}", const char*, UnsupportedFormatOptions);
+    CHECK_OPTIONS("{:08}", const char*, UnsupportedFormatOptions);
+    CHECK_OPTIONS("{:>5c}", char, Success);
+    CHECK_OPTIONS("{:+c}", char, UnsupportedFormatOptions);
+    CHECK_OPTIONS("{:^40}", GUID, Success);
+    CHECK_OPTIONS("{:.3}", GUID, UnsupportedFormatOptions);
+    CHECK_OPTIONS("{:08x}", std::optional<int>, Success);
+    using Pair = std::pair<int, const char*>;
+    CHECK_OPTIONS("{:08}", Pair, UnsupportedFormatOptions);
+}
+
+#define CHECK_ARGUMENT_COUNT(str, value)                                      \
+    do {                                                                      \
+        __WPP_STRING_MAKER(FormatType, str);                                  \
+        using FormatInfo = decltype(getFormatInfo<FormatType>());             \
+        STATIC_REQUIRE(FormatInfo::status() == ArgumentParseStatus::Success); \
+        STATIC_REQUIRE(FormatInfo::count() == value);                         \
+    } while (0)
+
+TEST_CASE("Argument references", "[Args]") {
+    using namespace ::wpp::internal;
+    using namespace ::wpp;
+
+    CHECK_ARGUMENT_COUNT("{} {}", 2);
+    CHECK_ARGUMENT_COUNT("{0} {1} {0}", 2);
+    CHECK_ARGUMENT_COUNT("{1:x} {0}", 2);
+    CHECK_ARGUMENT_COUNT("{name:x} {other} {name:>4x}", 2);
+    CHECK_ARGUMENT_COUNT("{name} {} {name}", 2);
+
+    // Every argument is traced once, using the type of its first reference
+    {
+        __WPP_STRING_MAKER(FormatType, "{0:>8x} ({0:#x}), {1:s}");
+        using FormatInfo = decltype(getFormatInfo<FormatType>());
+        STATIC_REQUIRE(std::is_same_v<std::remove_const_t<decltype(FormatInfo::value())>,
+                                      std::tuple<FormatString<'x'>, FormatString<'s'>>>);
+        constexpr const auto fields = FormatInfo::fields().fields;
+        STATIC_REQUIRE(fields.size() == 3);
+        STATIC_REQUIRE(fields[0].argIndex == 0);
+        STATIC_REQUIRE(fields[0].spec.width == 8);
+        STATIC_REQUIRE(fields[1].argIndex == 0);
+        STATIC_REQUIRE(fields[1].spec.alternate);
+        STATIC_REQUIRE(fields[2].argIndex == 1);
+    }
+    {
+        __WPP_STRING_MAKER(FormatType, "{user} logged in from {address} as {user}");
+        using FormatInfo = decltype(getFormatInfo<FormatType>());
+        constexpr const auto fields = FormatInfo::fields().fields;
+        STATIC_REQUIRE(fields[0].name == "user");
+        STATIC_REQUIRE(fields[1].name == "address");
+        STATIC_REQUIRE(fields[1].argIndex == 1);
+        STATIC_REQUIRE(fields[2].argIndex == 0);
+    }
+
+    CHECK_STATUS("{} {0}", ArgumentParseStatus::MixedArgumentReferences);
+    CHECK_STATUS("{name} {0}", ArgumentParseStatus::MixedArgumentReferences);
+    CHECK_STATUS("{1}", ArgumentParseStatus::UnreferencedArgument);
+    CHECK_STATUS("{0} {2}", ArgumentParseStatus::UnreferencedArgument);
+    CHECK_STATUS("{0} {99999999999999999999999}", ArgumentParseStatus::UnreferencedArgument);
+
+    // The references to an argument may use different types, as long as they select the same item
+    CHECK_TYPE("{0:x} {0:#x}", int, Int32Item);
+    CHECK_OPTIONS("{0} {0:#x}", int, Success);
+    CHECK_OPTIONS("{0:d} {0:x}", int, Success);
+    CHECK_OPTIONS("{0:x} {0:X}", int, Success);
+    CHECK_OPTIONS("{0:c} {0:d}", char, Success);
+    CHECK_OPTIONS("{0} {0:s}", const char*, Success);
+    CHECK_OPTIONS("{0:x} {0:s}", const char*, ConflictingFormatTypes);
+    CHECK_OPTIONS("{name} {name:x}", const char*, ConflictingFormatTypes);
+    CHECK_OPTIONS("{0:x} {0:xd}", const char*, ConflictingFormatTypes);
+    CHECK_OPTIONS("{0} {0:s}", int, InvalidFormat);
+    CHECK_OPTIONS("{0:x} {0:08x}", int, Success);
+    CHECK_OPTIONS("{0:s} {0:.3s}", int, InvalidFormat);
+    CHECK_OPTIONS("{0} {0:+}", const char*, UnsupportedFormatOptions);
+}
+
+TEST_CASE("Platform-independent encoding", "[Args]") {
+    using namespace ::wpp::internal;
+    using namespace ::wpp;
+
+    // Pointer-sized values are always traced as 64-bit values
+    STATIC_REQUIRE(sizeof(SizeTItem) == sizeof(uint64_t));
+    STATIC_REQUIRE(sizeof(PtrDiffItem) == sizeof(int64_t));
+    STATIC_REQUIRE(sizeof(PointerItem) == sizeof(uint64_t));
+    REQUIRE(buildTraceItem<FormatString<>>(static_cast<size_t>(5)).getSize() == 8);
+    REQUIRE(buildTraceItem<FormatString<>>(static_cast<ptrdiff_t>(-5)).getSize() == 8);
+
+    // Standard integer types are traced by their size and signedness, whichever of them the
+    // fixed-width types are aliases of
+    CHECK_TYPE("{}", long long, Int64Item);
+    CHECK_TYPE("{:x}", unsigned long long, UInt64Item);
+    CHECK_TYPE("{}", short, Int16Item);
+    CHECK_TYPE("{}", signed char, Int8Item);
+    CHECK_TYPE("{}", unsigned char, UInt8Item);
+    using LongItem = IntegerItemOf<sizeof(long), true>::Type;
+    using UnsignedLongItem = IntegerItemOf<sizeof(long), false>::Type;
+    CHECK_TYPE("{}", long, LongItem);
+    CHECK_TYPE("{:d}", unsigned long, UnsignedLongItem);
+    CHECK_BAD_FORMAT("{}", bool);
+    const auto longLongItem = buildTraceItem<FormatString<>>(-1LL);
+    REQUIRE(longLongItem.getSize() == 8);
+    REQUIRE(*static_cast<const int64_t*>(longLongItem.getPtr()) == -1);
+    const auto unsignedLongLongItem = buildTraceItem<FormatString<'x'>>(1ULL << 40);
+    REQUIRE(unsignedLongLongItem.getSize() == 8);
+    REQUIRE(*static_cast<const uint64_t*>(unsignedLongLongItem.getPtr()) == 1ULL << 40);
+
+    int value = 0;
+    const auto pointerItem = buildTraceItem<FormatString<'p'>>(&value);
+    REQUIRE(pointerItem.getSize() == 8);
+    REQUIRE(*static_cast<const uint64_t*>(pointerItem.getPtr()) ==
+            reinterpret_cast<uintptr_t>(&value));
+
+    // Long doubles are traced as doubles
+    REQUIRE(buildTraceItem<FormatString<>>(1.5L).getSize() == sizeof(double));
+    const auto longDoubleItem = buildTraceItem<FormatString<>>(1.5L);
+    REQUIRE(*static_cast<const double*>(longDoubleItem.getPtr()) == 1.5);
+
+    // Wide characters are traced as UTF-16 code units
+    REQUIRE(buildTraceItem<FormatString<>>(L'a').getSize() == sizeof(char16_t));
+    STATIC_REQUIRE(toUtf16CodeUnit(U'a') == u'a');
+    STATIC_REQUIRE(toUtf16CodeUnit(U'\x1F600') == UTF16_REPLACEMENT_CHARACTER);
+
+    // Wide strings are traced as null-terminated UTF-16 strings
+    const auto stringItem = buildTraceItem<FormatString<>>(L"abc");
+    REQUIRE(stringItem.getSize() == 4 * sizeof(char16_t));
+    REQUIRE(std::u16string_view(static_cast<const char16_t*>(stringItem.getPtr())) == u"abc");
+
+    // Wide strings traced as hex are UTF-16 as well, without the null-terminator
+    const auto checkHexItem = [](const auto& item) {
+        const auto pairs = item.makeTracePairs();
+        REQUIRE(*static_cast<const uint16_t*>(std::get<0>(pairs).ptr) == 3 * sizeof(char16_t));
+        REQUIRE(std::get<1>(pairs).size == 3 * sizeof(char16_t));
+        REQUIRE(std::u16string_view(static_cast<const char16_t*>(std::get<1>(pairs).ptr), 3) ==
+                u"abc");
+    };
+    checkHexItem(buildTraceItem<FormatString<'x'>>(L"abc"));
+    checkHexItem(buildTraceItem<FormatString<'x', 'd'>>(L"abc"));
+}
+
+TEST_CASE("UTF-16 transcoding", "[Args]") {
+    using namespace ::wpp::internal;
+
+    char16_t buffer[8] = {};
+
+    const std::u32string_view simple = U"abc";
+    REQUIRE(transcodeToUtf16(simple.data(), simple.size(), buffer, 8) == 3);
+    REQUIRE(std::u16string_view(buffer) == u"abc");
+
+    // Characters outside of the BMP are encoded as surrogate pairs
+    const std::u32string_view emoji = U"a\U0001F600b";
+    REQUIRE(transcodeToUtf16(emoji.data(), emoji.size(), buffer, 8) == 4);
+    REQUIRE(std::u16string_view(buffer) == u"a\U0001F600b");
+
+    // Invalid code points are replaced
+    const char32_t invalid[] = {0xd800, 0x110000};
+    REQUIRE(transcodeToUtf16(invalid, 2, buffer, 8) == 2);
+    REQUIRE(std::u16string_view(buffer) == u"\xfffd\xfffd");
+
+    // Long strings are truncated on a code point boundary
+    const std::u32string_view truncated = U"abc\U0001F600";
+    REQUIRE(transcodeToUtf16(truncated.data(), truncated.size(), buffer, 5) == 3);
+    REQUIRE(std::u16string_view(buffer) == u"abc");
+}
@@ -0,0 +1,99 @@
+#include "catch.hpp"
+
+#include <cstring>
+#include "wpp/Trace.h"
+
+using namespace wpp::internal;
+using namespace wpp;
+
+#define CHECK_ITEM(Format, ArgType, ItemType) \
+    STATIC_REQUIRE(                           \
+        std::is_same_v<decltype(buildTraceItem<Format>(std::declval<ArgType>())), ItemType>)
+
+TEST_CASE("Composite item types", "[CompositeItems]") {
+    CHECK_ITEM(FormatString<>, std::optional<int>, OptionalItem<Int32Item>);
+    CHECK_ITEM(FormatString<'x'>, std::optional<int>, OptionalItem<Int32Item>);
+    CHECK_ITEM(FormatString<>, const std::optional<const char*>&, OptionalItem<StringItem>);
+    CHECK_ITEM(FormatString<'x'>, std::optional<const char*>, OptionalItem<HexBufferItem>);
+
+    using Pair = std::pair<int, double>;
+    using PairItem = TupleItem<Int32Item, DoubleItem>;
+    CHECK_ITEM(FormatString<>, Pair, PairItem);
+
+    using Tuple = std::tuple<int, const char*, GUID>;
+    using TupleItemType = TupleItem<Int32Item, StringItem, GuidItem>;
+    CHECK_ITEM(FormatString<>, Tuple, TupleItemType);
+    CHECK_ITEM(FormatString<>, std::tuple<>, TupleItem<>);
+
+    using Variant = std::variant<int, const char*>;
+    using VariantItemType = VariantItem<Int32Item, StringItem>;
+    CHECK_ITEM(FormatString<>, Variant, VariantItemType);
+
+    // Nested composite items
+    using Nested = std::optional<std::pair<int, std::optional<int>>>;
+    using NestedItem = OptionalItem<TupleItem<Int32Item, OptionalItem<Int32Item>>>;
+    CHECK_ITEM(FormatString<>, Nested, NestedItem);
+
+    // The format must be valid for all the elements
+    using NumberVariant = std::variant<int, double>;
+    CHECK_ITEM(FormatString<'x'>, Pair, InvalidFormatItem);
+    CHECK_ITEM(FormatString<'e'>, NumberVariant, InvalidFormatItem);
+    CHECK_ITEM(FormatString<'e'>, std::optional<int>, InvalidFormatItem);
+}
+
+TEST_CASE("Optional trace pairs", "[CompositeItems]") {
+    SECTION("Value") {
+        const std::optional<int> value = 5;
+        const auto item = buildTraceItem<FormatString<>>(value);
+        const auto pairs = item.makeTracePairs();
+        STATIC_REQUIRE(std::tuple_size_v<decltype(pairs)> == 2);
+        REQUIRE(std::get<0>(pairs).size == 1);
+        REQUIRE(*static_cast<const uint8_t*>(std::get<0>(pairs).ptr) == 1);
+        REQUIRE(std::get<1>(pairs).size == sizeof(int));
+        REQUIRE(*static_cast<const int*>(std::get<1>(pairs).ptr) == 5);
+    }
+
+    SECTION("No value") {
+        const std::optional<const char*> value = std::nullopt;
+        const auto item = buildTraceItem<FormatString<>>(value);
+        const auto pairs = item.makeTracePairs();
+        STATIC_REQUIRE(std::tuple_size_v<decltype(pairs)> == 2);
+        REQUIRE(*static_cast<const uint8_t*>(std::get<0>(pairs).ptr) == 0);
+        REQUIRE(std::get<1>(pairs).ptr != nullptr);
+        REQUIRE(std::get<1>(pairs).size == 0);
+    }
+}
+
+TEST_CASE("Tuple trace pairs", "[CompositeItems]") {
+    const auto value = std::make_tuple(1, "ab", 2.0);
+    const auto item = buildTraceItem<FormatString<>>(value);
+    const auto pairs = item.makeTracePairs();
+    STATIC_REQUIRE(std::tuple_size_v<decltype(pairs)> == 3);
+    REQUIRE(*static_cast<const int*>(std::get<0>(pairs).ptr) == 1);
+    REQUIRE(std::get<1>(pairs).size == 3);
+    REQUIRE(std::strcmp(static_cast<const char*>(std::get<1>(pairs).ptr), "ab") == 0);
+    REQUIRE(*static_cast<const double*>(std::get<2>(pairs).ptr) == 2.0);
+}
+
+TEST_CASE("Variant trace pairs", "[CompositeItems]") {
+    using Variant = std::variant<int, std::pair<int, int>>;
+
+    SECTION("Padded alternative") {
+        const Variant value = 7;
+        const auto item = buildTraceItem<FormatString<>>(value);
+        const auto pairs = item.makeTracePairs();
+        STATIC_REQUIRE(std::tuple_size_v<decltype(pairs)> == 3);
+        REQUIRE(*static_cast<const uint8_t*>(std::get<0>(pairs).ptr) == 0);
+        REQUIRE(*static_cast<const int*>(std::get<1>(pairs).ptr) == 7);
+        REQUIRE(std::get<2>(pairs).size == 0);
+    }
+
+    SECTION("Full alternative") {
+        const Variant value = std::make_pair(1, 2);
+        const auto item = buildTraceItem<FormatString<>>(value);
+        const auto pairs = item.makeTracePairs();
+        REQUIRE(*static_cast<const uint8_t*>(std::get<0>(pairs).ptr) == 1);
+        REQUIRE(*static_cast<const int*>(std::get<1>(pairs).ptr) == 1);
+        REQUIRE(*static_cast<const int*>(std::get<2>(pairs).ptr) == 2);
+    }
+}
@@ -0,0 +1,41 @@
+#include "catch.hpp"
+
+#include "wpp/Trace.h"
+
+using namespace wpp::internal;
+using namespace wpp;
+
+namespace {
+
+enum class State : uint8_t { Idle, Connected = 7 };
+enum Plain { PlainValue = -5 };
+
+}  // namespace
+
+// The item type is last, as it may contain commas
+#define CHECK_ITEM(Format, value, ...)                                                           \
+    STATIC_REQUIRE(std::is_same_v<decltype(buildTraceItem<Format>(constant<value>)), __VA_ARGS__>)
+
+TEST_CASE("Constant item types", "[ConstantItems]") {
+    CHECK_ITEM(FormatString<>, 42, ConstantItem<Int32Item, 42>);
+    CHECK_ITEM(FormatString<'x'>, 42u, ConstantItem<UInt32Item, 42>);
+    CHECK_ITEM(FormatString<>, State::Connected, ConstantItem<UInt8Item, 7>);
+    CHECK_ITEM(FormatString<>, 'a', ConstantItem<CharItem, 'a'>);
+    CHECK_ITEM(FormatString<>, L'a', ConstantItem<WCharItem, 'a'>);
+    CHECK_ITEM(FormatString<>, uint64_t(12), ConstantItem<UInt64Item, 12>);
+
+    // The wire representation of negative values is zero-extended
+    CHECK_ITEM(FormatString<>, -1, ConstantItem<Int32Item, 0xffffffff>);
+    CHECK_ITEM(FormatString<>, PlainValue, ConstantItem<Int32Item, 0xfffffffb>);
+    CHECK_ITEM(FormatString<>, int64_t(-1), ConstantItem<Int64Item, 0xffffffffffffffff>);
+
+    // Constants support the same formats as traced values of their type
+    CHECK_ITEM(FormatString<'s'>, 42, InvalidFormatItem);
+    CHECK_ITEM(FormatString<'p'>, State::Idle, InvalidFormatItem);
+}
+
+TEST_CASE("Constant trace pairs", "[ConstantItems]") {
+    const auto item = buildTraceItem<FormatString<>>(constant<State::Connected>);
+    STATIC_REQUIRE(IsComplexTraceItem<std::decay_t<decltype(item)>>::value);
+    STATIC_REQUIRE(std::tuple_size_v<decltype(item.makeTracePairs())> == 0);
+}
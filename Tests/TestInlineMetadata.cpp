@@ -0,0 +1,155 @@
+#include "catch.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Inline metadata must be enabled for the whole program, so this file is built by the
+// TestsInlineMetadata project, which defines WPP_ENABLE_INLINE_METADATA for all its files.
+#ifndef WPP_ENABLE_INLINE_METADATA
+#error "Build this file with WPP_ENABLE_INLINE_METADATA (see TestsInlineMetadata.vcxproj)"
+#endif
+#include "wpp/Trace.h"
+
+using namespace wpp;
+using namespace wpp::internal;
+
+struct InlinePoint {
+    int32_t x;
+    int32_t y;
+};
+
+WPP_DEFINE_STRUCT_ITEM(InlinePoint, x, y);
+
+namespace {
+
+constexpr std::string_view toStringView(const ConstexprString<sizeof("x, y")>& value) {
+    return std::string_view(value.data(), value.size());
+}
+
+#ifndef _WIN32
+
+/**
+ * A sink keeping the GUIDs and the data of all the traced messages.
+ */
+class RecordingSink : public TraceSink {
+public:
+    struct Message {
+        GUID guid;
+        std::string data;
+
+        bool isMetadata() const {
+            return std::memcmp(&guid, &INLINE_METADATA_GUID, sizeof(GUID)) == 0;
+        }
+    };
+
+    void write(const GUID& messageGuid, const TracePair* pairs, size_t count) noexcept override {
+        Message message{messageGuid, {}};
+        for (size_t i = 0; i < count; ++i) {
+            message.data.append(static_cast<const char*>(pairs[i].ptr), pairs[i].size);
+        }
+        messages.push_back(std::move(message));
+    }
+
+    std::vector<Message> messages;
+};
+
+void traceSite(TraceProvider& provider, int value) {
+    WPP_DO_TRACE(provider, 1, TraceLevel::Information, "Inline {} {}", value, InlinePoint{1, 2});
+}
+
+void traceRepeatedArgument(TraceProvider& provider, int value) {
+    WPP_DO_TRACE(provider, 1, TraceLevel::Information, "{0} = {0:#x}", value);
+    WPP_DO_TRACE(provider, 1, TraceLevel::Information, "{0:d} {0:x}", value);
+}
+
+#endif
+
+}  // namespace
+
+TEST_CASE("Struct metadata records", "[InlineMetadata]") {
+    STATIC_REQUIRE(toStringView(makeStructFieldNames<InlinePoint>()) ==
+                   std::string_view("x, y", sizeof("x, y")));
+
+    const auto& payload = StructMetadataRecord<InlinePoint>::value();
+    const std::string_view record(payload.data(), payload.size());
+    REQUIRE(record.substr(0, sizeof("TMF_NG_STRUCT:")) ==
+            std::string_view("TMF_NG_STRUCT:", sizeof("TMF_NG_STRUCT:")));
+    REQUIRE(record.find("StructDescriptor<") != std::string_view::npos);
+    REQUIRE(record.find("InlinePoint>::annotate<") != std::string_view::npos);
+    REQUIRE(record.find("StructLayout<8") != std::string_view::npos);
+    REQUIRE(record.substr(record.size() - sizeof("x, y")) ==
+            std::string_view("x, y", sizeof("x, y")));
+}
+
+#ifndef _WIN32
+
+TEST_CASE("Inline metadata records", "[InlineMetadata]") {
+    TraceProvider provider(GUID{});
+    RecordingSink sink;
+    provider.enable(sink, 1, TraceLevel::Verbose);
+
+    SECTION("Records are traced before the first trace of the session") {
+        traceSite(provider, 1);
+        traceSite(provider, 2);
+
+        REQUIRE(sink.messages.size() == 4);
+        REQUIRE(sink.messages[0].isMetadata());
+        REQUIRE(sink.messages[0].data.find("TMF_NG_STRUCT:") == 0);
+        REQUIRE(sink.messages[1].isMetadata());
+        REQUIRE(sink.messages[1].data.find("TMF_NG:") == 0);
+        REQUIRE(sink.messages[1].data.find("Inline {} {}") != std::string::npos);
+        REQUIRE(sink.messages[1].data.find("TMF_NG_TYPES:") != std::string::npos);
+        REQUIRE_FALSE(sink.messages[2].isMetadata());
+        REQUIRE_FALSE(sink.messages[3].isMetadata());
+        REQUIRE(std::memcmp(&sink.messages[2].guid, &sink.messages[3].guid, sizeof(GUID)) == 0);
+    }
+
+    SECTION("Records are traced again in a new session") {
+        traceSite(provider, 1);
+        provider.enable(sink, 1, TraceLevel::Verbose);
+        traceSite(provider, 2);
+
+        REQUIRE(sink.messages.size() == 6);
+        REQUIRE(sink.messages[3].isMetadata());
+        REQUIRE(sink.messages[4].isMetadata());
+        REQUIRE(sink.messages[4].data == sink.messages[1].data);
+    }
+
+    SECTION("Disabled traces don't trace records") {
+        provider.disable();
+        traceSite(provider, 1);
+        provider.enable(sink, 1, TraceLevel::Verbose);
+        traceSite(provider, 2);
+
+        REQUIRE(sink.messages.size() == 3);
+        REQUIRE(sink.messages[0].isMetadata());
+    }
+}
+
+TEST_CASE("Repeated argument references", "[InlineMetadata]") {
+    TraceProvider provider(GUID{});
+    RecordingSink sink;
+    provider.enable(sink, 1, TraceLevel::Verbose);
+    traceRepeatedArgument(provider, 10);
+
+    // The argument is traced once, as a single Int32Item which the decoders format per field
+    REQUIRE(sink.messages.size() == 4);
+    for (const size_t index : {0, 2}) {
+        const auto& metadata = sink.messages[index];
+        REQUIRE(metadata.isMetadata());
+        REQUIRE(metadata.data.find("TMF_NG_TYPES:") != std::string::npos);
+        REQUIRE(metadata.data.find("Int32Item") != std::string::npos);
+
+        const auto& trace = sink.messages[index + 1];
+        REQUIRE_FALSE(trace.isMetadata());
+        int32_t value = 0;
+        REQUIRE(trace.data.size() == sizeof(value));
+        std::memcpy(&value, trace.data.data(), sizeof(value));
+        REQUIRE(value == 10);
+    }
+    REQUIRE(sink.messages[0].data.find("{0} = {0:#x}") != std::string::npos);
+    REQUIRE(sink.messages[2].data.find("{0:d} {0:x}") != std::string::npos);
+}
+
+#endif
@@ -0,0 +1,66 @@
+#include "catch.hpp"
+
+#include "wpp/Trace.h"
+
+using namespace wpp::internal;
+using namespace wpp;
+
+namespace {
+
+enum Keywords : uint64_t {
+    Network = 1 << 0,
+    Disk = 1 << 1,
+    Memory = 1ull << 40,
+};
+
+enum class ScopedKeywords : uint8_t {
+    First = 1,
+};
+
+}  // namespace
+
+TEST_CASE("Keyword matching", "[Keywords]") {
+    STATIC_REQUIRE(TraceKeywords(Network | Disk).isEnabled(Disk));
+    STATIC_REQUIRE(TraceKeywords(Memory).isEnabled(Memory | Network));
+    STATIC_REQUIRE_FALSE(TraceKeywords(Network | Disk).isEnabled(Memory));
+    STATIC_REQUIRE_FALSE(TraceKeywords(Network).isEnabled(0));
+
+    STATIC_REQUIRE(allOf(Network | Memory).isEnabled(Network | Disk | Memory));
+    STATIC_REQUIRE_FALSE(allOf(Network | Memory).isEnabled(Network | Disk));
+    STATIC_REQUIRE(anyOf(Network | Memory).isEnabled(Memory));
+
+    STATIC_REQUIRE(makeTraceKeywords(ScopedKeywords::First).mask == 1);
+    STATIC_REQUIRE(makeTraceKeywords(Memory).match == TraceKeywords::Match::Any);
+    STATIC_REQUIRE(makeTraceKeywords(allOf(Disk)).match == TraceKeywords::Match::All);
+}
+
+#ifndef _WIN32
+
+namespace {
+
+struct NullSink : TraceSink {
+    void write(const GUID&, const TracePair*, size_t) noexcept override {
+        // Intentionally left blank.
+    }
+};
+
+}  // namespace
+
+TEST_CASE("Enabled keywords", "[Keywords]") {
+    TraceProvider provider(GUID{});
+    NullSink sink;
+    REQUIRE_FALSE(provider.areTracesEnabled(Network, TraceLevel::Critical));
+
+    provider.enable(sink, Network | Memory, TraceLevel::Warning);
+    REQUIRE(provider.areTracesEnabled(Memory, TraceLevel::Error));
+    REQUIRE(provider.areTracesEnabled(Network | Disk, TraceLevel::Warning));
+    REQUIRE(provider.areTracesEnabled(allOf(Network | Memory), TraceLevel::Warning));
+    REQUIRE_FALSE(provider.areTracesEnabled(allOf(Network | Disk), TraceLevel::Warning));
+    REQUIRE_FALSE(provider.areTracesEnabled(Disk, TraceLevel::Error));
+    REQUIRE_FALSE(provider.areTracesEnabled(Network, TraceLevel::Information));
+
+    provider.disable();
+    REQUIRE_FALSE(provider.areTracesEnabled(Network, TraceLevel::Critical));
+}
+
+#endif
@@ -0,0 +1,75 @@
+#include "catch.hpp"
+
+#include "wpp/Metadata.h"
+
+using namespace wpp::internal;
+
+namespace {
+
+/**
+ * Records return a reference to their payload, as done by __WPP_DEFINE_METADATA_RECORD.
+ */
+struct TestRecord {
+    static constexpr const auto& value() {
+        return payload;
+    }
+
+    static constexpr const auto payload =
+        makeMetadataString("TMF_NG:") + makeMetadataString("abcde");
+};
+
+struct LongRecord {
+    static constexpr const auto& value() {
+        return payload;
+    }
+
+    static constexpr const ConstexprString<METADATA_CHUNK_SIZE + 1> payload =
+        makeString<METADATA_CHUNK_SIZE + 1>(
+            "0123456789012345678901234567890123456789012345678901234567890123456789012345678901"
+            "234567890123456");
+};
+
+}  // namespace
+
+TEST_CASE("Metadata strings include the null terminator", "[Metadata]") {
+    constexpr const auto string = makeMetadataString("ab");
+
+    STATIC_REQUIRE(string.size() == 3);
+    STATIC_REQUIRE(string == makeString("ab") + makeString<1>("\0"));
+}
+
+TEST_CASE("Type names", "[Metadata]") {
+    STATIC_REQUIRE(TypeName<int>::value == makeString("int"));
+    STATIC_REQUIRE(TypeName<double>::value == makeString("double"));
+#ifdef _MSC_VER
+    STATIC_REQUIRE(TypeName<TestRecord>::value ==
+                   makeString("struct `anonymous namespace'::TestRecord"));
+#else
+    STATIC_REQUIRE(TypeName<TestRecord>::value == makeString("{anonymous}::TestRecord"));
+#endif
+}
+
+TEST_CASE("Metadata chunks", "[Metadata]") {
+    using Chunks = MetadataChunks<TestRecord>;
+
+    STATIC_REQUIRE(Chunks::size == 14);
+    STATIC_REQUIRE(Chunks::count == 1);
+    STATIC_REQUIRE(Chunks::id == fnv1a(TestRecord::value()));
+    STATIC_REQUIRE(Chunks::id != MetadataChunks<LongRecord>::id);
+
+    SECTION("Words are little endian") {
+        STATIC_REQUIRE(Chunks::word(0) == 0x5f464d54);  // "TMF_"
+        STATIC_REQUIRE(Chunks::word(1) == 0x003a474e);  // "NG:\0"
+    }
+
+    SECTION("The last word is zero-padded") {
+        STATIC_REQUIRE(Chunks::word(3) == 0x00000065);  // "e\0"
+        STATIC_REQUIRE(Chunks::word(4) == 0);
+        STATIC_REQUIRE(Chunks::word(METADATA_CHUNK_WORDS - 1) == 0);
+    }
+
+    SECTION("Long records are split") {
+        STATIC_REQUIRE(MetadataChunks<LongRecord>::count == 2);
+        STATIC_REQUIRE(MetadataChunks<LongRecord>::word(METADATA_CHUNK_WORDS) == 0x00000036);
+    }
+}
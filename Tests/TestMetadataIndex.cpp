@@ -0,0 +1,192 @@
+#include "catch.hpp"
+
+// The call site registry must be enabled for the whole program, so this file is built by the
+// TestsInlineMetadata project, which defines WPP_ENABLE_CALL_SITE_REGISTRY for all its files.
+#ifndef WPP_ENABLE_CALL_SITE_REGISTRY
+#error "Build this file with WPP_ENABLE_CALL_SITE_REGISTRY (see TestsInlineMetadata.vcxproj)"
+#endif
+#include "wpp/Trace.h"
+#include "wpp/MetadataIndex.h"
+
+using namespace wpp;
+
+struct IndexedPoint {
+    int32_t x;
+    int32_t y;
+};
+
+WPP_DEFINE_STRUCT_ITEM(IndexedPoint, x, y);
+
+namespace {
+
+constexpr const GUID FIRST_GUID = {0x01020304, 0x0506, 0x0708, {9, 10, 11, 12, 13, 14, 15, 16}};
+constexpr const GUID SECOND_GUID = {0x01020305, 0x0506, 0x0708, {9, 10, 11, 12, 13, 14, 15, 16}};
+
+std::vector<uint8_t> writeTestIndex() {
+    MetadataIndexWriter writer;
+    writer.addTrace({SECOND_GUID, "Tests/b.cpp", 20, "void g()", "WPP_FLAG_2", "Error",
+                     "{{literal}} {:x}, {} done", "a, b", {"wpp::Int32Item", "wpp::StringItem"}});
+    writer.addTrace({FIRST_GUID, "Tests/a.cpp", 10, "void f()", "WPP_FLAG_1", "Information",
+                     "no arguments", "", {}});
+    writer.addStruct({"Point",
+                      8,
+                      {{"x", 0, 4, "wpp::Int32Item"}, {"y", 4, 4, "wpp::Int32Item"}}});
+    return writer.write();
+}
+
+const MetadataIndexTrace* findTraceByFormat(const MetadataIndex& index, std::string_view format) {
+    for (size_t i = 0; i < index.traceCount(); ++i) {
+        if (index.string(index.trace(i).format) == format) {
+            return &index.trace(i);
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * The traces of this function are registered, although it is never called.
+ */
+[[maybe_unused]] void registeredTraces(TraceProvider& provider) {
+    WPP_DO_TRACE(provider, 1, TraceLevel::Information, "Registered {} {:x}", 1, 2u);
+    WPP_DO_TRACE(provider, 2, TraceLevel::Error, "Registered point {}", IndexedPoint{3, 4});
+}
+
+}  // namespace
+
+TEST_CASE("Metadata index traces", "[MetadataIndex]") {
+    const auto data = writeTestIndex();
+    REQUIRE(data.size() % sizeof(uint32_t) == 0);
+
+    const MetadataIndex index(data.data(), data.size());
+    REQUIRE(index.isValid());
+    REQUIRE(index.traceCount() == 2);
+
+    SECTION("Traces are sorted by GUID") {
+        uint8_t bytes[16];
+        internal::writeGuidBytes(FIRST_GUID, bytes);
+        REQUIRE(std::memcmp(index.trace(0).guid, bytes, sizeof(bytes)) == 0);
+        REQUIRE(index.findTrace(FIRST_GUID) == &index.trace(0));
+        REQUIRE(index.findTrace(SECOND_GUID) == &index.trace(1));
+        REQUIRE(index.findTrace(GUID{}) == nullptr);
+    }
+
+    SECTION("Trace information") {
+        const auto* trace = index.findTrace(SECOND_GUID);
+        REQUIRE(trace != nullptr);
+        REQUIRE(index.string(trace->file) == "Tests/b.cpp");
+        REQUIRE(trace->line == 20);
+        REQUIRE(index.string(trace->function) == "void g()");
+        REQUIRE(index.string(trace->flag) == "WPP_FLAG_2");
+        REQUIRE(index.string(trace->level) == "Error");
+        REQUIRE(index.string(trace->args) == "a, b");
+    }
+
+    SECTION("Formats are pre-parsed") {
+        const auto* trace = index.findTrace(SECOND_GUID);
+        REQUIRE(trace->argumentCount == 2);
+        const auto* arguments = index.arguments(*trace);
+        REQUIRE(arguments != nullptr);
+        REQUIRE(index.string(arguments[0].type) == "wpp::Int32Item");
+        REQUIRE(index.string(arguments[0].prefix) == "{literal} ");
+        REQUIRE(index.string(arguments[0].spec) == "x");
+        REQUIRE(index.string(arguments[1].type) == "wpp::StringItem");
+        REQUIRE(index.string(arguments[1].prefix) == ", ");
+        REQUIRE(index.string(arguments[1].spec).empty());
+        REQUIRE(index.string(trace->suffix) == " done");
+
+        const auto* other = index.findTrace(FIRST_GUID);
+        REQUIRE(other->argumentCount == 0);
+        REQUIRE(index.string(other->suffix) == "no arguments");
+    }
+
+    SECTION("Strings are interned") {
+        const auto* arguments = index.arguments(*index.findTrace(SECOND_GUID));
+        const auto* point = index.findStruct("Point");
+        REQUIRE(point != nullptr);
+        REQUIRE(index.fields(*point)[0].type == arguments[0].type);
+        REQUIRE(index.string(0).empty());
+    }
+}
+
+TEST_CASE("Metadata index structs", "[MetadataIndex]") {
+    const auto data = writeTestIndex();
+    const MetadataIndex index(data.data(), data.size());
+
+    REQUIRE(index.structCount() == 1);
+    REQUIRE(index.findStruct("Other") == nullptr);
+    const auto* point = index.findStruct("Point");
+    REQUIRE(point != nullptr);
+    REQUIRE(point->size == 8);
+    REQUIRE(point->fieldCount == 2);
+    const auto* fields = index.fields(*point);
+    REQUIRE(index.string(fields[1].name) == "y");
+    REQUIRE(fields[1].offset == 4);
+    REQUIRE(fields[1].size == 4);
+}
+
+TEST_CASE("Invalid metadata indices", "[MetadataIndex]") {
+    auto data = writeTestIndex();
+
+    REQUIRE_FALSE(MetadataIndex(data.data(), sizeof(MetadataIndexHeader) - 1).isValid());
+    REQUIRE_FALSE(MetadataIndex(data.data(), data.size() - 8).isValid());
+
+    SECTION("Bad magic") {
+        data[0] ^= 0xff;
+        REQUIRE_FALSE(MetadataIndex(data.data(), data.size()).isValid());
+    }
+
+    SECTION("Unsupported version") {
+        reinterpret_cast<MetadataIndexHeader*>(data.data())->version++;
+        REQUIRE_FALSE(MetadataIndex(data.data(), data.size()).isValid());
+    }
+}
+
+TEST_CASE("Duplicate metadata index entries", "[MetadataIndex]") {
+    MetadataIndexWriter writer;
+    writer.addTrace({FIRST_GUID, "a.cpp", 1, "f", "WPP_FLAG_1", "Error", "first", "", {}});
+    writer.addTrace({FIRST_GUID, "a.cpp", 1, "f", "WPP_FLAG_1", "Error", "second", "", {}});
+    const auto data = writer.write();
+    const MetadataIndex index(data.data(), data.size());
+
+    REQUIRE(index.traceCount() == 1);
+    REQUIRE(index.string(index.trace(0).format) == "first");
+}
+
+TEST_CASE("Call site registry", "[MetadataIndex]") {
+    const auto data = CallSiteRegistry::instance().writeIndex();
+    const MetadataIndex index(data.data(), data.size());
+    REQUIRE(index.isValid());
+
+    SECTION("Call sites are registered") {
+        const auto* trace = findTraceByFormat(index, "Registered {} {:x}");
+        REQUIRE(trace != nullptr);
+        REQUIRE(index.string(trace->file).find("TestMetadataIndex.cpp") != std::string_view::npos);
+        REQUIRE(index.string(trace->flag) == "WPP_FLAG_1");
+        REQUIRE(index.string(trace->level) == "Information");
+        REQUIRE(index.string(trace->args) == "1, 2u");
+        REQUIRE(index.string(trace->function).find("registeredTraces") != std::string_view::npos);
+
+        REQUIRE(trace->argumentCount == 2);
+        const auto* arguments = index.arguments(*trace);
+        REQUIRE(index.string(arguments[0].type).find("Int32Item") != std::string_view::npos);
+        REQUIRE(index.string(arguments[1].type).find("UInt32Item") != std::string_view::npos);
+        REQUIRE(index.string(arguments[1].prefix) == " ");
+        REQUIRE(index.string(arguments[1].spec) == "x");
+    }
+
+    SECTION("Traced structs are registered") {
+        const auto* trace = findTraceByFormat(index, "Registered point {}");
+        REQUIRE(trace != nullptr);
+        REQUIRE(index.string(trace->level) == "Error");
+        REQUIRE(index.string(index.arguments(*trace)[0].type).find("StructItem") !=
+                std::string_view::npos);
+
+        const auto* point = index.findStruct(internal::makeStringView(
+            internal::TypeName<IndexedPoint>::value));
+        REQUIRE(point != nullptr);
+        REQUIRE(point->size == sizeof(IndexedPoint));
+        REQUIRE(point->fieldCount == 2);
+        REQUIRE(index.string(index.fields(*point)[1].name) == "y");
+        REQUIRE(index.fields(*point)[1].offset == offsetof(IndexedPoint, y));
+    }
+}
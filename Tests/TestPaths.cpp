@@ -1,5 +1,6 @@
 #include "catch.hpp"
 
+#include <string_view>
 #include "wpp/PathUtils.h"
 
 TEST_CASE("Path", "[Paths]") {
@@ -8,3 +9,18 @@ TEST_CASE("Path", "[Paths]") {
     STATIC_REQUIRE(wpp::internal::getBaseDirectoryIndex("some\\directory\\file.txt") == 5);
     STATIC_REQUIRE(wpp::internal::getBaseDirectoryIndex("C:\\some\\directory\\file.txt") == 8);
 }
+
+TEST_CASE("Unix paths", "[Paths]") {
+    STATIC_REQUIRE(wpp::internal::getBaseDirectoryIndex("directory/file.txt") == 0);
+    STATIC_REQUIRE(wpp::internal::getBaseDirectoryIndex("/home/user/project/file.cpp") == 11);
+    STATIC_REQUIRE(wpp::internal::getBaseDirectoryIndex("../project/file.cpp") == 3);
+    STATIC_REQUIRE(wpp::internal::getBaseDirectoryIndex("/file.cpp") == 0);
+    STATIC_REQUIRE(wpp::internal::getBaseDirectoryIndex("C:/some\\directory/file.txt") == 8);
+
+    // Paths remapped by -ffile-prefix-map (or -fmacro-prefix-map) keep their last directory, so
+    // the hashed path is the same as the one of the original path.
+    constexpr const char original[] = "/build/agent-7/src/project/file.cpp";
+    constexpr const char remapped[] = "./project/file.cpp";
+    STATIC_REQUIRE(std::string_view(original + wpp::internal::getBaseDirectoryIndex(original)) ==
+                   std::string_view(remapped + wpp::internal::getBaseDirectoryIndex(remapped)));
+}
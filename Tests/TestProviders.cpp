@@ -0,0 +1,70 @@
+#include "catch.hpp"
+
+#include "wpp/DefaultTracing.h"
+
+using namespace wpp::internal;
+using namespace wpp;
+
+namespace {
+
+WPP_DEFINE_TRACE_PROVIDER(g_firstProvider, "first",
+                          GUID{0x6f7e1a2b, 0x1c2d, 0x4e5f, {1, 2, 3, 4, 5, 6, 7, 8}});
+WPP_DEFINE_TRACE_PROVIDER(g_secondProvider, "second",
+                          GUID{0x6f7e1a2b, 0x1c2d, 0x4e5f, {1, 2, 3, 4, 5, 6, 7, 9}});
+
+}  // namespace
+
+TEST_CASE("Provider layout", "[Providers]") {
+    // The enable words of every provider are on their own cache lines.
+    STATIC_REQUIRE(alignof(TraceProvider) >= CACHE_LINE_SIZE);
+    STATIC_REQUIRE(alignof(NamedTraceProvider) >= CACHE_LINE_SIZE);
+}
+
+TEST_CASE("Provider registry", "[Providers]") {
+    auto& registry = TraceProviderRegistry::instance();
+    REQUIRE(registry.find("first") == &g_firstProvider);
+    REQUIRE(registry.find("second") == &g_secondProvider);
+    REQUIRE(registry.find("third") == nullptr);
+    REQUIRE(g_secondProvider.name() == "second");
+}
+
+#ifndef _WIN32
+
+namespace {
+
+struct NullSink : TraceSink {
+    void write(const GUID&, const TracePair*, size_t) noexcept override {
+        // Intentionally left blank.
+    }
+};
+
+}  // namespace
+
+TEST_CASE("Independent providers", "[Providers]") {
+    NullSink sink;
+    REQUIRE_FALSE(g_firstProvider.areTracesEnabled(1, TraceLevel::Critical));
+    REQUIRE_FALSE(g_wppDefaultProvider.areTracesEnabled(1, TraceLevel::Critical));
+
+    TraceProviderRegistry::instance().find("first")->enable(sink, 1, TraceLevel::Verbose);
+    REQUIRE(g_firstProvider.areTracesEnabled(1, TraceLevel::Verbose));
+    REQUIRE_FALSE(g_secondProvider.areTracesEnabled(1, TraceLevel::Critical));
+    REQUIRE_FALSE(g_wppDefaultProvider.areTracesEnabled(1, TraceLevel::Critical));
+
+    g_firstProvider.stop();
+    REQUIRE_FALSE(g_firstProvider.areTracesEnabled(1, TraceLevel::Critical));
+}
+
+TEST_CASE("Default provider", "[Providers]") {
+    // The trace macros can be used before the provider is started.
+    WPP_TRACE_INFO("Not traced {}", 1);
+
+    NullSink sink;
+    WppTraceGuard guard{GUID{}};
+    g_wppDefaultProvider.enable(sink, 1, TraceLevel::Information);
+    REQUIRE(g_wppDefaultProvider.areTracesEnabled(1, TraceLevel::Information));
+    WPP_TRACE_INFO("Traced {}", 2);
+    WPP_TRACE_INFO("Traced standard integers {} {:x} {}", 3LL, 4ULL, sizeof(int));
+    REQUIRE_FALSE(g_wppDefaultProvider.areTracesEnabled(1, TraceLevel::Verbose));
+}
+
+#endif
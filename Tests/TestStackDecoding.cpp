@@ -0,0 +1,68 @@
+#include "catch.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../tools/WppExtract/TraceItems.h"
+
+using namespace wpp::tools;
+
+namespace {
+
+constexpr const StreamModuleId KNOWN_MODULE = {0x01, 0x02, 0x03, 0x04};
+constexpr const StreamModuleId UNKNOWN_MODULE = {0xaa, 0xbb};
+
+/**
+ * Resolves offset 0x20 of KNOWN_MODULE as `app!function`.
+ */
+class TestSymbols : public SymbolResolver {
+public:
+    bool appendSymbol(uint16_t, uint64_t, std::string&) const override {
+        return false;
+    }
+
+    bool appendSymbol(const StreamModuleId& module, uint64_t offset,
+                      std::string& output) const override {
+        if (module != KNOWN_MODULE || offset != 0x20) {
+            return false;
+        }
+        output += "app!function";
+        return true;
+    }
+};
+
+void appendFrame(std::vector<uint8_t>& data, uint64_t moduleIndex, uint64_t offset) {
+    const uint64_t frame = (moduleIndex << 48) | offset;
+    for (size_t i = 0; i < sizeof(frame); ++i) {
+        data.push_back(static_cast<uint8_t>(frame >> (i * 8)));
+    }
+}
+
+}  // namespace
+
+TEST_CASE("Stack frames are symbolized", "[StackDecoding]") {
+    // 4 frames and 2 modules, prefixed by the size of the stack
+    std::vector<uint8_t> data = {2 + 2 * sizeof(StreamModuleId) + 4 * sizeof(uint64_t), 0, 4, 2};
+    data.insert(data.end(), KNOWN_MODULE.begin(), KNOWN_MODULE.end());
+    data.insert(data.end(), UNKNOWN_MODULE.begin(), UNKNOWN_MODULE.end());
+    appendFrame(data, 0, 0x20);
+    appendFrame(data, 1, 0x30);
+    appendFrame(data, 0xffff, 0x7f0040);
+    appendFrame(data, 0, 0x2000);
+
+    const auto item = makeTraceItem("StackItem", {});
+    const TestSymbols symbols;
+    std::string output;
+    REQUIRE(item->decode(TraceData{data.data(), data.size(), &symbols}, 0,
+                         wpp::internal::parseFormatSpec(""), output) == data.size());
+    REQUIRE(output == "stack: #0 app!function, "
+                      "#1 <aabb000000000000000000000000000000000000>+0x30, #2 0x7f0040, "
+                      "#3 <0102030400000000000000000000000000000000>+0x2000");
+
+    // Without symbols, the stack is printed as hex
+    output.clear();
+    REQUIRE(item->decode(TraceData{data.data(), data.size()}, 0,
+                         wpp::internal::parseFormatSpec(""), output) == data.size());
+    REQUIRE(output.rfind("stack:04 02 01 02 03 04 00", 0) == 0);
+}
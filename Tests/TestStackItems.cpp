@@ -0,0 +1,125 @@
+#include "catch.hpp"
+
+#include <cstring>
+#include <string>
+#include "wpp/Trace.h"
+
+using namespace wpp::internal;
+using namespace wpp;
+
+__WPP_NOINLINE static StackItem captureFromFunction() {
+    return buildTraceItem<FormatString<'s', 't', 'a', 'c', 'k'>>(currentStack);
+}
+
+#ifndef _WIN32
+
+namespace {
+
+/**
+ * A sink keeping the data of the last traced message.
+ */
+struct LastMessageSink : TraceSink {
+    void write(const GUID&, const TracePair* pairs, size_t count) noexcept override {
+        data.clear();
+        for (size_t i = 0; i < count; ++i) {
+            data.append(static_cast<const char*>(pairs[i].ptr), pairs[i].size);
+        }
+    }
+
+    std::string data;
+};
+
+/**
+ * Traces the stack, and captures it directly right afterwards.
+ */
+__WPP_NOINLINE StackItem traceFromFunction(TraceProvider& provider) {
+    WPP_DO_TRACE(provider, 1, TraceLevel::Information, "{:stack}", currentStack);
+    return StackItem{CapturedStack{}};
+}
+
+}  // namespace
+
+#endif
+
+TEST_CASE("Stack trace item types", "[StackItems]") {
+    STATIC_REQUIRE(
+        std::is_same_v<decltype(buildTraceItem<FormatString<>>(currentStack)), StackItem>);
+    STATIC_REQUIRE(std::is_same_v<decltype(buildTraceItem<FormatString<'s', 't', 'a', 'c', 'k'>>(
+                                      currentStack)),
+                                  StackItem>);
+    STATIC_REQUIRE(std::is_same_v<decltype(buildTraceItem<FormatString<'x'>>(currentStack)),
+                                  InvalidFormatItem>);
+}
+
+TEST_CASE("Module-relative addresses", "[StackItems]") {
+    STATIC_REQUIRE(encodeModuleAddress(1, 0x1234) == 0x0001000000001234);
+    STATIC_REQUIRE(encodeModuleAddress(UNKNOWN_MODULE_INDEX, 0x123400000000abcd) ==
+                   0xffff00000000abcd);
+
+    ModuleInfo info;
+    REQUIRE(findModule(reinterpret_cast<const void*>(&captureFromFunction), info));
+    REQUIRE(info.base <= reinterpret_cast<uintptr_t>(&captureFromFunction));
+}
+
+TEST_CASE("Stack trace capture", "[StackItems]") {
+    const auto item = captureFromFunction();
+    REQUIRE(item.frameCount() > 0);
+    REQUIRE(item.frameCount() <= WPP_MAX_STACK_FRAMES);
+    REQUIRE(item.moduleCount() > 0);
+
+    const auto pairs = item.makeTracePairs();
+    const auto& size = std::get<0>(pairs);
+    const auto& header = std::get<1>(pairs);
+    const auto& modules = std::get<2>(pairs);
+    const auto& frames = std::get<3>(pairs);
+
+    // The size prefix covers the rest of the data
+    REQUIRE(*static_cast<const uint16_t*>(size.ptr) == header.size + modules.size + frames.size);
+    REQUIRE(modules.size == item.moduleCount() * sizeof(ModuleId));
+    REQUIRE(frames.size == item.frameCount() * sizeof(uint64_t));
+
+    // The first frame is inside the test module, which is the first module
+    ModuleInfo info;
+    REQUIRE(findModule(reinterpret_cast<const void*>(&captureFromFunction), info));
+    REQUIRE(std::memcmp(modules.ptr, &info.id, sizeof(ModuleId)) == 0);
+    REQUIRE(*static_cast<const uint64_t*>(frames.ptr) >> MODULE_OFFSET_BITS == 0);
+
+    // The modules of the frames are resolved through the module registry, which caches them
+    auto& registry = ModuleRegistry::instance();
+    const size_t moduleCount = registry.size();
+    REQUIRE(moduleCount > 0);
+    REQUIRE(registry.getModuleIndex(reinterpret_cast<const void*>(&captureFromFunction)) !=
+            UNKNOWN_MODULE_INDEX);
+    REQUIRE(captureFromFunction().moduleCount() == item.moduleCount());
+    REQUIRE(registry.size() == moduleCount);
+}
+
+#ifndef _WIN32
+
+TEST_CASE("Stack trace of a trace macro", "[StackItems]") {
+    TraceProvider provider(GUID{});
+    LastMessageSink sink;
+    provider.enable(sink, 1, TraceLevel::Verbose);
+    const auto direct = traceFromFunction(provider);
+    provider.disable();
+
+    const auto pairs = direct.makeTracePairs();
+    const auto& frames = std::get<3>(pairs);
+    REQUIRE(direct.frameCount() > 1);
+    REQUIRE(sink.data.size() == sizeof(uint16_t) + std::get<1>(pairs).size +
+                                    std::get<2>(pairs).size + frames.size);
+    uint64_t traced[WPP_MAX_STACK_FRAMES];
+    std::memcpy(traced, sink.data.data() + sink.data.size() - frames.size, frames.size);
+    const auto* captured = static_cast<const uint64_t*>(frames.ptr);
+
+    // The stack is captured at the call site, so the first frame is in the calling function rather
+    // than in the internal trace functions - and the frames of its callers are the same as the
+    // frames of the direct capture. The order of the code within the function isn't checked, as
+    // the compiler may reorder it.
+    REQUIRE(static_cast<uint8_t>(sink.data[sizeof(uint16_t)]) == direct.frameCount());
+    for (size_t i = 1; i < direct.frameCount(); ++i) {
+        REQUIRE(traced[i] == captured[i]);
+    }
+}
+
+#endif
@@ -59,4 +59,26 @@ TEST_CASE("Fixed strings", "[String]") {
     STATIC_REQUIRE(WordType2::value() == "WORD");
 
     STATIC_REQUIRE(std::is_same_v<WordType, WordType2>);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Fixed strings with embedded null characters", "[String]") {
+    __WPP_STRING_MAKER(NullType, "A\0B");
+    STATIC_REQUIRE(NullType::size() == 3);
+    STATIC_REQUIRE(NullType::value() == std::string_view("A\0B", 3));
+
+    __WPP_STRING_MAKER(EmptyType, "");
+    STATIC_REQUIRE(EmptyType::size() == 0);
+    STATIC_REQUIRE(EmptyType::value().empty());
+}
+
+#ifdef __WPP_HAS_STRING_TEMPLATE_PARAMETERS
+
+TEST_CASE("Structural strings", "[String]") {
+    STATIC_REQUIRE(FixedStructuralString<makeStructuralString<'a', 'b'>()>::value() == "ab");
+    STATIC_REQUIRE(FixedStructuralString<makeStructuralString<>()>::size() == 0);
+
+    __WPP_STRING_MAKER(AbType, "ab");
+    STATIC_REQUIRE(std::is_same_v<AbType, FixedStructuralString<makeStructuralString<'a', 'b'>()>>);
+}
+
+#endif
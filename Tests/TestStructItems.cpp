@@ -0,0 +1,79 @@
+#include "catch.hpp"
+
+#include "wpp/Trace.h"
+
+struct Packet {
+    uint32_t src;
+    uint32_t dst;
+    uint16_t len;
+};
+WPP_DEFINE_STRUCT_ITEM(Packet, src, dst, len);
+
+struct Header {
+    Packet packet;
+    double timestamp;
+    const void* context;
+};
+WPP_DEFINE_STRUCT_ITEM(Header, packet, timestamp, context);
+
+struct NotRegistered {
+    int value;
+};
+
+using namespace wpp::internal;
+using namespace wpp;
+
+TEST_CASE("Struct descriptor", "[StructItems]") {
+    using Descriptor = StructDescriptor<Packet>;
+
+    STATIC_REQUIRE(Descriptor::fields.size() == 3);
+
+    STATIC_REQUIRE(Descriptor::fields[0].name == "src");
+    STATIC_REQUIRE(Descriptor::fields[0].offset == offsetof(Packet, src));
+    STATIC_REQUIRE(Descriptor::fields[0].size == sizeof(uint32_t));
+
+    STATIC_REQUIRE(Descriptor::fields[1].name == "dst");
+    STATIC_REQUIRE(Descriptor::fields[1].offset == offsetof(Packet, dst));
+    STATIC_REQUIRE(Descriptor::fields[1].size == sizeof(uint32_t));
+
+    STATIC_REQUIRE(Descriptor::fields[2].name == "len");
+    STATIC_REQUIRE(Descriptor::fields[2].offset == offsetof(Packet, len));
+    STATIC_REQUIRE(Descriptor::fields[2].size == sizeof(uint16_t));
+
+    STATIC_REQUIRE(std::is_same_v<Descriptor::FieldItems,
+                                  std::tuple<UInt32Item, UInt32Item, UInt16Item>>);
+}
+
+TEST_CASE("Nested struct descriptor", "[StructItems]") {
+    using Descriptor = StructDescriptor<Header>;
+
+    STATIC_REQUIRE(Descriptor::fields[0].name == "packet");
+    STATIC_REQUIRE(Descriptor::fields[0].size == sizeof(Packet));
+    STATIC_REQUIRE(Descriptor::fields[2].offset == offsetof(Header, context));
+
+    STATIC_REQUIRE(std::is_same_v<Descriptor::FieldItems,
+                                  std::tuple<StructItem<Packet>, DoubleItem, PointerItem>>);
+}
+
+TEST_CASE("Struct trace items", "[StructItems]") {
+    STATIC_REQUIRE(IsTraceableStruct<Packet>::value);
+    STATIC_REQUIRE_FALSE(IsTraceableStruct<NotRegistered>::value);
+
+    STATIC_REQUIRE(std::is_same_v<decltype(buildTraceItem<FormatString<>>(std::declval<Packet>())),
+                                  StructItem<Packet>>);
+    STATIC_REQUIRE(
+        std::is_same_v<decltype(buildTraceItem<FormatString<>>(std::declval<const Packet&>())),
+                       StructItem<Packet>>);
+    STATIC_REQUIRE(
+        std::is_same_v<decltype(buildTraceItem<FormatString<'x'>>(std::declval<Packet>())),
+                       InvalidFormatItem>);
+    STATIC_REQUIRE(
+        std::is_same_v<decltype(buildTraceItem<FormatString<>>(std::declval<NotRegistered>())),
+                       InvalidFormatItem>);
+
+    // The whole struct is traced as a single copy
+    const Packet packet{1, 2, 3};
+    const auto item = buildTraceItem<FormatString<>>(packet);
+    REQUIRE(item.getPtr() == &packet);
+    REQUIRE(item.getSize() == sizeof(Packet));
+}
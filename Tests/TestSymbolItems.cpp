@@ -0,0 +1,152 @@
+#include "catch.hpp"
+
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "wpp/Trace.h"
+
+using namespace wpp::internal;
+using namespace wpp;
+
+static int g_object = 0;
+
+static void function() {
+    // Intentionally left blank.
+}
+
+#ifndef _WIN32
+
+namespace {
+
+/**
+ * A sink keeping the GUIDs and the data of all the traced messages.
+ */
+struct MessagesSink : TraceSink {
+    void write(const GUID& messageGuid, const TracePair* pairs, size_t count) noexcept override {
+        std::string data;
+        for (size_t i = 0; i < count; ++i) {
+            data.append(static_cast<const char*>(pairs[i].ptr), pairs[i].size);
+        }
+        messages.emplace_back(messageGuid, std::move(data));
+    }
+
+    std::vector<std::pair<GUID, std::string>> messages;
+};
+
+}  // namespace
+
+#endif
+
+TEST_CASE("Symbol item types", "[SymbolItems]") {
+    STATIC_REQUIRE(std::is_same_v<decltype(buildTraceItem<FormatString<'s', 'y', 'm'>>(
+                                      std::declval<int*>())),
+                                  SymbolItem>);
+    STATIC_REQUIRE(std::is_same_v<decltype(buildTraceItem<FormatString<'s', 'y', 'm'>>(
+                                      std::declval<void (*)()>())),
+                                  SymbolItem>);
+    STATIC_REQUIRE(std::is_same_v<decltype(buildTraceItem<FormatString<'s', 'y', 'm'>>(
+                                      std::declval<const char*>())),
+                                  SymbolItem>);
+    STATIC_REQUIRE(
+        std::is_same_v<decltype(buildTraceItem<FormatString<'s', 'y', 'm'>>(std::declval<int>())),
+                       InvalidFormatItem>);
+
+    STATIC_REQUIRE(sizeof(SymbolItem) == sizeof(uint64_t));
+    STATIC_REQUIRE(UsesModuleRegistry<SymbolItem>::value);
+    STATIC_REQUIRE(UsesModuleRegistry<OptionalItem<SymbolItem>>::value);
+    STATIC_REQUIRE(UsesModuleRegistry<TupleItem<Int32Item, SymbolItem>>::value);
+    STATIC_REQUIRE_FALSE(UsesModuleRegistry<PointerItem>::value);
+    STATIC_REQUIRE_FALSE(UsesModuleRegistry<TupleItem<Int32Item, PointerItem>>::value);
+}
+
+TEST_CASE("Module registry", "[SymbolItems]") {
+    auto& registry = ModuleRegistry::instance();
+
+    const auto functionIndex = registry.getModuleIndex(reinterpret_cast<const void*>(&function));
+    const auto objectIndex = registry.getModuleIndex(&g_object);
+    REQUIRE(functionIndex != UNKNOWN_MODULE_INDEX);
+    REQUIRE(functionIndex == objectIndex);
+    REQUIRE(registry.size() > functionIndex);
+
+    const auto& module = registry[functionIndex];
+    REQUIRE(module.start <= reinterpret_cast<uintptr_t>(&g_object));
+    REQUIRE(module.end > reinterpret_cast<uintptr_t>(&g_object));
+
+    // Addresses outside of any module can't be registered
+    int local = 0;
+    REQUIRE(registry.getModuleIndex(&local) == UNKNOWN_MODULE_INDEX);
+}
+
+#ifndef _WIN32
+
+TEST_CASE("Traced modules", "[SymbolItems]") {
+    ModuleInfo info;
+    REQUIRE(findModule(reinterpret_cast<const void*>(&function), info));
+
+    ModuleId modules[WPP_MAX_MODULES];
+    const size_t count = getTracedModules(modules, WPP_MAX_MODULES);
+    REQUIRE(count > 0);
+
+    // The test binary includes the tracing headers, so it's marked as traced.
+    bool found = false;
+    for (size_t i = 0; i < count; ++i) {
+        found = found || std::memcmp(&modules[i], &info.id, sizeof(ModuleId)) == 0;
+    }
+    REQUIRE(found);
+
+    REQUIRE(getTracedModules(modules, 0) == 0);
+}
+
+#endif
+
+TEST_CASE("Symbol trace items", "[SymbolItems]") {
+    const auto item = buildTraceItem<FormatString<'s', 'y', 'm'>>(&g_object);
+    REQUIRE(item.getSize() == sizeof(uint64_t));
+
+    const auto& registry = ModuleRegistry::instance();
+    const auto value = *static_cast<const uint64_t*>(item.getPtr());
+    const auto index = value >> MODULE_OFFSET_BITS;
+    REQUIRE(index < registry.size());
+    REQUIRE((value & MODULE_OFFSET_MASK) ==
+            reinterpret_cast<uintptr_t>(&g_object) - registry[index].base);
+}
+
+TEST_CASE("Module load records", "[SymbolItems]") {
+    TraceProvider provider(GUID{});
+
+    // Each module is claimed only once in a session
+    REQUIRE(provider.claimUnreportedModules(2) == std::make_pair<size_t, size_t>(0, 2));
+    REQUIRE(provider.claimUnreportedModules(2) == std::make_pair<size_t, size_t>(2, 2));
+    REQUIRE(provider.claimUnreportedModules(3) == std::make_pair<size_t, size_t>(2, 3));
+
+    WPP_DO_TRACE(provider, 1, TraceLevel::Information, "Function: {:sym}", &function);
+}
+
+#ifndef _WIN32
+
+TEST_CASE("Module load records are traced with their reserved GUID", "[SymbolItems]") {
+    TraceProvider provider(GUID{});
+    MessagesSink sink;
+    provider.enable(sink, 1, TraceLevel::Information);
+    WPP_DO_TRACE(provider, 1, TraceLevel::Information, "Function: {:sym}", &function);
+    WPP_DO_TRACE(provider, 1, TraceLevel::Information, "Function: {:sym}", &function);
+    provider.disable();
+
+    // The records follow the first trace, and contain the module index and the module identifier
+    const auto& registry = ModuleRegistry::instance();
+    REQUIRE(sink.messages.size() == registry.size() + 2);
+    for (size_t i = 0; i < registry.size(); ++i) {
+        const auto& [guid, data] = sink.messages[i + 1];
+        REQUIRE(std::memcmp(&guid, &MODULE_LOAD_GUID, sizeof(GUID)) == 0);
+        REQUIRE(data.size() == 2 * sizeof(uint16_t) + sizeof(ModuleId));
+        uint16_t header[2];
+        std::memcpy(header, data.data(), sizeof(header));
+        REQUIRE(header[0] == i);
+        REQUIRE(header[1] == sizeof(ModuleId));
+        REQUIRE(std::memcmp(data.data() + sizeof(header), &registry[i].id, sizeof(ModuleId)) == 0);
+    }
+}
+
+#endif
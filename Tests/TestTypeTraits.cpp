@@ -104,6 +104,8 @@ TEST_CASE("RecursiveDecay", "[TypeTraits]") {
     STATIC_REQUIRE(std::is_same_v<RecursiveDecay<const volatile int* const&>, int*>);
     STATIC_REQUIRE(std::is_same_v<RecursiveDecay<volatile int[][10]>, int**>);
     STATIC_REQUIRE(std::is_same_v<RecursiveDecay<const int* const* const* const* const>, int****>);
+    STATIC_REQUIRE(std::is_same_v<RecursiveDecay<void (*const&)(int)>, void (*)(int)>);
+    STATIC_REQUIRE(std::is_same_v<RecursiveDecay<void (*const*)()>, void (**)()>);
 }
 
 TEST_CASE("UnderlyingType", "[TypeTraits]") {
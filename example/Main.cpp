@@ -9,6 +9,13 @@ constexpr const GUID CONTROL_GUID{
 
 #define TRACE_INFO(fmt, ...) WPP_TRACE_INFO(fmt, __VA_ARGS__)
 
+struct Packet {
+    uint32_t src;
+    uint32_t dst;
+    uint16_t len;
+};
+WPP_DEFINE_STRUCT_ITEM(Packet, src, dst, len);
+
 template<typename T>
 constexpr T maxVal() noexcept {
     return std::numeric_limits<T>::max();
@@ -64,6 +71,12 @@ int main() {
     TRACE_INFO("Long Double: {}, {:a}, {:A}, {:e}, {:E}, {:f}, {:F}, {:g}, {:G}", long_dbl,
                long_dbl, long_dbl, long_dbl, long_dbl, long_dbl, long_dbl, long_dbl, long_dbl);
     TRACE_INFO("GUID: {}", CONTROL_GUID);
+    TRACE_INFO("Struct: {}", Packet{1, 2, 3});
+    TRACE_INFO("Pair: {}, Tuple: {:x}", std::make_pair(1, "str"), std::make_tuple(1, 2u, int64));
+    TRACE_INFO("Optional: {}, {}", std::optional<int>{5}, std::optional<int>{});
+    TRACE_INFO("Variant: {}", std::variant<int, const char*>{"str"});
+    TRACE_INFO("Stack: {:stack}", wpp::currentStack);
+    TRACE_INFO("Symbol: {:sym}", &CONTROL_GUID);
 
     return 0;
 }
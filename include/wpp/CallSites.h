@@ -0,0 +1,168 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Platform.h"
+#include "MetadataIndex.h"
+#include "StructItems.h"
+
+namespace wpp {
+
+/**
+ * A trace call site, registered in the CallSiteRegistry.
+ */
+struct CallSite {
+    GUID guid;
+    /// The metadata record of the call site (see Metadata.h), including the trace item types.
+    std::string_view record;
+    const CallSite* next;
+};
+
+/**
+ * A struct registered using WPP_DEFINE_STRUCT_ITEM and traced by some call site, registered in the
+ * CallSiteRegistry.
+ */
+struct CallSiteStruct {
+    std::string_view name;
+    size_t size;
+    const StructFieldInfo* fields;
+    /// The trace item type names of the fields.
+    const std::string_view* fieldTypes;
+    size_t fieldCount;
+    const CallSiteStruct* next;
+};
+
+/**
+ * A process-wide registry of the trace call sites, used when WPP_ENABLE_CALL_SITE_REGISTRY is
+ * defined. Call sites are registered during static initialization, whether or not they are ever
+ * reached, so the registry can write the metadata index of the program without its PDB or its
+ * metadata section.
+ *
+ * The registry keeps the metadata of every call site in the binary, which is otherwise written to
+ * the PDB or to a non-allocated section only. This increases the binary size, and exposes the
+ * trace formats to anyone reading the binary - so it's disabled by default.
+ */
+class CallSiteRegistry {
+public:
+    static CallSiteRegistry& instance() noexcept {
+        static CallSiteRegistry registry;
+        return registry;
+    }
+
+    // Prevent copy operations
+    CallSiteRegistry(const CallSiteRegistry&) = delete;
+    CallSiteRegistry& operator=(const CallSiteRegistry&) = delete;
+
+    // Prevent move operations
+    CallSiteRegistry(CallSiteRegistry&&) = delete;
+    CallSiteRegistry& operator=(CallSiteRegistry&&) = delete;
+
+    void add(CallSite& site) noexcept {
+        push(m_sites, site);
+    }
+
+    void add(CallSiteStruct& info) noexcept {
+        push(m_structs, info);
+    }
+
+    /**
+     * The registered call sites, as a linked list (in no particular order).
+     */
+    const CallSite* sites() const noexcept {
+        return m_sites.load(std::memory_order_acquire);
+    }
+
+    /**
+     * The registered structs, as a linked list (in no particular order).
+     */
+    const CallSiteStruct* structs() const noexcept {
+        return m_structs.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Writes the metadata index (see MetadataIndex.h) of all the registered call sites. The index
+     * matches the one written by the metadata tools for the same binary.
+     */
+    std::vector<uint8_t> writeIndex() const {
+        MetadataIndexWriter writer;
+        for (const auto* site = sites(); site != nullptr; site = site->next) {
+            auto trace = parseRecord(*site);
+            // Numeric flags are named the same as in the legacy WPP flag definitions.
+            std::string flag;
+            if (!trace.flag.empty() &&
+                trace.flag.find_first_not_of("0123456789") == std::string_view::npos) {
+                flag = "WPP_FLAG_" + std::string(trace.flag);
+                trace.flag = flag;
+            }
+            writer.addTrace(trace);
+        }
+        for (const auto* info = structs(); info != nullptr; info = info->next) {
+            MetadataIndexWriter::Struct entry{info->name, static_cast<uint32_t>(info->size), {}};
+            for (size_t i = 0; i < info->fieldCount; ++i) {
+                entry.fields.push_back({info->fields[i].name,
+                                        static_cast<uint32_t>(info->fields[i].offset),
+                                        static_cast<uint32_t>(info->fields[i].size),
+                                        info->fieldTypes[i]});
+            }
+            writer.addStruct(entry);
+        }
+        return writer.write();
+    }
+
+private:
+    CallSiteRegistry() = default;
+
+    template<typename T>
+    static void push(std::atomic<const T*>& head, T& node) noexcept {
+        const T* next = head.load(std::memory_order_relaxed);
+        do {
+            node.next = next;
+        } while (!head.compare_exchange_weak(next, &node, std::memory_order_release,
+                                             std::memory_order_relaxed));
+    }
+
+    static std::string_view removePrefix(std::string_view value, std::string_view prefix) noexcept {
+        if (value.substr(0, prefix.size()) == prefix) {
+            value.remove_prefix(prefix.size());
+        }
+        return value;
+    }
+
+    /**
+     * Parses the metadata record of a call site, the same way as the metadata tools:
+     * "TMF_NG:", file, line, "FUNC=..", "FLAG=..", "LEVEL=..", format, args, "TMF_NG_TYPES:",
+     * followed by the item types.
+     */
+    static MetadataIndexWriter::Trace parseRecord(const CallSite& site) {
+        std::vector<std::string_view> strings;
+        for (size_t start = 0; start < site.record.size();) {
+            const size_t end = site.record.find('\0', start);
+            strings.push_back(site.record.substr(start, end - start));
+            start = end == std::string_view::npos ? end : end + 1;
+        }
+        strings.resize(std::max<size_t>(strings.size(), 9));
+
+        MetadataIndexWriter::Trace result{site.guid, strings[1], 0, {}, {}, {}, strings[6],
+                                          strings[7], {}};
+        for (const char c : strings[2]) {
+            result.line = result.line * 10 + static_cast<uint32_t>(c - '0');
+        }
+        result.function = removePrefix(strings[3], "FUNC=");
+        result.flag = removePrefix(strings[4], "FLAG=");
+        const size_t levelStart = strings[5].rfind("TraceLevel::");
+        result.level = levelStart == std::string_view::npos
+                           ? removePrefix(strings[5], "LEVEL=")
+                           : strings[5].substr(levelStart + sizeof("TraceLevel::") - 1);
+        result.types.assign(strings.begin() + 9, strings.end());
+        return result;
+    }
+
+    std::atomic<const CallSite*> m_sites{nullptr};
+    std::atomic<const CallSiteStruct*> m_structs{nullptr};
+};
+
+}  // namespace wpp
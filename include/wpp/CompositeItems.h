@@ -0,0 +1,250 @@
+#pragma once
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include "TraceItems.h"
+
+namespace wpp {
+
+namespace internal {
+
+/**
+ * The number of trace pairs generated by the given trace item type.
+ */
+template<typename T>
+constexpr size_t tracePairCount() {
+    return std::tuple_size_v<decltype(makeTracePairTuple(std::declval<const T&>()))>;
+}
+
+/**
+ * Generates a tuple of `count` empty trace pairs, used to keep a fixed number of trace pairs for
+ * items whose content changes at runtime. Empty pairs must still point to valid memory.
+ */
+template<size_t... Ixs>
+constexpr auto makeEmptyTracePairs(const void* ptr, std::index_sequence<Ixs...>) {
+    return std::make_tuple(TracePair{(static_cast<void>(Ixs), ptr), 0}...);
+}
+
+template<size_t N, size_t... Ixs>
+constexpr auto arrayToTuple(const std::array<TracePair, N>& pairs, std::index_sequence<Ixs...>) {
+    return std::make_tuple(pairs[Ixs]...);
+}
+
+/**
+ * Checks whether a value of the given type can be traced with the given format.
+ */
+template<typename T, typename Format>
+constexpr bool isTraceable() {
+    return !std::is_same_v<decltype(buildTraceItem<Format>(std::declval<const T&>())),
+                           InvalidFormatItem>;
+}
+
+/**
+ * The trace item type used for a value of the given type with the given format.
+ */
+template<typename T, typename Format>
+using TraceItemType = decltype(buildTraceItem<Format>(std::declval<const T&>()));
+
+}  // namespace internal
+
+/**
+ * A trace item for an optional value: a presence byte, followed by the value if it exists.
+ */
+template<typename Item>
+struct OptionalItem {
+    constexpr OptionalItem() : present(0) {
+        // Intentionally left blank.
+    }
+
+    explicit constexpr OptionalItem(Item&& item) : present(1), item(std::move(item)) {
+        // Intentionally left blank.
+    }
+
+    constexpr auto makeTracePairs() const {
+        const auto presence = std::make_tuple(TracePair{&present, sizeof(present)});
+        if (item) {
+            return std::tuple_cat(presence, internal::makeTracePairTuple(*item));
+        } else {
+            constexpr const size_t PAIR_COUNT = internal::tracePairCount<Item>();
+            return std::tuple_cat(presence, internal::makeEmptyTracePairs(
+                                                &present, std::make_index_sequence<PAIR_COUNT>()));
+        }
+    }
+
+private:
+    const uint8_t present;
+    std::optional<Item> item;
+};
+
+/**
+ * A trace item for a pair or a tuple: the trace items of all the elements, in order.
+ */
+template<typename... Items>
+struct TupleItem {
+    explicit constexpr TupleItem(Items&&... items) : items(std::move(items)...) {
+        // Intentionally left blank.
+    }
+
+    constexpr auto makeTracePairs() const {
+        return std::apply(
+            [](const auto&... elements) {
+                return std::tuple_cat(internal::makeTracePairTuple(elements)...);
+            },
+            items);
+    }
+
+private:
+    std::tuple<Items...> items;
+};
+
+/**
+ * A trace item for a variant: the index of the active alternative (as a byte), followed by the
+ * active alternative. A valueless variant is traced with an index of 0xff.
+ *
+ * In order to keep a fixed number of trace pairs, alternatives generating less trace pairs than
+ * others are followed by empty trace pairs.
+ */
+template<typename... Items>
+struct VariantItem {
+    static_assert(sizeof...(Items) < 0xff, "WPP: Too many variant alternatives!");
+
+    /// The first alternative of the items variant represents a valueless variant.
+    using ItemsVariant = std::variant<std::monostate, Items...>;
+
+    constexpr VariantItem(uint8_t index, ItemsVariant&& items)
+        : index(index), items(std::move(items)) {
+        // Intentionally left blank.
+    }
+
+    constexpr auto makeTracePairs() const {
+        std::array<TracePair, PAIR_COUNT> pairs{};
+        for (auto& pair : pairs) {
+            pair = {&index, 0};
+        }
+
+        std::visit(
+            [&pairs](const auto& item) {
+                if constexpr (!std::is_same_v<std::decay_t<decltype(item)>, std::monostate>) {
+                    std::apply(
+                        [&pairs](const auto&... itemPairs) {
+                            [[maybe_unused]] size_t i = 0;
+                            ((pairs[i++] = itemPairs), ...);
+                        },
+                        internal::makeTracePairTuple(item));
+                }
+            },
+            items);
+
+        return std::tuple_cat(
+            std::make_tuple(TracePair{&index, sizeof(index)}),
+            internal::arrayToTuple(pairs, std::make_index_sequence<PAIR_COUNT>()));
+    }
+
+private:
+    static constexpr const size_t PAIR_COUNT = std::max({internal::tracePairCount<Items>()...});
+
+    const uint8_t index;
+    ItemsVariant items;
+};
+
+namespace internal {
+
+/**
+ * Composite items are formatted by formatting their contents using the same format specification,
+ * so they support the options supported by all their contents.
+ */
+template<typename Item>
+struct SupportedFormatOptions<OptionalItem<Item>> : SupportedFormatOptions<Item> {};
+
+template<typename... Items>
+struct SupportedFormatOptions<TupleItem<Items...>>
+    : std::integral_constant<uint8_t,
+                             (FORMAT_OPTIONS_ALL & ... & SupportedFormatOptions<Items>::value)> {};
+
+template<typename... Items>
+struct SupportedFormatOptions<VariantItem<Items...>>
+    : SupportedFormatOptions<TupleItem<Items...>> {};
+
+}  // namespace internal
+
+/**
+ * Optional values are traced using the format of the value type.
+ */
+template<typename T, typename Format>
+struct TraceItemMaker<std::optional<T>, Format,
+                      std::enable_if_t<internal::isTraceable<T, Format>()>> {
+    static constexpr auto make(const std::optional<T>& value) {
+        using ItemType = OptionalItem<internal::TraceItemType<T, Format>>;
+        if (value) {
+            return ItemType{internal::buildTraceItem<Format>(*value)};
+        }
+        return ItemType{};
+    }
+};
+
+/**
+ * Pairs and tuples are traced using the same format for all the elements.
+ */
+template<typename First, typename Second, typename Format>
+struct TraceItemMaker<std::pair<First, Second>, Format,
+                      std::enable_if_t<internal::isTraceable<First, Format>() &&
+                                       internal::isTraceable<Second, Format>()>> {
+    static constexpr auto make(const std::pair<First, Second>& value) {
+        return TupleItem<internal::TraceItemType<First, Format>,
+                         internal::TraceItemType<Second, Format>>{
+            internal::buildTraceItem<Format>(value.first),
+            internal::buildTraceItem<Format>(value.second)};
+    }
+};
+
+template<typename... Ts, typename Format>
+struct TraceItemMaker<std::tuple<Ts...>, Format,
+                      std::enable_if_t<(internal::isTraceable<Ts, Format>() && ...)>> {
+    static constexpr auto make(const std::tuple<Ts...>& value) {
+        return std::apply(
+            [](const auto&... elements) {
+                return TupleItem<internal::TraceItemType<Ts, Format>...>{
+                    internal::buildTraceItem<Format>(elements)...};
+            },
+            value);
+    }
+};
+
+/**
+ * Variants are traced using the same format for all the alternatives.
+ */
+template<typename... Ts, typename Format>
+struct TraceItemMaker<std::variant<Ts...>, Format,
+                      std::enable_if_t<(internal::isTraceable<Ts, Format>() && ...)>> {
+    using ItemType = VariantItem<internal::TraceItemType<Ts, Format>...>;
+
+    static auto make(const std::variant<Ts...>& value) {
+        return makeFromIndex(value, std::index_sequence_for<Ts...>());
+    }
+
+private:
+    template<size_t Index>
+    static typename ItemType::ItemsVariant makeAlternative(const std::variant<Ts...>& value) {
+        // The first alternative is reserved for valueless variants
+        return typename ItemType::ItemsVariant{
+            std::in_place_index<Index + 1>,
+            internal::buildTraceItem<Format>(std::get<Index>(value))};
+    }
+
+    template<size_t... Ixs>
+    static auto makeFromIndex(const std::variant<Ts...>& value, std::index_sequence<Ixs...>) {
+        using AlternativeMaker = typename ItemType::ItemsVariant (*)(const std::variant<Ts...>&);
+        constexpr const AlternativeMaker makers[] = {&makeAlternative<Ixs>...};
+
+        if (value.valueless_by_exception()) {
+            return ItemType{0xff, typename ItemType::ItemsVariant{}};
+        }
+        return ItemType{static_cast<uint8_t>(value.index()), makers[value.index()](value)};
+    }
+};
+
+}  // namespace wpp
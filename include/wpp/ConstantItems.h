@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include "TraceItems.h"
+
+namespace wpp {
+
+/**
+ * A placeholder argument for a compile-time constant, which is folded into the metadata of the call
+ * site instead of being traced. For example:
+ *
+ *     WPP_TRACE_INFO("Entered state {}", wpp::constant<State::Connected>);
+ *
+ * Integral, character and enum values are supported, using the same specifiers as a traced value of
+ * their (underlying) type.
+ */
+template<auto value>
+struct Constant {};
+
+template<auto value>
+inline constexpr Constant<value> constant{};
+
+/**
+ * A trace item for a compile-time constant, formatted like a trace item of type Item. The wire
+ * representation of the value (zero-extended to 64 bits) is part of the item type, so it's written
+ * to the metadata of the call site, and the item takes no space in the traces - the decoder
+ * substitutes the value when formatting the trace.
+ */
+template<typename Item, uint64_t bits>
+struct ConstantItem {
+    constexpr std::tuple<> makeTracePairs() const {
+        return {};
+    }
+};
+
+namespace internal {
+
+template<auto value, typename Format>
+using ConstantValueMaker =
+    TraceItemMaker<RecursiveDecay<typename UnderlyingType<decltype(value)>::type>, Format>;
+
+/**
+ * Checks whether the given constant can be traced with the given format: it must be traceable as a
+ * value whose trace item holds an integer (such as Int32Item or WCharItem).
+ */
+template<auto value, typename Format, typename = void>
+struct IsTraceableConstant : std::false_type {};
+
+template<auto value, typename Format>
+struct IsTraceableConstant<
+    value, Format,
+    std::enable_if_t<std::is_integral_v<decltype(ConstantValueMaker<value, Format>::make(
+        static_cast<typename UnderlyingType<decltype(value)>::type>(value)).value)>>>
+    : std::true_type {};
+
+}  // namespace internal
+
+template<auto value, typename Format>
+struct TraceItemMaker<Constant<value>, Format,
+                      std::enable_if_t<internal::IsTraceableConstant<value, Format>::value>> {
+    using ValueType = typename internal::UnderlyingType<decltype(value)>::type;
+    using ValueItem = decltype(internal::ConstantValueMaker<value, Format>::make(ValueType{}));
+
+    // Converted by the trace item of the value, so the wire representation is the same.
+    static constexpr const auto wireValue =
+        internal::ConstantValueMaker<value, Format>::make(static_cast<ValueType>(value)).value;
+    static constexpr const uint64_t bits =
+        static_cast<std::make_unsigned_t<std::remove_const_t<decltype(wireValue)>>>(wireValue);
+
+    static constexpr auto make(Constant<value>) {
+        return ConstantItem<ValueItem, bits>{};
+    }
+};
+
+namespace internal {
+
+template<typename Item, uint64_t bits>
+struct SupportedFormatOptions<ConstantItem<Item, bits>> : SupportedFormatOptions<Item> {};
+
+}  // namespace internal
+
+}  // namespace wpp
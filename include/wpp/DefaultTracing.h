@@ -1,29 +1,128 @@
 /**
  * This is an example "default" trace definition file for a WPP-like experience - a global trace
  * provider used with trace macros all over the program.
+ *
+ * Components that should be enabled separately can define their own named providers using
+ * WPP_DEFINE_TRACE_PROVIDER, and bind the trace macros of their sources to them by defining
+ * WPP_DEFAULT_PROVIDER before including this file.
  */
-#include <optional>
+#pragma once
+#include <atomic>
+#include <string_view>
 #include "Trace.h"
 
 namespace wpp {
 
 /**
- * The global trace provider.
+ * A trace provider of a component, defined at namespace scope using WPP_DEFINE_TRACE_PROVIDER.
+ * The provider is constant-initialized (so it can be used by any static initializer, and is
+ * disabled until it's enabled), and it's started and added to the TraceProviderRegistry during
+ * dynamic initialization.
  */
-inline std::optional<TraceProvider> g_wppDefaultProvider = std::nullopt;
+class NamedTraceProvider : public TraceProvider {
+public:
+    constexpr NamedTraceProvider(std::string_view name, const GUID& controlGuid) noexcept
+        : m_name(name), m_guid(controlGuid) {
+        // Intentionally left blank.
+    }
+
+    std::string_view name() const noexcept {
+        return m_name;
+    }
+
+    /**
+     * The next registered provider, in no particular order.
+     */
+    const NamedTraceProvider* next() const noexcept {
+        return m_next;
+    }
+
+    NamedTraceProvider* next() noexcept {
+        return m_next;
+    }
+
+private:
+    friend class TraceProviderRegistry;
+
+    std::string_view m_name;
+    GUID m_guid;
+    NamedTraceProvider* m_next = nullptr;
+};
+
+/**
+ * A process-wide registry of the named trace providers, so they can be found (and enabled) by
+ * their names.
+ */
+class TraceProviderRegistry {
+public:
+    static TraceProviderRegistry& instance() noexcept {
+        static TraceProviderRegistry registry;
+        return registry;
+    }
+
+    // Prevent copy operations
+    TraceProviderRegistry(const TraceProviderRegistry&) = delete;
+    TraceProviderRegistry& operator=(const TraceProviderRegistry&) = delete;
+
+    // Prevent move operations
+    TraceProviderRegistry(TraceProviderRegistry&&) = delete;
+    TraceProviderRegistry& operator=(TraceProviderRegistry&&) = delete;
+
+    /**
+     * Starts the given provider (registering it with ETW on Windows), and adds it to the registry.
+     */
+    void add(NamedTraceProvider& provider) noexcept {
+        provider.start(provider.m_guid);
+        NamedTraceProvider* next = m_providers.load(std::memory_order_relaxed);
+        do {
+            provider.m_next = next;
+        } while (!m_providers.compare_exchange_weak(next, &provider, std::memory_order_release,
+                                                    std::memory_order_relaxed));
+    }
+
+    /**
+     * The registered providers, as a linked list (in no particular order).
+     */
+    NamedTraceProvider* providers() const noexcept {
+        return m_providers.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Finds a registered provider by its name, returning nullptr if there is no such provider.
+     */
+    NamedTraceProvider* find(std::string_view name) const noexcept {
+        for (auto* provider = providers(); provider != nullptr; provider = provider->next()) {
+            if (provider->name() == name) {
+                return provider;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    constexpr TraceProviderRegistry() noexcept = default;
+
+    std::atomic<NamedTraceProvider*> m_providers{nullptr};
+};
 
 /**
- * Initializes the global trace provider with the given GUID.
+ * The global trace provider. It's constant-initialized, and disabled until it's started by
+ * wppInitTraces (as its control GUID is only known then).
  */
-void wppInitTraces(const GUID& controlGuid) {
-    g_wppDefaultProvider.emplace(controlGuid);
+inline TraceProvider g_wppDefaultProvider;
+
+/**
+ * Starts the global trace provider with the given GUID.
+ */
+inline void wppInitTraces(const GUID& controlGuid) {
+    g_wppDefaultProvider.start(controlGuid);
 }
 
 /**
- * Destroys the global trace provider.
+ * Stops the global trace provider.
  */
-void wppStopTraces() {
-    g_wppDefaultProvider.reset();
+inline void wppStopTraces() {
+    g_wppDefaultProvider.stop();
 }
 
 /**
@@ -49,17 +148,33 @@ struct WppTraceGuard {
 
 };  // namespace wpp
 
+/**
+ * Defines a named trace provider (a NamedTraceProvider) at namespace scope, with the given name
+ * and control GUID. For example:
+ *
+ *     WPP_DEFINE_TRACE_PROVIDER(g_networkTraces, "network", GUID{0x11223344, ...});
+ *
+ * The provider can be defined in a header, as it's an inline variable.
+ */
+#define WPP_DEFINE_TRACE_PROVIDER(variable, name, ...)             \
+    inline ::wpp::NamedTraceProvider variable{name, __VA_ARGS__};  \
+    inline const bool ___wpp_isRegistered_##variable =             \
+        (::wpp::TraceProviderRegistry::instance().add(variable), true)
+
+/**
+ * The provider used by the trace macros below. Define it before including this file to bind the
+ * macros of a component to its own provider (consistently in all of its sources).
+ */
+#ifndef WPP_DEFAULT_PROVIDER
+#define WPP_DEFAULT_PROVIDER ::wpp::g_wppDefaultProvider
+#endif
+
 //////////////////
 // Trace Macros //
 //////////////////
 
-#define __WPP_TRACE_FLAG_LEVEL(flag, level, fmt, ...)                       \
-    do {                                                                  \
-        if (::wpp::g_wppDefaultProvider) {                                \
-            auto& ___wpp_provider = *::wpp::g_wppDefaultProvider;         \
-            WPP_DO_TRACE(___wpp_provider, flag, level, fmt, __VA_ARGS__); \
-        }                                                                 \
-    } while (0)
+#define __WPP_TRACE_FLAG_LEVEL(flag, level, fmt, ...) \
+    WPP_DO_TRACE(WPP_DEFAULT_PROVIDER, flag, level, fmt, __VA_ARGS__)
 
 #define WPP_TRACE_INFO(fmt, ...) \
     __WPP_TRACE_FLAG_LEVEL(1, ::wpp::TraceLevel::Information, fmt, __VA_ARGS__)
@@ -71,4 +186,4 @@ struct WppTraceGuard {
     __WPP_TRACE_FLAG_LEVEL(1, ::wpp::TraceLevel::Verbose, fmt, __VA_ARGS__)
 
 #define WPP_TRACE_WARNING(fmt, ...) \
-    __WPP_TRACE_FLAG_LEVEL(1, ::wpp::TraceLevel::Warning, fmt, __VA_ARGS__)
\ No newline at end of file
+    __WPP_TRACE_FLAG_LEVEL(1, ::wpp::TraceLevel::Warning, fmt, __VA_ARGS__)
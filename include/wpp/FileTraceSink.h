@@ -0,0 +1,140 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include "Platform.h"
+#include "Modules.h"
+#include "TraceProvider.h"
+
+namespace wpp {
+
+/**
+ * The trace stream format, written by FileTraceSink:
+ *
+ *     TraceStreamHeader header;
+ *     ModuleId modules[header.moduleCount];  // The modules traced by WPP (see getTracedModules)
+ *     struct {
+ *         TraceStreamRecordHeader header;
+ *         uint8_t data[header.size];  // The data of all the trace items, in order
+ *     } records[];
+ *
+ * The values are written in the byte order of the tracing machine, which is little-endian on all
+ * the supported targets - as are the trace items themselves. Each record starts with a magic value,
+ * so decoders can resynchronize after a truncated record.
+ *
+ * The modules let decoders find the metadata of the stream by the build identifiers of the traced
+ * binaries, and detect metadata of other builds.
+ */
+constexpr const uint32_t TRACE_STREAM_MAGIC = 0x53505057;         // "WPPS"
+constexpr const uint32_t TRACE_STREAM_RECORD_MAGIC = 0x52505057;  // "WPPR"
+constexpr const uint16_t TRACE_STREAM_VERSION = 2;
+
+struct TraceStreamHeader {
+    uint32_t magic;
+    uint16_t version;
+    /// The size of the header, including the module table, so later versions can extend it
+    uint16_t headerSize;
+    uint32_t moduleCount;
+};
+
+struct TraceStreamRecordHeader {
+    uint32_t magic;
+    /// The size of the record data, following the header
+    uint32_t size;
+    /// The time in which the record was written, in nanoseconds since the Unix epoch
+    uint64_t timestamp;
+    GUID messageGuid;
+};
+
+static_assert(sizeof(TraceStreamHeader) == 12, "WPP: Unexpected trace stream header size!");
+static_assert(WPP_MAX_MODULES * sizeof(ModuleId) <= UINT16_MAX - sizeof(TraceStreamHeader),
+              "WPP: Too many modules for the trace stream header!");
+static_assert(sizeof(TraceStreamRecordHeader) == 32,
+              "WPP: Unexpected trace stream record header size!");
+
+#ifndef _WIN32
+
+/**
+ * A trace sink writing the traces to a file, in the trace stream format. With
+ * WPP_ENABLE_INLINE_METADATA, the stream contains the metadata of all the traced call sites, and
+ * can be decoded using scripts/decode_stream.py without any other file.
+ *
+ * The header lists the traced modules which are loaded when the sink is created - modules loaded
+ * later are not listed, so their metadata must be given to the decoder explicitly.
+ *
+ * Currently, the class offers no error-handling: if the file can't be opened, or a write fails, the
+ * traces are silently lost (`isOpen()` may be used to check the file was opened).
+ */
+class FileTraceSink : public TraceSink {
+public:
+    explicit FileTraceSink(const char* path) noexcept : m_file(std::fopen(path, "wb")) {
+        if (m_file != nullptr) {
+            ModuleId modules[WPP_MAX_MODULES];
+            const size_t moduleCount = getTracedModules(modules, WPP_MAX_MODULES);
+            const TraceStreamHeader header{
+                TRACE_STREAM_MAGIC, TRACE_STREAM_VERSION,
+                static_cast<uint16_t>(sizeof(TraceStreamHeader) + moduleCount * sizeof(ModuleId)),
+                static_cast<uint32_t>(moduleCount)};
+            std::fwrite(&header, sizeof(header), 1, m_file);
+            std::fwrite(modules, sizeof(ModuleId), moduleCount, m_file);
+        }
+    }
+
+    ~FileTraceSink() override {
+        if (m_file != nullptr) {
+            std::fclose(m_file);
+        }
+    }
+
+    // Prevent copy operations
+    FileTraceSink(const FileTraceSink&) = delete;
+    FileTraceSink& operator=(const FileTraceSink&) = delete;
+
+    // Prevent move operations
+    FileTraceSink(FileTraceSink&&) = delete;
+    FileTraceSink& operator=(FileTraceSink&&) = delete;
+
+    bool isOpen() const noexcept {
+        return m_file != nullptr;
+    }
+
+    /**
+     * Writes any buffered records to the file.
+     */
+    void flush() noexcept {
+        if (m_file != nullptr) {
+            std::fflush(m_file);
+        }
+    }
+
+    void write(const GUID& messageGuid, const TracePair* pairs, size_t count) noexcept override {
+        if (m_file == nullptr) {
+            return;
+        }
+
+        TraceStreamRecordHeader header{TRACE_STREAM_RECORD_MAGIC, 0, 0, messageGuid};
+        for (size_t i = 0; i < count; ++i) {
+            header.size += static_cast<uint32_t>(pairs[i].size);
+        }
+        header.timestamp = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count());
+
+        // The lock is held while writing the whole record, so records are never interleaved.
+        std::lock_guard<std::mutex> lock(m_lock);
+        std::fwrite(&header, sizeof(header), 1, m_file);
+        for (size_t i = 0; i < count; ++i) {
+            std::fwrite(pairs[i].ptr, 1, pairs[i].size, m_file);
+        }
+    }
+
+private:
+    std::FILE* const m_file;
+    std::mutex m_lock;
+};
+
+#endif
+
+}  // namespace wpp
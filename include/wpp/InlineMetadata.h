@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "Platform.h"
+#include "String.h"
+#include "Metadata.h"
+#include "StructItems.h"
+#include "TraceProvider.h"
+
+namespace wpp {
+
+/**
+ * The message GUID of inline metadata records, used when WPP_ENABLE_INLINE_METADATA is defined.
+ *
+ * The first time a call site is traced in a trace session, its metadata record (see Metadata.h) is
+ * traced right before it, as a message with this GUID whose data is the record payload. Records of
+ * the structs traced by the call site are traced as well, so the trace session can be decoded
+ * without the PDB, the metadata section or the metadata index of the binary.
+ *
+ * Call sites traced concurrently by several threads may be traced by one thread before the record
+ * traced by another, so decoders should collect the records of the whole session first.
+ */
+constexpr const GUID INLINE_METADATA_GUID = {
+    0x4d505057, 0x0000, 0x3000, {0x80, 0x00, 'W', 'P', 'P', 'M', 'E', 'T'}};
+
+namespace internal {
+
+/**
+ * A trace item for the payload of a metadata record.
+ */
+struct MetadataRecordItem {
+    constexpr const void* getPtr() const noexcept {
+        return data;
+    }
+
+    constexpr size_t getSize() const noexcept {
+        return size;
+    }
+
+    const char* data;
+    size_t size;
+};
+
+/**
+ * The trace session in which a metadata record was last traced. This is a single value for every
+ * record, so checking it costs a single (predictable) branch once the record was traced.
+ */
+template<typename Record>
+struct InlineMetadataState {
+    static inline std::atomic<uint32_t> announcedSession{0};
+};
+
+/**
+ * Checks whether the given record was already traced in the current session of the provider.
+ */
+template<typename Record>
+__WPP_FORCEINLINE bool isMetadataAnnounced(const TraceProvider& provider) noexcept {
+    return InlineMetadataState<Record>::announcedSession.load(std::memory_order_relaxed) ==
+           provider.session();
+}
+
+/**
+ * Traces the given record, unless it was already traced in the current session of the provider.
+ */
+template<typename Record>
+void announceMetadata(const TraceProvider& provider) noexcept {
+    const uint32_t session = provider.session();
+    if (InlineMetadataState<Record>::announcedSession.exchange(
+            session, std::memory_order_relaxed) != session) {
+        const auto& payload = Record::value();
+        provider.traceMessageFromTraceItems(INLINE_METADATA_GUID,
+                                            MetadataRecordItem{payload.data(), payload.size()});
+    }
+}
+
+template<typename T>
+constexpr size_t getStructFieldNamesSize() {
+    size_t result = 0;
+    for (const auto& field : StructDescriptor<T>::fields) {
+        result += field.name.size() + (result == 0 ? 0 : sizeof(", ") - 1);
+    }
+    return result + 1;
+}
+
+/**
+ * The field names of a traceable struct, separated by commas (as written in
+ * WPP_DEFINE_STRUCT_ITEM), followed by a null-terminator.
+ */
+template<typename T>
+constexpr ConstexprString<getStructFieldNamesSize<T>()> makeStructFieldNames() {
+    ConstexprString<getStructFieldNamesSize<T>()> result{};
+    size_t position = 0;
+    for (const auto& field : StructDescriptor<T>::fields) {
+        if (position != 0) {
+            result[position++] = ',';
+            result[position++] = ' ';
+        }
+        for (const char c : field.name) {
+            result[position++] = c;
+        }
+    }
+    return result;
+}
+
+/**
+ * The metadata record of a traceable struct, matching the struct descriptor annotation: a
+ * signature containing the struct type and its layout, followed by the field names.
+ */
+template<typename T>
+struct StructMetadataRecord {
+    static constexpr const auto& value() {
+        return payload;
+    }
+
+private:
+    static constexpr const auto payload =
+        makeMetadataString("TMF_NG_STRUCT:") + makeString("wpp::StructDescriptor<") +
+        TypeName<T>::value + makeString(">::annotate<") + TypeName<StructLayoutType<T>>::value +
+        makeMetadataString(">") + makeStructFieldNames<T>();
+};
+
+}  // namespace internal
+
+}  // namespace wpp
@@ -0,0 +1,208 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include "Platform.h"
+#include "String.h"
+
+#ifndef WPP_METADATA_SECTION
+/**
+ * The name of the ELF section containing the trace metadata records.
+ */
+#define WPP_METADATA_SECTION ".wpp_meta"
+#endif
+
+namespace wpp::internal {
+
+////////////////
+// Type names //
+////////////////
+
+template<typename T>
+constexpr const char* typeSignature() {
+    return __WPP_FUNCTION_SIGNATURE;
+}
+
+/// The number of characters before and after the type name in typeSignature<T>().
+constexpr const size_t TYPE_NAME_PREFIX = std::string_view(typeSignature<void>()).find("void");
+constexpr const size_t TYPE_NAME_SUFFIX =
+    std::string_view(typeSignature<void>()).size() - TYPE_NAME_PREFIX - sizeof("void") + 1;
+
+/**
+ * The name of a type, as written by the compiler in function signatures (such as
+ * `struct wpp::StringItem` on MSVC, or `wpp::StringItem` on GCC and Clang). The name is a
+ * ConstexprString, so it can be used to build metadata records.
+ */
+template<typename T>
+struct TypeName {
+private:
+    static constexpr const std::string_view signature = typeSignature<T>();
+
+public:
+    static constexpr const auto value = makeString<signature.size() - TYPE_NAME_PREFIX -
+                                                   TYPE_NAME_SUFFIX>(signature.data() +
+                                                                     TYPE_NAME_PREFIX);
+};
+
+//////////////////////
+// Metadata records //
+//////////////////////
+
+/**
+ * Metadata records describe call sites and traced types, and are written to the
+ * WPP_METADATA_SECTION ELF section. The section is not allocated, so the records never take memory
+ * at runtime, and they can be extracted from the binary (or kept in a separate debug file) by the
+ * metadata tools.
+ *
+ * The payload of a record has the same content as the matching MSVC annotation: a list of
+ * null-terminated strings, starting with the record kind (such as "TMF_NG:").
+ *
+ * The record is written as chunks of 32-bit words, which are independent of the order in which the
+ * compiler emits them. Each chunk consists of:
+ *
+ *     uint32_t magic;                 // METADATA_MAGIC
+ *     uint32_t size;                  // The payload size
+ *     uint32_t recordId[2];           // A hash identifying the record (low word first)
+ *     uint32_t chunkIndex;
+ *     uint32_t chunkCount;
+ *     uint32_t data[METADATA_CHUNK_WORDS];
+ *
+ * The data words contain 4 payload bytes each, starting from the least significant byte, and the
+ * last chunk is zero-padded. Records of inline functions and templates are emitted once for every
+ * compilation unit using them, and identical records should be merged by the tools.
+ */
+constexpr const uint32_t METADATA_MAGIC = 0x4d505057;  // "WPPM"
+constexpr const size_t METADATA_CHUNK_WORDS = 24;
+constexpr const size_t METADATA_CHUNK_SIZE = METADATA_CHUNK_WORDS * sizeof(uint32_t);
+
+/**
+ * A 64-bit FNV-1a hash of the given data, used as a metadata record identifier.
+ */
+template<size_t N>
+constexpr uint64_t fnv1a(const ConstexprString<N>& data) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < N; ++i) {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * 0x100000001b3;
+    }
+    return hash;
+}
+
+/**
+ * The chunk words of a metadata record, whose payload is the ConstexprString `Record::value()`.
+ */
+template<typename Record>
+struct MetadataChunks {
+    static constexpr const auto& payload = Record::value();
+    static constexpr const size_t size = payload.size();
+    static constexpr const size_t count = (size + METADATA_CHUNK_SIZE - 1) / METADATA_CHUNK_SIZE;
+    static constexpr const uint64_t id = fnv1a(payload);
+
+    static_assert(size > 0 && size <= UINT32_MAX, "WPP: Invalid metadata record size!");
+
+    static constexpr uint32_t word(size_t index) {
+        uint32_t result = 0;
+        for (size_t i = 0; i < sizeof(uint32_t); ++i) {
+            const size_t offset = index * sizeof(uint32_t) + i;
+            if (offset < size) {
+                result |= static_cast<uint32_t>(static_cast<uint8_t>(payload[offset])) << (i * 8);
+            }
+        }
+        return result;
+    }
+};
+
+#if defined(__ELF__)
+
+#if defined(__arm__)
+// '@' starts a comment in ARM assembly.
+#define __WPP_METADATA_SECTION_TYPE "%progbits"
+#else
+#define __WPP_METADATA_SECTION_TYPE "@progbits"
+#endif
+
+#define __WPP_METADATA_WORD(i) "i"(Chunks::word(Chunk * METADATA_CHUNK_WORDS + i))
+
+/**
+ * Writes a single chunk of a metadata record.
+ *
+ * The chunk is written using inline assembly, as GCC ignores section attributes of template
+ * instances, and can't mix the section attributes of inline and non-inline functions. The assembly
+ * doesn't generate any code - it only appends the chunk to the (non-allocated) metadata section.
+ * The words are 32-bit, as some targets can't print larger assembly constants.
+ */
+template<typename Record, size_t Chunk>
+__WPP_FORCEINLINE void emitMetadataChunk() {
+    using Chunks = MetadataChunks<Record>;
+    static_assert(METADATA_CHUNK_WORDS == 24, "WPP: The chunk assembly must match the chunk size!");
+
+    __asm__ __volatile__(
+        ".pushsection " WPP_METADATA_SECTION ",\"\"," __WPP_METADATA_SECTION_TYPE "\n\t"
+        ".balign 4\n\t"
+        ".long %c0, %c1, %c2, %c3, %c4, %c5\n\t"
+        ".long %c6, %c7, %c8, %c9, %c10, %c11, %c12, %c13\n\t"
+        ".long %c14, %c15, %c16, %c17, %c18, %c19, %c20, %c21\n\t"
+        ".long %c22, %c23, %c24, %c25, %c26, %c27, %c28, %c29\n\t"
+        ".popsection" ::"i"(METADATA_MAGIC),
+        "i"(static_cast<uint32_t>(Chunks::size)), "i"(static_cast<uint32_t>(Chunks::id)),
+        "i"(static_cast<uint32_t>(Chunks::id >> 32)), "i"(static_cast<uint32_t>(Chunk)),
+        "i"(static_cast<uint32_t>(Chunks::count)), __WPP_METADATA_WORD(0), __WPP_METADATA_WORD(1),
+        __WPP_METADATA_WORD(2), __WPP_METADATA_WORD(3), __WPP_METADATA_WORD(4),
+        __WPP_METADATA_WORD(5), __WPP_METADATA_WORD(6), __WPP_METADATA_WORD(7),
+        __WPP_METADATA_WORD(8), __WPP_METADATA_WORD(9), __WPP_METADATA_WORD(10),
+        __WPP_METADATA_WORD(11), __WPP_METADATA_WORD(12), __WPP_METADATA_WORD(13),
+        __WPP_METADATA_WORD(14), __WPP_METADATA_WORD(15), __WPP_METADATA_WORD(16),
+        __WPP_METADATA_WORD(17), __WPP_METADATA_WORD(18), __WPP_METADATA_WORD(19),
+        __WPP_METADATA_WORD(20), __WPP_METADATA_WORD(21), __WPP_METADATA_WORD(22),
+        __WPP_METADATA_WORD(23));
+}
+
+#undef __WPP_METADATA_WORD
+
+template<typename Record, size_t... Chunks>
+__WPP_FORCEINLINE void emitMetadataChunks(std::index_sequence<Chunks...>) {
+    (emitMetadataChunk<Record, Chunks>(), ...);
+}
+
+/**
+ * Writes the given metadata record to the metadata section.
+ */
+template<typename Record>
+__WPP_FORCEINLINE void emitMetadata() {
+    emitMetadataChunks<Record>(std::make_index_sequence<MetadataChunks<Record>::count>());
+}
+
+#else
+
+/**
+ * Metadata sections are only supported in ELF binaries - PE binaries use MSVC annotations.
+ */
+template<typename Record>
+__WPP_FORCEINLINE void emitMetadata() {
+    // Intentionally left blank.
+}
+
+#endif
+
+/**
+ * A metadata string: the given string literal, including its null terminator.
+ */
+template<size_t N>
+constexpr ConstexprString<N> makeMetadataString(const char (&str)[N]) {
+    return makeString<N>(static_cast<const char*>(str));
+}
+
+}  // namespace wpp::internal
+
+/**
+ * Defines a metadata record type named `name`, whose payload is the given ConstexprString
+ * expression. The payload is stored in a static local, so it may use the function signature of the
+ * enclosing function.
+ */
+#define __WPP_DEFINE_METADATA_RECORD(name, ...)                     \
+    static constexpr const auto ___wpp_record_##name = __VA_ARGS__; \
+    struct name {                                                   \
+        static constexpr const auto& value() {                      \
+            return ___wpp_record_##name;                            \
+        }                                                           \
+    }
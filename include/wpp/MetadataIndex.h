@@ -0,0 +1,515 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Platform.h"
+
+namespace wpp {
+
+/**
+ * A metadata index is a compact binary form of the trace metadata of a binary. Decoders can map it
+ * into memory and use it as-is, without any parsing. The index is written by the metadata tools
+ * (`WppExtract --index`), or at runtime by the CallSiteRegistry (see CallSites.h).
+ *
+ * All the values are little-endian, and all the tables are 4-byte aligned:
+ *
+ *     MetadataIndexHeader header;
+ *     MetadataIndexTrace traces[traceCount];           // Sorted by GUID bytes
+ *     MetadataIndexArgument arguments[argumentCount];  // The arguments of each trace, in order
+ *     MetadataIndexStruct structs[structCount];        // Sorted by name
+ *     MetadataIndexField fields[fieldCount];           // The fields of each struct, in order
+ *     char strings[stringsSize];                       // Interned null-terminated strings
+ *
+ * Strings are referenced by their offset in the string pool, where offset 0 is the empty string.
+ * The format string of each trace is pre-parsed: each argument holds the literal text preceding it
+ * and its format specification, and the trace holds the literal text following the last argument.
+ * The literal text is unescaped, so a message is formatted by concatenation only.
+ */
+constexpr const uint32_t METADATA_INDEX_MAGIC = 0x49505057;  // "WPPI"
+constexpr const uint16_t METADATA_INDEX_VERSION = 1;
+
+struct MetadataIndexHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t traceCount;
+    uint32_t traceOffset;
+    uint32_t argumentCount;
+    uint32_t argumentOffset;
+    uint32_t structCount;
+    uint32_t structOffset;
+    uint32_t fieldCount;
+    uint32_t fieldOffset;
+    uint32_t stringsSize;
+    uint32_t stringsOffset;
+};
+
+struct MetadataIndexTrace {
+    /// The message GUID, in the memory layout of the GUID structure.
+    uint8_t guid[16];
+    uint32_t file;
+    uint32_t line;
+    uint32_t function;
+    uint32_t flag;
+    uint32_t level;
+    uint32_t format;
+    uint32_t args;
+    /// The literal text following the last argument.
+    uint32_t suffix;
+    uint32_t firstArgument;
+    uint32_t argumentCount;
+};
+
+struct MetadataIndexArgument {
+    /// The trace item type name (such as `wpp::Int32Item`).
+    uint32_t type;
+    /// The format specification of the argument, without the ':' (such as `x`).
+    uint32_t spec;
+    /// The literal text preceding the argument.
+    uint32_t prefix;
+};
+
+struct MetadataIndexStruct {
+    uint32_t name;
+    uint32_t size;
+    uint32_t firstField;
+    uint32_t fieldCount;
+};
+
+struct MetadataIndexField {
+    uint32_t name;
+    uint32_t offset;
+    uint32_t size;
+    /// The trace item type name of the field.
+    uint32_t type;
+};
+
+namespace internal {
+
+/**
+ * Writes a GUID in the memory layout of the GUID structure, with little-endian fields.
+ */
+inline void writeGuidBytes(const GUID& guid, uint8_t (&bytes)[16]) noexcept {
+    for (size_t i = 0; i < 4; ++i) {
+        bytes[i] = static_cast<uint8_t>(guid.Data1 >> (i * 8));
+    }
+    for (size_t i = 0; i < 2; ++i) {
+        bytes[4 + i] = static_cast<uint8_t>(guid.Data2 >> (i * 8));
+        bytes[6 + i] = static_cast<uint8_t>(guid.Data3 >> (i * 8));
+    }
+    for (size_t i = 0; i < 8; ++i) {
+        bytes[8 + i] = guid.Data4[i];
+    }
+}
+
+}  // namespace internal
+
+/**
+ * A read-only view of a metadata index. The data is not copied, so it must outlive the view, and it
+ * must be 4-byte aligned (as mapped files and heap allocations are). The index is accessed in
+ * place, so it's only supported on little-endian hosts.
+ */
+class MetadataIndex {
+public:
+    MetadataIndex(const void* data, size_t size) noexcept
+        : m_data(static_cast<const uint8_t*>(data)), m_size(size) {
+        m_isValid = validate();
+    }
+
+    /**
+     * Checks whether the data is a metadata index of a supported version. All the accessors
+     * require a valid index.
+     */
+    bool isValid() const noexcept {
+        return m_isValid;
+    }
+
+    size_t traceCount() const noexcept {
+        return header().traceCount;
+    }
+
+    const MetadataIndexTrace& trace(size_t index) const noexcept {
+        return table<MetadataIndexTrace>(header().traceOffset)[index];
+    }
+
+    /**
+     * Finds the trace with the given message GUID, or returns nullptr if there is no such trace.
+     */
+    const MetadataIndexTrace* findTrace(const GUID& guid) const noexcept {
+        uint8_t bytes[16];
+        internal::writeGuidBytes(guid, bytes);
+
+        const auto* first = table<MetadataIndexTrace>(header().traceOffset);
+        const auto* last = first + header().traceCount;
+        const auto* result =
+            std::lower_bound(first, last, bytes, [](const MetadataIndexTrace& trace, auto& key) {
+                return std::memcmp(trace.guid, key, sizeof(trace.guid)) < 0;
+            });
+        if (result == last || std::memcmp(result->guid, bytes, sizeof(bytes)) != 0) {
+            return nullptr;
+        }
+        return result;
+    }
+
+    /**
+     * Returns the arguments of the given trace, or nullptr if the trace references arguments out
+     * of the bounds of the index.
+     */
+    const MetadataIndexArgument* arguments(const MetadataIndexTrace& trace) const noexcept {
+        if (trace.firstArgument > header().argumentCount ||
+            trace.argumentCount > header().argumentCount - trace.firstArgument) {
+            return nullptr;
+        }
+        return table<MetadataIndexArgument>(header().argumentOffset) + trace.firstArgument;
+    }
+
+    size_t structCount() const noexcept {
+        return header().structCount;
+    }
+
+    const MetadataIndexStruct& structInfo(size_t index) const noexcept {
+        return table<MetadataIndexStruct>(header().structOffset)[index];
+    }
+
+    /**
+     * Finds the struct with the given name, or returns nullptr if there is no such struct.
+     */
+    const MetadataIndexStruct* findStruct(std::string_view name) const noexcept {
+        const auto* first = table<MetadataIndexStruct>(header().structOffset);
+        const auto* last = first + header().structCount;
+        const auto* result = std::lower_bound(
+            first, last, name, [this](const MetadataIndexStruct& info, std::string_view key) {
+                return string(info.name) < key;
+            });
+        if (result == last || string(result->name) != name) {
+            return nullptr;
+        }
+        return result;
+    }
+
+    /**
+     * Returns the fields of the given struct, or nullptr if the struct references fields out of the
+     * bounds of the index.
+     */
+    const MetadataIndexField* fields(const MetadataIndexStruct& info) const noexcept {
+        if (info.firstField > header().fieldCount ||
+            info.fieldCount > header().fieldCount - info.firstField) {
+            return nullptr;
+        }
+        return table<MetadataIndexField>(header().fieldOffset) + info.firstField;
+    }
+
+    /**
+     * Returns the string at the given offset of the string pool, or an empty string if the offset
+     * is out of bounds.
+     */
+    std::string_view string(uint32_t offset) const noexcept {
+        if (offset >= header().stringsSize) {
+            return {};
+        }
+        // The string pool is validated to end with a null terminator.
+        return std::string_view(
+            reinterpret_cast<const char*>(m_data + header().stringsOffset + offset));
+    }
+
+private:
+    const MetadataIndexHeader& header() const noexcept {
+        return *reinterpret_cast<const MetadataIndexHeader*>(m_data);
+    }
+
+    template<typename T>
+    const T* table(uint32_t offset) const noexcept {
+        return reinterpret_cast<const T*>(m_data + offset);
+    }
+
+    bool isTableInBounds(uint32_t offset, uint32_t count, size_t entrySize) const noexcept {
+        return offset % alignof(uint32_t) == 0 && offset <= m_size &&
+               count <= (m_size - offset) / entrySize;
+    }
+
+    bool validate() const noexcept {
+        if (m_size < sizeof(MetadataIndexHeader) ||
+            reinterpret_cast<uintptr_t>(m_data) % alignof(uint32_t) != 0) {
+            return false;
+        }
+
+        const auto& info = header();
+        return info.magic == METADATA_INDEX_MAGIC && info.version == METADATA_INDEX_VERSION &&
+               info.headerSize >= sizeof(MetadataIndexHeader) &&
+               isTableInBounds(info.traceOffset, info.traceCount, sizeof(MetadataIndexTrace)) &&
+               isTableInBounds(info.argumentOffset, info.argumentCount,
+                               sizeof(MetadataIndexArgument)) &&
+               isTableInBounds(info.structOffset, info.structCount, sizeof(MetadataIndexStruct)) &&
+               isTableInBounds(info.fieldOffset, info.fieldCount, sizeof(MetadataIndexField)) &&
+               info.stringsSize > 0 && info.stringsOffset <= m_size &&
+               info.stringsSize <= m_size - info.stringsOffset &&
+               m_data[info.stringsOffset + info.stringsSize - 1] == '\0';
+    }
+
+    const uint8_t* m_data;
+    size_t m_size;
+    bool m_isValid;
+};
+
+/**
+ * Builds a metadata index. Traces with the same GUID and structs with the same name are written
+ * once, keeping the first one added. The index doesn't depend on the order in which the traces and
+ * structs are added, so the same metadata always results in the same index. Like MetadataIndex,
+ * it's only supported on little-endian hosts.
+ */
+class MetadataIndexWriter {
+public:
+    struct Trace {
+        GUID guid;
+        std::string_view file;
+        uint32_t line;
+        std::string_view function;
+        std::string_view flag;
+        std::string_view level;
+        std::string_view format;
+        std::string_view args;
+        std::vector<std::string_view> types;
+    };
+
+    struct Field {
+        std::string_view name;
+        uint32_t offset;
+        uint32_t size;
+        std::string_view type;
+    };
+
+    struct Struct {
+        std::string_view name;
+        uint32_t size;
+        std::vector<Field> fields;
+    };
+
+    void addTrace(const Trace& trace) {
+        PendingTrace result{};
+        internal::writeGuidBytes(trace.guid, result.guid);
+        result.file = trace.file;
+        result.line = trace.line;
+        result.function = trace.function;
+        result.flag = trace.flag;
+        result.level = trace.level;
+        result.format = trace.format;
+        result.args = trace.args;
+
+        // Split the format into the literal text preceding each argument and its specification.
+        size_t position = 0;
+        for (const auto& type : trace.types) {
+            PendingArgument argument{std::string(type), {}, {}};
+            position = parseLiteral(trace.format, position, argument.prefix);
+            if (position < trace.format.size()) {
+                const size_t end = trace.format.find('}', position);
+                const auto field = trace.format.substr(position + 1, end - position - 1);
+                const size_t specStart = field.find(':');
+                if (specStart != std::string_view::npos) {
+                    argument.spec = field.substr(specStart + 1);
+                }
+                position = end == std::string_view::npos ? trace.format.size() : end + 1;
+            }
+            result.arguments.push_back(std::move(argument));
+        }
+        position = parseLiteral(trace.format, position, result.suffix);
+        // Any excess fields are kept as literal text.
+        result.suffix += trace.format.substr(std::min(position, trace.format.size()));
+
+        m_traces.push_back(std::move(result));
+    }
+
+    void addStruct(const Struct& info) {
+        PendingStruct result{std::string(info.name), info.size, {}};
+        for (const auto& field : info.fields) {
+            result.fields.push_back(
+                {std::string(field.name), field.offset, field.size, std::string(field.type)});
+        }
+        m_structs.push_back(std::move(result));
+    }
+
+    /**
+     * Writes the index of all the added traces and structs.
+     */
+    std::vector<uint8_t> write() const {
+        const auto traces =
+            sortedUnique(m_traces, [](const PendingTrace& a, const PendingTrace& b) {
+                return std::memcmp(a.guid, b.guid, sizeof(a.guid)) < 0;
+            });
+        const auto structs =
+            sortedUnique(m_structs, [](const PendingStruct& a, const PendingStruct& b) {
+                return a.name < b.name;
+            });
+
+        // Strings are interned in the order of the tables, so the pool doesn't depend on the order
+        // in which the entries were added. Offset 0 is reserved for the empty string.
+        StringPool strings;
+        strings.intern({});
+
+        std::vector<MetadataIndexTrace> traceEntries;
+        std::vector<MetadataIndexArgument> arguments;
+        for (const auto* trace : traces) {
+            MetadataIndexTrace entry{};
+            std::memcpy(entry.guid, trace->guid, sizeof(entry.guid));
+            entry.file = strings.intern(trace->file);
+            entry.line = trace->line;
+            entry.function = strings.intern(trace->function);
+            entry.flag = strings.intern(trace->flag);
+            entry.level = strings.intern(trace->level);
+            entry.format = strings.intern(trace->format);
+            entry.args = strings.intern(trace->args);
+            entry.firstArgument = static_cast<uint32_t>(arguments.size());
+            entry.argumentCount = static_cast<uint32_t>(trace->arguments.size());
+            for (const auto& argument : trace->arguments) {
+                arguments.push_back({strings.intern(argument.type), strings.intern(argument.spec),
+                                     strings.intern(argument.prefix)});
+            }
+            entry.suffix = strings.intern(trace->suffix);
+            traceEntries.push_back(entry);
+        }
+
+        std::vector<MetadataIndexStruct> structEntries;
+        std::vector<MetadataIndexField> fields;
+        for (const auto* info : structs) {
+            structEntries.push_back({strings.intern(info->name), info->size,
+                                     static_cast<uint32_t>(fields.size()),
+                                     static_cast<uint32_t>(info->fields.size())});
+            for (const auto& field : info->fields) {
+                fields.push_back({strings.intern(field.name), field.offset, field.size,
+                                  strings.intern(field.type)});
+            }
+        }
+
+        MetadataIndexHeader header{};
+        header.magic = METADATA_INDEX_MAGIC;
+        header.version = METADATA_INDEX_VERSION;
+        header.headerSize = sizeof(MetadataIndexHeader);
+        header.traceCount = static_cast<uint32_t>(traceEntries.size());
+        header.traceOffset = sizeof(MetadataIndexHeader);
+        header.argumentCount = static_cast<uint32_t>(arguments.size());
+        header.argumentOffset =
+            header.traceOffset + header.traceCount * sizeof(MetadataIndexTrace);
+        header.structCount = static_cast<uint32_t>(structEntries.size());
+        header.structOffset =
+            header.argumentOffset + header.argumentCount * sizeof(MetadataIndexArgument);
+        header.fieldCount = static_cast<uint32_t>(fields.size());
+        header.fieldOffset = header.structOffset + header.structCount * sizeof(MetadataIndexStruct);
+        header.stringsSize = static_cast<uint32_t>(strings.data.size());
+        header.stringsOffset = header.fieldOffset + header.fieldCount * sizeof(MetadataIndexField);
+
+        std::vector<uint8_t> result;
+        result.reserve(header.stringsOffset + header.stringsSize + sizeof(uint32_t));
+        appendEntries(result, &header, 1);
+        appendEntries(result, traceEntries.data(), traceEntries.size());
+        appendEntries(result, arguments.data(), arguments.size());
+        appendEntries(result, structEntries.data(), structEntries.size());
+        appendEntries(result, fields.data(), fields.size());
+        result.insert(result.end(), strings.data.begin(), strings.data.end());
+        // Pad the index, so indices can be concatenated or embedded as 4-byte aligned data.
+        result.resize((result.size() + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1));
+        return result;
+    }
+
+private:
+    struct PendingArgument {
+        std::string type;
+        std::string spec;
+        std::string prefix;
+    };
+
+    struct PendingTrace {
+        uint8_t guid[16];
+        std::string file;
+        uint32_t line;
+        std::string function;
+        std::string flag;
+        std::string level;
+        std::string format;
+        std::string args;
+        std::vector<PendingArgument> arguments;
+        std::string suffix;
+    };
+
+    struct PendingField {
+        std::string name;
+        uint32_t offset;
+        uint32_t size;
+        std::string type;
+    };
+
+    struct PendingStruct {
+        std::string name;
+        uint32_t size;
+        std::vector<PendingField> fields;
+    };
+
+    struct StringPool {
+        std::vector<char> data;
+        std::unordered_map<std::string_view, uint32_t> offsets;
+
+        uint32_t intern(std::string_view value) {
+            // The keys reference the strings of the pending entries, which outlive the pool.
+            const auto [it, isNew] = offsets.emplace(value, static_cast<uint32_t>(data.size()));
+            if (isNew) {
+                data.insert(data.end(), value.begin(), value.end());
+                data.push_back('\0');
+            }
+            return it->second;
+        }
+    };
+
+    /**
+     * Appends the unescaped literal text of the format starting at `position` to `literal`, and
+     * returns the position of the next field (or the end of the format).
+     */
+    static size_t parseLiteral(std::string_view format, size_t position, std::string& literal) {
+        while (position < format.size()) {
+            const char c = format[position];
+            if ((c == '{' || c == '}') && position + 1 < format.size() &&
+                format[position + 1] == c) {
+                literal += c;
+                position += 2;
+            } else if (c == '{') {
+                break;
+            } else {
+                literal += c;
+                ++position;
+            }
+        }
+        return position;
+    }
+
+    /**
+     * Returns pointers to the given entries, sorted and without duplicates (keeping the first
+     * entry of each duplicate).
+     */
+    template<typename T, typename Less>
+    static std::vector<const T*> sortedUnique(const std::vector<T>& values, Less less) {
+        std::vector<const T*> result;
+        for (const auto& value : values) {
+            result.push_back(&value);
+        }
+        std::stable_sort(result.begin(), result.end(),
+                         [&less](const T* a, const T* b) { return less(*a, *b); });
+        result.erase(std::unique(result.begin(), result.end(),
+                                 [&less](const T* a, const T* b) { return !less(*a, *b); }),
+                     result.end());
+        return result;
+    }
+
+    template<typename T>
+    static void appendEntries(std::vector<uint8_t>& output, const T* entries, size_t count) {
+        static_assert(sizeof(T) % sizeof(uint32_t) == 0, "WPP: Invalid metadata index entry!");
+        const auto* bytes = reinterpret_cast<const uint8_t*>(entries);
+        output.insert(output.end(), bytes, bytes + count * sizeof(T));
+    }
+
+    std::vector<PendingTrace> m_traces;
+    std::vector<PendingStruct> m_structs;
+};
+
+}  // namespace wpp
@@ -0,0 +1,426 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+
+#include "Platform.h"
+
+#ifndef _WIN32
+#include <link.h>
+#include <unwind.h>
+#endif
+
+namespace wpp {
+
+/**
+ * A build identifier of a loaded module, used to find its symbols offline.
+ *
+ * - PE modules: the CodeView GUID followed by the age (little endian), matching the PDB file.
+ * - ELF modules: the GNU build-id note, truncated or zero-padded to the identifier size.
+ */
+struct ModuleId {
+    uint8_t bytes[20];
+};
+
+/**
+ * Information about a module containing some address.
+ */
+struct ModuleInfo {
+    /// The address module-relative offsets are relative to (the image base or the load bias)
+    uintptr_t base;
+    /// The address range of the module
+    uintptr_t start;
+    uintptr_t end;
+    /// The build identifier of the module (all zeros if it has none)
+    ModuleId id;
+};
+
+namespace internal {
+
+/// The number of bits used for the offset in an encoded module-relative address
+constexpr const unsigned MODULE_OFFSET_BITS = 48;
+constexpr const uint64_t MODULE_OFFSET_MASK = (uint64_t(1) << MODULE_OFFSET_BITS) - 1;
+
+/// The module index used for addresses that don't belong to any known module
+constexpr const uint16_t UNKNOWN_MODULE_INDEX = 0xffff;
+
+/**
+ * Encodes a module-relative address as a 64-bit value: the module index in the upper 16 bits, and
+ * the offset inside the module in the lower 48 bits. Addresses of unknown modules are encoded with
+ * UNKNOWN_MODULE_INDEX and the (truncated) absolute address.
+ */
+constexpr uint64_t encodeModuleAddress(uint16_t moduleIndex, uint64_t offset) {
+    return (static_cast<uint64_t>(moduleIndex) << MODULE_OFFSET_BITS) |
+           (offset & MODULE_OFFSET_MASK);
+}
+
+#ifdef _WIN32
+
+/**
+ * The CodeView debug information record of a PE module, pointing to its PDB file.
+ */
+struct CodeViewRecord {
+    DWORD signature;
+    GUID guid;
+    DWORD age;
+};
+
+constexpr const DWORD CODEVIEW_RSDS_SIGNATURE = 'SDSR';
+
+inline const IMAGE_NT_HEADERS& getNtHeaders(uintptr_t base) {
+    const auto dosHeader = reinterpret_cast<const IMAGE_DOS_HEADER*>(base);
+    return *reinterpret_cast<const IMAGE_NT_HEADERS*>(base + dosHeader->e_lfanew);
+}
+
+/**
+ * Reads the build identifier of a loaded PE module from its debug directory.
+ */
+inline void readModuleId(uintptr_t base, ModuleId& id) {
+    std::memset(&id, 0, sizeof(id));
+
+    const auto& debugDirectory =
+        getNtHeaders(base).OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_DEBUG];
+
+    const auto entries =
+        reinterpret_cast<const IMAGE_DEBUG_DIRECTORY*>(base + debugDirectory.VirtualAddress);
+    const size_t entryCount = debugDirectory.Size / sizeof(IMAGE_DEBUG_DIRECTORY);
+    for (size_t i = 0; i < entryCount; ++i) {
+        if (entries[i].Type != IMAGE_DEBUG_TYPE_CODEVIEW || entries[i].AddressOfRawData == 0) {
+            continue;
+        }
+
+        const auto record =
+            reinterpret_cast<const CodeViewRecord*>(base + entries[i].AddressOfRawData);
+        if (record->signature == CODEVIEW_RSDS_SIGNATURE) {
+            std::memcpy(id.bytes, &record->guid, sizeof(record->guid));
+            std::memcpy(id.bytes + sizeof(record->guid), &record->age, sizeof(record->age));
+            return;
+        }
+    }
+}
+
+/**
+ * Finds the loaded module containing the given address.
+ */
+inline bool findModule(const void* address, ModuleInfo& info) {
+    PVOID base = nullptr;
+    if (RtlPcToFileHeader(const_cast<PVOID>(address), &base) == nullptr) {
+        return false;
+    }
+
+    info.base = reinterpret_cast<uintptr_t>(base);
+    info.start = info.base;
+    info.end = info.base + getNtHeaders(info.base).OptionalHeader.SizeOfImage;
+    readModuleId(info.base, info.id);
+    return true;
+}
+
+/**
+ * Captures up to `maxFrames` return addresses of the calling function, returning the number of
+ * captured frames.
+ */
+__WPP_NOINLINE inline size_t captureStack(void** frames, size_t maxFrames) {
+    // Skip the frame of this function.
+    return RtlCaptureStackBackTrace(1, static_cast<DWORD>(maxFrames), frames, nullptr);
+}
+
+#else
+
+constexpr const uint32_t ELF_NOTE_ALIGNMENT = 4;
+
+constexpr size_t alignNoteSize(size_t size) {
+    return (size + ELF_NOTE_ALIGNMENT - 1) & ~static_cast<size_t>(ELF_NOTE_ALIGNMENT - 1);
+}
+
+/**
+ * Finds a note with the given type and name (including its null terminator) in the note segments
+ * of a loaded ELF module. Returns the note header, or nullptr if there is no such note.
+ */
+template<size_t N>
+const ElfW(Nhdr)* findModuleNote(const dl_phdr_info& module, uint32_t type, const char (&name)[N]) {
+    for (size_t i = 0; i < module.dlpi_phnum; ++i) {
+        const auto& header = module.dlpi_phdr[i];
+        if (header.p_type != PT_NOTE) {
+            continue;
+        }
+
+        auto note = reinterpret_cast<const uint8_t*>(module.dlpi_addr + header.p_vaddr);
+        const auto end = note + header.p_memsz;
+        while (note + sizeof(ElfW(Nhdr)) <= end) {
+            const auto noteHeader = reinterpret_cast<const ElfW(Nhdr)*>(note);
+            const auto noteName = note + sizeof(ElfW(Nhdr));
+            if (noteHeader->n_type == type && noteHeader->n_namesz == N &&
+                std::memcmp(noteName, name, N) == 0) {
+                return noteHeader;
+            }
+            note = noteName + alignNoteSize(noteHeader->n_namesz) +
+                   alignNoteSize(noteHeader->n_descsz);
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Reads the GNU build-id of a loaded ELF module from its note segments.
+ */
+inline void readModuleId(const dl_phdr_info& module, ModuleId& id) {
+    std::memset(&id, 0, sizeof(id));
+
+    const auto note = findModuleNote(module, NT_GNU_BUILD_ID, "GNU");
+    if (note != nullptr) {
+        const auto desc =
+            reinterpret_cast<const uint8_t*>(note + 1) + alignNoteSize(note->n_namesz);
+        std::memcpy(id.bytes, desc,
+                    note->n_descsz < sizeof(id.bytes) ? note->n_descsz : sizeof(id.bytes));
+    }
+}
+
+struct FindModuleContext {
+    uintptr_t address;
+    ModuleInfo* info;
+};
+
+inline int findModuleCallback(dl_phdr_info* module, size_t, void* data) {
+    auto context = static_cast<FindModuleContext*>(data);
+    uintptr_t moduleStart = UINTPTR_MAX;
+    uintptr_t moduleEnd = 0;
+    bool found = false;
+    for (size_t i = 0; i < module->dlpi_phnum; ++i) {
+        const auto& header = module->dlpi_phdr[i];
+        if (header.p_type != PT_LOAD) {
+            continue;
+        }
+
+        const uintptr_t start = module->dlpi_addr + header.p_vaddr;
+        const uintptr_t end = start + header.p_memsz;
+        found = found || (context->address >= start && context->address < end);
+        moduleStart = start < moduleStart ? start : moduleStart;
+        moduleEnd = end > moduleEnd ? end : moduleEnd;
+    }
+
+    if (!found) {
+        return 0;
+    }
+
+    context->info->base = module->dlpi_addr;
+    context->info->start = moduleStart;
+    context->info->end = moduleEnd;
+    readModuleId(*module, context->info->id);
+    return 1;
+}
+
+/**
+ * Finds the loaded module containing the given address.
+ */
+inline bool findModule(const void* address, ModuleInfo& info) {
+    FindModuleContext context{reinterpret_cast<uintptr_t>(address), &info};
+    return dl_iterate_phdr(findModuleCallback, &context) != 0;
+}
+
+/**
+ * The note marking modules traced by WPP: modules containing this note are listed in the headers of
+ * trace streams, so decoders can find their metadata by their build identifiers.
+ */
+constexpr const uint32_t TRACED_MODULE_NOTE_TYPE = 0x57505001;
+constexpr const char TRACED_MODULE_NOTE_NAME[] = "WPP";
+
+#if defined(__ELF__) && !defined(WPP_DISABLE_MODULE_NOTE)
+
+#if defined(__arm__)
+// '@' starts a comment in ARM assembly.
+#define __WPP_NOTE_SECTION_TYPE "%note"
+#else
+#define __WPP_NOTE_SECTION_TYPE "@note"
+#endif
+
+// The note is emitted by every compilation unit including this header, in a COMDAT group, so the
+// linker keeps a single note in every module. It's marked as retained ("R"), so it's not removed
+// by --gc-sections - this requires binutils 2.36 or LLVM 13 (define WPP_DISABLE_MODULE_NOTE when
+// using older assemblers).
+__asm__(".pushsection .note.wpp,\"aGR\"," __WPP_NOTE_SECTION_TYPE ",.note.wpp,comdat\n\t"
+        ".balign 4\n\t"
+        ".long 4, 0, 0x57505001\n\t"
+        ".asciz \"WPP\"\n\t"
+        ".popsection");
+
+#undef __WPP_NOTE_SECTION_TYPE
+
+#endif
+
+/**
+ * The state of a stack capture, passed to the unwinder callback.
+ */
+struct StackCapture {
+    void** frames;
+    size_t maxFrames;
+    size_t count;
+    /// The number of innermost frames left to skip
+    size_t skip;
+};
+
+inline _Unwind_Reason_Code captureFrame(_Unwind_Context* context, void* argument) {
+    auto& capture = *static_cast<StackCapture*>(argument);
+    const auto returnAddress = _Unwind_GetIP(context);
+    if (returnAddress == 0) {
+        return _URC_END_OF_STACK;
+    }
+    if (capture.skip > 0) {
+        --capture.skip;
+        return _URC_NO_REASON;
+    }
+    capture.frames[capture.count++] = reinterpret_cast<void*>(returnAddress);
+    return capture.count < capture.maxFrames ? _URC_NO_REASON : _URC_END_OF_STACK;
+}
+
+/**
+ * Captures up to `maxFrames` return addresses of the calling function, returning the number of
+ * captured frames.
+ *
+ * The stack is walked by the unwinder using the unwind tables (.eh_frame) of the modules, which
+ * are emitted by default - so unlike walking frame pointers, frames of code compiled without frame
+ * pointers are captured, and no unrelated stack memory is read.
+ */
+__WPP_NOINLINE inline size_t captureStack(void** frames, size_t maxFrames) {
+    // Skip the frame of this function.
+    StackCapture capture{frames, maxFrames, 0, 1};
+    if (maxFrames > 0) {
+        _Unwind_Backtrace(captureFrame, &capture);
+    }
+    return capture.count;
+}
+
+#endif
+
+}  // namespace internal
+
+#ifndef WPP_MAX_MODULES
+/**
+ * The maximal number of modules in the module registry.
+ */
+#define WPP_MAX_MODULES 256
+#endif
+
+static_assert(WPP_MAX_MODULES > 0 && WPP_MAX_MODULES < internal::UNKNOWN_MODULE_INDEX,
+              "WPP: Invalid maximal number of modules!");
+
+/**
+ * A process-wide registry of the modules referenced by module-relative trace items, assigning each
+ * module a small index. Modules are registered on first use, and are never removed.
+ */
+class ModuleRegistry {
+public:
+    static ModuleRegistry& instance() noexcept {
+        static ModuleRegistry registry;
+        return registry;
+    }
+
+    // Prevent copy operations
+    ModuleRegistry(const ModuleRegistry&) = delete;
+    ModuleRegistry& operator=(const ModuleRegistry&) = delete;
+
+    // Prevent move operations
+    ModuleRegistry(ModuleRegistry&&) = delete;
+    ModuleRegistry& operator=(ModuleRegistry&&) = delete;
+
+    /**
+     * Get the index of the module containing the given address, registering it if required.
+     * Returns UNKNOWN_MODULE_INDEX if the address is not inside a module, or the registry is full.
+     */
+    uint16_t getModuleIndex(const void* address) noexcept {
+        const auto value = reinterpret_cast<uintptr_t>(address);
+        const size_t count = m_count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            if (value >= m_modules[i].start && value < m_modules[i].end) {
+                return static_cast<uint16_t>(i);
+            }
+        }
+
+        return registerModule(address);
+    }
+
+    /**
+     * The number of registered modules.
+     */
+    size_t size() const noexcept {
+        return m_count.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Get a registered module by its index.
+     */
+    const ModuleInfo& operator[](size_t index) const noexcept {
+        return m_modules[index];
+    }
+
+private:
+    ModuleRegistry() = default;
+
+    uint16_t registerModule(const void* address) noexcept {
+        ModuleInfo info;
+        if (!internal::findModule(address, info)) {
+            return internal::UNKNOWN_MODULE_INDEX;
+        }
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        const size_t count = m_count.load(std::memory_order_relaxed);
+
+        // The module could have been registered by another thread in the meantime.
+        for (size_t i = 0; i < count; ++i) {
+            if (m_modules[i].start == info.start) {
+                return static_cast<uint16_t>(i);
+            }
+        }
+
+        if (count == WPP_MAX_MODULES) {
+            return internal::UNKNOWN_MODULE_INDEX;
+        }
+
+        m_modules[count] = info;
+        m_count.store(count + 1, std::memory_order_release);
+        return static_cast<uint16_t>(count);
+    }
+
+    std::mutex m_lock;
+    std::atomic<size_t> m_count{0};
+    ModuleInfo m_modules[WPP_MAX_MODULES];
+};
+
+#ifndef _WIN32
+
+namespace internal {
+
+struct TracedModulesContext {
+    ModuleId* ids;
+    size_t maxCount;
+    size_t count;
+};
+
+inline int tracedModulesCallback(dl_phdr_info* module, size_t, void* data) {
+    auto context = static_cast<TracedModulesContext*>(data);
+    if (findModuleNote(*module, TRACED_MODULE_NOTE_TYPE, TRACED_MODULE_NOTE_NAME) != nullptr) {
+        readModuleId(*module, context->ids[context->count++]);
+    }
+    return context->count == context->maxCount ? 1 : 0;
+}
+
+}  // namespace internal
+
+/**
+ * Get the build identifiers of the loaded modules traced by WPP (the modules containing the traced
+ * module note), returning the number of modules written to `ids` (up to `maxCount`).
+ */
+inline size_t getTracedModules(ModuleId* ids, size_t maxCount) noexcept {
+    if (maxCount == 0) {
+        return 0;
+    }
+
+    internal::TracedModulesContext context{ids, maxCount, 0};
+    dl_iterate_phdr(internal::tracedModulesCallback, &context);
+    return context.count;
+}
+
+#endif
+
+}  // namespace wpp
@@ -20,7 +20,146 @@ constexpr bool isCloseBracket(const char* str) {
     return *str == '}';
 }
 
-enum class ArgumentParseStatus { Success, ExcessOpens, ExcessCloses, MissingColonInFormat };
+enum class ArgumentParseStatus {
+    Success,
+    ExcessOpens,
+    ExcessCloses,
+    InvalidFieldName,
+    InvalidFormatSpec,
+    MixedArgumentReferences,
+    UnreferencedArgument
+};
+
+constexpr bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+constexpr bool isIdentifierStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+/**
+ * Checks whether the given field name (the text preceding the ':' in a replacement field) is valid:
+ * either empty (the next argument), an argument index or an identifier.
+ */
+constexpr bool isValidFieldName(std::string_view name) {
+    if (name.empty()) {
+        return true;
+    }
+
+    const bool isIndex = isDigit(name[0]);
+    if (!isIndex && !isIdentifierStart(name[0])) {
+        return false;
+    }
+    for (const char c : name) {
+        if (!isDigit(c) && (isIndex || !isIdentifierStart(c))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr bool isAlignment(char c) {
+    return c == '<' || c == '>' || c == '^' || c == '=';
+}
+
+/**
+ * A parsed format specification, in the Python/fmt syntax:
+ *
+ *     [[fill]align][sign][#][0][width][grouping][.precision]type
+ *
+ * Only the type (such as `x`, `zx` or `stack`) selects the trace item of the argument. The rest of
+ * the specification describes how the value is rendered, so it's only kept in the trace metadata,
+ * and applied when the traces are formatted.
+ */
+struct FormatSpec {
+    bool isValid;
+    /// The fill character, or '\0' if not specified
+    char fill;
+    /// One of '<', '>', '^', '=', or '\0' if not specified
+    char align;
+    /// One of '+', '-', ' ', or '\0' if not specified
+    char sign;
+    bool alternate;
+    bool zeroPadding;
+    size_t width;
+    /// One of ',', '_', or '\0' if not specified
+    char grouping;
+    bool hasPrecision;
+    size_t precision;
+    std::string_view type;
+
+    /**
+     * Whether the specification uses any of the options which only apply to numbers.
+     */
+    constexpr bool hasNumericOptions() const {
+        return sign != '\0' || alternate || zeroPadding || grouping != '\0' || align == '=';
+    }
+};
+
+constexpr size_t parseNumber(std::string_view spec, size_t& position) {
+    size_t result = 0;
+    while (position < spec.size() && isDigit(spec[position])) {
+        result = result * 10 + static_cast<size_t>(spec[position] - '0');
+        ++position;
+    }
+    return result;
+}
+
+/**
+ * Parse a format specification (the text following the ':' in a replacement field).
+ */
+constexpr FormatSpec parseFormatSpec(std::string_view spec) {
+    FormatSpec result{true, '\0', '\0', '\0', false, false, 0, '\0', false, 0, {}};
+    size_t i = 0;
+    if (spec.size() >= 2 && isAlignment(spec[1])) {
+        if (spec[0] == '{' || spec[0] == '}') {
+            result.isValid = false;
+            return result;
+        }
+        result.fill = spec[0];
+        result.align = spec[1];
+        i = 2;
+    } else if (spec.size() >= 1 && isAlignment(spec[0])) {
+        result.align = spec[0];
+        i = 1;
+    }
+
+    if (i < spec.size() && (spec[i] == '+' || spec[i] == '-' || spec[i] == ' ')) {
+        result.sign = spec[i++];
+    }
+    if (i < spec.size() && spec[i] == '#') {
+        result.alternate = true;
+        ++i;
+    }
+    if (i < spec.size() && spec[i] == '0') {
+        result.zeroPadding = true;
+        ++i;
+    }
+    result.width = parseNumber(spec, i);
+    if (i < spec.size() && (spec[i] == ',' || spec[i] == '_')) {
+        result.grouping = spec[i++];
+    }
+    if (i < spec.size() && spec[i] == '.') {
+        ++i;
+        if (i >= spec.size() || !isDigit(spec[i])) {
+            result.isValid = false;
+            return result;
+        }
+        result.hasPrecision = true;
+        result.precision = parseNumber(spec, i);
+    }
+
+    result.type = spec.substr(i);
+    // The type may not contain any of the other options, which are only valid in order.
+    for (const char c : result.type) {
+        if (isDigit(c) || isAlignment(c) || c == '+' || c == '-' || c == ' ' || c == '#' ||
+            c == ',' || c == '_' || c == '.') {
+            result.isValid = false;
+        }
+    }
+    return result;
+}
 
 struct SingleArgumentResult {
     ArgumentParseStatus status;
@@ -28,6 +167,8 @@ struct SingleArgumentResult {
     const char* start;
     /// The end of the format specifier
     const char* end;
+    /// The field name, preceding the ':'
+    std::string_view name;
     /// The number of characters processed before returning the result (typically more than
     /// `end - start`, as you have to add any non-format characters, `{:` and `}`)
     size_t charsProcessed;
@@ -46,28 +187,33 @@ constexpr SingleArgumentResult getSingleArgument(const char* str, size_t size) {
                 ++i;
             }
             if (i >= size) {
-                return {ArgumentParseStatus::ExcessOpens, nullptr, nullptr, 0};
+                return {ArgumentParseStatus::ExcessOpens, nullptr, nullptr, {}, 0};
             }
 
             const char* argEnd = str + i;
-            if (argStart != argEnd) {
-                if (*argStart != ':') {
-                    return {ArgumentParseStatus::MissingColonInFormat, nullptr, nullptr, 0};
-                }
-                ++argStart;
+            const char* specStart = argStart;
+            while (specStart != argEnd && *specStart != ':') {
+                ++specStart;
+            }
+            const std::string_view name(argStart, static_cast<size_t>(specStart - argStart));
+            if (!isValidFieldName(name)) {
+                return {ArgumentParseStatus::InvalidFieldName, nullptr, nullptr, {}, 0};
+            }
+            if (specStart != argEnd) {
+                ++specStart;  // Skip the colon
             }
             // Got to a closing bracket!
-            return {ArgumentParseStatus::Success, argStart, argEnd, i + 1};
+            return {ArgumentParseStatus::Success, specStart, argEnd, name, i + 1};
         } else if (isDoubleOpenBracket(str + i, size - i) ||
                    isDoubleCloseBracket(str + i, size - i)) {
             i += 2;
         } else if (isCloseBracket(str + i)) {
-            return {ArgumentParseStatus::ExcessCloses, nullptr, nullptr, 0};
+            return {ArgumentParseStatus::ExcessCloses, nullptr, nullptr, {}, 0};
         } else {
             ++i;
         }
     }
-    return {ArgumentParseStatus::Success, nullptr, nullptr, i};
+    return {ArgumentParseStatus::Success, nullptr, nullptr, {}, i};
 }
 
 struct CountArgsResult {
@@ -76,10 +222,11 @@ struct CountArgsResult {
 };
 
 /**
- * Count the number of arguments found in the given string.
+ * Count the number of replacement fields found in the given string. Fields may reference the same
+ * argument, see parseFormatFields().
  * If the format string is invalid, an invalid status is returned with a count of 0.
  */
-constexpr CountArgsResult countArgs(std::string_view format) {
+constexpr CountArgsResult countFields(std::string_view format) {
     const auto size = format.size();
     const auto* str = format.data();
     size_t count = 0;
@@ -97,6 +244,11 @@ constexpr CountArgsResult countArgs(std::string_view format) {
             continue;
         }
 
+        if (!parseFormatSpec({result.start, static_cast<size_t>(result.end - result.start)})
+                 .isValid) {
+            return {ArgumentParseStatus::InvalidFormatSpec, 0};
+        }
+
         ++count;
     }
 
@@ -104,53 +256,181 @@ constexpr CountArgsResult countArgs(std::string_view format) {
 }
 
 /**
- * Get an array of format specifiers from the given format string.
- * It is assumed that the number of arguments is known in advance and that the format string is
- * valid.
+ * A replacement field of a format string, referencing an argument.
+ */
+struct FormatField {
+    /// Empty for the next argument, an argument index or an argument name
+    std::string_view name;
+    FormatSpec spec;
+    size_t argIndex;
+};
+
+template<size_t fieldCount>
+struct FormatFields {
+    ArgumentParseStatus status;
+    /// The number of distinct arguments referenced by the fields
+    size_t argCount;
+    std::array<FormatField, fieldCount> fields;
+};
+
+constexpr size_t parseArgumentIndex(std::string_view name, size_t limit) {
+    size_t result = 0;
+    for (const char c : name) {
+        result = result * 10 + static_cast<size_t>(c - '0');
+        if (result >= limit) {
+            return limit;
+        }
+    }
+    return result;
+}
+
+/**
+ * Parse the replacement fields of the given format string, and map them to argument indices.
+ * It is assumed that the number of fields is known in advance and that the format string is valid.
+ *
+ * Fields are either positional (`{0}`, `{1:x}`), or reference the next argument (`{}`, `{:x}`).
+ * Named fields (`{name}`) reference the next argument the first time the name is used, and the same
+ * argument afterwards. Every argument must be referenced. An argument is traced only once, so all
+ * its references must select the same trace item - which depends on the argument type, so it's
+ * checked with the arguments (see ArgChecker).
  */
-template<size_t argCount>
-constexpr auto getFormatInfo(std::string_view format) {
-    std::array<std::string_view, argCount> result{};
+template<size_t fieldCount>
+constexpr FormatFields<fieldCount> parseFormatFields(std::string_view format) {
+    FormatFields<fieldCount> result{ArgumentParseStatus::Success, 0, {}};
     auto size = format.size();
     const auto* str = format.data();
+    bool hasNextArgumentFields = false;
+    bool hasPositionalFields = false;
 
-    for (size_t i = 0; i < argCount; ++i) {
-        // This will never fail, as getFormatInfo is always called after countArgs(), that validates
-        // all arguments are correct.
+    for (size_t i = 0; i < fieldCount; ++i) {
+        // This will never fail, as parseFormatFields is always called after countFields(), that
+        // validates all fields are correct.
         const auto argInfo = wpp::internal::getSingleArgument(str, size);
 
         str += argInfo.charsProcessed;
         size -= argInfo.charsProcessed;
 
-        result[i] = {argInfo.start, static_cast<size_t>(argInfo.end - argInfo.start)};
+        auto& field = result.fields[i];
+        field.name = argInfo.name;
+        field.spec = parseFormatSpec(
+            {argInfo.start, static_cast<size_t>(argInfo.end - argInfo.start)});
+
+        if (!field.name.empty() && isDigit(field.name[0])) {
+            hasPositionalFields = true;
+            // An index of at least fieldCount can't have all the preceding arguments referenced.
+            field.argIndex = parseArgumentIndex(field.name, fieldCount);
+            if (field.argIndex >= result.argCount) {
+                result.argCount = field.argIndex + 1;
+            }
+            continue;
+        }
+
+        hasNextArgumentFields = true;
+        field.argIndex = result.argCount;
+        for (size_t j = 0; !field.name.empty() && j < i; ++j) {
+            if (result.fields[j].name == field.name) {
+                field.argIndex = result.fields[j].argIndex;
+                break;
+            }
+        }
+        if (field.argIndex == result.argCount) {
+            ++result.argCount;
+        }
+    }
+
+    if (hasNextArgumentFields && hasPositionalFields) {
+        return {ArgumentParseStatus::MixedArgumentReferences, 0, {}};
     }
 
+    for (size_t argIndex = 0; argIndex < result.argCount; ++argIndex) {
+        bool isReferenced = false;
+        for (const auto& field : result.fields) {
+            isReferenced = isReferenced || field.argIndex == argIndex;
+        }
+        if (!isReferenced) {
+            return {ArgumentParseStatus::UnreferencedArgument, 0, {}};
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Get an array of the format specifications of the arguments, taken from their first references.
+ */
+template<size_t argCount, size_t fieldCount>
+constexpr auto getArgumentSpecs(const FormatFields<fieldCount>& formatFields) {
+    std::array<FormatSpec, argCount> result{};
+    for (size_t i = fieldCount; i > 0; --i) {
+        const auto& field = formatFields.fields[i - 1];
+        result[field.argIndex] = field.spec;
+    }
     return result;
 }
 
 /**
- * Convert the string_view at index Index in the given format to FixedConstexprString.
+ * The type of the format specification of the argument at index Index in the given format, which
+ * selects the trace item. This is a class member rather than a static local, as static variables
+ * are not allowed in constexpr functions before C++23.
+ */
+template<typename FormatInfo, size_t Index>
+struct FormatSpecifier {
+    static constexpr const auto value = FormatInfo::formatArray()[Index].type;
+};
+
+/**
+ * The type of the format specification of the replacement field at index Index in the given format.
+ */
+template<typename FormatInfo, size_t Index>
+struct FieldSpecifier {
+    static constexpr const auto value = FormatInfo::fields().fields[Index].spec.type;
+};
+
+#ifdef __WPP_HAS_STRING_TEMPLATE_PARAMETERS
+
+/**
+ * Convert the string_view of the given specifier to FixedStructuralString, which is the same type
+ * as the matching FormatString.
+ */
+template<typename Specifier, size_t... Ixs>
+constexpr auto makeFixedString(std::index_sequence<Ixs...>) {
+    return FixedStructuralString<StructuralString<sizeof...(Ixs)>(Specifier::value)>();
+}
+
+#else
+
+/**
+ * Convert the string_view of the given specifier to FixedConstexprString.
  */
-template<typename FormatInfo, size_t Index, size_t... Ixs>
+template<typename Specifier, size_t... Ixs>
 constexpr auto makeFixedString(std::index_sequence<Ixs...>) {
-    static constexpr const auto format = FormatInfo::formatArray()[Index];
-    static constexpr const auto data = format.data();
-    return FixedConstexprString<data[Ixs]...>();
+    return FixedConstexprString<Specifier::value[Ixs]...>();
 }
 
+#endif
+
 /**
- * Convert the given format info from an array of string views to a tuple of FixedConstexprStrings.
+ * Convert the given format info from an array of string views to a tuple of FormatStrings.
  */
 template<typename FormatInfo, size_t... Ixs>
 constexpr auto convertFormatInfo(std::index_sequence<Ixs...>) {
-    static constexpr const auto formatArray = FormatInfo::formatArray();
-    return std::make_tuple(
-        makeFixedString<FormatInfo, Ixs>(std::make_index_sequence<formatArray[Ixs].size()>())...);
+    return std::make_tuple(makeFixedString<FormatSpecifier<FormatInfo, Ixs>>(
+        std::make_index_sequence<FormatSpecifier<FormatInfo, Ixs>::value.size()>())...);
 }
 
 /**
- * Parse format information from the given template FixedConstexprString into a tuple of
- * FixedConstexprString representing the format specifiers.
+ * Convert the format specifications of the replacement fields of the given format info to a tuple
+ * of FormatStrings.
+ */
+template<typename FormatInfo, size_t... Ixs>
+constexpr auto convertFieldFormats(std::index_sequence<Ixs...>) {
+    return std::make_tuple(makeFixedString<FieldSpecifier<FormatInfo, Ixs>>(
+        std::make_index_sequence<FieldSpecifier<FormatInfo, Ixs>::value.size()>())...);
+}
+
+/**
+ * Parse format information from the given fixed string type (see __WPP_STRING_MAKER) into a tuple
+ * of FormatStrings representing the format specifiers of the arguments.
  *
  * The function is used as a way to get compile-time information from a string, that should be
  * usable in compile-time - therefore the type of the result is more important than the value of the
@@ -161,39 +441,63 @@ constexpr auto getFormatInfo() {
     struct FormatInfoType {
     private:
         static constexpr const auto countResult() {
-            return countArgs(StringType::value());
+            return countFields(StringType::value());
         }
 
     public:
+        /**
+         * Get the parsed replacement fields of the given format string, with their argument
+         * indices.
+         */
+        static constexpr const auto fields() {
+            return parseFormatFields<countResult().count>(StringType::value());
+        }
+
         /**
          * Get the argument count status for the given format string.
          */
         static constexpr const auto status() {
-            return countResult().status;
+            return countResult().status != ArgumentParseStatus::Success ? countResult().status
+                                                                        : fields().status;
         }
 
         /**
          * Get the number of arguments in the given format string.
          */
         static constexpr const auto count() {
+            return fields().argCount;
+        }
+
+        /**
+         * Get the number of replacement fields in the given format string, which is more than the
+         * number of arguments if some arguments are referenced more than once.
+         */
+        static constexpr const auto fieldCount() {
             return countResult().count;
         }
 
         /**
-         * Get an array of format specifier string-views.
+         * Get an array of the parsed format specifications of the arguments.
          * For internal use only (but can't be private because it is required by a template, and a
          * template can't be used in locally defined classes)
          */
         static constexpr const auto formatArray() {
-            return getFormatInfo<count()>(StringType::value());
+            return getArgumentSpecs<count()>(fields());
         }
 
         /**
-         * Get a tuple of the format specifiers.
+         * Get a tuple of the format specifier types.
          */
         static constexpr const auto value() {
             return convertFormatInfo<FormatInfoType>(std::make_index_sequence<count()>());
         }
+
+        /**
+         * Get a tuple of the format specifier types of the replacement fields.
+         */
+        static constexpr const auto fieldFormats() {
+            return convertFieldFormats<FormatInfoType>(std::make_index_sequence<fieldCount()>());
+        }
     };
 
     return FormatInfoType{};
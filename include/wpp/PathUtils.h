@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 
 namespace wpp::internal {
 
@@ -8,7 +9,7 @@ namespace wpp::internal {
  * (the index of 'p' of the word "project").
  *
  * In the case of a relative path not including a directory name, 0 is returned (the beginning of
- * the path).
+ * the path). Both backslashes and forward slashes are treated as path separators.
  *
  * This is used to generate unique trace hashes while keeping the build reproducible.
  */
@@ -18,7 +19,7 @@ constexpr size_t getBaseDirectoryIndex(const char (&file)[N]) {
     size_t index = 0;
     size_t prevIndex = 0;
     for (size_t i = 0; i < len; ++i) {
-        if (file[i] == '\\') {
+        if (file[i] == '\\' || file[i] == '/') {
             prevIndex = index;
             index = i + 1;  // point to the character after
         }
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Platform and compiler abstractions.
+ *
+ * On Windows, the ETW types are taken from the Windows headers. On other platforms, the same types
+ * are defined with the same layout, so trace items and the trace metadata are platform-independent.
+ */
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <guiddef.h>
+#else
+
+/**
+ * A GUID, with the same layout as the Windows GUID structure.
+ */
+struct GUID {
+    uint32_t Data1;
+    uint16_t Data2;
+    uint16_t Data3;
+    uint8_t Data4[8];
+};
+
+using UCHAR = unsigned char;
+using ULONG = uint32_t;
+
+#endif
+
+#ifdef _MSC_VER
+
+#define __WPP_FORCEINLINE __forceinline
+#define __WPP_NOINLINE __declspec(noinline)
+// MSVC has no equivalent of the cold attribute, so cold functions are only kept out of line.
+#define __WPP_COLD
+
+/**
+ * The signature of the current function, used as part of the trace hash and the trace metadata.
+ */
+#define __WPP_FUNCTION_SIGNATURE __FUNCSIG__
+
+/**
+ * Expands to a comma followed by the given arguments, or to nothing if there are no arguments.
+ */
+#define __WPP_COMMA_VA_ARGS(...) , __VA_ARGS__
+
+#else
+
+#define __WPP_FORCEINLINE inline __attribute__((always_inline))
+#define __WPP_NOINLINE __attribute__((noinline))
+#define __WPP_COLD __attribute__((cold))
+#define __WPP_FUNCTION_SIGNATURE __PRETTY_FUNCTION__
+#define __WPP_COMMA_VA_ARGS(...) __VA_OPT__(, ) __VA_ARGS__
+
+#endif
+
+namespace wpp::internal {
+
+/**
+ * The assumed size of a cache line, used to keep frequently read data away from written data.
+ */
+constexpr const size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * A value-dependent false, used in static assertions that should fail only when instantiated.
+ */
+template<typename T>
+inline constexpr bool DependentFalse = false;
+
+}  // namespace wpp::internal
@@ -0,0 +1,159 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include "Modules.h"
+#include "TraceItems.h"
+
+#ifndef WPP_MAX_STACK_FRAMES
+/**
+ * The maximal number of return addresses captured by a single stack trace item.
+ */
+#define WPP_MAX_STACK_FRAMES 16
+#endif
+
+static_assert(WPP_MAX_STACK_FRAMES > 0 && WPP_MAX_STACK_FRAMES < 0xff,
+              "WPP: Invalid maximal number of stack frames!");
+
+namespace wpp {
+
+/**
+ * A placeholder argument, used in order to trace the call stack of the trace. For example:
+ *
+ *     WPP_TRACE_ERROR("Failed to open the file {:stack}", wpp::currentStack);
+ */
+struct CurrentStack {};
+
+inline constexpr CurrentStack currentStack{};
+
+namespace internal {
+
+/**
+ * The return addresses of a call stack. Traces of `currentStack` capture it in the function calling
+ * the trace macro, as the trace items are built in an outlined function (which may be tail-called,
+ * replacing the frame of the caller).
+ */
+struct CapturedStack {
+    /**
+     * Captures the stack of the function this constructor is inlined into, starting at the return
+     * address into that function.
+     */
+    __WPP_FORCEINLINE CapturedStack() noexcept
+        : count(captureStack(frames, WPP_MAX_STACK_FRAMES)) {
+        // Intentionally left blank.
+    }
+
+    void* frames[WPP_MAX_STACK_FRAMES];
+    size_t count;
+};
+
+}  // namespace internal
+
+/**
+ * A trace item containing the call stack, captured at the call site of the trace.
+ *
+ * Frames are not symbolized at runtime - each frame is traced as a module-relative address (see
+ * encodeModuleAddress), and the modules are traced by their build identifiers, so the decoder can
+ * find the matching symbols offline. The item is traced as a size followed by the data:
+ *
+ *     uint16_t size;                // The size of the following data
+ *     uint8_t frameCount;
+ *     uint8_t moduleCount;
+ *     ModuleId modules[moduleCount];
+ *     uint64_t frames[frameCount];  // Module indices are indices into `modules`
+ */
+struct StackItem {
+    explicit StackItem(const internal::CapturedStack& stack) noexcept : header{0, 0} {
+        uint16_t registryIndices[WPP_MAX_STACK_FRAMES];
+        for (size_t i = 0; i < stack.count; ++i) {
+            frames[i] = encodeFrame(stack.frames[i], registryIndices);
+        }
+        header.frameCount = static_cast<uint8_t>(stack.count);
+
+        size = static_cast<uint16_t>(sizeof(header) + header.moduleCount * sizeof(ModuleId) +
+                                     header.frameCount * sizeof(uint64_t));
+    }
+
+    auto makeTracePairs() const {
+        return std::make_tuple<TracePair, TracePair, TracePair, TracePair>(
+            {&size, sizeof(size)}, {&header, sizeof(header)},
+            {modules, header.moduleCount * sizeof(ModuleId)},
+            {frames, header.frameCount * sizeof(uint64_t)});
+    }
+
+    /**
+     * The number of captured frames.
+     */
+    size_t frameCount() const noexcept {
+        return header.frameCount;
+    }
+
+    /**
+     * The number of distinct modules referenced by the captured frames.
+     */
+    size_t moduleCount() const noexcept {
+        return header.moduleCount;
+    }
+
+private:
+    /**
+     * Encodes a single frame, adding its module to the module list if required. Modules are found
+     * through the address ranges cached by the ModuleRegistry, so the loaded modules are only
+     * iterated the first time an address of a module is seen.
+     */
+    uint64_t encodeFrame(const void* address, uint16_t* registryIndices) {
+        auto& registry = ModuleRegistry::instance();
+        const uint16_t registryIndex = registry.getModuleIndex(address);
+        if (registryIndex == internal::UNKNOWN_MODULE_INDEX) {
+            return internal::encodeModuleAddress(internal::UNKNOWN_MODULE_INDEX,
+                                                 reinterpret_cast<uintptr_t>(address));
+        }
+
+        uint8_t index = 0;
+        while (index < header.moduleCount && registryIndices[index] != registryIndex) {
+            ++index;
+        }
+        const auto& info = registry[registryIndex];
+        if (index == header.moduleCount) {
+            registryIndices[index] = registryIndex;
+            modules[index] = info.id;
+            ++header.moduleCount;
+        }
+
+        return internal::encodeModuleAddress(index,
+                                             reinterpret_cast<uintptr_t>(address) - info.base);
+    }
+
+    struct Header {
+        uint8_t frameCount;
+        uint8_t moduleCount;
+    };
+
+    uint16_t size;
+    Header header;
+    ModuleId modules[WPP_MAX_STACK_FRAMES];
+    uint64_t frames[WPP_MAX_STACK_FRAMES];
+};
+
+/**
+ * The call stack is traced with the `stack` specifier (or an empty one). The trace macros replace
+ * `currentStack` with the stack captured at the call site, so the stack is only captured here when
+ * the item is built directly.
+ */
+template<typename Format>
+struct TraceItemMaker<CurrentStack, Format,
+                      std::enable_if_t<Format::size() == 0 || Format::value() == "stack">> {
+    static auto make(CurrentStack) {
+        return StackItem{internal::CapturedStack{}};
+    }
+};
+
+template<typename Format>
+struct TraceItemMaker<internal::CapturedStack, Format,
+                      std::enable_if_t<Format::size() == 0 || Format::value() == "stack">> {
+    static auto make(const internal::CapturedStack& stack) {
+        return StackItem{stack};
+    }
+};
+
+}  // namespace wpp
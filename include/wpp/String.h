@@ -99,6 +99,64 @@ struct FixedConstexprString<> {
     }
 };
 
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+
+/**
+ * Strings can be passed as a single template parameter of a structural class type (C++20), rather
+ * than as a pack of characters. This is much cheaper to compile for long strings, and shortens the
+ * names of the instantiations in the debug information.
+ */
+#define __WPP_HAS_STRING_TEMPLATE_PARAMETERS
+
+/**
+ * A structural fixed-size string, usable as a template parameter. The string is null-terminated,
+ * so strings of size 0 are supported as well.
+ */
+template<size_t N>
+struct StructuralString {
+    constexpr StructuralString(const char (&str)[N + 1]) noexcept
+        : StructuralString(std::string_view(str, N)) {
+        // Intentionally left blank.
+    }
+
+    constexpr explicit StructuralString(std::string_view str) noexcept {
+        for (size_t i = 0; i < N; ++i) {
+            data[i] = str[i];
+        }
+    }
+
+    char data[N + 1]{};
+};
+
+template<size_t N>
+StructuralString(const char (&)[N]) -> StructuralString<N - 1>;
+
+/**
+ * This is a string class for fixed strings, with the same interface as FixedConstexprString.
+ * Each different string is a unique instantiation of this class.
+ */
+template<StructuralString str>
+struct FixedStructuralString {
+    static constexpr const auto value() {
+        return std::string_view(str.data, size());
+    }
+
+    static constexpr auto size() {
+        return sizeof(str.data) - 1;
+    }
+};
+
+/**
+ * A Generator for FixedStructuralStrings from characters, used to spell format specifiers.
+ */
+template<char... chars>
+constexpr auto makeStructuralString() noexcept {
+    const char str[] = {chars..., '\0'};
+    return StructuralString<sizeof...(chars)>(str);
+}
+
+#endif
+
 /**
  * A Generator for FixedConstexprStrings from a pointer to a string and indices.
  */
@@ -112,13 +170,34 @@ static auto makeFixedString(std::index_sequence<Ixs...>) {
     return FixedConstexprString<str[Ixs]...>();
 }
 
+/**
+ * A Generator for FixedConstexprStrings from a type whose static `get()` function returns a
+ * pointer to the string.
+ */
+template<typename StringProvider, std::size_t... Ixs>
+constexpr auto makeProvidedFixedString(std::index_sequence<Ixs...>) {
+    return FixedConstexprString<StringProvider::get()[Ixs]...>();
+}
+
 }  // namespace wpp::internal
 
 /**
  * Generates a type named `name` whose static `::value()` function returns a string view of the
  * given string literal. `name` must be a valid class name, and `str` must be a string literal.
+ *
+ * The literal is only referenced by a template parameter or a constexpr function, so unlike a
+ * static variable, it is never emitted into the binary.
  */
-#define __WPP_STRING_MAKER(name, str)                                                 \
-    static constexpr const auto ___wpp_trace_str_##name = str;                        \
-    using name = decltype(::wpp::internal::makeFixedString<&___wpp_trace_str_##name>( \
+#ifdef __WPP_HAS_STRING_TEMPLATE_PARAMETERS
+#define __WPP_STRING_MAKER(name, str) \
+    using name = ::wpp::internal::FixedStructuralString<::wpp::internal::StructuralString(str)>
+#else
+#define __WPP_STRING_MAKER(name, str)                                                       \
+    struct ___WppStringProvider##name {                                                     \
+        static constexpr const char* get() {                                                \
+            return str;                                                                     \
+        }                                                                                   \
+    };                                                                                      \
+    using name = decltype(::wpp::internal::makeProvidedFixedString<___WppStringProvider##name>( \
         std::make_index_sequence<sizeof(str) - 1>()))
+#endif
@@ -0,0 +1,194 @@
+#pragma once
+#include <cstddef>
+#include <array>
+#include <string_view>
+#include <type_traits>
+#include "TraceItems.h"
+
+namespace wpp {
+
+/**
+ * Compile-time information about a single field of a traceable struct.
+ */
+struct StructFieldInfo {
+    /// The field name, as written in WPP_DEFINE_STRUCT_ITEM
+    std::string_view name;
+    /// The offset of the field inside the struct
+    size_t offset;
+    /// The size of the field inside the struct
+    size_t size;
+};
+
+/**
+ * A compile-time description of a traceable struct.
+ * This template should not be specialized directly - use WPP_DEFINE_STRUCT_ITEM instead.
+ *
+ * A specialization provides:
+ * - `fields` - a std::array of StructFieldInfo, in declaration order.
+ * - `FieldItems` - a std::tuple of the trace item types matching each field.
+ */
+template<typename T>
+struct StructDescriptor;
+
+/**
+ * A trace item for a struct registered using WPP_DEFINE_STRUCT_ITEM.
+ * The struct is traced as a single copy of its bytes, and the fields are described by the
+ * metadata only.
+ */
+template<typename T>
+struct StructItem : ReferenceTraceItem<T> {};
+
+namespace internal {
+
+/**
+ * Checks whether the given type was registered as a traceable struct.
+ */
+template<typename T, typename = void>
+struct IsTraceableStruct : std::false_type {};
+
+template<typename T>
+struct IsTraceableStruct<T, std::void_t<decltype(StructDescriptor<T>::fields)>> : std::true_type {
+};
+
+/**
+ * The layout of a traceable struct: its size, the offsets and sizes of its fields, and their trace
+ * item types. The type is used in order to write the struct layout to the metadata.
+ */
+template<size_t Size, typename Offsets, typename Sizes, typename FieldItems>
+struct StructLayout {};
+
+template<typename T, size_t... Ixs>
+constexpr auto makeStructLayout(std::index_sequence<Ixs...>) {
+    constexpr const auto& fields = StructDescriptor<T>::fields;
+    return StructLayout<sizeof(T), std::index_sequence<fields[Ixs].offset...>,
+                        std::index_sequence<fields[Ixs].size...>,
+                        typename StructDescriptor<T>::FieldItems>{};
+}
+
+/**
+ * Get the StructLayout type of the given traceable struct.
+ */
+template<typename T>
+using StructLayoutType = decltype(makeStructLayout<T>(
+    std::make_index_sequence<std::tuple_size_v<typename StructDescriptor<T>::FieldItems>>()));
+
+/**
+ * Gets the trace item type of a single struct field, validating it can be part of a struct.
+ */
+template<typename FieldType>
+struct StructFieldItem {
+    static_assert(!std::is_array_v<FieldType>,
+                  "WPP: Array fields are not supported in traced structs!");
+
+    using type = decltype(buildTraceItem<FormatString<>>(std::declval<const FieldType&>()));
+
+    static_assert(!std::is_same_v<type, InvalidFormatItem>,
+                  "WPP: The struct field type cannot be traced!");
+};
+
+}  // namespace internal
+
+/**
+ * Structs are only supported with the default format specifier.
+ */
+template<typename T, typename Format>
+struct TraceItemMaker<
+    T, Format, std::enable_if_t<internal::IsTraceableStruct<T>::value && Format::size() == 0>> {
+    static constexpr auto make(const T& value) {
+        return StructItem<T>{value};
+    }
+};
+
+}  // namespace wpp
+
+//////////////////////////////
+// Struct definition macros //
+//////////////////////////////
+
+#define __WPP_EXPAND(x) x
+
+#define __WPP_FOR_EACH_1(macro, arg, x) macro(arg, x)
+#define __WPP_FOR_EACH_2(macro, arg, x, ...) \
+    macro(arg, x), __WPP_EXPAND(__WPP_FOR_EACH_1(macro, arg, __VA_ARGS__))
+#define __WPP_FOR_EACH_3(macro, arg, x, ...) \
+    macro(arg, x), __WPP_EXPAND(__WPP_FOR_EACH_2(macro, arg, __VA_ARGS__))
+#define __WPP_FOR_EACH_4(macro, arg, x, ...) \
+    macro(arg, x), __WPP_EXPAND(__WPP_FOR_EACH_3(macro, arg, __VA_ARGS__))
+#define __WPP_FOR_EACH_5(macro, arg, x, ...) \
+    macro(arg, x), __WPP_EXPAND(__WPP_FOR_EACH_4(macro, arg, __VA_ARGS__))
+#define __WPP_FOR_EACH_6(macro, arg, x, ...) \
+    macro(arg, x), __WPP_EXPAND(__WPP_FOR_EACH_5(macro, arg, __VA_ARGS__))
+#define __WPP_FOR_EACH_7(macro, arg, x, ...) \
+    macro(arg, x), __WPP_EXPAND(__WPP_FOR_EACH_6(macro, arg, __VA_ARGS__))
+#define __WPP_FOR_EACH_8(macro, arg, x, ...) \
+    macro(arg, x), __WPP_EXPAND(__WPP_FOR_EACH_7(macro, arg, __VA_ARGS__))
+#define __WPP_FOR_EACH_9(macro, arg, x, ...) \
+    macro(arg, x), __WPP_EXPAND(__WPP_FOR_EACH_8(macro, arg, __VA_ARGS__))
+#define __WPP_FOR_EACH_10(macro, arg, x, ...) \
+    macro(arg, x), __WPP_EXPAND(__WPP_FOR_EACH_9(macro, arg, __VA_ARGS__))
+#define __WPP_FOR_EACH_11(macro, arg, x, ...) \
+    macro(arg, x), __WPP_EXPAND(__WPP_FOR_EACH_10(macro, arg, __VA_ARGS__))
+#define __WPP_FOR_EACH_12(macro, arg, x, ...) \
+    macro(arg, x), __WPP_EXPAND(__WPP_FOR_EACH_11(macro, arg, __VA_ARGS__))
+#define __WPP_FOR_EACH_13(macro, arg, x, ...) \
+    macro(arg, x), __WPP_EXPAND(__WPP_FOR_EACH_12(macro, arg, __VA_ARGS__))
+#define __WPP_FOR_EACH_14(macro, arg, x, ...) \
+    macro(arg, x), __WPP_EXPAND(__WPP_FOR_EACH_13(macro, arg, __VA_ARGS__))
+#define __WPP_FOR_EACH_15(macro, arg, x, ...) \
+    macro(arg, x), __WPP_EXPAND(__WPP_FOR_EACH_14(macro, arg, __VA_ARGS__))
+#define __WPP_FOR_EACH_16(macro, arg, x, ...) \
+    macro(arg, x), __WPP_EXPAND(__WPP_FOR_EACH_15(macro, arg, __VA_ARGS__))
+
+#define __WPP_GET_FOR_EACH(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, \
+                           name, ...)                                                              \
+    name
+
+/**
+ * Expands to `macro(arg, x)` for each x in the variadic arguments, separated by commas.
+ * Up to 16 arguments are supported.
+ */
+#define __WPP_FOR_EACH(macro, arg, ...)                                                           \
+    __WPP_EXPAND(__WPP_GET_FOR_EACH(                                                              \
+        __VA_ARGS__, __WPP_FOR_EACH_16, __WPP_FOR_EACH_15, __WPP_FOR_EACH_14, __WPP_FOR_EACH_13, \
+        __WPP_FOR_EACH_12, __WPP_FOR_EACH_11, __WPP_FOR_EACH_10, __WPP_FOR_EACH_9,               \
+        __WPP_FOR_EACH_8, __WPP_FOR_EACH_7, __WPP_FOR_EACH_6, __WPP_FOR_EACH_5, __WPP_FOR_EACH_4, \
+        __WPP_FOR_EACH_3, __WPP_FOR_EACH_2, __WPP_FOR_EACH_1)(macro, arg, __VA_ARGS__))
+
+#define __WPP_STRUCT_FIELD_INFO(Type, field) \
+    ::wpp::StructFieldInfo { #field, offsetof(Type, field), sizeof(Type::field) }
+
+#define __WPP_STRUCT_FIELD_ITEM(Type, field) \
+    typename ::wpp::internal::StructFieldItem<decltype(Type::field)>::type
+
+/**
+ * Registers a trivially copyable struct as a single trace item.
+ *
+ * Type - the struct type. Must be trivially copyable and standard layout.
+ * ... - the names of the fields to describe in the metadata (up to 16).
+ *
+ * The macro must be used in the global namespace, after including "wpp/Trace.h". For example:
+ *
+ *     struct Packet { uint32_t src, dst; uint16_t len; };
+ *     WPP_DEFINE_STRUCT_ITEM(Packet, src, dst, len);
+ *
+ *     WPP_TRACE_INFO("Got packet {}", packet);  // Traces "Got packet {src=1, dst=2, len=3}"
+ */
+#define WPP_DEFINE_STRUCT_ITEM(Type, ...)                                                         \
+    template<>                                                                                    \
+    struct wpp::StructDescriptor<Type> {                                                          \
+        static_assert(std::is_trivially_copyable_v<Type>,                                         \
+                      "WPP: Traced structs must be trivially copyable!");                         \
+        static_assert(std::is_standard_layout_v<Type>,                                            \
+                      "WPP: Traced structs must have a standard layout!");                        \
+                                                                                                  \
+        static constexpr const std::array fields{                                                 \
+            __WPP_FOR_EACH(__WPP_STRUCT_FIELD_INFO, Type, __VA_ARGS__)};                          \
+                                                                                                  \
+        using FieldItems = std::tuple<__WPP_FOR_EACH(__WPP_STRUCT_FIELD_ITEM, Type, __VA_ARGS__)>; \
+                                                                                                  \
+        /* Writes the struct layout and the field names to the metadata. */                       \
+        template<typename Layout>                                                                 \
+        static void annotate() {                                                                  \
+            __WPP_ANNOTATE_STRUCT_DESCRIPTOR(__VA_ARGS__);                                        \
+        }                                                                                         \
+    }
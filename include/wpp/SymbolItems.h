@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include "Modules.h"
+#include "TraceItems.h"
+
+namespace wpp {
+
+/**
+ * A trace item for a pointer traced using the `sym` specifier, which the decoder resolves to a
+ * symbol (such as a function or a global object).
+ *
+ * The pointer is traced as a module-relative address (see encodeModuleAddress), using the index of
+ * the module in the ModuleRegistry, so it takes the same 8 bytes as a raw pointer. The module
+ * indices are resolved to build identifiers using module load records, which are traced once per
+ * module in every trace session.
+ */
+struct SymbolItem : TrivialTraceItem<uint64_t> {
+    static SymbolItem fromAddress(const void* address) noexcept {
+        const uint16_t index = ModuleRegistry::instance().getModuleIndex(address);
+        const auto value = reinterpret_cast<uintptr_t>(address);
+        if (index == internal::UNKNOWN_MODULE_INDEX) {
+            return SymbolItem{internal::encodeModuleAddress(index, value)};
+        }
+        return SymbolItem{
+            internal::encodeModuleAddress(index, value - ModuleRegistry::instance()[index].base)};
+    }
+};
+
+/**
+ * Any pointer (including function pointers) can be traced as a symbol.
+ */
+template<typename T, typename Format>
+struct TraceItemMaker<T*, Format, std::enable_if_t<Format::value() == "sym">> {
+    static auto make(const T* ptr) {
+        return SymbolItem::fromAddress(reinterpret_cast<const void*>(ptr));
+    }
+};
+
+/**
+ * The message GUID of module load records, which match the module indices of SymbolItems with the
+ * build identifiers of their modules. Every record contains the module index (a 16-bit integer)
+ * and the module identifier (as a size-prefixed buffer), and is traced right after the first trace
+ * referencing the module in a trace session (see internal::traceModuleLoads).
+ *
+ * Decoders that resolve the symbols consume these records, instead of printing them as traces.
+ */
+constexpr const GUID MODULE_LOAD_GUID = {
+    0x4d505057, 0x0001, 0x3000, {0x80, 0x00, 'W', 'P', 'P', 'M', 'O', 'D'}};
+
+/**
+ * Module identifiers are traced as hex, used by module load records.
+ */
+template<typename Format>
+struct TraceItemMaker<ModuleId, Format, std::enable_if_t<Format::size() == 0>> {
+    static constexpr auto make(const ModuleId& id) {
+        return HexBufferItem{id.bytes, sizeof(id.bytes)};
+    }
+};
+
+}  // namespace wpp
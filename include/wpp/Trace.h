@@ -1,14 +1,33 @@
 #pragma once
+#include "Platform.h"
 #include "TypeTraits.h"
 #include "String.h"
 #include "PathUtils.h"
 #include "TraceItems.h"
+#include "StructItems.h"
+#include "CompositeItems.h"
+#include "StackItems.h"
+#include "SymbolItems.h"
+#include "ConstantItems.h"
 #include "TraceProvider.h"
 #include "Md5.h"
+#include "Metadata.h"
 #include "ParseUtils.h"
 
+#ifdef WPP_ENABLE_CALL_SITE_REGISTRY
+#include "CallSites.h"
+#endif
+
+#ifdef WPP_ENABLE_INLINE_METADATA
+#include "InlineMetadata.h"
+#endif
+
 #define __WPP_MAKE_STRING_IMPL(...) #__VA_ARGS__
+#ifdef _MSC_VER
 #define __WPP_MAKE_STRING(...) __WPP_MAKE_STRING_IMPL(__VA_ARGS__)##""
+#else
+#define __WPP_MAKE_STRING(...) __WPP_MAKE_STRING_IMPL(__VA_ARGS__)
+#endif
 
 #define _WPP_MAKE_WIDE_IMPL(X) L##X
 #define __WPP_MAKE_WIDE(X) _WPP_MAKE_WIDE_IMPL(X)
@@ -16,10 +35,22 @@
 
 namespace wpp::internal {
 
+constexpr GUID md5ToUUID3(const wpp::internal::md5::MD5Sum& sum) {
+    return {sum.a,
+            static_cast<unsigned short>(sum.b & 0xffff),
+            static_cast<unsigned short>(((sum.b >> 16) & 0x0fff) | 0x3000),
+            {static_cast<uint8_t>(sum.c), static_cast<uint8_t>(sum.c >> 8),
+             static_cast<uint8_t>(sum.c >> 16), static_cast<uint8_t>(sum.c >> 24),
+             static_cast<uint8_t>(sum.d), static_cast<uint8_t>(sum.d >> 8),
+             static_cast<uint8_t>(sum.d >> 16), static_cast<uint8_t>(sum.d >> 24)}};
+}
+
 ////////////////////////////////
 // Trace argument annotations //
 ////////////////////////////////
 
+#ifdef _MSC_VER
+
 /**
  * Annotates the function name, containing the trace hash and the trace item argument types.
  * This is used to write the argument types to the PDB file, and the hash is required in order
@@ -30,18 +61,167 @@ void annotateArgTypes() {
     __annotation(L"TMF_NG_TYPES:", __WPP_MAKE_WIDE(__FUNCSIG__));
 }
 
-template<uint32_t hashA, uint32_t hashB, uint32_t hashC, uint32_t hashD, typename Format,
-         typename TupleType>
+#endif
+
+/**
+ * The metadata record of a call site: the site information (matching the "TMF_NG:" annotation),
+ * followed by the trace item types (matching the "TMF_NG_TYPES:" annotation) in the same record.
+ * The record is written to the metadata section on ELF targets, and kept by the CallSiteRegistry.
+ */
+template<typename SiteInfo, typename... Items>
+struct TraceMetadataRecord {
+    static constexpr const auto& value() {
+        return payload;
+    }
+
+private:
+    static constexpr const auto payload =
+        ((SiteInfo::value() + makeMetadataString("TMF_NG_TYPES:")) + ... +
+         (TypeName<Items>::value + makeMetadataString("")));
+};
+
+#ifdef WPP_ENABLE_CALL_SITE_REGISTRY
+
+template<typename T>
+constexpr std::string_view makeStringView(const T& value) {
+    return std::string_view(value.data(), value.size());
+}
+
+/**
+ * Registers a call site in the CallSiteRegistry during static initialization. The registration is
+ * instantiated by the call site, and takes no time when the call site is reached.
+ */
+template<uint32_t hashA, uint32_t hashB, uint32_t hashC, uint32_t hashD, typename Record>
+struct CallSiteRegistration {
+    static inline CallSite site{md5ToUUID3({hashA, hashB, hashC, hashD}),
+                                makeStringView(Record::value()), nullptr};
+    static inline const bool isRegistered = (CallSiteRegistry::instance().add(site), true);
+};
+
+template<typename T, typename FieldItems = typename StructDescriptor<T>::FieldItems>
+struct CallSiteStructRegistration;
+
+template<typename T, typename... FieldItems>
+struct CallSiteStructRegistration<T, std::tuple<FieldItems...>> {
+    static constexpr const std::string_view fieldTypes[] = {
+        makeStringView(TypeName<FieldItems>::value)...};
+    static inline CallSiteStruct info{makeStringView(TypeName<T>::value),
+                                      sizeof(T),
+                                      StructDescriptor<T>::fields.data(),
+                                      fieldTypes,
+                                      sizeof...(FieldItems),
+                                      nullptr};
+    static inline const bool isRegistered = (CallSiteRegistry::instance().add(info), true);
+};
+
+#endif
+
+/**
+ * Annotates additional metadata required to parse the given trace item type, such as the layout of
+ * traced structs. Most trace items are fully described by their type, and require nothing more.
+ */
+template<typename Item>
+struct ItemDescriptorAnnotator {
+    static void annotate() {
+        // Intentionally left blank.
+    }
+
+#ifdef WPP_ENABLE_INLINE_METADATA
+    static void announce([[maybe_unused]] const TraceProvider& provider) noexcept {
+        // Intentionally left blank.
+    }
+#endif
+};
+
+template<typename T>
+struct ItemDescriptorAnnotator<StructItem<T>> {
+    template<typename... FieldItems>
+    static void annotateFields(std::tuple<FieldItems...>*) {
+        (ItemDescriptorAnnotator<FieldItems>::annotate(), ...);
+    }
+
+    static void annotate() {
+        StructDescriptor<T>::template annotate<StructLayoutType<T>>();
+        annotateFields(static_cast<typename StructDescriptor<T>::FieldItems*>(nullptr));
+#ifdef WPP_ENABLE_CALL_SITE_REGISTRY
+        (void)CallSiteStructRegistration<T>::isRegistered;
+#endif
+    }
+
+#ifdef WPP_ENABLE_INLINE_METADATA
+    template<typename... FieldItems>
+    static void announceFields(const TraceProvider& provider, std::tuple<FieldItems...>*) noexcept {
+        (ItemDescriptorAnnotator<FieldItems>::announce(provider), ...);
+    }
+
+    static void announce(const TraceProvider& provider) noexcept {
+        announceMetadata<StructMetadataRecord<T>>(provider);
+        announceFields(provider, static_cast<typename StructDescriptor<T>::FieldItems*>(nullptr));
+    }
+#endif
+};
+
+template<typename Item>
+struct ItemDescriptorAnnotator<OptionalItem<Item>> : ItemDescriptorAnnotator<Item> {};
+
+template<typename... Items>
+struct ItemDescriptorAnnotator<TupleItem<Items...>> {
+    static void annotate() {
+        (ItemDescriptorAnnotator<Items>::annotate(), ...);
+    }
+
+#ifdef WPP_ENABLE_INLINE_METADATA
+    static void announce([[maybe_unused]] const TraceProvider& provider) noexcept {
+        (ItemDescriptorAnnotator<Items>::announce(provider), ...);
+    }
+#endif
+};
+
+template<typename... Items>
+struct ItemDescriptorAnnotator<VariantItem<Items...>>
+    : ItemDescriptorAnnotator<TupleItem<Items...>> {};
+
+template<typename... Items>
+void annotateItemDescriptors() {
+    (ItemDescriptorAnnotator<Items>::annotate(), ...);
+}
+
+template<typename Format, typename ArgsTuple,
+         typename Indices = std::make_index_sequence<std::tuple_size_v<ArgsTuple>>>
+struct TraceItemTypesBuilder;
+
+template<typename Format, typename... Args, size_t... Ixs>
+struct TraceItemTypesBuilder<Format, std::tuple<Args...>, std::index_sequence<Ixs...>> {
+    using type = std::tuple<decltype(buildTraceItem<std::tuple_element_t<Ixs, Format>>(
+        std::declval<Args>()))...>;
+};
+
+/**
+ * The trace item types (as a std::tuple) built from the argument types in ArgsTuple (as created by
+ * std::forward_as_tuple) using the format specifiers in Format. The types are computed once per
+ * format specifiers and argument types, and are shared by all the call sites with the same shape.
+ */
+template<typename Format, typename ArgsTuple>
+using TraceItemTypes = typename TraceItemTypesBuilder<Format, ArgsTuple>::type;
+
+template<uint32_t hashA, uint32_t hashB, uint32_t hashC, uint32_t hashD, typename SiteInfo,
+         typename ItemsTuple>
 struct AnnotateArgsCaller;
 
-template<uint32_t hashA, uint32_t hashB, uint32_t hashC, uint32_t hashD, typename Format,
-         typename... Args>
-struct AnnotateArgsCaller<hashA, hashB, hashC, hashD, Format, std::tuple<Args...>> {
-    template<size_t... Ixs>
-    constexpr void operator()(std::index_sequence<Ixs...>) {
-        annotateArgTypes<hashA, hashB, hashC, hashD,
-                         decltype(buildTraceItem<std::tuple_element_t<Ixs, Format>>(
-                             std::declval<Args>()))...>();
+template<uint32_t hashA, uint32_t hashB, uint32_t hashC, uint32_t hashD, typename SiteInfo,
+         typename... Items>
+struct AnnotateArgsCaller<hashA, hashB, hashC, hashD, SiteInfo, std::tuple<Items...>> {
+    constexpr void operator()() {
+        using Record = TraceMetadataRecord<SiteInfo, Items...>;
+#ifdef _MSC_VER
+        annotateArgTypes<hashA, hashB, hashC, hashD, Items...>();
+#else
+        emitMetadata<Record>();
+#endif
+#ifdef WPP_ENABLE_CALL_SITE_REGISTRY
+        (void)CallSiteRegistration<hashA, hashB, hashC, hashD, Record>::isRegistered;
+#endif
+        annotateItemDescriptors<Items...>();
     }
 };
 
@@ -49,62 +229,251 @@ struct AnnotateArgsCaller<hashA, hashB, hashC, hashD, Format, std::tuple<Args...
 // Trace argument validation //
 ///////////////////////////////
 
-template<typename Format, typename TupleType>
-struct ArgChecker;
+enum class ArgCheckResult {
+    Success,
+    InvalidFormat,
+    ConflictingFormatTypes,
+    UnsupportedFormatOptions
+};
 
-enum class ArgCheckResult { Success, InvalidFormat };
+/**
+ * Checks whether the options of the format specification (such as the precision) are supported by
+ * a trace item with the given SupportedFormatOptions. Characters formatted as characters are
+ * rendered as text, like strings.
+ */
+constexpr bool areFormatOptionsSupported(uint8_t options, const FormatSpec& spec) {
+    const bool isNumeric = (options & FORMAT_OPTIONS_NUMERIC) && spec.type != "c";
+    return (isNumeric || !spec.hasNumericOptions()) &&
+           ((options & FORMAT_OPTIONS_PRECISION) || !spec.hasPrecision);
+}
 
 /**
  * Checks that the format is valid for all the argument types.
- * This is done by checking that all the generated trace items are not InvalidFormatItem.
+ * This is done by checking that all the generated trace items are not InvalidFormatItem, and that
+ * they support the options of every format specification referencing them.
  */
-template<typename... Args>
-constexpr ArgCheckResult makeArgCheckStatus() {
+template<typename... Args, size_t N>
+constexpr ArgCheckResult makeArgCheckStatus(
+    std::tuple<Args...>*, [[maybe_unused]] const std::array<FormatField, N>& fields) {
     if constexpr ((std::is_same_v<Args, ::wpp::internal::InvalidFormatItem> || ...)) {
         return ArgCheckResult::InvalidFormat;
     } else {
+        [[maybe_unused]] constexpr const std::array<uint8_t, sizeof...(Args)> options = {
+            SupportedFormatOptions<Args>::value...};
+        for (const auto& field : fields) {
+            if (!areFormatOptionsSupported(options[field.argIndex], field.spec)) {
+                return ArgCheckResult::UnsupportedFormatOptions;
+            }
+        }
         return ArgCheckResult::Success;
     }
 }
 
-template<typename Format, typename... Args>
-struct ArgChecker<Format, std::tuple<Args...>> {
-    template<size_t... Ixs>
-    constexpr auto operator()(std::index_sequence<Ixs...>) {
-        return makeArgCheckStatus<decltype(
-            buildTraceItem<std::tuple_element_t<Ixs, Format>>(std::declval<Args>()))...>();
+template<typename FormatInfo, typename ArgsTuple,
+         typename Indices = std::make_index_sequence<FormatInfo::fieldCount()>>
+struct FieldItemChecker;
+
+/**
+ * Checks that every replacement field selects the trace item of the argument it references (the
+ * item selected by the first reference). For example, `{0} {0:#x}` formats the same Int32Item of
+ * an int twice, while `{0} {0:x}` of a string selects both a StringItem and a HexBufferItem.
+ */
+template<typename FormatInfo, typename ArgsTuple, size_t... Ixs>
+struct FieldItemChecker<FormatInfo, ArgsTuple, std::index_sequence<Ixs...>> {
+    using ArgItems = TraceItemTypes<decltype(FormatInfo::value()), ArgsTuple>;
+
+    template<size_t Index>
+    static constexpr const size_t argIndex = FormatInfo::fields().fields[Index].argIndex;
+
+    template<size_t Index>
+    using ArgItem = std::tuple_element_t<argIndex<Index>, ArgItems>;
+
+    template<size_t Index>
+    using FieldFormat = std::tuple_element_t<Index, decltype(FormatInfo::fieldFormats())>;
+
+    template<size_t Index>
+    using FieldItem = decltype(buildTraceItem<FieldFormat<Index>>(
+        std::declval<std::tuple_element_t<argIndex<Index>, ArgsTuple>>()));
+
+    static constexpr const ArgCheckResult value =
+        (std::is_same_v<FieldItem<Ixs>, InvalidFormatItem> || ...) ? ArgCheckResult::InvalidFormat
+        : (std::is_same_v<FieldItem<Ixs>, ArgItem<Ixs>> && ...)
+            ? ArgCheckResult::Success
+            : ArgCheckResult::ConflictingFormatTypes;
+};
+
+template<typename FormatInfo, typename ArgsTuple>
+struct ArgChecker {
+    static constexpr ArgCheckResult check() {
+        constexpr const ArgCheckResult result = ::wpp::internal::makeArgCheckStatus(
+            static_cast<TraceItemTypes<decltype(FormatInfo::value()), ArgsTuple>*>(nullptr),
+            FormatInfo::fields().fields);
+        // Arguments referenced by a single field can't conflict, so the items of the fields are
+        // only built for formats which repeat arguments.
+        if constexpr (result == ArgCheckResult::Success &&
+                      FormatInfo::fieldCount() > FormatInfo::count()) {
+            return FieldItemChecker<FormatInfo, ArgsTuple>::value;
+        } else {
+            return result;
+        }
     }
+
+    static constexpr const ArgCheckResult value = check();
 };
 
 /////////////////////
 // Trace utilities //
 /////////////////////
 
-constexpr GUID md5ToUUID3(const wpp::internal::md5::MD5Sum& sum) {
-    return {sum.a,
-            static_cast<unsigned short>(sum.b & 0xffff),
-            static_cast<unsigned short>(((sum.b >> 16) & 0x0fff) | 0x3000),
-            {sum.c & 0xff, (sum.c >> 8) & 0xff, (sum.c >> 16) & 0xff, (sum.c >> 24) & 0xff,
-             sum.d & 0xff, (sum.d >> 8) & 0xff, (sum.d >> 16) & 0xff, (sum.d >> 24) & 0xff}};
+/**
+ * Checks whether the given trace item references modules in the ModuleRegistry, requiring module
+ * load records to be traced.
+ */
+template<typename Item>
+struct UsesModuleRegistry : std::is_same<Item, SymbolItem> {};
+
+template<typename Item>
+struct UsesModuleRegistry<OptionalItem<Item>> : UsesModuleRegistry<Item> {};
+
+template<typename... Items>
+struct UsesModuleRegistry<TupleItem<Items...>>
+    : std::disjunction<UsesModuleRegistry<Items>...> {};
+
+template<typename... Items>
+struct UsesModuleRegistry<VariantItem<Items...>>
+    : std::disjunction<UsesModuleRegistry<Items>...> {};
+
+/**
+ * Traces the load records of modules that were registered since the last load records were traced
+ * by the provider, using the reserved MODULE_LOAD_GUID.
+ */
+inline void traceModuleLoads(TraceProvider& provider) {
+    const auto& registry = ModuleRegistry::instance();
+    const auto [first, last] = provider.claimUnreportedModules(registry.size());
+    for (size_t i = first; i < last; ++i) {
+        provider.traceMessageFromTraceItems(
+            MODULE_LOAD_GUID, buildTraceItem<FormatString<>>(static_cast<uint16_t>(i)),
+            buildTraceItem<FormatString<>>(registry[i].id));
+    }
 }
 
-template<typename Format, size_t... indices, typename... Args>
-constexpr __forceinline void wppDoTraceInternal(std::index_sequence<indices...>,
-                                                TraceProvider& provider, const GUID& traceGuid,
-                                                Args&&... args) {
+#ifdef WPP_ENABLE_INLINE_METADATA
+
+/**
+ * Traces the metadata records of a call site and of the structs it traces, the first time the call
+ * site is traced in the current trace session. Kept out of line, as it's called once per session.
+ */
+template<typename Record, typename... Items>
+__WPP_NOINLINE void announceCallSite(const TraceProvider& provider) noexcept {
+    (ItemDescriptorAnnotator<Items>::announce(provider), ...);
+    announceMetadata<Record>(provider);
+}
+
+template<typename SiteInfo, typename... Items>
+__WPP_FORCEINLINE void announceCallSiteOnce(const TraceProvider& provider) noexcept {
+    using Record = TraceMetadataRecord<SiteInfo, Items...>;
+    if (!isMetadataAnnounced<Record>(provider)) {
+        announceCallSite<Record, Items...>(provider);
+    }
+}
+
+#endif
+
+#ifdef WPP_ENABLE_INLINE_METADATA
+/**
+ * The site information is announced when the call site is traced, so every call site has its own
+ * trace functions.
+ */
+template<typename SiteInfo>
+using TraceSiteKey = SiteInfo;
+#else
+/**
+ * The site information isn't used when tracing, so the trace functions of all the call sites with
+ * the same format specifiers and argument types are shared.
+ */
+template<typename SiteInfo>
+using TraceSiteKey = void;
+#endif
+
+template<typename Format, typename SiteInfo, size_t... indices, typename... Args>
+constexpr __WPP_FORCEINLINE void wppDoTraceInternal(std::index_sequence<indices...>,
+                                                    TraceProvider& provider, const GUID& traceGuid,
+                                                    Args&&... args) {
+    using Items = TraceItemTypes<Format, std::tuple<Args&&...>>;
+#ifdef WPP_ENABLE_INLINE_METADATA
+    announceCallSiteOnce<SiteInfo, std::tuple_element_t<indices, Items>...>(provider);
+#endif
+
     provider.traceMessageFromTraceItems(
         traceGuid,
         buildTraceItem<std::tuple_element_t<indices, Format>>(std::forward<Args>(args))...);
+
+    // Modules are registered while building the trace items, so the load records of new modules
+    // are traced right after the first trace referencing them.
+    if constexpr ((UsesModuleRegistry<std::tuple_element_t<indices, Items>>::value || ...)) {
+        traceModuleLoads(provider);
+    }
+}
+
+/**
+ * The type of an argument passed to wppDoTraceOutlined. Scalars are passed by value, so they can
+ * stay in registers at the call site, while other arguments are passed by reference.
+ */
+template<typename T>
+using OutlinedArg = std::conditional_t<std::is_scalar_v<std::remove_reference_t<T>>,
+                                       std::remove_cv_t<std::remove_reference_t<T>>, T&&>;
+
+/**
+ * Builds the trace items and traces them, out of line. The function is instantiated per format
+ * specifiers and argument types (and per call site with inline metadata), and is marked as cold -
+ * so the code of the enabled path doesn't bloat the calling function, and is kept away from its hot
+ * code.
+ */
+template<typename Format, typename SiteInfo, typename... Args>
+__WPP_NOINLINE __WPP_COLD void wppDoTraceOutlined(TraceProvider& provider, const GUID& traceGuid,
+                                                  OutlinedArg<Args>... args) {
+    wppDoTraceInternal<Format, SiteInfo>(std::make_index_sequence<sizeof...(Args)>{}, provider,
+                                         traceGuid, std::forward<OutlinedArg<Args>>(args)...);
+}
+
+template<typename T>
+struct IsCurrentStack : std::is_same<RecursiveDecay<T>, CurrentStack> {};
+
+/**
+ * The type of an argument passed to wppDoTraceOutlined by a trace of the call stack, in which
+ * `currentStack` is replaced by the stack captured at the call site.
+ */
+template<typename T>
+using CapturedArg = std::conditional_t<IsCurrentStack<T>::value, const CapturedStack&, T&&>;
+
+template<typename T>
+__WPP_FORCEINLINE CapturedArg<T> captureArg(T&& arg, const CapturedStack& stack) noexcept {
+    if constexpr (IsCurrentStack<T>::value) {
+        return stack;
+    } else {
+        return std::forward<T>(arg);
+    }
 }
 
 /**
- * Traces only if traces are currently enabled.
+ * Traces only if traces are currently enabled. Only the enable check is inlined into the caller.
+ *
+ * Traces of the call stack capture it here, so its first frame is the caller rather than the
+ * outlined function. The captured stack is passed by reference, which also keeps the caller from
+ * tail-calling the outlined function and dropping its own frame.
  */
-template<typename Format, UCHAR flag, TraceLevel level, typename... Args>
-constexpr void wppDoTrace(TraceProvider& provider, const GUID& traceGuid, Args&&... args) {
-    if (provider.areTracesEnabled(flag, level)) {
-        wppDoTraceInternal<Format>(std::make_index_sequence<sizeof...(Args)>{}, provider, traceGuid,
-                                   std::forward<Args>(args)...);
+template<typename Format, typename SiteInfo, typename... Args>
+__WPP_FORCEINLINE void wppDoTrace(TraceProvider& provider, TraceKeywords keywords,
+                                  TraceLevel level, const GUID& traceGuid, Args&&... args) {
+    if (provider.areTracesEnabled(keywords, level)) {
+        if constexpr ((IsCurrentStack<Args>::value || ...)) {
+            const CapturedStack stack;
+            wppDoTraceOutlined<Format, SiteInfo, CapturedArg<Args>...>(
+                provider, traceGuid, captureArg(std::forward<Args>(args), stack)...);
+        } else {
+            wppDoTraceOutlined<Format, SiteInfo, Args...>(provider, traceGuid,
+                                                          std::forward<Args>(args)...);
+        }
     }
 }
 
@@ -123,12 +492,12 @@ constexpr void wppDoTrace(TraceProvider& provider, const GUID& traceGuid, Args&&
     static_assert(std::is_same_v<decltype(level), ::wpp::TraceLevel>,                        \
                   "WPP: The trace level must be a TraceLevel!");                             \
     static_assert(                                                                           \
-        std::is_convertible_v<::wpp::internal::UnderlyingType<decltype(flag)>::type, UCHAR>, \
-        "WPP: The flag must be a UCHAR or convertible to a UCHAR!");                         \
-    static_assert(static_cast<UCHAR>(flag) > 0 &&                                            \
-                      (static_cast<UCHAR>(flag) & (static_cast<UCHAR>(flag) - 1)) == 0,      \
-                  "The flag must be a power of two!");                                       \
-    static_assert(std::is_same_v<std::decay_t<decltype(provider)>, ::wpp::TraceProvider>,    \
+        std::is_convertible_v<::wpp::internal::UnderlyingType<decltype(flag)>::type,         \
+                              ::wpp::TraceKeywords>,                                         \
+        "WPP: The keywords must be an integer, an enum or wpp::TraceKeywords!");             \
+    static_assert(::wpp::internal::makeTraceKeywords(flag).mask != 0,                        \
+                  "WPP: The keywords must not be empty!");                                   \
+    static_assert(std::is_base_of_v<::wpp::TraceProvider, std::decay_t<decltype(provider)>>, \
                   "WPP: The provider must be a valid TraceProvider!");
 
 /**
@@ -141,8 +510,16 @@ constexpr void wppDoTrace(TraceProvider& provider, const GUID& traceGuid, Args&&
                       "WPP: Too many closing brackets!");                                          \
         static_assert(___wpp_status != ::wpp::internal::ArgumentParseStatus::ExcessOpens,          \
                       "WPP: Too many opening brackets!");                                          \
-        static_assert(___wpp_status != ::wpp::internal::ArgumentParseStatus::MissingColonInFormat, \
-                      "WPP: Format specificatiton is missing ':' in brackets!");                   \
+        static_assert(___wpp_status != ::wpp::internal::ArgumentParseStatus::InvalidFieldName,     \
+                      "WPP: Invalid field name, expected an argument index or an identifier!");    \
+        static_assert(___wpp_status != ::wpp::internal::ArgumentParseStatus::InvalidFormatSpec,    \
+                      "WPP: Invalid format specification, expected "                               \
+                      "[[fill]align][sign][#][0][width][grouping][.precision]type!");              \
+        static_assert(                                                                             \
+            ___wpp_status != ::wpp::internal::ArgumentParseStatus::MixedArgumentReferences,        \
+            "WPP: Positional fields can't be mixed with automatic or named fields!");              \
+        static_assert(___wpp_status != ::wpp::internal::ArgumentParseStatus::UnreferencedArgument, \
+                      "WPP: The format string doesn't reference all the argument indices!");       \
     } else {                                                                                       \
         constexpr const auto formatCount = std::tuple_size_v<decltype(FormatInfo::value())>;       \
         static_assert(                                                                             \
@@ -152,11 +529,15 @@ constexpr void wppDoTrace(TraceProvider& provider, const GUID& traceGuid, Args&&
             formatCount >= actualCount,                                                            \
             "WPP: The format string specifies less than the passed number of arguments!");         \
         constexpr const auto argCheckResult =                                                      \
-            ::wpp::internal::ArgChecker<decltype(FormatInfo::value()),                             \
-                                        decltype(std::forward_as_tuple(__VA_ARGS__))>{}(           \
-                std::make_index_sequence<FormatInfo::count()>());                                  \
+            ::wpp::internal::ArgChecker<FormatInfo,                                                \
+                                        decltype(std::forward_as_tuple(__VA_ARGS__))>::value;      \
         static_assert(argCheckResult != ::wpp::internal::ArgCheckResult::InvalidFormat,            \
                       "WPP: Argument does not support the given extended format specification!");  \
+        static_assert(                                                                             \
+            argCheckResult != ::wpp::internal::ArgCheckResult::ConflictingFormatTypes,             \
+            "WPP: All the references to an argument must select the same trace item!");            \
+        static_assert(argCheckResult != ::wpp::internal::ArgCheckResult::UnsupportedFormatOptions, \
+                      "WPP: Argument does not support the options of the format specification!");  \
         static_assert(argCheckResult == ::wpp::internal::ArgCheckResult::Success,                  \
                       "WPP: Unexpected argument check result!");                                   \
     }
@@ -164,38 +545,94 @@ constexpr void wppDoTrace(TraceProvider& provider, const GUID& traceGuid, Args&&
 /**
  * Calculates the trace hash, used to generate the trace message GUID.
  */
-#define __WPP_CALCULATE_TRACE_HASH(baseDirectoryIndex, flag, level, fmt, ...)          \
-    ::wpp::internal::md5::md5Sum(                                                      \
-        ::wpp::internal::makeString("TMF_NG:") +                                       \
-        ::wpp::internal::makeString<sizeof(__FILE__) - baseDirectoryIndex - 1>(        \
-            __FILE__ + baseDirectoryIndex) +                                           \
-        ::wpp::internal::makeString(                                                   \
-            __WPP_MAKE_STRING(__LINE__) "FUNC=" __FUNCSIG__ "FLAG=" __WPP_MAKE_STRING( \
-                flag) "LEVEL=" __WPP_MAKE_STRING(level) fmt __WPP_MAKE_STRING(__VA_ARGS__)))
+#define __WPP_CALCULATE_TRACE_HASH(baseDirectoryIndex, flag, level, fmt, ...)                     \
+    ::wpp::internal::md5::md5Sum(                                                                 \
+        ::wpp::internal::makeString("TMF_NG:") +                                                  \
+        ::wpp::internal::makeString<sizeof(__FILE__) - baseDirectoryIndex - 1>(                   \
+            __FILE__ + baseDirectoryIndex) +                                                      \
+        ::wpp::internal::makeString(__WPP_MAKE_STRING(__LINE__) "FUNC=") +                        \
+        ::wpp::internal::makeString(__WPP_FUNCTION_SIGNATURE) +                                   \
+        ::wpp::internal::makeString("FLAG=" __WPP_MAKE_STRING(flag) "LEVEL=" __WPP_MAKE_STRING( \
+            level) fmt __WPP_MAKE_STRING(__VA_ARGS__)))
+
+/**
+ * Defines the metadata record of the trace information, named ___WppSiteInfo. The record contains
+ * the same strings as the MSVC annotation, except for the path of the file, which is relative to
+ * the base directory (as in the trace hash).
+ */
+#define __WPP_DEFINE_SITE_INFO(baseDirectoryIndex, flag, level, fmt, ...)                  \
+    __WPP_DEFINE_METADATA_RECORD(                                                          \
+        ___WppSiteInfo,                                                                    \
+        ::wpp::internal::makeMetadataString("TMF_NG:") +                                   \
+            ::wpp::internal::makeString<sizeof(__FILE__) - baseDirectoryIndex>(            \
+                __FILE__ + baseDirectoryIndex) +                                           \
+            ::wpp::internal::makeString(__WPP_MAKE_STRING(__LINE__) "\0FUNC=") +           \
+            ::wpp::internal::makeMetadataString(__WPP_FUNCTION_SIGNATURE) +                \
+            ::wpp::internal::makeMetadataString("FLAG=" __WPP_MAKE_STRING(flag) "\0LEVEL=" \
+                                                __WPP_MAKE_STRING(level) "\0" fmt "\0"     \
+                                                __WPP_MAKE_STRING(__VA_ARGS__)))
+
+#ifdef _MSC_VER
+
+#if defined(WPP_ENABLE_CALL_SITE_REGISTRY) || defined(WPP_ENABLE_INLINE_METADATA)
+#define __WPP_DEFINE_REGISTERED_SITE_INFO __WPP_DEFINE_SITE_INFO
+#else
+// The site information is only annotated into the PDB file.
+#define __WPP_DEFINE_REGISTERED_SITE_INFO(...) using ___WppSiteInfo = void
+#endif
 
 /**
  * Annotates the trace information into the PDB file.
  */
-#define __WPP_ANNOTATE_TRACE_INFO(hash, flag, level, fmt, FormatInfo, ...)                 \
-    __annotation(L"TMF_NG:", __WPP_MAKE_WIDE(__FILE__), __WPP_MAKE_WSTRING(__LINE__),      \
-                 L"FUNC=" __WPP_MAKE_WIDE(__FUNCSIG__), L"FLAG=" __WPP_MAKE_WSTRING(flag), \
-                 L"LEVEL=" __WPP_MAKE_WSTRING(level), __WPP_MAKE_WIDE(fmt),                \
-                 __WPP_MAKE_WSTRING(__VA_ARGS__));                                         \
-    ::wpp::internal::AnnotateArgsCaller<hash.a, hash.b, hash.c, hash.d,                    \
-                                        decltype(FormatInfo::value()),                     \
-                                        decltype(std::forward_as_tuple(__VA_ARGS__))>{}(   \
-        std::make_index_sequence<FormatInfo::count()>())
+#define __WPP_ANNOTATE_TRACE_INFO(hash, baseDirectoryIndex, flag, level, fmt, FormatInfo, ...) \
+    __annotation(L"TMF_NG:", __WPP_MAKE_WIDE(__FILE__), __WPP_MAKE_WSTRING(__LINE__),          \
+                 L"FUNC=" __WPP_MAKE_WIDE(__FUNCSIG__), L"FLAG=" __WPP_MAKE_WSTRING(flag),     \
+                 L"LEVEL=" __WPP_MAKE_WSTRING(level), __WPP_MAKE_WIDE(fmt),                    \
+                 __WPP_MAKE_WSTRING(__VA_ARGS__));                                             \
+    __WPP_DEFINE_REGISTERED_SITE_INFO(baseDirectoryIndex, flag, level, fmt, __VA_ARGS__);      \
+    ::wpp::internal::AnnotateArgsCaller<                                                       \
+        hash.a, hash.b, hash.c, hash.d, ___WppSiteInfo,                                        \
+        ::wpp::internal::TraceItemTypes<decltype(FormatInfo::value()),                         \
+                                        decltype(std::forward_as_tuple(__VA_ARGS__))>>{}()
 
 /**
- * This is the main tracing macro.
- *
- * provider - a TraceProvider
- * flag - a UCHAR with only a single bit set (a power of 2)
- * level - a wpp::TraceLevel value
- * fmt - a string literal containing the trace format
- * ... - the arguments to trace. The arguments must match the format string.
+ * Annotates the layout of a struct registered with WPP_DEFINE_STRUCT_ITEM into the PDB file.
+ * This is expanded inside `StructDescriptor<T>::annotate<Layout>()`, so the function signature
+ * contains both the struct type and its layout, while the field names are annotated directly.
+ */
+#define __WPP_ANNOTATE_STRUCT_DESCRIPTOR(...) \
+    __annotation(L"TMF_NG_STRUCT:", __WPP_MAKE_WIDE(__FUNCSIG__), __WPP_MAKE_WSTRING(__VA_ARGS__))
+
+#else
+
+/**
+ * Writes the trace information into a metadata record (see Metadata.h).
+ */
+#define __WPP_ANNOTATE_TRACE_INFO(hash, baseDirectoryIndex, flag, level, fmt, FormatInfo, ...) \
+    __WPP_DEFINE_SITE_INFO(baseDirectoryIndex, flag, level, fmt, __VA_ARGS__);                 \
+    ::wpp::internal::AnnotateArgsCaller<                                                       \
+        hash.a, hash.b, hash.c, hash.d, ___WppSiteInfo,                                        \
+        ::wpp::internal::TraceItemTypes<decltype(FormatInfo::value()),                         \
+                                        decltype(std::forward_as_tuple(__VA_ARGS__))>>{}()
+
+/**
+ * Writes the layout of a struct registered with WPP_DEFINE_STRUCT_ITEM into a metadata record, with
+ * the same strings as the MSVC annotation.
+ */
+#define __WPP_ANNOTATE_STRUCT_DESCRIPTOR(...)                                             \
+    __WPP_DEFINE_METADATA_RECORD(                                                         \
+        ___WppStructInfo,                                                                 \
+        ::wpp::internal::makeMetadataString("TMF_NG_STRUCT:") +                           \
+            ::wpp::internal::makeMetadataString(__WPP_FUNCTION_SIGNATURE) +               \
+            ::wpp::internal::makeMetadataString(__WPP_MAKE_STRING(__VA_ARGS__)));         \
+    ::wpp::internal::emitMetadata<___WppStructInfo>()
+
+#endif
+
+/**
+ * Implements the trace macros, using the given trace function (such as wppDoTrace).
  */
-#define WPP_DO_TRACE(provider, flag, level, fmt, ...)                                             \
+#define __WPP_DO_TRACE_IMPL(traceFunction, provider, flag, level, fmt, ...)                       \
     do {                                                                                          \
         __WPP_VALIDATE_BASIC_PARAMETERS(provider, flag, level, fmt, __VA_ARGS__);                 \
         constexpr const auto ___wpp_baseDirectoryIndex =                                          \
@@ -208,7 +645,23 @@ constexpr void wppDoTrace(TraceProvider& provider, const GUID& traceGuid, Args&&
         __WPP_STRING_MAKER(FormatType, fmt);                                                      \
         using FormatInfo = decltype(::wpp::internal::getFormatInfo<FormatType>());                \
         __WPP_VALIDATE_FORMAT_AND_ARGS(FormatInfo, ___wpp_paramter_count, __VA_ARGS__);           \
-        __WPP_ANNOTATE_TRACE_INFO(___wpp_hash, flag, level, fmt, FormatInfo, __VA_ARGS__);        \
-        ::wpp::internal::wppDoTrace<decltype(FormatInfo::value()), static_cast<UCHAR>(flag),      \
-                                    level>(provider, ___wpp_guid, __VA_ARGS__);                   \
+        __WPP_ANNOTATE_TRACE_INFO(___wpp_hash, ___wpp_baseDirectoryIndex, flag, level, fmt,       \
+                                  FormatInfo, __VA_ARGS__);                                       \
+        ::wpp::internal::traceFunction<decltype(FormatInfo::value()),                             \
+                                       ::wpp::internal::TraceSiteKey<___WppSiteInfo>>(            \
+            provider, ::wpp::internal::makeTraceKeywords(flag), level,                            \
+            ___wpp_guid __WPP_COMMA_VA_ARGS(__VA_ARGS__));                                        \
     } while (0)
+
+/**
+ * This is the main tracing macro.
+ *
+ * provider - a TraceProvider
+ * flag - the keywords of the trace: a non-zero 64-bit mask (an integer or an enum), which is
+ *        enabled if any of its keywords is enabled, or `wpp::allOf(mask)` to require all of them
+ * level - a wpp::TraceLevel value
+ * fmt - a string literal containing the trace format
+ * ... - the arguments to trace. The arguments must match the format string.
+ */
+#define WPP_DO_TRACE(provider, flag, level, fmt, ...) \
+    __WPP_DO_TRACE_IMPL(wppDoTrace, provider, flag, level, fmt, __VA_ARGS__)
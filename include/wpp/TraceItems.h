@@ -1,7 +1,8 @@
 #pragma once
 #include <cstdint>
+#include <limits>
 #include <tuple>
-#include <guiddef.h>
+#include "Platform.h"
 #include "TypeTraits.h"
 #include "String.h"
 
@@ -12,8 +13,14 @@ namespace wpp {
  *
  * For example, FormatString<'a', 'b', 'c'>::value() == "abc"
  */
+#ifdef __WPP_HAS_STRING_TEMPLATE_PARAMETERS
+template<char... chars>
+using FormatString =
+    internal::FixedStructuralString<internal::makeStructuralString<chars...>()>;
+#else
 template<char... chars>
 using FormatString = internal::FixedConstexprString<chars...>;
+#endif
 
 /**
  * This template is used in order to provide a customization interface for trace formats.
@@ -146,8 +153,73 @@ constexpr bool isValidFloatFormat(std::string_view format) {
     }
 }
 
+/**
+ * The replacement character, used for characters that cannot be encoded.
+ */
+constexpr const char16_t UTF16_REPLACEMENT_CHARACTER = 0xfffd;
+
+/**
+ * Converts a single character to a UTF-16 code unit. Characters outside of the basic multilingual
+ * plane can't be represented by a single code unit, and are replaced by U+FFFD.
+ */
+template<typename CharType>
+constexpr char16_t toUtf16CodeUnit(CharType c) {
+    const auto codePoint = static_cast<uint32_t>(c);
+    return codePoint > 0xffff ? UTF16_REPLACEMENT_CHARACTER : static_cast<char16_t>(codePoint);
+}
+
+/**
+ * Transcodes a UTF-32 string to a UTF-16 string in the given buffer. The result is always
+ * null-terminated, and is truncated (on a code point boundary) if the buffer is too small.
+ * Invalid code points are replaced by U+FFFD.
+ *
+ * Returns the number of code units written, not including the null-terminator.
+ */
+template<typename CharType>
+constexpr size_t transcodeToUtf16(const CharType* str, size_t length, char16_t* buffer,
+                                  size_t capacity) {
+    size_t written = 0;
+    for (size_t i = 0; i < length; ++i) {
+        auto codePoint = static_cast<uint32_t>(str[i]);
+        if (codePoint > 0x10ffff || (codePoint >= 0xd800 && codePoint <= 0xdfff)) {
+            codePoint = UTF16_REPLACEMENT_CHARACTER;
+        }
+
+        if (codePoint > 0xffff) {
+            if (written + 2 >= capacity) {
+                break;
+            }
+            codePoint -= 0x10000;
+            buffer[written++] = static_cast<char16_t>(0xd800 + (codePoint >> 10));
+            buffer[written++] = static_cast<char16_t>(0xdc00 + (codePoint & 0x3ff));
+        } else {
+            if (written + 1 >= capacity) {
+                break;
+            }
+            buffer[written++] = static_cast<char16_t>(codePoint);
+        }
+    }
+
+    buffer[written] = 0;
+    return written;
+}
+
 }  // namespace internal
 
+/**
+ * All trace items use a platform-independent wire encoding, so traces from all platforms can be
+ * parsed using the same trace information:
+ * - Fixed-size integers and IEEE-754 binary32/binary64 floating point numbers.
+ * - Pointer-sized values (size_t, ptrdiff_t and pointers) are always traced as 64-bit values.
+ * - `long double` values are traced as binary64 (which is their representation in MSVC).
+ * - Wide characters and strings are traced as UTF-16.
+ */
+static_assert(std::numeric_limits<float>::is_iec559 && sizeof(float) == 4,
+              "WPP: float must be an IEEE-754 binary32!");
+static_assert(std::numeric_limits<double>::is_iec559 && sizeof(double) == 8,
+              "WPP: double must be an IEEE-754 binary64!");
+static_assert(sizeof(GUID) == 16, "WPP: Unexpected GUID size!");
+
 #define WPP_SPECIALIZE_LOGGER(RealType, Tag, formatValidationFuncion)                   \
     template<typename Format>                                                           \
     struct TraceItemMaker<RealType, Format,                                             \
@@ -157,41 +229,119 @@ constexpr bool isValidFloatFormat(std::string_view format) {
         }                                                                               \
     }
 
+/**
+ * Specializes a logger for a type whose wire representation is different than its native
+ * representation. The value is converted using `convertFunction` when the trace item is built.
+ */
+#define WPP_SPECIALIZE_CONVERTING_LOGGER(RealType, Tag, convertFunction, formatValidationFuncion) \
+    template<typename Format>                                                                     \
+    struct TraceItemMaker<RealType, Format,                                                       \
+                          std::enable_if_t<formatValidationFuncion(Format::value())>> {           \
+        static constexpr auto make(RealType value) {                                              \
+            return Tag{convertFunction(value)};                                                   \
+        }                                                                                         \
+    }
+
 #define WPP_SPECIALIZE_INTEGRAL_LOGGER(RealType, Tag) \
     WPP_SPECIALIZE_LOGGER(RealType, Tag, internal::isValidIntegerFormat)
 
 struct Int8Item : TrivialTraceItem<int8_t> {};
-WPP_SPECIALIZE_INTEGRAL_LOGGER(int8_t, Int8Item);
-
 struct Int16Item : TrivialTraceItem<int16_t> {};
-WPP_SPECIALIZE_INTEGRAL_LOGGER(int16_t, Int16Item);
-
 struct Int32Item : TrivialTraceItem<int32_t> {};
-WPP_SPECIALIZE_INTEGRAL_LOGGER(int32_t, Int32Item);
-
 struct Int64Item : TrivialTraceItem<int64_t> {};
-WPP_SPECIALIZE_INTEGRAL_LOGGER(int64_t, Int64Item);
-
 struct UInt8Item : TrivialTraceItem<uint8_t> {};
-WPP_SPECIALIZE_INTEGRAL_LOGGER(uint8_t, UInt8Item);
-
 struct UInt16Item : TrivialTraceItem<uint16_t> {};
-WPP_SPECIALIZE_INTEGRAL_LOGGER(uint16_t, UInt16Item);
-
 struct UInt32Item : TrivialTraceItem<uint32_t> {};
-WPP_SPECIALIZE_INTEGRAL_LOGGER(uint32_t, UInt32Item);
-
 struct UInt64Item : TrivialTraceItem<uint64_t> {};
-WPP_SPECIALIZE_INTEGRAL_LOGGER(uint64_t, UInt64Item);
+
+namespace internal {
+
+/**
+ * The trace item of an integer type of the given size and signedness. The fixed-width integer
+ * types are aliases of different standard types on different platforms (`int64_t` is `long` on
+ * LP64 Linux, while `long long` is a distinct type of the same size), so every standard integer
+ * type is traced by its size and signedness.
+ */
+template<size_t size, bool isSigned>
+struct IntegerItemOf {};
+
+template<>
+struct IntegerItemOf<1, true> {
+    using Type = Int8Item;
+};
+
+template<>
+struct IntegerItemOf<2, true> {
+    using Type = Int16Item;
+};
+
+template<>
+struct IntegerItemOf<4, true> {
+    using Type = Int32Item;
+};
+
+template<>
+struct IntegerItemOf<8, true> {
+    using Type = Int64Item;
+};
+
+template<>
+struct IntegerItemOf<1, false> {
+    using Type = UInt8Item;
+};
+
+template<>
+struct IntegerItemOf<2, false> {
+    using Type = UInt16Item;
+};
+
+template<>
+struct IntegerItemOf<4, false> {
+    using Type = UInt32Item;
+};
+
+template<>
+struct IntegerItemOf<8, false> {
+    using Type = UInt64Item;
+};
+
+/**
+ * Checks whether the given type is an integer type traced as a number: any integral type except
+ * for bool and the character types (which are traced as characters).
+ */
+template<typename T>
+struct IsNumericInteger
+    : std::bool_constant<std::is_integral_v<T> && !std::is_same_v<T, bool> &&
+                         !std::is_same_v<T, char> && !std::is_same_v<T, wchar_t> &&
+#ifdef __cpp_char8_t
+                         !std::is_same_v<T, char8_t> &&
+#endif
+                         !std::is_same_v<T, char16_t> && !std::is_same_v<T, char32_t>> {
+};
+
+}  // namespace internal
+
+template<typename T, typename Format>
+struct TraceItemMaker<T, Format,
+                      std::enable_if_t<internal::IsNumericInteger<T>::value &&
+                                       internal::isValidIntegerFormat(Format::value())>> {
+    using ItemType = typename internal::IntegerItemOf<sizeof(T), std::is_signed_v<T>>::Type;
+
+    static constexpr auto make(T value) {
+        return ItemType{static_cast<decltype(ItemType::value)>(value)};
+    }
+};
 
 struct ByteItem : TrivialTraceItem<std::byte> {};
 WPP_SPECIALIZE_INTEGRAL_LOGGER(std::byte, ByteItem);
 
-struct PtrDiffItem : TrivialTraceItem<ptrdiff_t> {};
-WPP_SPECIALIZE_LOGGER(ptrdiff_t, PtrDiffItem, internal::isValidPointerSizedIntegerFormat);
+struct PtrDiffItem : TrivialTraceItem<int64_t> {};
+WPP_SPECIALIZE_CONVERTING_LOGGER(ptrdiff_t, PtrDiffItem, static_cast<int64_t>,
+                                 internal::isValidPointerSizedIntegerFormat);
 
-struct SizeTItem : TrivialTraceItem<size_t> {};
-WPP_SPECIALIZE_LOGGER(size_t, SizeTItem, internal::isValidPointerSizedIntegerFormat);
+struct SizeTItem : TrivialTraceItem<uint64_t> {};
+WPP_SPECIALIZE_CONVERTING_LOGGER(size_t, SizeTItem, static_cast<uint64_t>,
+                                 internal::isValidPointerSizedIntegerFormat);
 
 struct FloatItem : TrivialTraceItem<float> {};
 WPP_SPECIALIZE_LOGGER(float, FloatItem, internal::isValidFloatFormat);
@@ -199,8 +349,9 @@ WPP_SPECIALIZE_LOGGER(float, FloatItem, internal::isValidFloatFormat);
 struct DoubleItem : TrivialTraceItem<double> {};
 WPP_SPECIALIZE_LOGGER(double, DoubleItem, internal::isValidFloatFormat);
 
-struct LongDoubleItem : TrivialTraceItem<long double> {};
-WPP_SPECIALIZE_LOGGER(long double, LongDoubleItem, internal::isValidFloatFormat);
+struct LongDoubleItem : TrivialTraceItem<double> {};
+WPP_SPECIALIZE_CONVERTING_LOGGER(long double, LongDoubleItem, static_cast<double>,
+                                 internal::isValidFloatFormat);
 
 struct GuidItem : ReferenceTraceItem<GUID> {};
 
@@ -214,16 +365,17 @@ struct TraceItemMaker<GUID> {
 struct CharItem : TrivialTraceItem<char> {};
 WPP_SPECIALIZE_LOGGER(char, CharItem, internal::isValidCharacterFormat);
 
-struct WCharItem : TrivialTraceItem<wchar_t> {};
-WPP_SPECIALIZE_LOGGER(wchar_t, WCharItem, internal::isValidCharacterFormat);
+struct WCharItem : TrivialTraceItem<char16_t> {};
+WPP_SPECIALIZE_CONVERTING_LOGGER(wchar_t, WCharItem, internal::toUtf16CodeUnit,
+                                 internal::isValidCharacterFormat);
 
-struct PointerItem : TrivialTraceItem<const void*> {};
+struct PointerItem : TrivialTraceItem<uint64_t> {};
 
 template<typename T, typename Format>
 struct TraceItemMaker<T*, Format,
                       std::enable_if_t<internal::isValidPointerFormat(Format::value())>> {
-    static constexpr auto make(const T* ptr) {
-        return PointerItem{static_cast<const void*>(ptr)};
+    static auto make(const T* ptr) {
+        return PointerItem{reinterpret_cast<uintptr_t>(ptr)};
     }
 };
 
@@ -261,8 +413,93 @@ struct StringItem : internal::NullTerminatedStringItemType<char> {
     using NullTerminatedStringItemType::NullTerminatedStringItemType;
 };
 
-struct WStringItem : internal::NullTerminatedStringItemType<wchar_t> {
-    using NullTerminatedStringItemType::NullTerminatedStringItemType;
+#ifndef WPP_MAX_TRANSCODED_WSTRING_LENGTH
+/**
+ * The maximal number of UTF-16 code units traced for a single wide string, on platforms where
+ * wide strings have to be transcoded to UTF-16 (longer strings are truncated).
+ */
+#define WPP_MAX_TRANSCODED_WSTRING_LENGTH 256
+#endif
+
+namespace internal {
+
+/**
+ * A UTF-16 copy of a UTF-32 wide string, used on platforms where wchar_t is not UTF-16.
+ */
+struct TranscodedWideStringItemType {
+    explicit TranscodedWideStringItemType(const wchar_t* const ptr, size_t byteSize)
+        : size((transcodeToUtf16(ptr, byteSize / sizeof(wchar_t) - 1, buffer,
+                                 WPP_MAX_TRANSCODED_WSTRING_LENGTH + 1) +
+                1) *
+               sizeof(char16_t)) {
+    }
+
+    const void* getPtr() const noexcept {
+        return buffer;
+    }
+
+    size_t getSize() const noexcept {
+        return size;
+    }
+
+    char16_t buffer[WPP_MAX_TRANSCODED_WSTRING_LENGTH + 1];
+    const size_t size;
+};
+
+/**
+ * Wide strings are traced as-is where wchar_t is UTF-16, and transcoded to UTF-16 otherwise.
+ */
+using WideStringItemType =
+    std::conditional_t<sizeof(wchar_t) == sizeof(char16_t), NullTerminatedStringItemType<wchar_t>,
+                       TranscodedWideStringItemType>;
+
+}  // namespace internal
+
+struct WStringItem : internal::WideStringItemType {
+    using internal::WideStringItemType::WideStringItemType;
+};
+
+namespace internal {
+
+/**
+ * A UTF-16 copy of a UTF-32 wide string, traced as a size followed by the data (without a
+ * null-terminator). Used on platforms where wchar_t is not UTF-16.
+ */
+struct TranscodedWideBufferItemType {
+    explicit TranscodedWideBufferItemType(const wchar_t* const ptr, uint16_t byteSize)
+        : size(static_cast<uint16_t>(transcodeToUtf16(ptr, byteSize / sizeof(wchar_t), buffer,
+                                                      WPP_MAX_TRANSCODED_WSTRING_LENGTH + 1) *
+                                     sizeof(char16_t))) {
+    }
+
+    auto makeTracePairs() const {
+        return std::make_tuple<TracePair, TracePair>({&size, sizeof(size)}, {buffer, size});
+    }
+
+    char16_t buffer[WPP_MAX_TRANSCODED_WSTRING_LENGTH + 1];
+    const uint16_t size;
+};
+
+/**
+ * Wide strings traced as hex are traced as-is where wchar_t is UTF-16, and transcoded to UTF-16
+ * otherwise.
+ */
+using WideBufferItemType =
+    std::conditional_t<sizeof(wchar_t) == sizeof(char16_t), SizeAndDataTraceItem,
+                       TranscodedWideBufferItemType>;
+
+}  // namespace internal
+
+/**
+ * Wide strings traced using the `x` and `xd` specifications, whose data is UTF-16 (the same as
+ * WStringItem), and is printed the same as HexBufferItem and HexDumpItem.
+ */
+struct WHexBufferItem : internal::WideBufferItemType {
+    using internal::WideBufferItemType::WideBufferItemType;
+};
+
+struct WHexDumpItem : internal::WideBufferItemType {
+    using internal::WideBufferItemType::WideBufferItemType;
 };
 
 template<typename CharType, typename ItemType, bool includeNull = true>
@@ -301,11 +538,11 @@ struct TraceItemMaker<wchar_t*, FormatString<'s'>> : StringTraceItemMaker<wchar_
 
 template<>
 struct TraceItemMaker<wchar_t*, FormatString<'x'>>
-    : StringTraceItemMaker<wchar_t, HexBufferItem, false> {};
+    : StringTraceItemMaker<wchar_t, WHexBufferItem, false> {};
 
 template<>
 struct TraceItemMaker<wchar_t*, FormatString<'x', 'd'>>
-    : StringTraceItemMaker<wchar_t, HexDumpItem, false> {};
+    : StringTraceItemMaker<wchar_t, WHexDumpItem, false> {};
 
 }  // namespace wpp
 
@@ -316,6 +553,46 @@ namespace wpp::internal {
  */
 struct InvalidFormatItem {};
 
+/**
+ * The format specification options that can be used with a trace item, in addition to the type
+ * which selects the item (see FormatSpec). Any item can be padded, as that only changes the
+ * rendered text.
+ */
+constexpr const uint8_t FORMAT_OPTIONS_WIDTH = 1;      // fill, align and width
+constexpr const uint8_t FORMAT_OPTIONS_NUMERIC = 2;    // sign, '#', '0', grouping and '=' align
+constexpr const uint8_t FORMAT_OPTIONS_PRECISION = 4;  // precision
+constexpr const uint8_t FORMAT_OPTIONS_ALL =
+    FORMAT_OPTIONS_WIDTH | FORMAT_OPTIONS_NUMERIC | FORMAT_OPTIONS_PRECISION;
+
+template<typename Item>
+struct SupportedFormatOptions : std::integral_constant<uint8_t, FORMAT_OPTIONS_WIDTH> {};
+
+#define __WPP_SUPPORT_FORMAT_OPTIONS(Item, options) \
+    template<>                                      \
+    struct SupportedFormatOptions<Item> : std::integral_constant<uint8_t, options> {}
+
+#define __WPP_SUPPORT_INTEGER_FORMAT_OPTIONS(Item) \
+    __WPP_SUPPORT_FORMAT_OPTIONS(Item, FORMAT_OPTIONS_WIDTH | FORMAT_OPTIONS_NUMERIC)
+
+__WPP_SUPPORT_INTEGER_FORMAT_OPTIONS(Int8Item);
+__WPP_SUPPORT_INTEGER_FORMAT_OPTIONS(Int16Item);
+__WPP_SUPPORT_INTEGER_FORMAT_OPTIONS(Int32Item);
+__WPP_SUPPORT_INTEGER_FORMAT_OPTIONS(Int64Item);
+__WPP_SUPPORT_INTEGER_FORMAT_OPTIONS(UInt8Item);
+__WPP_SUPPORT_INTEGER_FORMAT_OPTIONS(UInt16Item);
+__WPP_SUPPORT_INTEGER_FORMAT_OPTIONS(UInt32Item);
+__WPP_SUPPORT_INTEGER_FORMAT_OPTIONS(UInt64Item);
+__WPP_SUPPORT_INTEGER_FORMAT_OPTIONS(ByteItem);
+__WPP_SUPPORT_INTEGER_FORMAT_OPTIONS(PtrDiffItem);
+__WPP_SUPPORT_INTEGER_FORMAT_OPTIONS(SizeTItem);
+__WPP_SUPPORT_INTEGER_FORMAT_OPTIONS(CharItem);
+__WPP_SUPPORT_INTEGER_FORMAT_OPTIONS(WCharItem);
+__WPP_SUPPORT_FORMAT_OPTIONS(FloatItem, FORMAT_OPTIONS_ALL);
+__WPP_SUPPORT_FORMAT_OPTIONS(DoubleItem, FORMAT_OPTIONS_ALL);
+__WPP_SUPPORT_FORMAT_OPTIONS(LongDoubleItem, FORMAT_OPTIONS_ALL);
+__WPP_SUPPORT_FORMAT_OPTIONS(StringItem, FORMAT_OPTIONS_WIDTH | FORMAT_OPTIONS_PRECISION);
+__WPP_SUPPORT_FORMAT_OPTIONS(WStringItem, FORMAT_OPTIONS_WIDTH | FORMAT_OPTIONS_PRECISION);
+
 /**
  * Builds the matching trace item for the given type and format.
  */
@@ -338,7 +615,19 @@ constexpr auto makeTracePairs(const T& t) {
             [](auto&&... args) { return std::tuple_cat(std::make_tuple(args.ptr, args.size)...); },
             t.makeTracePairs());
     } else {
-        static_assert(false, "Bad trace item type!");
+        static_assert(DependentFalse<T>, "WPP: Bad trace item type!");
+    }
+}
+
+/**
+ * Get the trace pairs of any (simple or complex) trace item, as a tuple of TracePair objects.
+ */
+template<typename T>
+constexpr auto makeTracePairTuple(const T& item) {
+    if constexpr (IsSimpleTraceItem<T>::value) {
+        return std::make_tuple(TracePair{item.getPtr(), item.getSize()});
+    } else {
+        return item.makeTracePairs();
     }
 }
 
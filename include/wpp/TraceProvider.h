@@ -1,9 +1,18 @@
 #pragma once
-#include <Windows.h>
-#include <evntrace.h>
-
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include "Platform.h"
 #include "TraceItems.h"
 
+#ifdef _WIN32
+#include <evntrace.h>
+#else
+#include <array>
+#include <tuple>
+#endif
+
 namespace wpp {
 
 /**
@@ -25,6 +34,115 @@ enum class TraceLevel : uint32_t {
     Reserved9 = 9,
 };
 
+/**
+ * The keywords of a trace: a 64-bit mask of the categories (subsystems) it belongs to. By default,
+ * a trace is enabled if any of its keywords is enabled - use `wpp::allOf` for traces that should
+ * only be enabled if all their keywords are enabled.
+ */
+struct TraceKeywords {
+    enum class Match : uint8_t {
+        Any,
+        All,
+    };
+
+    constexpr TraceKeywords(uint64_t keywordMask, Match keywordMatch = Match::Any) noexcept
+        : mask(keywordMask), match(keywordMatch) {
+        // Intentionally left blank.
+    }
+
+    /**
+     * Checks whether the trace is enabled, given the mask of the enabled keywords.
+     */
+    constexpr bool isEnabled(uint64_t enabledKeywords) const noexcept {
+        const uint64_t enabled = enabledKeywords & mask;
+        return match == Match::All ? enabled == mask : enabled != 0;
+    }
+
+    uint64_t mask;
+    Match match;
+};
+
+/**
+ * Keywords for a trace which is only enabled if all the given keywords are enabled.
+ */
+constexpr TraceKeywords allOf(uint64_t keywordMask) noexcept {
+    return TraceKeywords(keywordMask, TraceKeywords::Match::All);
+}
+
+/**
+ * Keywords for a trace which is enabled if any of the given keywords is enabled (the default).
+ */
+constexpr TraceKeywords anyOf(uint64_t keywordMask) noexcept {
+    return TraceKeywords(keywordMask, TraceKeywords::Match::Any);
+}
+
+namespace internal {
+
+/**
+ * The number of trace levels (including the reserved levels).
+ */
+constexpr const size_t TRACE_LEVEL_COUNT = static_cast<size_t>(TraceLevel::Reserved9) + 1;
+
+/**
+ * Converts the keywords argument of the trace macros (an integer, an enum or TraceKeywords).
+ */
+constexpr TraceKeywords makeTraceKeywords(TraceKeywords keywords) noexcept {
+    return keywords;
+}
+
+template<typename T, typename = std::enable_if_t<std::is_enum_v<T>>>
+constexpr TraceKeywords makeTraceKeywords(T keywords) noexcept {
+    return static_cast<uint64_t>(keywords);
+}
+
+/**
+ * The index of a trace level in the enabled keywords of the levels. Out of range levels are treated
+ * as the least important level (this is folded away for constant levels).
+ */
+constexpr size_t getLevelIndex(TraceLevel level) noexcept {
+    return static_cast<size_t>(level) < TRACE_LEVEL_COUNT ? static_cast<size_t>(level)
+                                                          : TRACE_LEVEL_COUNT - 1;
+}
+
+/**
+ * The enabled keywords of every trace level: the keywords enabled for a level are the enabled
+ * keywords if the level is enabled, and none otherwise. This way, checking whether a trace is
+ * enabled takes a single load and a single AND.
+ */
+template<typename Word>
+void setEnabledKeywords(Word (&enabledKeywords)[TRACE_LEVEL_COUNT], uint64_t keywords,
+                        TraceLevel enabledLevel) noexcept {
+    for (size_t level = 0; level < TRACE_LEVEL_COUNT; ++level) {
+        const uint64_t value = level <= static_cast<size_t>(enabledLevel) ? keywords : 0;
+        if constexpr (std::is_same_v<Word, uint64_t>) {
+            enabledKeywords[level] = value;
+        } else {
+            enabledKeywords[level].store(value, std::memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * The last trace session number allocated in the process.
+ */
+inline std::atomic<uint32_t> g_lastTraceSession{0};
+
+/**
+ * Allocates a process-wide unique trace session number, whenever a provider is enabled. Session
+ * numbers are never 0, which is used for call sites that were never traced.
+ */
+inline uint32_t allocateTraceSession() noexcept {
+    uint32_t session = g_lastTraceSession.fetch_add(1, std::memory_order_relaxed) + 1;
+    while (session == 0) {
+        session = g_lastTraceSession.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+    return session;
+}
+
+}  // namespace internal
+
+#ifdef _WIN32
+
 /**
  * This class is an ETW trace provider, registering as a provider on construction and un-registering
  * on destruction.
@@ -37,18 +155,43 @@ enum class TraceLevel : uint32_t {
  */
 class TraceProvider {
 public:
+    /**
+     * Creates a provider which is registered later, using start(). The provider is disabled until
+     * then, and providers with static storage are constant-initialized - so they can be used by
+     * any static initializer.
+     */
+    constexpr TraceProvider() noexcept = default;
+
     TraceProvider(const GUID& controlGUID) {
+        start(controlGUID);
+    }
+
+    ~TraceProvider() noexcept {
+        stop();
+    }
+
+    /**
+     * Registers the provider with the given control GUID.
+     */
+    void start(const GUID& controlGUID) noexcept {
+        stop();
         TRACE_GUID_REGISTRATION guids[] = {{&controlGUID, nullptr}};
         // Currently, no error handling if status != ERROR_SUCCESS
         (void)RegisterTraceGuids(controlCallback, &m_context, &controlGUID, 1, guids, nullptr,
                                  nullptr, &m_controlHandle);
     }
 
-    ~TraceProvider() noexcept {
+    /**
+     * Un-registers the provider, disabling all traces.
+     */
+    void stop() noexcept {
         if (m_controlHandle) {
-            // Since this is a destructor, nothing could be done in the case of a failure anyways
+            // Nothing could be done in the case of a failure anyways
             UnregisterTraceGuids(m_controlHandle);
+            m_controlHandle = 0;
         }
+        m_context.sessionHandle = 0;
+        internal::setEnabledKeywords(m_context.enabledKeywords, 0, TraceLevel::None);
     }
 
     // Prevent copy operations
@@ -60,11 +203,10 @@ public:
     TraceProvider& operator=(TraceProvider&&) = delete;
 
     /**
-     * Checks whether the given flag and trace level are currently enabled for tracing.
+     * Checks whether the given keywords and trace level are currently enabled for tracing.
      */
-    constexpr bool areTracesEnabled(UCHAR flag, TraceLevel level) const noexcept {
-        return (flag & m_context.enabledFlags) &&
-               (m_context.enabledLevels >= static_cast<uint32_t>(level));
+    constexpr bool areTracesEnabled(TraceKeywords keywords, TraceLevel level) const noexcept {
+        return keywords.isEnabled(m_context.enabledKeywords[internal::getLevelIndex(level)]);
     }
 
     /**
@@ -87,18 +229,42 @@ public:
             std::tuple_cat(internal::makeTracePairs(std::forward<TraceItems>(traceItems))...));
     }
 
+    /**
+     * Claims the registered modules whose load records weren't traced yet in the current session.
+     * Returns the range [first, last) of module indices whose load records should be traced.
+     */
+    std::pair<size_t, size_t> claimUnreportedModules(size_t registeredCount) noexcept {
+        size_t reported = m_context.reportedModules.load(std::memory_order_relaxed);
+        while (reported < registeredCount &&
+               !m_context.reportedModules.compare_exchange_weak(reported, registeredCount,
+                                                                std::memory_order_relaxed)) {
+            // Intentionally left blank.
+        }
+        return {reported, reported < registeredCount ? registeredCount : reported};
+    }
+
+    /**
+     * The number of the current trace session, which changes whenever the provider is enabled.
+     */
+    uint32_t session() const noexcept {
+        return m_context.session.load(std::memory_order_relaxed);
+    }
+
 private:
     /**
      * This structure holds a trace context for a provider: the current ETW session handle, and
      * which traces should be issued.
      */
     struct TraceContext {
+        /// Which keywords are currently enabled, for every trace level. These are read by every
+        /// call site, so they don't share cache lines with other data.
+        alignas(internal::CACHE_LINE_SIZE) uint64_t enabledKeywords[internal::TRACE_LEVEL_COUNT]{};
         /// The current session handle
-        TRACEHANDLE sessionHandle{};
-        /// Which trace levels are currently enabled
-        ULONG enabledLevels{};
-        /// Which trace flags are currently enabled
-        ULONG enabledFlags{};
+        alignas(internal::CACHE_LINE_SIZE) TRACEHANDLE sessionHandle{};
+        /// The number of modules whose load records were traced in the current session
+        std::atomic<size_t> reportedModules{};
+        /// The number of the current trace session
+        std::atomic<uint32_t> session{};
     };
 
     TraceContext m_context{};
@@ -119,19 +285,23 @@ private:
         switch (RequestCode) {
             case WMI_ENABLE_EVENTS: {
                 auto traceHandle = GetTraceLoggerHandle(Header);
-                auto enabledLevels = GetTraceEnableLevel(traceHandle);
+                auto enabledLevel = GetTraceEnableLevel(traceHandle);
+                // Classic ETW sessions enable 32-bit flags, so only the low 32 keywords can be
+                // enabled on Windows.
                 auto enabledFlags = GetTraceEnableFlags(traceHandle);
 
                 traceContext.sessionHandle = traceHandle;
-                traceContext.enabledLevels = enabledLevels;
-                traceContext.enabledFlags = enabledFlags;
+                internal::setEnabledKeywords(traceContext.enabledKeywords, enabledFlags,
+                                             static_cast<TraceLevel>(enabledLevel));
+                // A new session requires all the module load records.
+                traceContext.reportedModules = 0;
+                traceContext.session = internal::allocateTraceSession();
 
                 break;
             }
             case WMI_DISABLE_EVENTS: {
                 traceContext.sessionHandle = 0;
-                traceContext.enabledLevels = 0;
-                traceContext.enabledFlags = 0;
+                internal::setEnabledKeywords(traceContext.enabledKeywords, 0, TraceLevel::None);
 
                 break;
             }
@@ -143,4 +313,155 @@ private:
     }
 };
 
+#else
+
+/**
+ * A destination for traces, used on platforms without ETW. Sinks are called concurrently by all the
+ * tracing threads, so implementations must be thread-safe.
+ */
+class TraceSink {
+public:
+    virtual ~TraceSink() = default;
+
+    /**
+     * Writes a single trace message: the message GUID, followed by the data of all the trace items.
+     * The data is given as pairs of pointers and sizes, which are only valid during the call.
+     */
+    virtual void write(const GUID& messageGuid, const TracePair* pairs, size_t count) noexcept = 0;
+};
+
+/**
+ * A trace provider for platforms without ETW, with the same interface as the ETW trace provider.
+ *
+ * Instead of being enabled by an ETW session, the provider is enabled by the application, which
+ * chooses the trace sink and the enabled flags and levels. The sink must stay valid until the
+ * provider is disabled, and no traces are being written to it.
+ */
+class TraceProvider {
+public:
+    /**
+     * Creates a provider whose control GUID is set later, using start(). Providers with static
+     * storage are constant-initialized, so they can be used by any static initializer.
+     */
+    constexpr TraceProvider() noexcept = default;
+
+    explicit constexpr TraceProvider(const GUID& controlGUID) noexcept
+        : m_controlGuid(controlGUID) {
+        // Intentionally left blank.
+    }
+
+    /**
+     * Sets the control GUID of the provider, matching the ETW trace provider.
+     */
+    void start(const GUID& controlGUID) noexcept {
+        m_controlGuid = controlGUID;
+    }
+
+    /**
+     * Disables all traces, matching the ETW trace provider.
+     */
+    void stop() noexcept {
+        disable();
+    }
+
+    // Prevent copy operations
+    TraceProvider(const TraceProvider&) = delete;
+    TraceProvider& operator=(const TraceProvider&) = delete;
+
+    // Prevent move operations
+    TraceProvider(TraceProvider&&) = delete;
+    TraceProvider& operator=(TraceProvider&&) = delete;
+
+    /**
+     * Enables the given trace keywords and levels, writing the traces to the given sink. This
+     * starts a new trace session, so the module load records are traced again.
+     */
+    void enable(TraceSink& sink, uint64_t enabledKeywords, TraceLevel enabledLevel) noexcept {
+        m_sink.store(&sink, std::memory_order_release);
+        m_reportedModules.store(0, std::memory_order_relaxed);
+        m_session.store(internal::allocateTraceSession(), std::memory_order_relaxed);
+        // The keywords are stored last, so tracing threads see the new sink and session first.
+        std::atomic_thread_fence(std::memory_order_release);
+        internal::setEnabledKeywords(m_enabledKeywords, enabledKeywords, enabledLevel);
+    }
+
+    /**
+     * Disables all traces.
+     */
+    void disable() noexcept {
+        internal::setEnabledKeywords(m_enabledKeywords, 0, TraceLevel::None);
+        m_sink.store(nullptr, std::memory_order_release);
+    }
+
+    /**
+     * The GUID identifying the provider.
+     */
+    const GUID& controlGuid() const noexcept {
+        return m_controlGuid;
+    }
+
+    /**
+     * Checks whether the given keywords and trace level are currently enabled for tracing.
+     */
+    bool areTracesEnabled(TraceKeywords keywords, TraceLevel level) const noexcept {
+        return keywords.isEnabled(
+            m_enabledKeywords[internal::getLevelIndex(level)].load(std::memory_order_relaxed));
+    }
+
+    /**
+     * Traces the given trace items to the current trace sink.
+     */
+    template<typename... TraceItems>
+    void traceMessageFromTraceItems(const GUID& messageGuid,
+                                    TraceItems&&... traceItems) const noexcept {
+        TraceSink* sink = m_sink.load(std::memory_order_acquire);
+        if (sink == nullptr) {
+            return;
+        }
+
+        std::apply(
+            [sink, &messageGuid](const auto&... pairs) {
+                const std::array<TracePair, sizeof...(pairs)> pairArray{pairs...};
+                sink->write(messageGuid, pairArray.data(), pairArray.size());
+            },
+            std::tuple_cat(internal::makeTracePairTuple(traceItems)...));
+    }
+
+    /**
+     * Claims the registered modules whose load records weren't traced yet in the current session.
+     * Returns the range [first, last) of module indices whose load records should be traced.
+     */
+    std::pair<size_t, size_t> claimUnreportedModules(size_t registeredCount) noexcept {
+        size_t reported = m_reportedModules.load(std::memory_order_relaxed);
+        while (reported < registeredCount &&
+               !m_reportedModules.compare_exchange_weak(reported, registeredCount,
+                                                        std::memory_order_relaxed)) {
+            // Intentionally left blank.
+        }
+        return {reported, reported < registeredCount ? registeredCount : reported};
+    }
+
+    /**
+     * The number of the current trace session, which changes whenever the provider is enabled.
+     */
+    uint32_t session() const noexcept {
+        return m_session.load(std::memory_order_relaxed);
+    }
+
+private:
+    /// Which keywords are currently enabled, for every trace level. These are read by every call
+    /// site, so they don't share cache lines with other data.
+    alignas(internal::CACHE_LINE_SIZE) std::atomic<uint64_t>
+        m_enabledKeywords[internal::TRACE_LEVEL_COUNT]{};
+    /// The current trace sink, or nullptr if traces are disabled
+    alignas(internal::CACHE_LINE_SIZE) std::atomic<TraceSink*> m_sink{nullptr};
+    GUID m_controlGuid{};
+    /// The number of modules whose load records were traced in the current session
+    std::atomic<size_t> m_reportedModules{0};
+    /// The number of the current trace session
+    std::atomic<uint32_t> m_session{0};
+};
+
+#endif
+
 }  // namespace wpp
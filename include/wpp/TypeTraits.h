@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 #include <type_traits>
 #include <tuple>
 
@@ -24,24 +25,38 @@ struct RecursiveDecayHelper {
     using type = std::decay_t<T>;
 };
 
+/**
+ * Recursively decays the pointee type of a pointer. Function types are kept as-is, as decaying them
+ * yields a pointer to the same function type.
+ */
+template<typename T, bool = std::is_function_v<T>>
+struct RecursivePointeeDecayHelper {
+    using type = std::add_pointer_t<typename RecursiveDecayHelper<std::decay_t<T>>::type>;
+};
+
+template<typename T>
+struct RecursivePointeeDecayHelper<T, true> {
+    using type = T*;
+};
+
 template<typename T>
 struct RecursiveDecayHelper<T*> {
-    using type = std::add_pointer_t<typename RecursiveDecayHelper<std::decay_t<T>>::type>;
+    using type = typename RecursivePointeeDecayHelper<T>::type;
 };
 
 template<typename T>
 struct RecursiveDecayHelper<T* const> {
-    using type = std::add_pointer_t<typename RecursiveDecayHelper<std::decay_t<T>>::type>;
+    using type = typename RecursivePointeeDecayHelper<T>::type;
 };
 
 template<typename T>
 struct RecursiveDecayHelper<T* volatile> {
-    using type = std::add_pointer_t<typename RecursiveDecayHelper<std::decay_t<T>>::type>;
+    using type = typename RecursivePointeeDecayHelper<T>::type;
 };
 
 template<typename T>
 struct RecursiveDecayHelper<T* const volatile> {
-    using type = std::add_pointer_t<typename RecursiveDecayHelper<std::decay_t<T>>::type>;
+    using type = typename RecursivePointeeDecayHelper<T>::type;
 };
 
 template<typename T>
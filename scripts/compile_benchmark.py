@@ -0,0 +1,291 @@
+"""
+Measures the compile-time cost of the trace macros with GCC and Clang.
+
+For every call site count (100, 1k and 10k by default), a translation unit containing that many
+`WPP_DO_TRACE` call sites is generated, with varied argument counts and types. Every TU is compiled
+by every compiler, and the wall time, the peak memory of the compiler and the size of the object
+file (and of its hot `.text` and cold `.text.unlikely` code, and of its metadata section) are
+reported. The enabled path of every call site is outlined into a cold function, so the hot code
+divided by the number of call sites is the code size that a call site adds to its function.
+
+The results can be written as JSON, and compared with the results of a previous run - the script
+fails if any measurement regressed by more than the given tolerance.
+
+This is a script rather than a target of the solution, as the benchmark itself runs the compilers:
+it generates the TUs, measures every compilation and inspects the resulting ELF object files, so
+only POSIX hosts (with GCC or Clang) are supported.
+"""
+import argparse
+import json
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+from elf_parser import ElfFile, METADATA_SECTION
+from logger import setup_logger, logger
+
+
+INCLUDE_DIRECTORY = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'include')
+DEFAULT_SIZES = [100, 1000, 10000]
+DEFAULT_COMPILERS = ['g++', 'clang++']
+
+# Every call site is placed in a function of at most this many call sites, so the benchmark
+# measures the cost of the call sites rather than the cost of optimizing a single huge function.
+SITES_PER_FUNCTION = 50
+
+# Traced arguments: (format specifier, expression) - the expressions use the parameters of the
+# generated functions.
+ARGUMENTS = [
+    ('{}', 'i'),
+    ('{:x}', 'i'),
+    ('{}', 'u64'),
+    ('{:x}', 'u64'),
+    ('{}', 'd'),
+    ('{}', 'u8'),
+    ('{}', 'c'),
+    ('{}', 'str'),
+    ('{:s}', 'str'),
+    ('{:xd}', 'str'),
+    ('{}', 'wstr'),
+    ('{}', 'guid'),
+    ('{:p}', 'ptr'),
+    ('{}', 'size'),
+    ('{}', 'opt'),
+]
+MAX_ARGUMENTS = 8
+
+# The measurements compared against the baseline
+MEASUREMENTS = ['wall_time', 'peak_memory', 'object_size', 'text_size', 'cold_text_size', 'metadata_size']
+
+
+def generate_arguments(generator):
+    """
+    Generate a random number of random arguments, as (format specifier, expression) pairs.
+    """
+    return [generator.choice(ARGUMENTS) for _ in range(generator.randint(0, MAX_ARGUMENTS))]
+
+
+def generate_call_site(index, arguments):
+    """
+    Generate a single trace call site with the given arguments. The format also contains the index
+    of the call site, so every call site is unique.
+    """
+    fmt = 'site {}: '.format(index) + ', '.join(
+        'arg{} = {}'.format(i, specifier) for i, (specifier, _) in enumerate(arguments))
+    expressions = ''.join(', ' + expression for _, expression in arguments)
+    return '    WPP_DO_TRACE(provider, 1, ::wpp::TraceLevel::Information, "{}"{});'.format(
+        fmt, expressions)
+
+
+def generate_source(site_count, seed, shape_count=None):
+    """
+    Generate the source of a TU containing `site_count` trace call sites. If `shape_count` is
+    given, the arguments of every call site are chosen out of that many random argument lists, as
+    real code traces the same argument types in many call sites.
+    The same count, seed and shape count always generate the same source.
+    """
+    generator = random.Random(seed)
+    shapes = None
+    if shape_count is not None:
+        shapes = [generate_arguments(generator) for _ in range(shape_count)]
+    lines = [
+        '#include <cstdint>',
+        '#include <optional>',
+        '#include "wpp/Trace.h"',
+        '',
+    ]
+    for function_index, first in enumerate(range(0, site_count, SITES_PER_FUNCTION)):
+        lines.append('void traceSites{}(wpp::TraceProvider& provider, int i, uint64_t u64, double d, '
+                     'uint8_t u8, char c, const char* str, const wchar_t* wstr, const GUID& guid, '
+                     'const void* ptr, size_t size, std::optional<int> opt) {{'.format(function_index))
+        for index in range(first, min(first + SITES_PER_FUNCTION, site_count)):
+            arguments = generator.choice(shapes) if shapes else generate_arguments(generator)
+            lines.append(generate_call_site(index, arguments))
+        lines.append('}')
+        lines.append('')
+    return '\n'.join(lines)
+
+
+def run_compiler(command):
+    """
+    Run the compiler, returning the wall time (in seconds) and the peak resident memory (in bytes)
+    of the compiler. The peak memory includes the processes spawned by the compiler driver.
+    """
+    start = time.perf_counter()
+    process = subprocess.Popen(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    output = process.stdout.read()
+    _, status, usage = os.wait4(process.pid, 0)
+    wall_time = time.perf_counter() - start
+    process.stdout.close()
+
+    if os.waitstatus_to_exitcode(status) != 0:
+        raise RuntimeError('Compilation failed: {}\n{}'.format(
+            ' '.join(command), output.decode(errors='replace')))
+
+    # ru_maxrss is in kilobytes on Linux
+    return wall_time, usage.ru_maxrss * 1024
+
+
+def get_section_size(elf, name):
+    data = elf.get_section(name)
+    return 0 if data is None else len(data)
+
+
+def get_code_sizes(elf):
+    """
+    Return the total size of the hot and of the cold code sections. Functions shared between TUs
+    (such as template instantiations) are placed in their own `.text.<name>` or
+    `.text.unlikely.<name>` sections.
+    """
+    hot_size = cold_size = 0
+    for name, _, data in elf.sections:
+        if name == '.text.unlikely' or name.startswith('.text.unlikely.'):
+            cold_size += len(data)
+        elif name == '.text' or name.startswith('.text.'):
+            hot_size += len(data)
+    return hot_size, cold_size
+
+
+def benchmark(compiler, source_path, object_path, flags, repeat):
+    """
+    Compile the given source `repeat` times, and return the measurements of the fastest run.
+    """
+    command = [compiler, '-I', INCLUDE_DIRECTORY, '-c', source_path, '-o', object_path] + flags
+    runs = [run_compiler(command) for _ in range(repeat)]
+    wall_time, peak_memory = min(runs)
+
+    elf = ElfFile(object_path)
+    text_size, cold_text_size = get_code_sizes(elf)
+    return {
+        'wall_time': wall_time,
+        'peak_memory': peak_memory,
+        'object_size': os.path.getsize(object_path),
+        'text_size': text_size,
+        'cold_text_size': cold_text_size,
+        'metadata_size': get_section_size(elf, METADATA_SECTION),
+    }
+
+
+def make_key(result):
+    return '{}/{}'.format(result['compiler'], result['sites'])
+
+
+def compare_results(results, baseline, tolerance):
+    """
+    Compare the results with the baseline results, returning a list of regression descriptions.
+    Configurations that are missing from the baseline are ignored.
+    """
+    baseline = {make_key(result): result for result in baseline['results']}
+    regressions = []
+    for result in results:
+        previous = baseline.get(make_key(result))
+        if previous is None:
+            continue
+
+        for measurement in MEASUREMENTS:
+            if previous.get(measurement, 0) == 0:
+                continue
+            change = result[measurement] / previous[measurement] - 1
+            if change > tolerance:
+                regressions.append('{}: {} regressed by {:.1%} ({} -> {})'.format(
+                    make_key(result), measurement, change, previous[measurement],
+                    result[measurement]))
+    return regressions
+
+
+def print_results(results):
+    print('{:<12} {:>6} {:>10} {:>12} {:>12} {:>10} {:>14} {:>10} {:>10}'.format(
+        'compiler', 'sites', 'time (s)', 'memory (MB)', 'object (KB)', 'text (KB)', 'text/site (B)',
+        'cold (KB)', 'meta (KB)'))
+    for result in results:
+        print('{:<12} {:>6} {:>10.2f} {:>12.1f} {:>12.1f} {:>10.1f} {:>14.1f} {:>10.1f} {:>10.1f}'.format(
+            result['compiler'], result['sites'], result['wall_time'],
+            result['peak_memory'] / 2 ** 20, result['object_size'] / 2 ** 10,
+            result['text_size'] / 2 ** 10, result['text_size'] / result['sites'],
+            result['cold_text_size'] / 2 ** 10, result['metadata_size'] / 2 ** 10))
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(description='Measure the compile-time cost of the trace macros.')
+    parser.add_argument('-c', '--compiler', type=str, action='append',
+                        help='A compiler to benchmark (can be specified multiple times, defaults to the '
+                             'available compilers out of {}).'.format(', '.join(DEFAULT_COMPILERS)))
+    parser.add_argument('-s', '--sizes', type=int, nargs='+', default=DEFAULT_SIZES,
+                        help='The numbers of call sites in the generated TUs.')
+    parser.add_argument('-f', '--flags', type=str, default='-std=c++17 -O2',
+                        help='The compilation flags (default: %(default)s). As the flags start with a dash, '
+                             'pass them attached to the option, such as --flags="-std=c++20 -O2".')
+    parser.add_argument('-r', '--repeat', type=int, default=1,
+                        help='The number of compilations of every TU, the fastest one is reported.')
+    parser.add_argument('--seed', type=int, default=0, help='The seed used to generate the call sites.')
+    parser.add_argument('--shapes', type=int,
+                        help='Choose the arguments of every call site out of this many random argument '
+                             'lists (by default, the arguments of every call site are random).')
+    parser.add_argument('-o', '--output', type=str, help='Write the results to a JSON file.')
+    parser.add_argument('-b', '--baseline', type=str,
+                        help='A JSON file of previous results, to compare the results with.')
+    parser.add_argument('-t', '--tolerance', type=float, default=0.1,
+                        help='The allowed relative regression from the baseline (default: %(default)s).')
+    parser.add_argument('-k', '--keep', type=str,
+                        help='Keep the generated sources and object files in the given directory.')
+    parser.add_argument('-v', '--verbose', help='Display verbose output (use -vv for debug output).', action='count', default=0)
+    return parser.parse_args()
+
+
+def main():
+    args = parse_arguments()
+    setup_logger(args.verbose)
+
+    if not hasattr(os, 'wait4'):
+        logger.error('The compile benchmark is only supported on POSIX hosts!')
+        return 1
+
+    compilers = args.compiler or [compiler for compiler in DEFAULT_COMPILERS if shutil.which(compiler)]
+    if not compilers:
+        logger.error('No compiler was found!')
+        return 1
+
+    directory = args.keep or tempfile.mkdtemp(prefix='wpp-compile-benchmark-')
+    os.makedirs(directory, exist_ok=True)
+    flags = args.flags.split()
+    results = []
+    try:
+        for sites in args.sizes:
+            source_path = os.path.join(directory, 'sites_{}.cpp'.format(sites))
+            with open(source_path, 'w') as f:
+                f.write(generate_source(sites, args.seed, args.shapes))
+
+            for compiler in compilers:
+                logger.info('Compiling %d call sites with %s', sites, compiler)
+                object_path = os.path.join(directory, 'sites_{}_{}.o'.format(
+                    sites, os.path.basename(compiler)))
+                result = {'compiler': os.path.basename(compiler), 'sites': sites}
+                result.update(benchmark(compiler, source_path, object_path, flags, args.repeat))
+                results.append(result)
+    finally:
+        if args.keep is None:
+            shutil.rmtree(directory)
+
+    print_results(results)
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump({'flags': args.flags, 'seed': args.seed, 'shapes': args.shapes, 'results': results}, f, indent=4)
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            regressions = compare_results(results, json.load(f), args.tolerance)
+        for regression in regressions:
+            logger.error(regression)
+        if regressions:
+            return 1
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -33,6 +33,12 @@ class LoadModuleError(DbgHelpException):
 class UnLoadModuleError(DbgHelpException):
     pass
 
+class SymbolNotFoundError(DbgHelpException):
+    pass
+
+class ModuleInfoError(DbgHelpException):
+    pass
+
 
 _SymInitialize = _DBG_HELP_DLL["SymInitialize"]
 _SymCleanup = _DBG_HELP_DLL["SymCleanup"]
@@ -40,6 +46,8 @@ _SymSetOptions = _DBG_HELP_DLL["SymSetOptions"]
 _SymSearch = _DBG_HELP_DLL["SymSearch"]
 _SymLoadModuleEx = _DBG_HELP_DLL["SymLoadModuleEx"]
 _SymUnloadModule64 = _DBG_HELP_DLL["SymUnloadModule64"]
+_SymFromAddr = _DBG_HELP_DLL["SymFromAddr"]
+_SymGetModuleInfo64 = _DBG_HELP_DLL["SymGetModuleInfo64"]
 
 def SymInitialize(process_handle, user_search_path=None, invade_process=False):
     if not _SymInitialize(process_handle, user_search_path, invade_process):
@@ -138,3 +146,62 @@ def SymUnloadModule64(process_handle, base_address):
     base_address = ctypes.c_ulonglong(base_address)
     if not _SymUnloadModule64(process_handle, base_address):
         raise UnLoadModuleError()
+
+
+MAX_SYM_NAME = 2000
+
+
+def SymFromAddr(process_handle, address):
+    """
+    Get the name of the symbol containing the given address, and the displacement from its start.
+    """
+    buffer = ctypes.create_string_buffer(ctypes.sizeof(SYMBOL_INFO) + MAX_SYM_NAME)
+    symbol = ctypes.cast(buffer, ctypes.POINTER(SYMBOL_INFO)).contents
+    symbol.SizeOfStruct = ctypes.sizeof(SYMBOL_INFO)
+    symbol.MaxNameLen = MAX_SYM_NAME
+    displacement = ctypes.c_ulonglong(0)
+    if not _SymFromAddr(process_handle, ctypes.c_ulonglong(address), ctypes.byref(displacement), buffer):
+        raise SymbolNotFoundError()
+    name_offset = SYMBOL_INFO.Name.offset
+    return buffer.raw[name_offset:name_offset + symbol.NameLen].decode(), displacement.value
+
+
+class IMAGEHLP_MODULE64(ctypes.Structure):
+    """
+    Information about a loaded module, returned by SymGetModuleInfo64.
+    """
+    _fields_ = [
+        ('SizeOfStruct', ctypes.c_ulong),
+        ('BaseOfImage', ctypes.c_ulonglong),
+        ('ImageSize', ctypes.c_ulong),
+        ('TimeDateStamp', ctypes.c_ulong),
+        ('CheckSum', ctypes.c_ulong),
+        ('NumSyms', ctypes.c_ulong),
+        ('SymType', ctypes.c_ulong),
+        ('ModuleName', ctypes.c_char * 32),
+        ('ImageName', ctypes.c_char * 256),
+        ('LoadedImageName', ctypes.c_char * 256),
+        ('LoadedPdbName', ctypes.c_char * 256),
+        ('CVSig', ctypes.c_ulong),
+        ('CVData', ctypes.c_char * (260 * 3)),
+        ('PdbSig', ctypes.c_ulong),
+        ('PdbSig70', ctypes.c_ubyte * 16),  # The raw bytes of the PDB GUID
+        ('PdbAge', ctypes.c_ulong),
+        ('PdbUnmatched', ctypes.c_int),
+        ('DbgUnmatched', ctypes.c_int),
+        ('LineNumbers', ctypes.c_int),
+        ('GlobalSymbols', ctypes.c_int),
+        ('TypeInfo', ctypes.c_int),
+        ('SourceIndexed', ctypes.c_int),
+        ('Publics', ctypes.c_int),
+        ('MachineType', ctypes.c_ulong),
+        ('Reserved', ctypes.c_ulong),
+    ]
+
+
+def SymGetModuleInfo64(process_handle, base_address):
+    info = IMAGEHLP_MODULE64()
+    info.SizeOfStruct = ctypes.sizeof(IMAGEHLP_MODULE64)
+    if not _SymGetModuleInfo64(process_handle, ctypes.c_ulonglong(base_address), ctypes.byref(info)):
+        raise ModuleInfoError()
+    return info
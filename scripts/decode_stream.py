@@ -0,0 +1,302 @@
+"""
+Decodes trace streams written by wpp::FileTraceSink (see FileTraceSink.h).
+
+Streams of programs built with WPP_ENABLE_INLINE_METADATA contain the metadata records of all the
+traced call sites, so they are decoded without the PDB or ELF file of the program. The metadata of
+other streams can be read from their ELF files (or from their metadata sections), or from a symbol
+store: a directory of metadata indices named by the build-ids of their binaries (written using
+`WppExtract --symbol-store`). The stream header lists the build-ids of the traced modules, so the
+matching indices are found automatically, and ELF files of other builds are rejected.
+
+`{:sym}` pointers are resolved using the symbol tables of the given ELF files (the metadata files,
+and other modules given with `--symbols`), which are matched with the module indices of the pointers
+using the module load records of the stream.
+
+With `--json`, every trace is written as a JSON object, including the values of the named fields of
+its format (such as `{user}`) as structured arguments.
+"""
+import argparse
+import datetime
+import json
+import os
+import struct
+import uuid
+
+import elf_parser
+from logger import setup_logger, logger
+from metadata_index import read_metadata_index
+from trace_items import TraceData
+from trace_metadata import MetadataContext, parse_annotation_data
+
+
+STREAM_MAGIC = 0x53505057  # "WPPS"
+STREAM_RECORD_MAGIC = 0x52505057  # "WPPR"
+STREAM_VERSION = 2
+SUPPORTED_STREAM_VERSIONS = (1, STREAM_VERSION)
+
+# The size of wpp::ModuleId, used for the build-ids of the traced modules
+MODULE_ID_SIZE = 20
+
+_STREAM_HEADER = struct.Struct('<IHH')
+_STREAM_MODULES_HEADER = struct.Struct('<I')
+_RECORD_HEADER = struct.Struct('<IIQ16s')
+# A module index, followed by the build-id as a size-prefixed buffer
+_MODULE_LOAD_RECORD = struct.Struct('<HH{}s'.format(MODULE_ID_SIZE))
+
+# The message GUID of inline metadata records (wpp::INLINE_METADATA_GUID)
+INLINE_METADATA_GUID = uuid.UUID('4d505057-0000-3000-8000-5750504d4554')
+
+# The message GUID of the module load records traced by wpp::internal::traceModuleLoads
+# (wpp::MODULE_LOAD_GUID)
+MODULE_LOAD_GUID = uuid.UUID('4d505057-0001-3000-8000-5750504d4f44')
+
+
+class StreamRecord(object):
+    def __init__(self, timestamp, guid, data):
+        self.timestamp = timestamp
+        self.guid = guid
+        self.data = data
+
+
+def read_stream_header(data):
+    """
+    Read the header of a trace stream, returning its size and the build-ids of the traced modules.
+    Version 1 streams have no modules.
+
+    :type data: bytes
+    """
+    magic, version, header_size = _STREAM_HEADER.unpack_from(data)
+    if magic != STREAM_MAGIC:
+        raise ValueError('Not a trace stream!')
+    if version not in SUPPORTED_STREAM_VERSIONS:
+        raise ValueError('Unsupported trace stream version {}!'.format(version))
+
+    modules = []
+    if version >= 2:
+        (module_count,) = _STREAM_MODULES_HEADER.unpack_from(data, _STREAM_HEADER.size)
+        position = _STREAM_HEADER.size + _STREAM_MODULES_HEADER.size
+        for _ in range(module_count):
+            modules.append(data[position:position + MODULE_ID_SIZE])
+            position += MODULE_ID_SIZE
+
+    return header_size, modules
+
+
+def read_stream(data, header_size):
+    """
+    Yield the records of a trace stream, following its header.
+
+    :type data: bytes
+    """
+    position = header_size
+    while position + _RECORD_HEADER.size <= len(data):
+        magic, size, timestamp, guid = _RECORD_HEADER.unpack_from(data, position)
+        end = position + _RECORD_HEADER.size + size
+        if magic != STREAM_RECORD_MAGIC or end > len(data):
+            # Skip to the next record
+            logger.warning('Bad record at offset {:#x}, skipping...'.format(position))
+            position = data.find(struct.pack('<I', STREAM_RECORD_MAGIC), position + 1)
+            if position == -1:
+                return
+            continue
+
+        yield StreamRecord(timestamp, uuid.UUID(bytes_le=guid), data[end - size:end])
+        position = end
+
+
+def parse_inline_metadata(records, context):
+    """
+    Parse the inline metadata records of a trace stream into the given MetadataContext.
+    Records are traced once for every trace session, so they usually appear several times.
+    """
+    for record in records:
+        if record.guid == INLINE_METADATA_GUID:
+            # The record is a list of null-terminated strings
+            parse_annotation_data(record.data.decode().split('\0')[:-1], context)
+
+
+def make_module_id(raw_id):
+    """
+    Pad or truncate a raw build-id to the size used by the stream header.
+    """
+    return raw_id[:MODULE_ID_SIZE].ljust(MODULE_ID_SIZE, b'\0')
+
+
+def load_symbol_store_traces(directory, modules):
+    """
+    Load the traces of the metadata indices of the given modules from a symbol store directory.
+    """
+    traces = []
+    for module in modules:
+        path = os.path.join(directory, module.hex() + '.wppidx')
+        if not os.path.isfile(path):
+            logger.warning('No metadata for module {} in the symbol store'.format(module.hex()))
+            continue
+        logger.info('Loading {}'.format(path))
+        traces += read_metadata_index(path)
+    return traces
+
+
+def load_elf_traces(path, modules):
+    """
+    Load the traces of an ELF file, checking that it's one of the given modules of the stream.
+    Files without a build-id (such as extracted metadata sections) can't be checked.
+    """
+    build_id = elf_parser.ElfFile(path).get_build_id()
+    if build_id is None:
+        logger.warning('{} has no build-id, assuming it matches the stream'.format(path))
+    elif modules and make_module_id(build_id) not in modules:
+        raise ValueError('{} (build-id {}) does not match any module of the stream!'.format(
+            path, build_id.hex()))
+    return elf_parser.extract_trace_info(path)
+
+
+class StreamSymbols(object):
+    """
+    Resolves the `{:sym}` pointers and `{:stack}` frames of a stream (see trace_items.TraceData).
+    Module indices are assigned by the traced process, which reports them using module load
+    records, while stack frames refer to the build-ids of their modules.
+    """
+    def __init__(self, records, symbol_tables):
+        """
+        :param symbol_tables: Maps module ids to (name, elf_parser.SymbolTable) tuples.
+        """
+        self._symbol_tables = symbol_tables
+        self._modules = {}
+        for record in records:
+            if record.guid != MODULE_LOAD_GUID or len(record.data) != _MODULE_LOAD_RECORD.size:
+                continue
+            index, size, module_id = _MODULE_LOAD_RECORD.unpack(record.data)
+            if size == MODULE_ID_SIZE and module_id in symbol_tables:
+                self._modules[index] = symbol_tables[module_id]
+
+    def describe(self, module_index, offset):
+        if module_index not in self._modules:
+            return None
+        return self._describe(self._modules[module_index], offset)
+
+    def describe_module(self, module_id, offset):
+        if module_id not in self._symbol_tables:
+            return None
+        return self._describe(self._symbol_tables[module_id], offset)
+
+    @staticmethod
+    def _describe(module, offset):
+        name, symbols = module
+        description = symbols.describe(offset)
+        return None if description is None else '{}!{}'.format(name, description)
+
+
+def load_symbol_tables(paths):
+    """
+    Load the symbol tables of the given ELF files, mapping their build-ids to (name, SymbolTable)
+    tuples. Files without a build-id can't be matched with the traced modules, and are skipped.
+    """
+    symbol_tables = {}
+    for path in paths:
+        elf_file = elf_parser.ElfFile(path)
+        build_id = elf_file.get_build_id()
+        if build_id is None:
+            logger.warning('{} has no build-id, so its symbols are not used'.format(path))
+            continue
+        symbols = elf_parser.SymbolTable(elf_file)
+        logger.info('Loaded {} symbols of {}'.format(len(symbols), path))
+        symbol_tables[make_module_id(build_id)] = (os.path.basename(path), symbols)
+    return symbol_tables
+
+
+def format_timestamp(timestamp):
+    seconds, nanoseconds = divmod(timestamp, 10 ** 9)
+    time = datetime.datetime.fromtimestamp(seconds, datetime.timezone.utc)
+    return '{}.{:09d}'.format(time.strftime('%Y-%m-%d %H:%M:%S'), nanoseconds)
+
+
+def decode_stream(records, traces, as_json=False, keywords=None, symbols=None):
+    """
+    Yield the formatted traces of a trace stream, using the given traces (mapped by their GUIDs).
+    If keyword names are given, only the traces with any of these keywords are formatted.
+    If a StreamSymbols is given, it's used to resolve the `{:sym}` pointers of the traces.
+    """
+    for record in records:
+        if record.guid in (INLINE_METADATA_GUID, MODULE_LOAD_GUID):
+            continue
+
+        trace = traces.get(record.guid)
+        if keywords and (trace is None or keywords.isdisjoint(trace.keywords)):
+            continue
+        arguments = {}
+        if trace is None:
+            message = '<unknown trace {}: {} bytes>'.format(record.guid, len(record.data))
+            location = '?'
+            level = '?'
+        else:
+            data = record.data if symbols is None else TraceData(record.data, symbols)
+            try:
+                message = trace.format_message(data)
+                if as_json:
+                    arguments = trace.get_named_arguments(data)
+            except (ValueError, IndexError, StopIteration, struct.error) as e:
+                message = '<bad trace {}: {}>'.format(record.guid, e)
+            location = '{}:{}'.format(trace.file, trace.line)
+            level = trace.level
+
+        if as_json:
+            yield json.dumps({'time': format_timestamp(record.timestamp), 'level': level,
+                              'location': location, 'message': message, 'args': arguments})
+        else:
+            yield '{} {:<11} {} {}'.format(format_timestamp(record.timestamp), level, location, message)
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(description='Decode trace streams written by wpp::FileTraceSink.')
+    parser.add_argument('stream', type=str, help='The path to the trace stream.')
+    parser.add_argument('-m', '--metadata', type=str, action='append', default=[],
+                        help='An ELF file containing the metadata of traces which were not traced inline (can be specified multiple times).')
+    parser.add_argument('-s', '--symbol-store', type=str,
+                        help='A directory of metadata indices, named by the build-ids of their binaries.')
+    parser.add_argument('-y', '--symbols', type=str, action='append', default=[],
+                        help='An ELF file (or its debug file) whose symbols are used to resolve {:sym} pointers, in addition to the symbols of the metadata files (can be specified multiple times).')
+    parser.add_argument('-k', '--keyword', type=str, action='append', default=[],
+                        help='Only decode the traces with the given keyword, such as Network or WPP_FLAG_1 (can be specified multiple times).')
+    parser.add_argument('-j', '--json', action='store_true',
+                        help='Write every trace as a JSON object, including its named arguments.')
+    parser.add_argument('-v', '--verbose', help='Display verbose output (use -vv for debug output).', action='count', default=0)
+    return parser.parse_args()
+
+
+def main():
+    args = parse_arguments()
+    setup_logger(args.verbose)
+
+    with open(args.stream, 'rb') as stream:
+        data = stream.read()
+    header_size, modules = read_stream_header(data)
+    records = list(read_stream(data, header_size))
+    for module in modules:
+        logger.info('Traced module: {}'.format(module.hex()))
+
+    # Records may be traced before the metadata traced by another thread, so all the metadata is
+    # parsed before any trace is decoded.
+    context = MetadataContext()
+    parse_inline_metadata(records, context)
+    traces = {trace.guid: trace for trace in context.get_traces()}
+    if args.symbol_store is not None:
+        traces.update((trace.guid, trace) for trace in load_symbol_store_traces(args.symbol_store, modules))
+    for path in args.metadata:
+        traces.update((trace.guid, trace) for trace in load_elf_traces(path, modules))
+    logger.info('Found {} traces!'.format(len(traces)))
+
+    # The metadata files are usually the traced binaries, so their symbols are used as well
+    symbols = None
+    symbol_tables = load_symbol_tables(args.metadata + args.symbols)
+    if symbol_tables:
+        symbols = StreamSymbols(records, symbol_tables)
+
+    for line in decode_stream(records, traces, args.json, set(args.keyword), symbols):
+        print(line)
+
+    return 0
+
+
+if __name__ == '__main__':
+    exit(main())
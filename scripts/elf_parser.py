@@ -0,0 +1,235 @@
+"""
+Extraction of trace metadata from ELF files built with GCC or Clang.
+
+The metadata records are written to the `.wpp_meta` section as chunks of 32-bit words (see
+`include/wpp/Metadata.h`). Since the linker concatenates the sections of all the object files,
+records of inline functions and templates may appear several times, and are merged here.
+"""
+import bisect
+import struct
+import subprocess
+
+from trace_metadata import MetadataContext, parse_annotation_data
+
+
+ELF_MAGIC = b'\x7fELF'
+METADATA_SECTION = '.wpp_meta'
+METADATA_MAGIC = 0x4d505057  # "WPPM"
+METADATA_CHUNK_WORDS = 24
+METADATA_HEADER_WORDS = 6
+
+SHT_NOTE = 7
+NT_GNU_BUILD_ID = 3
+
+STT_OBJECT = 1
+STT_FUNC = 2
+SHN_UNDEF = 0
+
+
+def is_elf_file(path):
+    with open(path, 'rb') as f:
+        return f.read(len(ELF_MAGIC)) == ELF_MAGIC
+
+
+class ElfFile(object):
+    """
+    A minimal ELF reader, supporting the section headers only.
+    `sections` is a list of (name, type, data) tuples.
+    """
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            data = f.read()
+
+        if data[:4] != ELF_MAGIC:
+            raise ValueError('{} is not an ELF file!'.format(path))
+
+        is_64 = data[4] == 2
+        self.is_64 = is_64
+        self.endian = '<' if data[5] == 1 else '>'
+        if is_64:
+            section_offset, = struct.unpack_from(self.endian + 'Q', data, 0x28)
+            entry_size, entry_count, names_index = struct.unpack_from(self.endian + 'HHH', data, 0x3a)
+            section_format = self.endian + 'IIQQQQIIQQ'
+        else:
+            section_offset, = struct.unpack_from(self.endian + 'I', data, 0x20)
+            entry_size, entry_count, names_index = struct.unpack_from(self.endian + 'HHH', data, 0x2e)
+            section_format = self.endian + 'IIIIIIIIII'
+
+        headers = [struct.unpack_from(section_format, data, section_offset + i * entry_size)
+                   for i in range(entry_count)]
+
+        names = b''
+        if names_index < len(headers):
+            names_header = headers[names_index]
+            names = data[names_header[4]:names_header[4] + names_header[5]]
+
+        self.sections = []
+        for name_offset, section_type, _, _, offset, size, *_ in headers:
+            name = names[name_offset:names.find(b'\0', name_offset)].decode()
+            self.sections.append((name, section_type, data[offset:offset + size]))
+
+    def get_section(self, name):
+        for section_name, _, data in self.sections:
+            if section_name == name:
+                return data
+        return None
+
+    def get_build_id(self):
+        """
+        Get the GNU build-id note, or None if the file has none.
+        """
+        for _, section_type, data in self.sections:
+            if section_type != SHT_NOTE:
+                continue
+
+            position = 0
+            while position + 12 <= len(data):
+                name_size, desc_size, note_type = struct.unpack_from(self.endian + 'III', data, position)
+                name = data[position + 12:position + 12 + name_size]
+                desc_offset = position + 12 + ((name_size + 3) & ~3)
+                if note_type == NT_GNU_BUILD_ID and name == b'GNU\0':
+                    return data[desc_offset:desc_offset + desc_size]
+                position = desc_offset + ((desc_size + 3) & ~3)
+
+        return None
+
+    def get_symbols(self):
+        """
+        Get the defined function and object symbols as (address, size, name) tuples, from the
+        `.symtab` section (or from the `.dynsym` section if the file is stripped).
+        """
+        symbols = self.get_section('.symtab')
+        names = self.get_section('.strtab')
+        if not symbols:
+            symbols = self.get_section('.dynsym')
+            names = self.get_section('.dynstr')
+        if symbols is None or names is None:
+            return []
+
+        entry = struct.Struct(self.endian + ('IBBHQQ' if self.is_64 else 'IIIBBH'))
+        result = []
+        for position in range(0, len(symbols) - entry.size + 1, entry.size):
+            if self.is_64:
+                name, info, _, section, address, size = entry.unpack_from(symbols, position)
+            else:
+                name, address, size, info, _, section = entry.unpack_from(symbols, position)
+            if info & 0xf not in (STT_FUNC, STT_OBJECT) or section == SHN_UNDEF or name >= len(names):
+                continue
+            name = names[name:names.find(b'\0', name)].decode('utf-8', errors='replace')
+            result.append((address, size, name))
+        return result
+
+
+def demangle(names):
+    """
+    Demangle C++ symbol names using c++filt, leaving other names (and all the names if c++filt is
+    not available) as they are.
+    """
+    mangled = sorted({name for name in names if name.startswith('_Z')})
+    demangled = {}
+    if mangled:
+        try:
+            output = subprocess.run(['c++filt'], input='\n'.join(mangled), stdout=subprocess.PIPE,
+                                    check=True, universal_newlines=True).stdout
+            demangled = dict(zip(mangled, output.splitlines()))
+        except (OSError, subprocess.CalledProcessError):
+            pass
+    return [demangled.get(name, name) for name in names]
+
+
+class SymbolTable(object):
+    """
+    The function and object symbols of an ELF file (see ElfFile.get_symbols), used to resolve
+    module-relative addresses. Addresses are resolved by the address ranges of the symbols, so
+    addresses of global objects are resolved as well as addresses of functions.
+    """
+    def __init__(self, elf_file):
+        symbols = sorted(elf_file.get_symbols(), key=lambda symbol: (symbol[0], symbol[2], symbol[1]))
+        # Remove duplicates (such as local symbols of several files), keeping the smallest one
+        unique = []
+        for symbol in symbols:
+            if not unique or (unique[-1][0], unique[-1][2]) != (symbol[0], symbol[2]):
+                unique.append(symbol)
+        names = demangle([name for _, _, name in unique])
+        self._addresses = [address for address, _, _ in unique]
+        self._symbols = [(address, size, name) for (address, size, _), name in zip(unique, names)]
+
+    def __len__(self):
+        return len(self._symbols)
+
+    def describe(self, offset):
+        """
+        Get the symbol containing the given address as `symbol` or `symbol+0x<displacement>`, or
+        None if no symbol contains it.
+        """
+        index = bisect.bisect_right(self._addresses, offset) - 1
+        if index < 0:
+            return None
+        address, size, name = self._symbols[index]
+        displacement = offset - address
+        if displacement == 0:
+            return name
+        if displacement >= size:
+            return None
+        return '{}+{:#x}'.format(name, displacement)
+
+
+def parse_metadata_records(section, endian):
+    """
+    Reassemble the metadata records of the given section data, returning a list of records, where
+    each record is a list of strings.
+    """
+    word = struct.Struct(endian + 'I')
+    chunk = struct.Struct(endian + 'I' * (METADATA_HEADER_WORDS + METADATA_CHUNK_WORDS))
+
+    chunks = {}  # map (record id, chunk index) to chunk data
+    record_info = {}  # map record id to (size, chunk count)
+    position = 0
+    while position + chunk.size <= len(section):
+        # Skip the alignment padding between the chunks
+        if word.unpack_from(section, position)[0] != METADATA_MAGIC:
+            position += word.size
+            continue
+
+        words = chunk.unpack_from(section, position)
+        position += chunk.size
+        _, size, id_low, id_high, chunk_index, chunk_count = words[:METADATA_HEADER_WORDS]
+        data = struct.pack('<' + 'I' * METADATA_CHUNK_WORDS, *words[METADATA_HEADER_WORDS:])
+        record_id = (id_high << 32) | id_low
+
+        if record_info.setdefault(record_id, (size, chunk_count)) != (size, chunk_count):
+            raise Exception('Record {:#x} has conflicting sizes!'.format(record_id))
+        if chunks.setdefault((record_id, chunk_index), data) != data:
+            raise Exception('Record {:#x} has conflicting contents!'.format(record_id))
+
+    records = []
+    for record_id, (size, chunk_count) in record_info.items():
+        try:
+            payload = b''.join(chunks[(record_id, i)] for i in range(chunk_count))[:size]
+        except KeyError:
+            raise Exception('Record {:#x} is incomplete!'.format(record_id))
+
+        record = payload.decode().split('\x00')
+        # Since the payload ends with '\x00', there is an empty string left in the list - remove it.
+        record.pop()
+        records.append(record)
+
+    return records
+
+
+def extract_trace_info(elf_path):
+    """
+    Extract trace information from the metadata section of the given ELF file.
+
+    :type elf_path: str
+    """
+    elf_file = ElfFile(elf_path)
+    section = elf_file.get_section(METADATA_SECTION)
+    if section is None:
+        raise Exception('{} has no {} section!'.format(elf_path, METADATA_SECTION))
+
+    context = MetadataContext()
+    for record in parse_metadata_records(section, elf_file.endian):
+        parse_annotation_data(record, context)
+
+    return context.get_traces()
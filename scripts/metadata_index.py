@@ -0,0 +1,76 @@
+"""
+Reading of metadata indices, written by `WppExtract --index` (see `include/wpp/MetadataIndex.h`).
+
+The index holds the same trace information as the metadata records, after parsing and merging, so
+the traces are built from its tables directly.
+"""
+import struct
+import uuid
+
+from trace_info import TraceInfo
+from trace_items import StructInfo
+
+
+METADATA_INDEX_MAGIC = 0x49505057  # "WPPI"
+METADATA_INDEX_VERSION = 1
+
+_HEADER = struct.Struct('<IHH10I')
+_TRACE = struct.Struct('<16s10I')
+_ARGUMENT = struct.Struct('<3I')
+_STRUCT = struct.Struct('<4I')
+_FIELD = struct.Struct('<4I')
+
+
+def _read_table(data, entry, offset, count):
+    if offset + count * entry.size > len(data):
+        raise ValueError('Metadata index table is out of bounds!')
+    return [entry.unpack_from(data, offset + i * entry.size) for i in range(count)]
+
+
+def parse_metadata_index(data):
+    """
+    Parse the traces of a metadata index.
+
+    :type data: bytes
+    """
+    (magic, version, _, trace_count, trace_offset, argument_count, argument_offset, struct_count,
+     struct_offset, field_count, field_offset, strings_size, strings_offset) = _HEADER.unpack_from(data)
+    if magic != METADATA_INDEX_MAGIC:
+        raise ValueError('Not a metadata index!')
+    if version != METADATA_INDEX_VERSION:
+        raise ValueError('Unsupported metadata index version {}!'.format(version))
+
+    strings = data[strings_offset:strings_offset + strings_size]
+
+    def string(offset):
+        return strings[offset:strings.index(b'\0', offset)].decode()
+
+    arguments = _read_table(data, _ARGUMENT, argument_offset, argument_count)
+    fields = _read_table(data, _FIELD, field_offset, field_count)
+
+    structs = {}
+    for name, size, first_field, count in _read_table(data, _STRUCT, struct_offset, struct_count):
+        struct_fields = [(string(name), offset, size, string(item_type))
+                         for name, offset, size, item_type in fields[first_field:first_field + count]]
+        structs[string(name)] = StructInfo(string(name), size, struct_fields)
+
+    traces = []
+    for entry in _read_table(data, _TRACE, trace_offset, trace_count):
+        guid, file, line, function, flag, level, fmt, args, _, first_argument, count = entry
+        # The index holds the values without the prefixes of the metadata records.
+        general_info = (string(file), str(line), 'FUNC=' + string(function), 'FLAG=' + string(flag),
+                        string(level), string(fmt), string(args))
+        types_info = [string(argument[0]) for argument in arguments[first_argument:first_argument + count]]
+        traces.append(TraceInfo(uuid.UUID(bytes_le=guid), general_info, types_info, structs))
+
+    return traces
+
+
+def read_metadata_index(path):
+    """
+    Read the traces of a metadata index file.
+
+    :type path: str
+    """
+    with open(path, 'rb') as f:
+        return parse_metadata_index(f.read())
@@ -0,0 +1,232 @@
+"""
+Symbolizes stack traces and pointers traced using the `{:stack}` and `{:sym}` formats.
+
+Both are traced as module-relative addresses. Stack trace items contain the build identifiers of
+their modules, while `{:sym}` pointers contain a module index, which is matched with a build
+identifier using the module load records of the trace session. This script matches the build
+identifiers with the given PDB / ELF files, and resolves the addresses to symbol names.
+"""
+import argparse
+import os
+import re
+import struct
+import subprocess
+import sys
+from contextlib import ExitStack
+
+from elf_parser import ElfFile, SymbolTable
+from logger import setup_logger, logger
+
+
+MODULE_ID_SIZE = 20
+MODULE_OFFSET_BITS = 48
+MODULE_OFFSET_MASK = (1 << MODULE_OFFSET_BITS) - 1
+UNKNOWN_MODULE_INDEX = 0xffff
+
+
+class StackTrace(object):
+    """
+    A parsed stack trace item.
+    `modules` is a list of module ids (bytes), and `frames` is a list of (module index, offset)
+    tuples. Frames of unknown modules have a module index of None and an absolute address.
+    """
+    def __init__(self, modules, frames):
+        self.modules = modules
+        self.frames = frames
+
+
+def parse_stack_trace(data):
+    """
+    Parse the data of a stack trace item (without the size prefix).
+
+    :type data: bytes
+    """
+    frame_count, module_count = struct.unpack_from('<BB', data)
+    position = 2
+    modules = []
+    for _ in range(module_count):
+        modules.append(data[position:position + MODULE_ID_SIZE])
+        position += MODULE_ID_SIZE
+
+    frames = []
+    for (frame,) in struct.iter_unpack('<Q', data[position:position + frame_count * 8]):
+        module_index = frame >> MODULE_OFFSET_BITS
+        if module_index == UNKNOWN_MODULE_INDEX:
+            module_index = None
+        frames.append((module_index, frame & MODULE_OFFSET_MASK))
+
+    return StackTrace(modules, frames)
+
+
+def make_module_id(raw_id):
+    """
+    Pad or truncate a raw build identifier to the size used by the traces.
+    """
+    return raw_id[:MODULE_ID_SIZE].ljust(MODULE_ID_SIZE, b'\0')
+
+
+class ElfModule(object):
+    """
+    An ELF file, symbolized using its symbol table (so addresses of global objects are resolved as
+    well as addresses of functions). Source locations are resolved using addr2line.
+    """
+    def __init__(self, path):
+        self.path = path
+        elf_file = ElfFile(path)
+        build_id = elf_file.get_build_id()
+        if build_id is None:
+            raise ValueError('{} has no build-id!'.format(path))
+        self.module_id = make_module_id(build_id)
+        self.symbols = SymbolTable(elf_file)
+
+    def symbolize(self, offset):
+        symbol = self.symbols.describe(offset)
+        if symbol is None:
+            raise ValueError('No symbol contains {:#x}'.format(offset))
+        output = subprocess.check_output(['addr2line', '-e', self.path, hex(offset)])
+        return '{} ({})'.format(symbol, output.decode().strip())
+
+
+class PdbModule(object):
+    """
+    A PDB file, symbolized using DbgHelp.
+    """
+    def __init__(self, path, handle, exit_stack):
+        from pdb_parser import load_module
+        import dbgHelp
+
+        self.path = path
+        self._handle = handle
+        self._base_address = exit_stack.enter_context(load_module(handle, path))
+        info = dbgHelp.SymGetModuleInfo64(handle, self._base_address)
+        self.module_id = make_module_id(bytes(info.PdbSig70) + struct.pack('<I', info.PdbAge))
+
+    def symbolize(self, offset):
+        import dbgHelp
+
+        name, displacement = dbgHelp.SymFromAddr(self._handle, self._base_address + offset)
+        return '{}+{:#x}'.format(name, displacement)
+
+
+def describe_address(modules, module_id, offset):
+    """
+    Describe a module-relative address, using the symbols of the module if they are available.
+
+    :param modules: A mapping between module ids and their modules.
+    """
+    module = modules.get(module_id)
+    if module is None:
+        return '<{}>+{:#x}'.format(module_id.hex(), offset)
+
+    try:
+        return '{}!{}'.format(os.path.basename(module.path), module.symbolize(offset))
+    except Exception:
+        logger.debug('Failed to symbolize %#x in %s', offset, module.path, exc_info=True)
+        return '{}+{:#x}'.format(os.path.basename(module.path), offset)
+
+
+def format_stack_trace(stack_trace, modules):
+    """
+    Format a stack trace, a frame per line.
+
+    :param modules: A mapping between module ids and their modules.
+    """
+    lines = []
+    for frame_index, (module_index, offset) in enumerate(stack_trace.frames):
+        if module_index is None:
+            description = '{:#x}'.format(offset)
+        else:
+            description = describe_address(modules, stack_trace.modules[module_index], offset)
+        lines.append('#{} {}'.format(frame_index, description))
+    return '\n'.join(lines)
+
+
+# The formats of the module load records, `{:sym}` pointers and stack traces in formatted traces
+MODULE_LOAD_RECORD = re.compile(r'WPP module (\d+) loaded: ([0-9a-fA-F ]+)')
+SYMBOL_VALUE = re.compile(r'sym:([0-9a-fA-F]{16})')
+STACK_VALUE = re.compile(r'stack:([0-9a-fA-F ]+)')
+
+
+def parse_hex(value):
+    return bytes.fromhex(re.sub('[^0-9a-fA-F]', '', value))
+
+
+def symbolize_log(lines, modules):
+    """
+    Symbolize the `{:sym}` pointers and stack traces in formatted traces, yielding the new lines.
+    Module indices are matched using the module load records anywhere in the log, as a load record
+    is traced right after the first trace referencing the module. Only logs of a single process
+    are supported, as module indices are assigned by each process.
+
+    :param modules: A mapping between module ids and their modules.
+    """
+    lines = list(lines)
+    module_ids = {}
+    for line in lines:
+        match = MODULE_LOAD_RECORD.search(line)
+        if match:
+            module_ids[int(match.group(1))] = make_module_id(parse_hex(match.group(2)))
+
+    def replace_symbol(match):
+        value = int(match.group(1), 16)
+        module_index, offset = value >> MODULE_OFFSET_BITS, value & MODULE_OFFSET_MASK
+        if module_index == UNKNOWN_MODULE_INDEX:
+            return '{:#x}'.format(offset)
+        if module_index not in module_ids:
+            return '<module {}>+{:#x}'.format(module_index, offset)
+        return describe_address(modules, module_ids[module_index], offset)
+
+    def replace_stack(match):
+        return '\n' + format_stack_trace(parse_stack_trace(parse_hex(match.group(1))), modules)
+
+    for line in lines:
+        line = SYMBOL_VALUE.sub(replace_symbol, line)
+        yield STACK_VALUE.sub(replace_stack, line)
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(description='Symbolize stack traces traced with the {:stack} format.')
+    parser.add_argument('stacks', type=str, nargs='*',
+                        help='Hex strings of traced stacks (read from stdin if not specified).')
+    parser.add_argument('-l', '--log', type=str,
+                        help='A formatted trace log, whose {:sym} pointers and stacks will be symbolized.')
+    parser.add_argument('-m', '--module', type=str, action='append', default=[],
+                        help='A PDB or ELF file used for symbolization (can be specified multiple times).')
+    parser.add_argument('-v', '--verbose', help='Display verbose output (use -vv for debug output).', action='count', default=0)
+    return parser.parse_args()
+
+
+def main():
+    args = parse_arguments()
+    setup_logger(args.verbose)
+
+    with ExitStack() as exit_stack:
+        modules = {}
+        handle = None
+        for path in args.module:
+            if path.lower().endswith('.pdb'):
+                if handle is None:
+                    from pdb_parser import initialize_dbghelp
+                    handle = exit_stack.enter_context(initialize_dbghelp())
+                module = PdbModule(path, handle, exit_stack)
+            else:
+                module = ElfModule(path)
+            logger.info('Loaded %s (%s)', path, module.module_id.hex())
+            modules[module.module_id] = module
+
+        if args.log is not None:
+            with open(args.log) as log:
+                for line in symbolize_log(log.read().splitlines(), modules):
+                    print(line)
+            return 0
+
+        stacks = args.stacks or sys.stdin.read().split()
+        for stack in stacks:
+            print(format_stack_trace(parse_stack_trace(parse_hex(stack)), modules))
+            print()
+
+    return 0
+
+
+if __name__ == '__main__':
+    exit(main())
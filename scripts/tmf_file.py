@@ -1,6 +1,24 @@
 import os
+import uuid
 
 from logger import logger
+from trace_info import TraceInfo
+
+
+# The message GUID of the module load records (wpp::MODULE_LOAD_GUID)
+MODULE_LOAD_GUID = uuid.UUID('4d505057-0001-3000-8000-5750504d4f44')
+
+
+def make_module_load_trace():
+    """
+    Make the trace information of the module load records. They're traced without a call site, so
+    they're added to every TMF output - legacy logs need them to resolve `{:sym}` pointers using
+    symbolize.py.
+    """
+    return TraceInfo(MODULE_LOAD_GUID,
+                     ('wpp/SymbolItems.h', '0', 'FUNC=wpp::internal::traceModuleLoads', 'FLAG=1',
+                      'LEVEL=TraceLevel::None', 'WPP module {} loaded: {}', 'index, id'),
+                     ['wpp::UInt16Item', 'wpp::HexBufferItem'], {})
 
 
 def write_tmf_trace(tmf_file, pdb_path, trace):
@@ -43,6 +61,9 @@ def generate_tmf_file(output_directory, pdb_path, trace):
     """
     output_path = os.path.join(output_directory, '{}.tmf'.format(trace.guid))
     with logger.set_trace_context(trace):
+        if not trace.supports_legacy_format:
+            logger.warning('The trace arguments are not supported by legacy tmf files, skipping...')
+            return
         logger.info('Generating trace file: "%s"', output_path)
         with open(output_path, 'w') as tmf_file:
             write_tmf_trace(tmf_file, pdb_path, trace)
@@ -62,4 +83,7 @@ def generate_tmf_file_for_multiple_traces(output_path, pdb_path, traces):
     with open(output_path, 'w') as tmf_file:
         for trace in traces:
             with logger.set_trace_context(trace):
+                if not trace.supports_legacy_format:
+                    logger.warning('The trace arguments are not supported by legacy tmf files, skipping...')
+                    continue
                 write_tmf_trace(tmf_file, pdb_path, trace)
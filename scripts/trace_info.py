@@ -1,63 +1,166 @@
 import json
-import os
+import re
 import string
 
 from logger import logger
-from trace_items import LegacyTraceItem, make_trace_item_from_name
+from trace_items import make_trace_item_from_name
+
+
+# A name in the keywords expression of a trace (followed by `(` or `<` for functions and templates,
+# such as `wpp::allOf(...)`), or an integer literal.
+_KEYWORD_TOKEN = re.compile(r'(?P<name>[A-Za-z_]\w*(?:\s*::\s*[A-Za-z_]\w*)*)(?P<call>\s*[(<])?|'
+                            r'(?P<number>\d\w*)')
+
+
+def get_keyword_names(flag):
+    """
+    Get the keyword names of a trace from its keywords expression, as written in the trace macro.
+    Keywords are expected to be named constants (such as `Keywords::Network | Keywords::Disk`), and
+    their names are unqualified. Integer literals are named as in the legacy WPP flag definitions,
+    by their value (such as `WPP_FLAG_1`).
+    """
+    names = []
+    for match in _KEYWORD_TOKEN.finditer(flag):
+        if match.group('number'):
+            try:
+                names.append('WPP_FLAG_{}'.format(int(match.group('number').rstrip('uUlL'), 0)))
+            except ValueError:
+                pass
+        elif not match.group('call'):
+            names.append(match.group('name').split('::')[-1].strip())
+    return names
 
 
 class TraceInfo(object):
     """
     This class represents a single trace information.
     """
-    def __init__(self, guid, general_info, types_info):
+    def __init__(self, guid, general_info, types_info, structs):
         self.guid = guid
         self.file, self.line, func, flag, level, self.format, self.args = general_info
         self.func = func[len('FUNC='):]
         self.flag = flag[len('FLAG='):]
+        self.keywords = get_keyword_names(self.flag)
         if self.flag.isdigit():
             self.flag = 'WPP_FLAG_' + self.flag
         self.level = level.split('TraceLevel::')[-1]
-        self.arg_types = tuple(make_trace_item_from_name(t) for t in types_info)
+        self.arg_types = tuple(make_trace_item_from_name(t, structs) for t in types_info)
+        self.fields, self.arg_names = parse_format_fields(self.format)
+        # Every argument is traced once, and is parsed using the format of its first reference
+        self.arg_format_specs = [None] * len(self.arg_types)
+        for _, index, format_spec in reversed(self.fields):
+            if index is not None:
+                self.arg_format_specs[index] = format_spec
     
     @property
     def file_name(self):
-        return os.path.basename(self.file)
+        return self.file[self._get_name_start():]
     
     @property
     def dir_name(self):
-        return os.path.dirname(self.file)
+        return self.file[:max(self._get_name_start() - 1, 0)]
+
+    def _get_name_start(self):
+        # The file may have been traced on another platform, so both separators are supported
+        return max(self.file.rfind('/'), self.file.rfind('\\')) + 1
     
     @property
     def supports_legacy_format(self):
-        return all(isinstance(arg, LegacyTraceItem) for arg in self.arg_types)
+        return all(arg.supports_legacy_format for arg in self.arg_types)
     
     def get_legacy_wpp_format(self):
         """
         Get a legacy wpp-style format string for the given trace information. 
         """
-        # Escape % characters before starting to generate the new format
-        escaped = self.format.replace('%', '%%')
+        assert len(self.arg_names) == len(self.arg_types), 'Missing format specifiers!'
+
+        # Legacy ids 0..9 are reserved
+        arg_ids = []
+        arg_id = 10
+        for arg_type in self.arg_types:
+            arg_ids.append(arg_id)
+            arg_id += len(arg_type.get_legacy_item_names())
+
         result = '%0 '
-        parts = string.Formatter().parse(escaped)
-        i = 0
-        for part in parts:
-            literal_text, field_name, format_spec, conversion = part
-            assert not field_name, 'Found unexpected field name in format'
-            assert not conversion, 'Found unexpected conversion in format'
-            result += literal_text
-            if format_spec is not None:
-                result += '%{}!{}!'.format(i + 10, self.arg_types[i].get_legacy_format(format_spec))
-                i += 1
-        
-        assert i == len(self.arg_types), 'Missing format specifiers!'
+        for literal_text, index, format_spec in self.fields:
+            # Escape % characters, as they are used by the legacy inserts
+            result += literal_text.replace('%', '%%')
+            if index is not None:
+                result += self.arg_types[index].get_legacy_insert(format_spec, arg_ids[index])
 
         # Use json dumps for string escaping
         return json.dumps(result)
     
+    def decode_arguments(self, data):
+        """
+        Decode the arguments of the trace from the data of its trace items, returning the values
+        formatted by their first references and the offsets of the arguments.
+        """
+        values = []
+        offsets = []
+        offset = 0
+        for arg_type, format_spec in zip(self.arg_types, self.arg_format_specs):
+            offsets.append(offset)
+            value, offset = arg_type.decode(data, offset, format_spec)
+            values.append(value)
+        return values, offsets
+
+    def format_message(self, data):
+        """
+        Format the trace message from the data of its trace items.
+        """
+        values, offsets = self.decode_arguments(data)
+        result = ''
+        for literal_text, index, format_spec in self.fields:
+            result += literal_text
+            if index is None:
+                continue
+            if format_spec == self.arg_format_specs[index]:
+                result += values[index]
+            else:
+                result += self.arg_types[index].decode(data, offsets[index], format_spec)[0]
+        return result
+
+    def get_named_arguments(self, data):
+        """
+        Get the formatted values of the named arguments of the trace (such as `{user}`).
+        """
+        values, _ = self.decode_arguments(data)
+        return {name: value for name, value in zip(self.arg_names, values) if name is not None}
+
     @property
     def legacy_wpp_arg_types(self):
         """
         Get the legacy WPP item name for all the arguments of the current trace.
         """
-        return [arg.get_legacy_item_name() for arg in self.arg_types]
+        return [name for arg in self.arg_types for name in arg.get_legacy_item_names()]
+
+
+def parse_format_fields(fmt):
+    """
+    Parse a format string into a list of (literal text, argument index, format spec) parts, and the
+    names of the arguments (None for unnamed arguments). The argument index of a part without a
+    field is None.
+
+    Fields reference the next argument (`{}`), a positional argument (`{0}`) or a named argument
+    (`{name}`), which is the next argument the first time the name is used. This matches the
+    argument mapping of the c++ format parser.
+    """
+    fields = []
+    arg_names = []
+    for literal_text, field_name, format_spec, conversion in string.Formatter().parse(fmt):
+        assert not conversion, 'Found unexpected conversion in format'
+        if field_name is None:
+            fields.append((literal_text, None, None))
+            continue
+
+        if field_name.isdigit():
+            index = int(field_name)
+            arg_names.extend([None] * (index + 1 - len(arg_names)))
+        elif field_name and field_name in arg_names:
+            index = arg_names.index(field_name)
+        else:
+            index = len(arg_names)
+            arg_names.append(field_name or None)
+        fields.append((literal_text, index, format_spec))
+    return fields, arg_names
@@ -1,13 +1,100 @@
+import re
+import struct
+import uuid
+
 from logger import logger
+from type_names import get_base_name, get_template_args
+
+
+_FORMAT_SPEC = re.compile(r'(?:(?P<fill>[^{}])?(?P<align>[<>=^]))?(?P<sign>[-+ ])?(?P<alternate>#)?'
+                          r'(?P<zero>0)?(?P<width>\d+)?(?P<grouping>[,_])?(?:\.(?P<precision>\d+))?'
+                          r'(?P<type>.*)', re.DOTALL)
+
+
+class FormatSpec(object):
+    """
+    A format specification, in the Python/fmt syntax used by the c++ formats:
+        [[fill]align][sign][#][0][width][grouping][.precision]type
+    Only the type selects the trace item - the rest of the specification (the layout) is only
+    written to the trace metadata, and is applied when the trace is formatted.
+    """
+    def __init__(self, spec):
+        match = _FORMAT_SPEC.fullmatch(spec)
+        self.fill = match.group('fill')
+        self.align = match.group('align')
+        self.sign = match.group('sign')
+        self.alternate = match.group('alternate') is not None
+        self.zero = match.group('zero') is not None
+        self.width = int(match.group('width')) if match.group('width') else None
+        self.grouping = match.group('grouping')
+        self.precision = int(match.group('precision')) if match.group('precision') else None
+        self.type = match.group('type')
+        self.layout = spec[:len(spec) - len(self.type)]
+
+
+class TraceData(bytes):
+    """
+    The data of a single trace, with the resolver of its `{:sym}` pointers and `{:stack}` frames (if
+    there's one). The resolver has `describe(module_index, offset)` and
+    `describe_module(module_id, offset)` methods, returning the symbol containing the address or
+    None.
+    """
+    def __new__(cls, data, symbols=None):
+        result = super(TraceData, cls).__new__(cls, data)
+        result.symbols = symbols
+        return result
+
+
+def _pad(text, format_spec, default_align='<'):
+    """
+    Pad formatted text according to the width of the format specification.
+    Numbers which are formatted as text should be right-aligned by default.
+    """
+    spec = FormatSpec(format_spec)
+    return format(text, (spec.fill or '') + (spec.align or default_align) + str(spec.width or ''))
+
+
+def _format_integer(value, format_spec):
+    """
+    Format an integer using a c++ integer format specification.
+    """
+    spec = FormatSpec(format_spec)
+    # The size prefix of size_t and ptrdiff_t formats only selects the trace item
+    int_type = spec.type[1:] if spec.type.startswith('z') else spec.type
+    if int_type == 'B':
+        # Python has no uppercase binary format
+        return format(value, spec.layout + 'b').replace('0b', '0B')
+    return format(value, spec.layout + int_type)
+
+
+def _format_bytes(data):
+    return ' '.join('{:02x}'.format(byte) for byte in data)
+
 
 class TraceItem(object):
-    pass
+    @property
+    def supports_legacy_format(self):
+        """
+        Whether the trace item can be converted to "legacy" tmf items.
+        """
+        return False
+
+    def decode(self, data, offset, format_spec):
+        """
+        Decode the trace item at the given offset of the trace data, formatted using the given c++
+        format specification. Returns the formatted value and the offset following the item.
+        """
+        raise NotImplementedError('{} does not support decoding!'.format(type(self).__name__))
 
 
 class LegacyTraceItem(TraceItem):
     """
     The base class for all trace items supporting conversion to "legacy" tmf files.
     """
+    @property
+    def supports_legacy_format(self):
+        return True
+
     @classmethod
     def get_legacy_format(cls, format_spec):
         """
@@ -22,7 +109,62 @@ class LegacyTraceItem(TraceItem):
         """
         raise NotImplementedError()
 
+    def get_legacy_item_names(self):
+        """
+        Get the names of all the legacy wpp items used to parse the trace item.
+        """
+        return [self.get_legacy_item_name()]
+
+    def get_legacy_insert(self, format_spec, arg_id):
+        """
+        Get the legacy format insert (for example `%10!08x!`) for the trace item, where `arg_id` is
+        the id of the first legacy item used by the trace item.
+        """
+        spec = FormatSpec(format_spec)
+        return '%{}!{}{}!'.format(arg_id, self._get_legacy_flags(spec), self.get_legacy_format(spec.type))
+
+    # How the layout of the format specification is converted to printf flags: None if the legacy
+    # format doesn't support it, 'number' or 'text' (which is left-aligned by default).
+    _LEGACY_LAYOUT = None
+
+    def _get_legacy_layout(self, spec):
+        return self._LEGACY_LAYOUT
+
+    def _get_legacy_flags(self, spec):
+        """
+        Convert the layout of the format specification to printf flags, width and precision.
+        Options which can't be represented by printf are ignored.
+        """
+        if not spec.layout:
+            return ''
+
+        layout = self._get_legacy_layout(spec)
+        if layout is None:
+            logger.warning('{} does not support the legacy format layout "{}", ignoring it'.format(
+                type(self).__name__, spec.layout))
+            return ''
+
+        flags = ''
+        if spec.align == '<' or (spec.align is None and layout == 'text' and spec.width):
+            flags += '-'
+        if spec.align == '^' or spec.grouping or (spec.fill not in (None, ' ', '0') or
+                                                  (spec.fill == '0' and spec.align != '=')):
+            logger.warning('Got unsupported legacy format layout "{}", ignoring some of it'.format(spec.layout))
+        flags += {'+': '+', ' ': ' '}.get(spec.sign, '')
+        if spec.alternate:
+            flags += '#'
+        if spec.zero or (spec.fill == '0' and spec.align == '='):
+            flags += '0'
+        if spec.width:
+            flags += str(spec.width)
+        if spec.precision is not None:
+            flags += '.{}'.format(spec.precision)
+        return flags
+
+
 class IntegralTraceItem(LegacyTraceItem):
+    _LEGACY_LAYOUT = 'number'
+
     @classmethod
     def get_legacy_format(cls, format_spec):
         default_sign_specifier = 'd' if cls._IS_SIGNED else 'u'
@@ -48,14 +190,21 @@ class IntegralTraceItem(LegacyTraceItem):
             return 'h'
         if size == 1:
             return 'hh'
-        if size == '?':  # architecture dependant
-            return 'I'
         raise ValueError('Bad integer type size!')
     
     @classmethod
     def get_legacy_item_name(cls):
         return cls._LEGACY_ITEM_NAME
 
+    def decode(self, data, offset, format_spec):
+        code = {1: 'b', 2: 'h', 4: 'i', 8: 'q'}[self._BYTE_SIZE]
+        (value,) = struct.unpack_from('<' + (code if self._IS_SIGNED else code.upper()), data, offset)
+        return self._format_value(value, format_spec), offset + self._BYTE_SIZE
+
+    @classmethod
+    def _format_value(cls, value, format_spec):
+        return _format_integer(value, format_spec)
+
 
 class SignedIntegralTraceItem(IntegralTraceItem):
     _IS_SIGNED = True
@@ -106,8 +255,9 @@ class UInt64Item(UnsignedIntegralTraceItem):
     _LEGACY_ITEM_NAME = 'ItemULongLong'
 
 class SizeTItem(UnsignedIntegralTraceItem):
-    _BYTE_SIZE = '?'
-    _LEGACY_ITEM_NAME = 'ItemPtr'
+    # Pointer-sized values are always traced as 64-bit values
+    _BYTE_SIZE = 8
+    _LEGACY_ITEM_NAME = 'ItemULongLong'
 
     @classmethod
     def get_legacy_format(cls, format_spec):
@@ -116,8 +266,9 @@ class SizeTItem(UnsignedIntegralTraceItem):
         return super(SizeTItem, cls).get_legacy_format(format_spec)
 
 class PtrDiffItem(SignedIntegralTraceItem):
-    _BYTE_SIZE = '?'
-    _LEGACY_ITEM_NAME = 'ItemPtr'
+    # Pointer-sized values are always traced as 64-bit values
+    _BYTE_SIZE = 8
+    _LEGACY_ITEM_NAME = 'ItemLongLong'
 
     @classmethod
     def get_legacy_format(cls, format_spec):
@@ -135,7 +286,18 @@ class CharItem(SignedIntegralTraceItem):
             return 'c'
         return super(CharItem, cls).get_legacy_format(format_spec)
 
+    def _get_legacy_layout(self, spec):
+        return 'text' if spec.type in ('c', '') else 'number'
+
+    @classmethod
+    def _format_value(cls, value, format_spec):
+        spec = FormatSpec(format_spec)
+        if spec.type in ('c', ''):
+            return format(bytes([value & 0xff]).decode('latin-1'), spec.layout)
+        return _format_integer(value, format_spec)
+
 class WCharItem(SignedIntegralTraceItem):
+    # Wide characters are always traced as UTF-16 code units
     _BYTE_SIZE = 2
     _LEGACY_ITEM_NAME = 'ItemShort'
     
@@ -145,18 +307,38 @@ class WCharItem(SignedIntegralTraceItem):
             return 'c'
         return super(WCharItem, cls).get_legacy_format(format_spec)
 
+    def _get_legacy_layout(self, spec):
+        return 'text' if spec.type in ('c', '') else 'number'
+
+    @classmethod
+    def _format_value(cls, value, format_spec):
+        spec = FormatSpec(format_spec)
+        if spec.type in ('c', ''):
+            return format(chr(value & 0xffff), spec.layout)
+        return _format_integer(value, format_spec)
+
 class PointerItem(LegacyTraceItem):
+    """
+    Pointers are always traced as 64-bit values, so they are printed as 64-bit integers instead of
+    using the architecture dependant ItemPtr.
+    """
     @classmethod
     def get_legacy_format(cls, format_spec):
         if format_spec in ('', 'p'):
-            return 'p'
+            return '016I64X'
         return super(PointerItem, cls).get_legacy_format(format_spec)
     
     @classmethod
     def get_legacy_item_name(cls):
-        return 'ItemPtr'
+        return 'ItemULongLong'
+
+    def decode(self, data, offset, format_spec):
+        (value,) = struct.unpack_from('<Q', data, offset)
+        return _pad('0x{:x}'.format(value), format_spec, '>'), offset + 8
 
 class StringItem(LegacyTraceItem):
+    _LEGACY_LAYOUT = 'text'
+
     @classmethod
     def get_legacy_format(cls, format_spec):
         if format_spec in ('', 's'):
@@ -167,7 +349,19 @@ class StringItem(LegacyTraceItem):
     def get_legacy_item_name(cls):
         return 'ItemString'
 
+    def decode(self, data, offset, format_spec):
+        end = data.find(b'\0', offset)
+        if end == -1:
+            raise ValueError('Unterminated string!')
+        value = data[offset:end].decode('utf-8', errors='replace')
+        return format(value, FormatSpec(format_spec).layout), end + 1
+
 class WStringItem(LegacyTraceItem):
+    """
+    Wide strings are always traced as null-terminated UTF-16 strings.
+    """
+    _LEGACY_LAYOUT = 'text'
+
     @classmethod
     def get_legacy_format(cls, format_spec):
         if format_spec in ('', 's'):
@@ -178,6 +372,15 @@ class WStringItem(LegacyTraceItem):
     def get_legacy_item_name(cls):
         return 'ItemWString'
 
+    def decode(self, data, offset, format_spec):
+        end = offset
+        while data[end:end + 2] != b'\0\0':
+            if end + 2 > len(data):
+                raise ValueError('Unterminated wide string!')
+            end += 2
+        value = data[offset:end].decode('utf-16-le', errors='replace')
+        return format(value, FormatSpec(format_spec).layout), end + 2
+
 class GuidItem(LegacyTraceItem):
     @classmethod
     def get_legacy_format(cls, format_spec):
@@ -189,6 +392,9 @@ class GuidItem(LegacyTraceItem):
     def get_legacy_item_name(cls):
         return 'ItemGuid'
 
+    def decode(self, data, offset, format_spec):
+        return _pad(str(uuid.UUID(bytes_le=bytes(data[offset:offset + 16]))), format_spec), offset + 16
+
 class HexBufferItem(LegacyTraceItem):
     @classmethod
     def get_legacy_format(cls, format_spec):
@@ -198,17 +404,118 @@ class HexBufferItem(LegacyTraceItem):
     def get_legacy_item_name(cls):
         return 'ItemHEXBytes'
 
-class HexDumpItem(LegacyTraceItem):
+    def decode(self, data, offset, format_spec):
+        # The data is prefixed by its size
+        (size,) = struct.unpack_from('<H', data, offset)
+        offset += 2
+        if offset + size > len(data):
+            raise ValueError('Truncated buffer!')
+        return _pad(self._format_data(data[offset:offset + size]), format_spec), offset + size
+
+    @classmethod
+    def _format_data(cls, data):
+        return _format_bytes(data)
+
+class StackItem(HexBufferItem):
+    """
+    A captured call stack, traced as a size followed by the data: the frame count, the module
+    count, the build-ids of the modules and the frames (each a module index and an offset).
+    The frames are printed as `#0 module!symbol, #1 ...` if the trace data has symbols (see
+    TraceData). Otherwise (and in legacy tmf files) the data is printed as hex (prefixed by
+    `stack:`), which can be symbolized using symbolize.py.
+    """
+    MODULE_ID_SIZE = 20
+    MODULE_OFFSET_BITS = 48
+    UNKNOWN_MODULE_INDEX = 0xffff
+
+    def get_legacy_insert(self, format_spec, arg_id):
+        return 'stack:' + super(StackItem, self).get_legacy_insert(format_spec, arg_id)
+
+    def decode(self, data, offset, format_spec):
+        symbols = getattr(data, 'symbols', None)
+        (size,) = struct.unpack_from('<H', data, offset)
+        stack = data[offset + 2:offset + 2 + size]
+        if symbols is None or len(stack) < 2 or size != len(stack) or \
+                size != 2 + stack[1] * self.MODULE_ID_SIZE + stack[0] * 8:
+            return super(StackItem, self).decode(data, offset, format_spec)
+
+        frame_count, module_count = stack[0], stack[1]
+        modules = [stack[2 + i * self.MODULE_ID_SIZE:2 + (i + 1) * self.MODULE_ID_SIZE]
+                   for i in range(module_count)]
+        frames = struct.unpack_from('<{}Q'.format(frame_count), stack,
+                                    2 + module_count * self.MODULE_ID_SIZE)
+        descriptions = []
+        for frame in frames:
+            module_index = frame >> self.MODULE_OFFSET_BITS
+            module_offset = frame & ((1 << self.MODULE_OFFSET_BITS) - 1)
+            if module_index == self.UNKNOWN_MODULE_INDEX or module_index >= module_count:
+                description = '{:#x}'.format(module_offset)
+            else:
+                module = modules[module_index]
+                description = symbols.describe_module(module, module_offset)
+                if description is None:
+                    description = '<{}>+{:#x}'.format(module.hex(), module_offset)
+            descriptions.append('#{} {}'.format(len(descriptions), description))
+        return _pad('stack: ' + ', '.join(descriptions), format_spec), offset + 2 + size
+
+    @classmethod
+    def _format_data(cls, data):
+        return 'stack:' + _format_bytes(data)
+
+
+class SymbolItem(LegacyTraceItem):
+    """
+    A pointer traced as a module index and an offset.
+    It's printed as `module!symbol` if the trace data has the symbols of the module (see TraceData).
+    Otherwise (and in legacy tmf files) the value is printed as hex (prefixed by `sym:`), which can
+    be symbolized using symbolize.py and the module load records in the same trace session.
+    """
+    MODULE_OFFSET_BITS = 48
+
     @classmethod
     def get_legacy_format(cls, format_spec):
-        return 's'
-    
+        return '016I64X'
+
+    @classmethod
+    def get_legacy_item_name(cls):
+        return 'ItemULongLong'
+
+    def get_legacy_insert(self, format_spec, arg_id):
+        return 'sym:' + super(SymbolItem, self).get_legacy_insert(format_spec, arg_id)
+
+    def decode(self, data, offset, format_spec):
+        (value,) = struct.unpack_from('<Q', data, offset)
+        symbols = getattr(data, 'symbols', None)
+        text = None
+        if symbols is not None:
+            text = symbols.describe(value >> self.MODULE_OFFSET_BITS,
+                                    value & ((1 << self.MODULE_OFFSET_BITS) - 1))
+        if text is None:
+            text = 'sym:{:016X}'.format(value)
+        return _pad(text, format_spec), offset + 8
+
+
+class HexDumpItem(HexBufferItem):
     @classmethod
     def get_legacy_item_name(cls):
         return 'ItemHEXDump'
 
 
+class WHexBufferItem(HexBufferItem):
+    """
+    A wide string traced as hex, whose data is always UTF-16.
+    """
+
+
+class WHexDumpItem(HexDumpItem):
+    """
+    A wide string traced as a hex dump, whose data is always UTF-16.
+    """
+
+
 class FloatingPointItem(LegacyTraceItem):
+    _LEGACY_LAYOUT = 'number'
+
     @classmethod
     def get_legacy_format(cls, format_spec):
         if not format_spec:
@@ -217,6 +524,18 @@ class FloatingPointItem(LegacyTraceItem):
             return super(FloatingPointItem, cls).get_legacy_format(format_spec)
         return format_spec
 
+    def decode(self, data, offset, format_spec):
+        code = 'f' if isinstance(self, FloatItem) else 'd'
+        (value,) = struct.unpack_from('<' + code, data, offset)
+        spec = FormatSpec(format_spec)
+        if spec.type == 'a':
+            result = _pad(value.hex(), format_spec, '>')
+        elif spec.type == 'A':
+            result = _pad(value.hex().upper(), format_spec, '>')
+        else:
+            result = format(value, format_spec)
+        return result, offset + struct.calcsize(code)
+
 
 class FloatItem(FloatingPointItem):
     @classmethod
@@ -231,10 +550,188 @@ class DoubleItem(FloatingPointItem):
 
 
 class LongDoubleItem(FloatingPointItem):
+    """
+    Long doubles are always traced as IEEE-754 binary64 values.
+    """
     @classmethod
     def get_legacy_item_name(cls):
-        return 'ItemLongDouble'
+        return 'ItemDouble'
+
+
+
+# Legacy items used to skip struct padding, by their size
+_LEGACY_PADDING_ITEMS = ((8, 'ItemLongLong'), (4, 'ItemLong'), (2, 'ItemShort'), (1, 'ItemChar'))
+
+
+def _get_legacy_padding_items(size):
+    """
+    Get legacy item names that consume exactly `size` bytes, used to skip struct padding.
+    """
+    result = []
+    for item_size, item_name in _LEGACY_PADDING_ITEMS:
+        while size >= item_size:
+            result.append(item_name)
+            size -= item_size
+    return result
+
+
+class StructInfo(object):
+    """
+    The layout of a struct registered using WPP_DEFINE_STRUCT_ITEM.
+    `fields` is a list of (name, offset, size, item type name) tuples.
+    """
+    def __init__(self, name, size, fields):
+        self.name = name
+        self.size = size
+        self.fields = fields
+
+    def __eq__(self, other):
+        return (self.name, self.size, self.fields) == (other.name, other.size, other.fields)
+
+    def __ne__(self, other):
+        return not self == other
+
+
+class StructItem(LegacyTraceItem):
+    """
+    A struct traced as a single copy of its bytes, printed as `{field1=..., field2=...}`.
+    """
+    def __init__(self, struct_info, structs):
+        self.struct_info = struct_info
+        self.fields = [(name, offset, size, make_trace_item_from_name(item_name, structs))
+                       for name, offset, size, item_name in sorted(struct_info.fields, key=lambda f: f[1])]
+
+    def _get_legacy_layout(self):
+        """
+        Yield (field name, field item, legacy item names) for each field in the struct.
+        Struct padding and fields missing from the descriptor are yielded with a None name.
+        """
+        position = 0
+        for name, offset, size, item in self.fields:
+            if offset < position:
+                raise NotImplementedError('Struct {} has overlapping fields!'.format(self.struct_info.name))
+            if offset > position:
+                yield None, None, _get_legacy_padding_items(offset - position)
+            yield name, item, item.get_legacy_item_names()
+            position = offset + size
+
+        if position < self.struct_info.size:
+            yield None, None, _get_legacy_padding_items(self.struct_info.size - position)
+
+    @property
+    def supports_legacy_format(self):
+        return all(item.supports_legacy_format for _, _, _, item in self.fields)
+
+    def get_legacy_item_names(self):
+        return [item_name for _, _, item_names in self._get_legacy_layout() for item_name in item_names]
+
+    def decode(self, data, offset, format_spec):
+        if offset + self.struct_info.size > len(data):
+            raise ValueError('Truncated struct {}!'.format(self.struct_info.name))
+
+        fields = []
+        for name, field_offset, _, item in self.fields:
+            value, _ = item.decode(data, offset + field_offset, '')
+            fields.append('{}={}'.format(name, value))
+        return _pad('{' + ', '.join(fields) + '}', format_spec), offset + self.struct_info.size
+
+    def get_legacy_insert(self, format_spec, arg_id):
+        spec = FormatSpec(format_spec)
+        if spec.type:
+            return super(StructItem, self).get_legacy_format(format_spec)
+        self._get_legacy_flags(spec)
+
+        fields = []
+        for name, item, item_names in self._get_legacy_layout():
+            if name is not None:
+                fields.append('{}={}'.format(name, item.get_legacy_insert('', arg_id)))
+            arg_id += len(item_names)
+        return '{' + ', '.join(fields) + '}'
+
+
+class OptionalItem(TraceItem):
+    """
+    An optional value: a presence byte followed by the value, if it exists.
+    Not supported by legacy tmf files, as the trace size depends on the presence byte.
+    """
+    def __init__(self, item):
+        self.item = item
+
+    def decode(self, data, offset, format_spec):
+        if not data[offset]:
+            return _pad('none', format_spec), offset + 1
+        return self.item.decode(data, offset + 1, format_spec)
+
+
+class TupleItem(LegacyTraceItem):
+    """
+    A pair or a tuple, traced as its elements in order and printed as `(element1, element2, ...)`.
+    """
+    def __init__(self, *items):
+        self.items = items
+
+    @property
+    def supports_legacy_format(self):
+        return all(item.supports_legacy_format for item in self.items)
+
+    def get_legacy_item_names(self):
+        return [item_name for item in self.items for item_name in item.get_legacy_item_names()]
+
+    def decode(self, data, offset, format_spec):
+        elements = []
+        for item in self.items:
+            element, offset = item.decode(data, offset, format_spec)
+            elements.append(element)
+        return '(' + ', '.join(elements) + ')', offset
+
+    def get_legacy_insert(self, format_spec, arg_id):
+        elements = []
+        for item in self.items:
+            elements.append(item.get_legacy_insert(format_spec, arg_id))
+            arg_id += len(item.get_legacy_item_names())
+        return '(' + ', '.join(elements) + ')'
+
+
+class VariantItem(TraceItem):
+    """
+    A variant: an index byte followed by the active alternative (0xff for a valueless variant).
+    Not supported by legacy tmf files, as the trace layout depends on the index byte.
+    """
+    def __init__(self, *items):
+        self.items = items
+
+    def decode(self, data, offset, format_spec):
+        index = data[offset]
+        if index == 0xff:
+            return _pad('valueless', format_spec), offset + 1
+        return self.items[index].decode(data, offset + 1, format_spec)
+
+
+class ConstantItem(LegacyTraceItem):
+    """
+    A compile-time constant, formatted like its value item. The value is part of the item type (as
+    its wire representation, zero-extended to 64 bits), so it takes no space in the trace and no
+    legacy wpp items - legacy tmf files contain the formatted value instead of an insert.
+    """
+    def __init__(self, item, bits):
+        self.item = item
+        self.data = struct.pack('<Q', bits)
+
+    def get_legacy_item_names(self):
+        return []
+
+    def decode(self, data, offset, format_spec):
+        return self.item.decode(self.data, 0, format_spec)[0], offset
 
+    def get_legacy_insert(self, format_spec, arg_id):
+        return self.decode(b'', 0, format_spec)[0].replace('%', '%%')
+
+
+# Trace items composed of other trace items, created from their template arguments
+COMPOSITE_TRACE_ITEM_TYPES = {
+    cls.__name__: cls
+    for cls in (OptionalItem, TupleItem, VariantItem)
+}
 
 
 TRACE_ITEM_TYPES = {
@@ -245,10 +742,33 @@ TRACE_ITEM_TYPES = {
         UInt8Item, UInt16Item, UInt32Item, UInt64Item,
         SizeTItem, PtrDiffItem,
         FloatItem, DoubleItem, LongDoubleItem,
-        PointerItem, GuidItem, HexBufferItem, HexDumpItem
+        PointerItem, GuidItem, HexBufferItem, HexDumpItem, WHexBufferItem, WHexDumpItem,
+        StackItem, SymbolItem
     )
 }
 
-def make_trace_item_from_name(name):
-    actual_name = name.split('wpp::')[-1]
+def make_trace_item_from_name(name, structs):
+    """
+    Create a trace item from the c++ type name of the item.
+
+    :param structs: A mapping between struct type names and their StructInfo.
+    """
+    actual_name = get_base_name(name)
+
+    if actual_name == 'StructItem':
+        struct_name = get_template_args(name)[0]
+        if struct_name not in structs:
+            raise KeyError('Missing struct descriptor for {}!'.format(struct_name))
+        return StructItem(structs[struct_name], structs)
+
+    if actual_name == 'ConstantItem':
+        item_name, bits = get_template_args(name)
+        # Integer template arguments may have a suffix (such as 7ul)
+        return ConstantItem(make_trace_item_from_name(item_name, structs),
+                            int(re.sub('[ul]+$', '', bits.lower()), 0))
+
+    if actual_name in COMPOSITE_TRACE_ITEM_TYPES:
+        items = [make_trace_item_from_name(arg, structs) for arg in get_template_args(name) if arg]
+        return COMPOSITE_TRACE_ITEM_TYPES[actual_name](*items)
+
     return TRACE_ITEM_TYPES[actual_name]()
\ No newline at end of file
@@ -0,0 +1,182 @@
+"""
+Parsing of the trace metadata, shared by all the binary formats.
+
+The metadata consists of records, each containing a list of strings. MSVC builds write the records
+as PDB annotations, while GCC and Clang builds write them to an ELF section (see `elf_parser.py`).
+"""
+import hashlib
+import re
+import struct
+import uuid
+
+from logger import logger
+from trace_info import TraceInfo
+from trace_items import StructInfo
+from type_names import get_template_args, split_args
+
+
+# The number of strings in the primary trace info, including the record kind
+_TRACE_INFO_SIZE = 8
+
+
+def get_relative_path(path):
+    """
+    Get the path relative to its parent directory (such as `project/file.cpp`), the same way as
+    `getBaseDirectoryIndex` in the c++ code. Both separators are supported regardless of the host,
+    and the original separator is kept, as the path is a part of the trace hash.
+    """
+    name_start = max(path.rfind('/'), path.rfind('\\'))
+    if name_start <= 0:
+        return path
+    directory_start = max(path.rfind('/', 0, name_start), path.rfind('\\', 0, name_start))
+    return path[directory_start + 1:] if directory_start >= 0 else path
+
+
+def md5_to_uuid(hash_result):
+    """
+    Convert an md hash to a UUID3 value the same way as the c++ code.
+    """
+    parts = struct.unpack_from('<IHH2s6s', hash_result)
+    result = struct.pack('>IHH2s6s', parts[0], parts[1], (parts[2] & 0x0fff) | 0x3000, parts[3], parts[4])
+    return uuid.UUID(bytes=result)
+
+
+def md5_ints_to_digest(a, b, c, d):
+    """
+    Combine four uint32_t values into an md5 message digest.
+    """
+    return struct.pack('<IIII', a, b, c, d)
+
+
+def parse_int(arg):
+    """
+    Parse an integer of an unknown base.
+    The supported bases are 2, 8, 10 and 16. Integer suffixes (such as `ul`) are ignored.
+    """
+    arg = re.sub('[ul]+$', '', arg.lower())
+    base = 10
+    if arg.startswith('0x'):
+        base = 16
+    elif arg.startswith('0b'):
+        base = 2
+    elif arg.startswith('0o'):
+        base = 8
+
+    return int(arg, base)
+
+
+def parse_struct_descriptor(signature, field_names):
+    """
+    Parse a struct descriptor annotation.
+    The signature format is:
+    `...StructDescriptor<Type>::annotate<...StructLayout<Size, Offsets, Sizes, std::tuple<Items...>>>(void)`
+    """
+    struct_name = get_template_args(signature, 'StructDescriptor')[0]
+    size, offsets, sizes, items = get_template_args(signature, 'StructLayout')
+    # The offsets and sizes are std::integer_sequence<size_t, ...> - skip the type argument
+    offsets = [parse_int(arg) for arg in get_template_args(offsets, 'integer_sequence')[1:]]
+    sizes = [parse_int(arg) for arg in get_template_args(sizes, 'integer_sequence')[1:]]
+    items = get_template_args(items, 'tuple')
+    field_names = split_args(field_names)
+
+    return StructInfo(struct_name, parse_int(size), list(zip(field_names, offsets, sizes, items)))
+
+
+def parse_item_types(args):
+    """
+    Parse the trace item types of a "TMF_NG_TYPES:" annotation, returning the message GUID and the
+    item types. The data format is: `...annotateArgTypes<hashA, hashB, hashC, hashD, TraceItem1, ...>`.
+    """
+    assert 'annotateArgTypes<' in args
+    args = args[args.index('<') + 1:args.rindex('>')]
+    args = split_args(args)
+
+    # Calculate the message GUID. It should eventually match some primary info message hash.
+    hash_parts = [parse_int(arg) for arg in args[:4]]
+    md5_hash = md5_ints_to_digest(*hash_parts)
+    return md5_to_uuid(md5_hash), args[4:]  # No need to store the hash
+
+
+class MetadataContext(object):
+    """
+    The trace information collected from the metadata records.
+    Identical definitions (such as of traces in inline functions) are merged, while conflicting
+    definitions are logged - and fail the parsing once all the records are collected.
+    """
+    def __init__(self):
+        self.info = {}  # map GUID to general info
+        self.types = {}  # map GUID to argument type info
+        self.structs = {}  # map struct name to struct layout info
+        self.conflict_count = 0
+
+    def _report_conflict(self, name, first, second):
+        logger.error('Conflicting definitions of {}:\n    {}\n    {}'.format(name, first, second))
+        self.conflict_count += 1
+
+    def add_info(self, guid, info):
+        if guid not in self.info:
+            self.info[guid] = info
+        elif self.info[guid] != info:
+            describe = lambda info: '{}:{} "{}"'.format(info[0], info[1], info[5])
+            self._report_conflict('trace {}'.format(guid), describe(self.info[guid]), describe(info))
+
+    def add_types(self, guid, types):
+        if guid not in self.types:
+            self.types[guid] = types
+        elif self.types[guid] != types:
+            self._report_conflict('the types of trace {}'.format(guid), ', '.join(self.types[guid]),
+                                  ', '.join(types))
+
+    def add_struct(self, struct_info):
+        # The same descriptor may be annotated by several compilation units.
+        if struct_info.name not in self.structs:
+            self.structs[struct_info.name] = struct_info
+        elif self.structs[struct_info.name] != struct_info:
+            describe = lambda info: 'size {} {{{}}}'.format(
+                info.size, ', '.join('{}@{}:{} {}'.format(*field) for field in info.fields))
+            self._report_conflict('struct {}'.format(struct_info.name),
+                                  describe(self.structs[struct_info.name]), describe(struct_info))
+
+    def get_traces(self):
+        if self.conflict_count:
+            raise Exception('Found {} conflicting definitions!'.format(self.conflict_count))
+
+        # Assert primary and secondary was found for all the GUIDs
+        assert set(self.info) == set(self.types), 'Bad annotations!'
+
+        return [TraceInfo(guid, self.info[guid], self.types[guid], self.structs) for guid in self.info.keys()]
+
+
+def parse_annotation_data(trace_data, context):
+    """
+    Parse the strings of a single metadata record into the given MetadataContext.
+
+    :type trace_data: list[str]
+    :type context: MetadataContext
+    """
+    if trace_data[0] == 'TMF_NG:':
+        # Primary trace info, containing the path, function, line, flag, level and arguments.
+        # ELF metadata records are followed by the types of the arguments.
+        trace_data, types_data = trace_data[:_TRACE_INFO_SIZE], trace_data[_TRACE_INFO_SIZE:]
+
+        # Get file directory and name for the hash (and not full path). ELF records already contain
+        # the relative path, which is kept as is.
+        trace_data[1] = get_relative_path(trace_data[1])
+
+        # Now calculate the trace hash
+        md5_hash = hashlib.md5(''.join(trace_data).encode()).digest()
+        guid = md5_to_uuid(md5_hash)
+
+        context.add_info(guid, trace_data[1:])  # No need for the "TMF_NG:" part
+        if types_data:
+            assert types_data[0] == 'TMF_NG_TYPES:', 'Bad trace metadata record!'
+            context.add_types(guid, types_data[1:])
+    elif trace_data[0] == 'TMF_NG_TYPES:':
+        # Secondary trace info, containing the types of the arguments.
+        context.add_types(*parse_item_types(trace_data[1]))
+    elif trace_data[0] == 'TMF_NG_STRUCT:':
+        # The layout of a struct registered with WPP_DEFINE_STRUCT_ITEM, and its field names.
+        context.add_struct(parse_struct_descriptor(trace_data[1], trace_data[2]))
+    else:
+        logger.warning('Unexpected annotation data: {}!'.format('\x00'.join(trace_data).encode().hex()))
+        logger.warning('Skipping...')
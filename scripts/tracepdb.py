@@ -1,19 +1,20 @@
 """
 This is the wpp++ equivalent of tracepdb.exe, used to generate TMF files from PDBs of wpp++ projets.
+ELF files built with GCC or Clang are supported as well, using their metadata section.
 """
 import argparse
 import os
 import sys
 
-from tmf_file import generate_tmf_file, generate_tmf_file_for_multiple_traces
-from pdb_parser import extract_trace_info
+from tmf_file import generate_tmf_file, generate_tmf_file_for_multiple_traces, make_module_load_trace
+import elf_parser
 
 from logger import setup_logger, logger
 
 
 def parse_arguments():
     parser = argparse.ArgumentParser(description='''This is the wpp++ equivalent of tracepdb.exe, used to generate TMF files from PDBs of wpp++ projects.''')
-    parser.add_argument('file', type=str, help='The path to the pdb file containing formatting instructions.')
+    parser.add_argument('file', type=str, help='The path to the pdb (or ELF) file containing formatting instructions.')
     
     # Either create a tmf file for each trace or a single tmf file contating all the traces.
     out_group = parser.add_mutually_exclusive_group(required=True)
@@ -34,9 +35,15 @@ def main():
         logger.error('Invalid PDB path: "{}"!'.format(pdb_path))
         return 1
 
-    traces = extract_trace_info(pdb_path)
+    if elf_parser.is_elf_file(pdb_path):
+        traces = elf_parser.extract_trace_info(pdb_path)
+    else:
+        # DbgHelp is only available on Windows
+        from pdb_parser import extract_trace_info
+        traces = extract_trace_info(pdb_path)
 
     logger.info('Found {} traces!'.format(len(traces)))
+    traces = list(traces) + [make_module_load_trace()]
 
     if args.output_directory is not None:
         output_directory = args.output_directory
@@ -0,0 +1,59 @@
+"""
+Utilities for parsing c++ type names and function signatures, as written by the compiler.
+"""
+
+_OPEN_BRACKETS = '[({<'
+_CLOSE_BRACKETS = '])}>'
+
+
+def split_args(args):
+    """
+    Split template arguments, taking into consideration (possibly nested) brackets of the given
+    types: [], (), {}, <>.
+    """
+    result = []
+    depth = 0
+    start = 0
+    for i, char in enumerate(args):
+        if char in _OPEN_BRACKETS:
+            depth += 1
+        elif char in _CLOSE_BRACKETS:
+            depth -= 1
+        elif char == ',' and depth == 0:
+            result.append(args[start:i].strip())
+            start = i + 1
+    result.append(args[start:].strip())
+    return result
+
+
+def get_template_args(name, template_name=None):
+    """
+    Get the template arguments of the given template inside a type name or a function signature.
+    If no template name is given, the first template in the name is used.
+    For example, `get_template_args('void f<int, A<B, C>>(void)', 'f')` returns `['int', 'A<B, C>']`.
+    """
+    if template_name is None:
+        start = name.index('<') + 1
+    else:
+        start = name.index(template_name + '<') + len(template_name) + 1
+
+    depth = 1
+    for i in range(start, len(name)):
+        if name[i] == '<':
+            depth += 1
+        elif name[i] == '>':
+            depth -= 1
+            if depth == 0:
+                return split_args(name[start:i])
+    raise ValueError('Unmatched template brackets in "{}"!'.format(name))
+
+
+def get_base_name(name):
+    """
+    Get the unqualified name of a (possibly templated) wpp type name.
+    For example, `struct wpp::StructItem<struct Packet>` returns `StructItem`.
+    """
+    template_start = name.find('<')
+    if template_start != -1:
+        name = name[:template_start]
+    return name.split('wpp::')[-1]
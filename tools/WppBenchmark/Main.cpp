@@ -0,0 +1,429 @@
+/**
+ * WppBenchmark - measures the runtime cost of the trace macros.
+ *
+ * Measures the cost of disabled traces, the cost of enabled traces per trace item type and per
+ * argument count, and the multithreaded throughput of traces written to a null sink and to a
+ * FileTraceSink. The results are printed as a table, and may be written as JSON for trend tracking.
+ *
+ * On platforms without ETW, the enabled benchmarks write to a wpp::TraceSink. On Windows they
+ * measure the ETW path, so they only run while an ETW session enables the provider of the benchmark
+ * (see USAGE) - and the disabled benchmarks run without one.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "wpp/Trace.h"
+#include "wpp/FileTraceSink.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+constexpr const char USAGE[] =
+    "Usage: WppBenchmark [options]\n"
+    "\n"
+    "Measures the runtime cost of the trace macros.\n"
+    "\n"
+    "Options:\n"
+    "  --json <file>                 Write the results as JSON.\n"
+    "  --filter <text>               Only run the benchmarks whose names contain the text.\n"
+    "  --min-time <ms>               The minimal duration of every benchmark (200 by default).\n"
+    "  -t, --threads <count>         The maximal number of threads in the throughput benchmarks\n"
+    "                                (all the cores by default).\n"
+    "  --file <path>                 The file written by the file sink benchmarks\n"
+    "                                (wpp-benchmark.wpps by default, removed afterwards).\n"
+#ifdef _WIN32
+    "\n"
+    "The enabled benchmarks only run while an ETW session enables flag 1 of the provider\n"
+    "{5d0e9c37-1f4b-4a6e-9b2d-713c8e50a416} at the information level, for example:\n"
+    "  tracelog -start WppBenchmark -guid #5d0e9c37-1f4b-4a6e-9b2d-713c8e50a416 -flag 1\n"
+    "           -level 4 -f WppBenchmark.etl\n"
+#endif
+    ;
+
+constexpr const GUID CONTROL_GUID{
+    0x5d0e9c37, 0x1f4b, 0x4a6e, {0x9b, 0x2d, 0x71, 0x3c, 0x8e, 0x50, 0xa4, 0x16}};
+
+constexpr const UCHAR TRACE_FLAG = 1;
+constexpr const UCHAR OTHER_FLAG = 2;
+
+struct Arguments {
+    std::optional<std::string> jsonFile;
+    std::string filter;
+    std::chrono::milliseconds minTime{200};
+    size_t threadCount = std::max(1U, std::thread::hardware_concurrency());
+    std::string file = "wpp-benchmark.wpps";
+};
+
+std::optional<Arguments> parseArguments(int argc, char* argv[]) {
+    Arguments result;
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (argument == "--json" && hasValue) {
+            result.jsonFile = argv[++i];
+        } else if (argument == "--filter" && hasValue) {
+            result.filter = argv[++i];
+        } else if (argument == "--min-time" && hasValue) {
+            result.minTime = std::chrono::milliseconds(std::stoul(argv[++i]));
+        } else if ((argument == "-t" || argument == "--threads") && hasValue) {
+            result.threadCount = std::max(1UL, std::stoul(argv[++i]));
+        } else if (argument == "--file" && hasValue) {
+            result.file = argv[++i];
+        } else {
+            return std::nullopt;
+        }
+    }
+    return result;
+}
+
+/**
+ * Prevents the compiler from assuming anything about the value, so traced values are not folded
+ * into constants, and the traces are not optimized out.
+ */
+template<typename T>
+inline void escape(T& value) noexcept {
+#ifdef _MSC_VER
+    // MSVC has no inline assembly on x64, so the address is stored to a volatile instead.
+    static thread_local const void* volatile t_escaped;
+    t_escaped = &value;
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : "g"(&value) : "memory");
+#endif
+}
+
+#ifdef _WIN32
+
+/**
+ * With ETW, the traces are written to the trace session which enabled the provider, so there's no
+ * sink - the placeholder sink is only used to share the benchmarks with other platforms.
+ */
+struct NullTraceSink {};
+
+/**
+ * Checks whether the ETW session enabled the traces of the benchmarks.
+ */
+bool enableTraces(wpp::TraceProvider& provider, NullTraceSink&) {
+    return provider.areTracesEnabled(TRACE_FLAG, wpp::TraceLevel::Information);
+}
+
+void disableTraces(wpp::TraceProvider&) {
+    // The traces are disabled by stopping the ETW session.
+}
+
+#else
+
+/**
+ * A sink discarding all the traces, so only the cost of the trace macros is measured.
+ */
+class NullTraceSink : public wpp::TraceSink {
+public:
+    void write(const GUID&, const wpp::TracePair* pairs, size_t) noexcept override {
+        escape(pairs);
+    }
+};
+
+bool enableTraces(wpp::TraceProvider& provider, wpp::TraceSink& sink) {
+    provider.enable(sink, TRACE_FLAG, wpp::TraceLevel::Verbose);
+    return true;
+}
+
+void disableTraces(wpp::TraceProvider& provider) {
+    provider.disable();
+}
+
+#endif
+
+struct Result {
+    std::string name;
+    size_t threads;
+    /// The number of traces in every thread
+    uint64_t iterations;
+    /// The duration of a single trace in a single thread
+    double nanosecondsPerTrace;
+    /// The number of traces per second, in all the threads
+    double tracesPerSecond;
+};
+
+class Benchmark {
+public:
+    Benchmark(const Arguments& arguments) : m_arguments(arguments), m_provider(CONTROL_GUID) {
+        // Intentionally left blank.
+    }
+
+    wpp::TraceProvider& provider() noexcept {
+        return m_provider;
+    }
+
+    const std::vector<Result>& results() const noexcept {
+        return m_results;
+    }
+
+    /**
+     * Measures `trace(iteration)` on each of the given number of threads. The number of iterations
+     * is doubled until the benchmark takes the minimal duration.
+     */
+    template<typename Function>
+    void run(const std::string& name, size_t threads, Function trace) {
+        if (name.find(m_arguments.filter) == std::string::npos) {
+            return;
+        }
+
+        uint64_t iterations = 1024;
+        std::chrono::nanoseconds elapsed = measure(threads, iterations, trace);
+        while (elapsed < m_arguments.minTime) {
+            iterations *= 2;
+            elapsed = measure(threads, iterations, trace);
+        }
+
+        const double nanoseconds = static_cast<double>(elapsed.count());
+        const double traces = static_cast<double>(iterations);
+        m_results.push_back({name, threads, iterations, nanoseconds / traces,
+                             static_cast<double>(threads) * traces * 1e9 / nanoseconds});
+        printResult(m_results.back());
+    }
+
+private:
+    template<typename Function>
+    static std::chrono::nanoseconds measure(size_t threads, uint64_t iterations, Function& trace) {
+        const auto work = [&trace, iterations]() {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                trace(i);
+            }
+        };
+
+        const auto start = std::chrono::steady_clock::now();
+        if (threads == 1) {
+            work();
+        } else {
+            std::vector<std::thread> workers;
+            for (size_t i = 0; i < threads; ++i) {
+                workers.emplace_back(work);
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+        return std::chrono::steady_clock::now() - start;
+    }
+
+    static void printResult(const Result& result) {
+        std::printf("%-40s %8zu %14.2f %16.0f\n", result.name.c_str(), result.threads,
+                    result.nanosecondsPerTrace, result.tracesPerSecond);
+        std::fflush(stdout);
+    }
+
+    const Arguments& m_arguments;
+    wpp::TraceProvider m_provider;
+    std::vector<Result> m_results;
+};
+
+void runDisabledBenchmarks(Benchmark& benchmark) {
+    auto& provider = benchmark.provider();
+    int value = 5;
+
+#ifdef _WIN32
+    // The ETW session enables the traces of TRACE_FLAG up to the information level, if there's one
+    if (!provider.areTracesEnabled(TRACE_FLAG, wpp::TraceLevel::Information)) {
+        benchmark.run("disabled/provider", 1, [&](uint64_t) {
+            escape(value);
+            WPP_DO_TRACE(provider, TRACE_FLAG, wpp::TraceLevel::Information, "Value: {}", value);
+        });
+        return;
+    }
+    benchmark.run("disabled/flag", 1, [&](uint64_t) {
+        escape(value);
+        WPP_DO_TRACE(provider, OTHER_FLAG, wpp::TraceLevel::Information, "Value: {}", value);
+    });
+    benchmark.run("disabled/level", 1, [&](uint64_t) {
+        escape(value);
+        WPP_DO_TRACE(provider, TRACE_FLAG, wpp::TraceLevel::Verbose, "Value: {}", value);
+    });
+#else
+    NullTraceSink sink;
+    provider.disable();
+    benchmark.run("disabled/provider", 1, [&](uint64_t) {
+        escape(value);
+        WPP_DO_TRACE(provider, TRACE_FLAG, wpp::TraceLevel::Information, "Value: {}", value);
+    });
+
+    provider.enable(sink, OTHER_FLAG, wpp::TraceLevel::Verbose);
+    benchmark.run("disabled/flag", 1, [&](uint64_t) {
+        escape(value);
+        WPP_DO_TRACE(provider, TRACE_FLAG, wpp::TraceLevel::Information, "Value: {}", value);
+    });
+
+    provider.enable(sink, TRACE_FLAG, wpp::TraceLevel::Error);
+    benchmark.run("disabled/level", 1, [&](uint64_t) {
+        escape(value);
+        WPP_DO_TRACE(provider, TRACE_FLAG, wpp::TraceLevel::Information, "Value: {}", value);
+    });
+    provider.disable();
+#endif
+}
+
+void runItemBenchmarks(Benchmark& benchmark) {
+    auto& provider = benchmark.provider();
+    NullTraceSink sink;
+    if (!enableTraces(provider, sink)) {
+        return;
+    }
+
+    int32_t value = 5;
+    benchmark.run("item/Int32Item", 1, [&](uint64_t) {
+        escape(value);
+        WPP_DO_TRACE(provider, TRACE_FLAG, wpp::TraceLevel::Information, "{}", value);
+    });
+
+    GUID guid = CONTROL_GUID;
+    benchmark.run("item/GuidItem", 1, [&](uint64_t) {
+        escape(guid);
+        WPP_DO_TRACE(provider, TRACE_FLAG, wpp::TraceLevel::Information, "{}", guid);
+    });
+
+    for (const size_t length : {8, 64, 512, 4096}) {
+        const std::string string(length, 'a');
+        const char* str = string.c_str();
+        benchmark.run("item/StringItem/" + std::to_string(length), 1, [&](uint64_t) {
+            escape(str);
+            WPP_DO_TRACE(provider, TRACE_FLAG, wpp::TraceLevel::Information, "{}", str);
+        });
+    }
+
+    for (const size_t length : {16, 256, 4096}) {
+        const std::string buffer(length, 'a');
+        const char* data = buffer.c_str();
+        benchmark.run("item/HexDumpItem/" + std::to_string(length), 1, [&](uint64_t) {
+            escape(data);
+            WPP_DO_TRACE(provider, TRACE_FLAG, wpp::TraceLevel::Information, "{:xd}", data);
+        });
+    }
+    disableTraces(provider);
+}
+
+void runArgumentCountBenchmarks(Benchmark& benchmark) {
+    auto& provider = benchmark.provider();
+    NullTraceSink sink;
+    if (!enableTraces(provider, sink)) {
+        return;
+    }
+
+    int a = 1;
+    benchmark.run("arguments/0", 1, [&](uint64_t) {
+        escape(a);
+        WPP_DO_TRACE(provider, TRACE_FLAG, wpp::TraceLevel::Information, "No arguments");
+    });
+    benchmark.run("arguments/1", 1, [&](uint64_t) {
+        escape(a);
+        WPP_DO_TRACE(provider, TRACE_FLAG, wpp::TraceLevel::Information, "{}", a);
+    });
+    benchmark.run("arguments/2", 1, [&](uint64_t) {
+        escape(a);
+        WPP_DO_TRACE(provider, TRACE_FLAG, wpp::TraceLevel::Information, "{} {}", a, a);
+    });
+    benchmark.run("arguments/4", 1, [&](uint64_t) {
+        escape(a);
+        WPP_DO_TRACE(provider, TRACE_FLAG, wpp::TraceLevel::Information, "{} {} {} {}", a, a, a,
+                     a);
+    });
+    benchmark.run("arguments/8", 1, [&](uint64_t) {
+        escape(a);
+        WPP_DO_TRACE(provider, TRACE_FLAG, wpp::TraceLevel::Information,
+                     "{} {} {} {} {} {} {} {}", a, a, a, a, a, a, a, a);
+    });
+    benchmark.run("arguments/16", 1, [&](uint64_t) {
+        escape(a);
+        WPP_DO_TRACE(provider, TRACE_FLAG, wpp::TraceLevel::Information,
+                     "{} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {}", a, a, a, a, a, a, a, a, a,
+                     a, a, a, a, a, a, a);
+    });
+    disableTraces(provider);
+}
+
+/**
+ * Measures the throughput of a typical trace with every power of two number of threads, up to the
+ * given number of threads.
+ */
+template<typename Sink>
+void runThroughputBenchmarks(Benchmark& benchmark, const std::string& name, Sink& sink,
+                             size_t maxThreads) {
+    auto& provider = benchmark.provider();
+    if (!enableTraces(provider, sink)) {
+        return;
+    }
+
+    const char* str = "request";
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        benchmark.run("throughput/" + name, threads, [&](uint64_t i) {
+            escape(str);
+            WPP_DO_TRACE(provider, TRACE_FLAG, wpp::TraceLevel::Information,
+                         "Handled {} number {} in {}us", str, i, static_cast<uint32_t>(i));
+        });
+    }
+    disableTraces(provider);
+}
+
+void writeJson(const std::string& path, const std::vector<Result>& results) {
+    std::ofstream output(path);
+    output << "{\n    \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& result = results[i];
+        output << (i == 0 ? "\n" : ",\n") << "        {\"name\": \"" << result.name
+               << "\", \"threads\": " << result.threads
+               << ", \"iterations\": " << result.iterations
+               << ", \"ns_per_trace\": " << result.nanosecondsPerTrace
+               << ", \"traces_per_second\": " << result.tracesPerSecond << "}";
+    }
+    output << "\n    ]\n}\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const auto arguments = parseArguments(argc, argv);
+    if (!arguments.has_value()) {
+        std::cerr << USAGE;
+        return 1;
+    }
+
+    Benchmark benchmark(*arguments);
+    std::printf("%-40s %8s %14s %16s\n", "benchmark", "threads", "ns/trace", "traces/s");
+
+    runDisabledBenchmarks(benchmark);
+    runItemBenchmarks(benchmark);
+    runArgumentCountBenchmarks(benchmark);
+
+    NullTraceSink nullSink;
+#ifdef _WIN32
+    if (!enableTraces(benchmark.provider(), nullSink)) {
+        std::cerr << "The enabled benchmarks were skipped, as no ETW session enabled the traces"
+                  << std::endl;
+    }
+    runThroughputBenchmarks(benchmark, "etw", nullSink, arguments->threadCount);
+#else
+    runThroughputBenchmarks(benchmark, "null-sink", nullSink, arguments->threadCount);
+    {
+        wpp::FileTraceSink fileSink(arguments->file.c_str());
+        if (!fileSink.isOpen()) {
+            std::cerr << "Failed to open " << arguments->file << std::endl;
+            return 1;
+        }
+        runThroughputBenchmarks(benchmark, "file-sink", fileSink, arguments->threadCount);
+    }
+    std::remove(arguments->file.c_str());
+#endif
+
+    if (arguments->jsonFile.has_value()) {
+        writeJson(*arguments->jsonFile, benchmark.results());
+    }
+    return 0;
+}
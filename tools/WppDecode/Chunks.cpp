@@ -0,0 +1,225 @@
+#include "Chunks.h"
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include "Parallel.h"
+
+namespace wpp::tools {
+
+namespace {
+
+/**
+ * Writes batches of buffers to a file on a background thread.
+ */
+class BackgroundWriter {
+public:
+    explicit BackgroundWriter(FILE* output) : m_output(output) {
+        // Intentionally left blank.
+    }
+
+    ~BackgroundWriter() {
+        wait();
+    }
+
+    // Disallow copy operations
+    BackgroundWriter(const BackgroundWriter&) = delete;
+    BackgroundWriter& operator=(const BackgroundWriter&) = delete;
+
+    // Disallow move operations
+    BackgroundWriter(BackgroundWriter&&) = delete;
+    BackgroundWriter& operator=(BackgroundWriter&&) = delete;
+
+    /**
+     * Waits for the previous batch to be written, and starts writing the given buffers. They're
+     * swapped with the buffers of the previous batch, which are cleared to be reused.
+     */
+    void write(std::vector<std::string>& buffers) {
+        wait();
+        std::swap(m_buffers, buffers);
+        for (auto& buffer : buffers) {
+            buffer.clear();
+        }
+        m_thread = std::thread([this]() {
+            for (const auto& buffer : m_buffers) {
+                std::fwrite(buffer.data(), 1, buffer.size(), m_output);
+            }
+        });
+    }
+
+    void wait() {
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+private:
+    FILE* m_output;
+    std::vector<std::string> m_buffers;
+    std::thread m_thread;
+};
+
+/**
+ * The order of a decoded trace when merging: by timestamp, then by stream, and then by the
+ * position of its record in the stream.
+ */
+struct LineKey {
+    uint64_t timestamp;
+    uint32_t stream;
+    size_t position;
+
+    bool operator<(const LineKey& other) const noexcept {
+        return std::tie(timestamp, stream, position) <
+               std::tie(other.timestamp, other.stream, other.position);
+    }
+};
+
+struct Line {
+    LineKey key;
+    size_t begin;
+    size_t size;
+};
+
+/**
+ * Decoded traces sorted by their keys, whose text is stored (in any order) in a single buffer.
+ */
+struct Run {
+    std::string text;
+    std::vector<Line> lines;
+};
+
+/**
+ * The key of the earliest trace which a chunk may contain.
+ */
+LineKey getChunkKey(const StreamChunk& chunk) {
+    return LineKey{chunk.minTimestamp, chunk.stream, chunk.begin};
+}
+
+/**
+ * Decodes the records of a chunk. If `lines` is given, the decoded traces are added to it.
+ */
+void decodeChunk(const StreamChunk& chunk, const TraceDecoder& decoder,
+                 const std::vector<StreamSymbols>& symbols, std::string& output,
+                 std::vector<Line>* lines) {
+    const SymbolResolver* streamSymbols =
+        chunk.stream < symbols.size() ? &symbols[chunk.stream] : nullptr;
+    StreamReader reader(chunk.data, chunk.size, chunk.begin, chunk.end);
+    StreamRecord record;
+    while (reader.next(record)) {
+        record.data.symbols = streamSymbols;
+        const size_t begin = output.size();
+        decoder.decode(record, output);
+        if (lines != nullptr && output.size() != begin) {
+            const auto position = static_cast<size_t>(record.data.data - chunk.data);
+            lines->push_back(
+                Line{{record.timestamp, chunk.stream, position}, begin, output.size() - begin});
+        }
+    }
+}
+
+/**
+ * Merges the runs, appending the traces which are earlier than the horizon (or all of them if
+ * there's none) to the output. The first run is replaced by the later traces.
+ */
+void mergeRuns(std::vector<Run>& runs, const std::optional<LineKey>& horizon,
+               std::string& output) {
+    std::vector<size_t> cursors(runs.size());
+    const auto isLater = [&runs, &cursors](size_t left, size_t right) {
+        return runs[right].lines[cursors[right]].key < runs[left].lines[cursors[left]].key;
+    };
+
+    std::vector<size_t> heap;
+    for (size_t i = 0; i < runs.size(); ++i) {
+        if (!runs[i].lines.empty()) {
+            heap.push_back(i);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), isLater);
+
+    Run later;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), isLater);
+        const size_t run = heap.back();
+        const auto& line = runs[run].lines[cursors[run]];
+        const std::string_view text(runs[run].text.data() + line.begin, line.size);
+        if (!horizon.has_value() || line.key < *horizon) {
+            output += text;
+        } else {
+            later.lines.push_back(Line{line.key, later.text.size(), line.size});
+            later.text += text;
+        }
+
+        if (++cursors[run] < runs[run].lines.size()) {
+            std::push_heap(heap.begin(), heap.end(), isLater);
+        } else {
+            heap.pop_back();
+        }
+    }
+    runs[0] = std::move(later);
+}
+
+}  // namespace
+
+void writeChunks(const std::vector<StreamChunk>& chunks, const TraceDecoder& decoder,
+                 const std::vector<StreamSymbols>& symbols, size_t threadCount, FILE* output) {
+    BackgroundWriter writer(output);
+    std::vector<std::string> buffers;
+    for (size_t batch = 0; batch < chunks.size(); batch += threadCount) {
+        const size_t count = std::min(threadCount, chunks.size() - batch);
+        buffers.resize(count);
+        parallelFor(count, count, [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                decodeChunk(chunks[batch + i], decoder, symbols, buffers[i], nullptr);
+            }
+        });
+        writer.write(buffers);
+    }
+}
+
+void writeMergedChunks(const std::vector<StreamChunk>& chunks, const TraceDecoder& decoder,
+                       const std::vector<StreamSymbols>& symbols, size_t threadCount,
+                       FILE* output) {
+    std::vector<const StreamChunk*> order;
+    for (const auto& chunk : chunks) {
+        order.push_back(&chunk);
+    }
+    std::sort(order.begin(), order.end(), [](const StreamChunk* left, const StreamChunk* right) {
+        return getChunkKey(*left) < getChunkKey(*right);
+    });
+
+    BackgroundWriter writer(output);
+    std::vector<std::string> buffers;
+    // The first run holds the traces left from the previous batches
+    std::vector<Run> runs(1);
+    for (size_t batch = 0; batch < order.size(); batch += threadCount) {
+        const size_t count = std::min(threadCount, order.size() - batch);
+        runs.resize(count + 1);
+        parallelFor(count, count, [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                auto& run = runs[i + 1];
+                run.text.clear();
+                run.lines.clear();
+                decodeChunk(*order[batch + i], decoder, symbols, run.text, &run.lines);
+                const auto isEarlier = [](const Line& left, const Line& right) {
+                    return left.key < right.key;
+                };
+                if (!std::is_sorted(run.lines.begin(), run.lines.end(), isEarlier)) {
+                    std::sort(run.lines.begin(), run.lines.end(), isEarlier);
+                }
+            }
+        });
+
+        // Every trace of the following chunks is at or after the key of the next chunk
+        std::optional<LineKey> horizon;
+        if (batch + count < order.size()) {
+            horizon = getChunkKey(*order[batch + count]);
+        }
+        buffers.resize(1);
+        mergeRuns(runs, horizon, buffers[0]);
+        writer.write(buffers);
+    }
+}
+
+}  // namespace wpp::tools
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+#include "Decoder.h"
+#include "Stream.h"
+#include "Symbols.h"
+
+namespace wpp::tools {
+
+/**
+ * Decodes the chunks of one or more streams on the given number of threads, and writes the
+ * decoded traces to the output in the order of the chunks.
+ *
+ * Every thread decodes a chunk into its own buffer, and the buffers of the previous chunks are
+ * written in the background meanwhile, so the output is written at the same time as the traces
+ * are decoded.
+ *
+ * `symbols` resolves the `{:sym}` pointers of every stream (by its index), and may be empty.
+ */
+void writeChunks(const std::vector<StreamChunk>& chunks, const TraceDecoder& decoder,
+                 const std::vector<StreamSymbols>& symbols, size_t threadCount, FILE* output);
+
+/**
+ * Decodes the chunks of one or more streams on the given number of threads, and writes the
+ * decoded traces to the output in the order of their timestamps. Traces with the same timestamp
+ * are written in the order of the streams, and then in the order of the stream.
+ *
+ * The chunks are decoded in the order of their earliest timestamps, and every decoded chunk is
+ * sorted by its thread. The sorted chunks are then merged, writing the traces which are earlier
+ * than every trace of the chunks which weren't decoded yet - so the records of a stream may be
+ * out of order (as traces are timestamped before they're written), but streams which overlap in
+ * time for long keep more traces in memory.
+ */
+void writeMergedChunks(const std::vector<StreamChunk>& chunks, const TraceDecoder& decoder,
+                       const std::vector<StreamSymbols>& symbols, size_t threadCount,
+                       FILE* output);
+
+}  // namespace wpp::tools
@@ -0,0 +1,348 @@
+#include "Decoder.h"
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include "Strings.h"
+
+namespace wpp::tools {
+
+namespace {
+
+constexpr FormatSpec EMPTY_SPEC = wpp::internal::parseFormatSpec("");
+
+/// The width of the level column, the same as `{:<11}` in scripts/decode_stream.py
+constexpr const size_t LEVEL_WIDTH = 11;
+
+void appendPadded(std::string& output, std::string_view text, size_t width) {
+    output += text;
+    if (text.size() < width) {
+        output.append(width - text.size(), ' ');
+    }
+}
+
+/**
+ * Writes the 9 digits of the nanoseconds of a timestamp, two digits at a time.
+ */
+void writeNanoseconds(char* output, uint32_t value) {
+    static constexpr const char DIGIT_PAIRS[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    output[8] = static_cast<char>('0' + value % 10);
+    value /= 10;
+    for (size_t i = 8; i > 0; i -= 2) {
+        std::memcpy(output + i - 2, DIGIT_PAIRS + (value % 100) * 2, 2);
+        value /= 100;
+    }
+}
+
+}  // namespace
+
+void appendTimestamp(std::string& output, uint64_t timestamp) {
+    constexpr const uint64_t NANOSECONDS_PER_SECOND = 1000000000;
+    constexpr const uint64_t SECONDS_PER_DAY = 86400;
+
+    // Consecutive records are usually written in the same second, so its text is cached. The
+    // timestamp is written into the cached text, and appended at once.
+    constexpr const size_t SECONDS_SIZE = sizeof("YYYY-MM-DD HH:MM:SS") - 1;
+    thread_local uint64_t t_seconds = UINT64_MAX;
+    thread_local char t_text[64];
+    const uint64_t seconds = timestamp / NANOSECONDS_PER_SECOND;
+    if (seconds != t_seconds) {
+        // Convert the days since the epoch to a civil date (see Howard Hinnant's `civil_from_days`)
+        const uint64_t days = seconds / SECONDS_PER_DAY + 719468;
+        const uint64_t era = days / 146097;
+        const uint64_t dayOfEra = days - era * 146097;
+        const uint64_t yearOfEra =
+            (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        const uint64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        const uint64_t shiftedMonth = (5 * dayOfYear + 2) / 153;
+        const uint64_t day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+        const uint64_t month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+        const uint64_t year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+
+        const uint64_t secondOfDay = seconds % SECONDS_PER_DAY;
+        std::snprintf(t_text, sizeof(t_text), "%04u-%02u-%02u %02u:%02u:%02u",
+                      static_cast<unsigned>(year), static_cast<unsigned>(month),
+                      static_cast<unsigned>(day), static_cast<unsigned>(secondOfDay / 3600),
+                      static_cast<unsigned>(secondOfDay / 60 % 60),
+                      static_cast<unsigned>(secondOfDay % 60));
+        t_text[SECONDS_SIZE] = '.';
+        t_seconds = seconds;
+    }
+
+    writeNanoseconds(t_text + SECONDS_SIZE + 1,
+                     static_cast<uint32_t>(timestamp % NANOSECONDS_PER_SECOND));
+    output.append(t_text, SECONDS_SIZE + 1 + 9);
+}
+
+/**
+ * Formats the records of a single trace. The format string is parsed once, and traces whose fields
+ * reference their arguments in order (as most traces do) are decoded directly into the output.
+ */
+class TraceDecoder::TraceFormatter {
+public:
+    explicit TraceFormatter(const TraceInfo& trace)
+        : m_trace(trace), m_keywords(getKeywordNames(trace.flag)) {
+        const auto location = trace.file + ":" + trace.line;
+        m_textPrefix += ' ';
+        appendPadded(m_textPrefix, trace.level, LEVEL_WIDTH);
+        m_textPrefix += ' ' + location + ' ';
+        m_jsonFields = "\", \"level\": " + quoteJson(trace.level) +
+                       ", \"location\": " + quoteJson(location) + ", \"message\": ";
+
+        try {
+            parse();
+        } catch (const std::exception& e) {
+            // Every record of the trace is reported as a bad trace
+            m_error = e.what();
+        }
+    }
+
+    // Disallow copy operations (the parsed specs refer to the parts)
+    TraceFormatter(const TraceFormatter&) = delete;
+    TraceFormatter& operator=(const TraceFormatter&) = delete;
+
+    // Disallow move operations
+    TraceFormatter(TraceFormatter&&) = delete;
+    TraceFormatter& operator=(TraceFormatter&&) = delete;
+
+    bool hasAnyKeyword(const std::vector<std::string>& keywords) const {
+        return std::any_of(m_keywords.begin(), m_keywords.end(), [&keywords](const auto& name) {
+            return std::find(keywords.begin(), keywords.end(), name) != keywords.end();
+        });
+    }
+
+    void appendTextLine(const StreamRecord& record, std::string& output) const {
+        appendTimestamp(output, record.timestamp);
+        output += m_textPrefix;
+        const size_t messageStart = output.size();
+        try {
+            appendMessage(record.data, output, nullptr);
+        } catch (const std::exception& e) {
+            output.resize(messageStart);
+            appendBadTrace(record, e, output);
+        }
+        output += '\n';
+    }
+
+    void appendJsonLine(const StreamRecord& record, std::string& output) const {
+        output += "{\"time\": \"";
+        appendTimestamp(output, record.timestamp);
+        output += m_jsonFields;
+
+        // The buffers of the message and the values are reused between records, and the values
+        // are only needed for the named arguments
+        thread_local std::string t_message;
+        thread_local std::vector<std::string> t_values;
+        t_message.clear();
+        bool hasValues = m_hasNamedArgs;
+        try {
+            appendMessage(record.data, t_message, hasValues ? &t_values : nullptr);
+        } catch (const std::exception& e) {
+            t_message.clear();
+            hasValues = false;
+            appendBadTrace(record, e, t_message);
+        }
+        appendQuotedJson(output, t_message);
+
+        output += ", \"args\": {";
+        bool isFirst = true;
+        for (size_t i = 0; hasValues && i < m_argKeys.size(); ++i) {
+            if (!m_argKeys[i].empty()) {
+                output += isFirst ? "" : ", ";
+                output += m_argKeys[i];
+                appendQuotedJson(output, t_values[i]);
+                isFirst = false;
+            }
+        }
+        output += "}}\n";
+    }
+
+private:
+    void parse() {
+        m_parts = parseFormat(m_trace.format);
+        const size_t argCount = m_trace.argTypes.size();
+        m_argSpecs.assign(argCount, EMPTY_SPEC);
+        m_argSpecTexts.assign(argCount, nullptr);
+        m_argKeys.resize(argCount);
+
+        size_t fieldCount = 0;
+        m_isSequential = true;
+        for (const auto& part : m_parts) {
+            if (!part.formatSpec.has_value()) {
+                m_partSpecs.push_back(EMPTY_SPEC);
+                m_usesFirstSpec.push_back(false);
+                continue;
+            }
+            if (part.argIndex >= argCount) {
+                throw std::runtime_error("Too many format specifiers");
+            }
+
+            // Every argument is traced once, and is decoded using the format of its first reference
+            const size_t index = part.argIndex;
+            const auto spec = wpp::internal::parseFormatSpec(*part.formatSpec);
+            if (m_argSpecTexts[index] == nullptr) {
+                m_argSpecTexts[index] = &*part.formatSpec;
+                m_argSpecs[index] = spec;
+            }
+            if (!part.argName.empty()) {
+                m_argKeys[index] = quoteJson(part.argName) + ": ";
+                m_hasNamedArgs = true;
+            }
+            m_partSpecs.push_back(spec);
+            m_usesFirstSpec.push_back(*part.formatSpec == *m_argSpecTexts[index]);
+            m_isSequential = m_isSequential && index == fieldCount;
+            ++fieldCount;
+        }
+        m_isSequential = m_isSequential && fieldCount == argCount;
+    }
+
+    /**
+     * Appends the formatted message of the trace, or throws if the trace data can't be decoded. If
+     * `values` is given, its first elements are set to the values of the arguments, formatted by
+     * their first references (it's never shrunk, so the buffers of the values are reused).
+     */
+    void appendMessage(TraceData data, std::string& output,
+                       std::vector<std::string>* values) const {
+        if (m_error.has_value()) {
+            throw std::runtime_error(*m_error);
+        }
+
+        const auto& argTypes = m_trace.argTypes;
+        if (m_isSequential && values == nullptr) {
+            size_t offset = 0;
+            for (size_t i = 0; i < m_parts.size(); ++i) {
+                if (!m_parts[i].literal.empty()) {
+                    output += m_parts[i].literal;
+                }
+                if (m_parts[i].formatSpec.has_value()) {
+                    offset = argTypes[m_parts[i].argIndex]->decode(data, offset, m_partSpecs[i],
+                                                                   output);
+                }
+            }
+            return;
+        }
+
+        // The buffers of the values are reused between records
+        thread_local std::vector<std::string> t_values;
+        thread_local std::vector<size_t> t_offsets;
+        auto& decoded = values != nullptr ? *values : t_values;
+        if (decoded.size() < argTypes.size()) {
+            decoded.resize(argTypes.size());
+        }
+        if (t_offsets.size() < argTypes.size()) {
+            t_offsets.resize(argTypes.size());
+        }
+        size_t offset = 0;
+        for (size_t i = 0; i < argTypes.size(); ++i) {
+            decoded[i].clear();
+            t_offsets[i] = offset;
+            offset = argTypes[i]->decode(data, offset, m_argSpecs[i], decoded[i]);
+        }
+
+        for (size_t i = 0; i < m_parts.size(); ++i) {
+            const auto& part = m_parts[i];
+            if (!part.literal.empty()) {
+                output += part.literal;
+            }
+            if (!part.formatSpec.has_value()) {
+                continue;
+            }
+            if (m_usesFirstSpec[i]) {
+                output += decoded[part.argIndex];
+            } else {
+                argTypes[part.argIndex]->decode(data, t_offsets[part.argIndex], m_partSpecs[i],
+                                                output);
+            }
+        }
+    }
+
+    static void appendBadTrace(const StreamRecord& record, const std::exception& error,
+                               std::string& output) {
+        output += "<bad trace ";
+        output += formatGuid(record.guid);
+        output += ": ";
+        output += error.what();
+        output += '>';
+    }
+
+    const TraceInfo& m_trace;
+    std::vector<std::string> m_keywords;
+    /// The level and location columns of text lines, including their separators
+    std::string m_textPrefix;
+    /// The end of the time, and the level, location and message keys of JSON objects
+    std::string m_jsonFields;
+
+    std::optional<std::string> m_error;
+    std::vector<FormatPart> m_parts;
+    std::vector<FormatSpec> m_partSpecs;
+    std::vector<bool> m_usesFirstSpec;
+    bool m_isSequential = false;
+    std::vector<FormatSpec> m_argSpecs;
+    std::vector<const std::string*> m_argSpecTexts;
+    /// The quoted names of the named arguments, followed by a colon (empty for other arguments)
+    std::vector<std::string> m_argKeys;
+    bool m_hasNamedArgs = false;
+};
+
+TraceDecoder::TraceDecoder(const std::vector<TraceMetadata>& metadata, Options options)
+    : m_options(std::move(options)) {
+    for (const auto& source : metadata) {
+        for (const auto& trace : source.traces) {
+            if (isSameGuid(trace.guid, INLINE_METADATA_RECORD_GUID) ||
+                isSameGuid(trace.guid, MODULE_LOAD_RECORD_GUID)) {
+                continue;
+            }
+            m_formatters[trace.guid] = std::make_unique<TraceFormatter>(trace);
+        }
+    }
+}
+
+TraceDecoder::~TraceDecoder() = default;
+
+void TraceDecoder::decode(const StreamRecord& record, std::string& output) const {
+    // The records with reserved GUIDs have no formatters, so they're only checked for if there's
+    // no formatter
+    const auto found = m_formatters.find(record.guid);
+    const TraceFormatter* formatter = found == m_formatters.end() ? nullptr : found->second.get();
+    if (formatter == nullptr && (isSameGuid(record.guid, INLINE_METADATA_RECORD_GUID) ||
+                                 isSameGuid(record.guid, MODULE_LOAD_RECORD_GUID))) {
+        return;
+    }
+    if (!m_options.keywords.empty() &&
+        (formatter == nullptr || !formatter->hasAnyKeyword(m_options.keywords))) {
+        return;
+    }
+
+    if (formatter == nullptr) {
+        appendUnknownTrace(record, output);
+    } else if (m_options.json) {
+        formatter->appendJsonLine(record, output);
+    } else {
+        formatter->appendTextLine(record, output);
+    }
+}
+
+void TraceDecoder::appendUnknownTrace(const StreamRecord& record, std::string& output) const {
+    const auto message = "<unknown trace " + formatGuid(record.guid) + ": " +
+                         std::to_string(record.data.size) + " bytes>";
+    if (m_options.json) {
+        output += "{\"time\": \"";
+        appendTimestamp(output, record.timestamp);
+        output += "\", \"level\": \"?\", \"location\": \"?\", \"message\": ";
+        output += quoteJson(message);
+        output += ", \"args\": {}}\n";
+    } else {
+        appendTimestamp(output, record.timestamp);
+        output += ' ';
+        appendPadded(output, "?", LEVEL_WIDTH);
+        output += " ? ";
+        output += message;
+        output += '\n';
+    }
+}
+
+}  // namespace wpp::tools
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Stream.h"
+#include "TraceInfo.h"
+
+namespace wpp::tools {
+
+/**
+ * Formats a timestamp (in nanoseconds since the Unix epoch) as `YYYY-MM-DD HH:MM:SS.nnnnnnnnn`
+ * in UTC, and appends it to the output.
+ */
+void appendTimestamp(std::string& output, uint64_t timestamp);
+
+/**
+ * Decodes the records of a trace stream into lines of text (or JSON objects), the same as
+ * scripts/decode_stream.py.
+ *
+ * Decoding doesn't modify the decoder, so several threads can decode records at the same time.
+ */
+class TraceDecoder {
+public:
+    struct Options {
+        /// Write every trace as a JSON object, including its named arguments
+        bool json = false;
+        /// Only decode the traces with any of these keywords (all the traces if empty)
+        std::vector<std::string> keywords;
+    };
+
+    /**
+     * Creates a decoder of the traces of the given metadata. Traces defined by several of them are
+     * decoded using the last definition. The metadata must outlive the decoder.
+     */
+    TraceDecoder(const std::vector<TraceMetadata>& metadata, Options options);
+    ~TraceDecoder();
+
+    // Disallow copy operations
+    TraceDecoder(const TraceDecoder&) = delete;
+    TraceDecoder& operator=(const TraceDecoder&) = delete;
+
+    // Disallow move operations
+    TraceDecoder(TraceDecoder&&) = delete;
+    TraceDecoder& operator=(TraceDecoder&&) = delete;
+
+    /**
+     * The number of distinct traces known to the decoder.
+     */
+    size_t traceCount() const noexcept {
+        return m_formatters.size();
+    }
+
+    /**
+     * Appends the formatted record to the output, followed by a newline. Metadata records and
+     * traces without any of the requested keywords are skipped.
+     */
+    void decode(const StreamRecord& record, std::string& output) const;
+
+private:
+    class TraceFormatter;
+
+    struct GuidHash {
+        size_t operator()(const Guid& guid) const noexcept {
+            // The GUIDs are hashes, so their bytes are already uniformly distributed
+            size_t result;
+            std::memcpy(&result, guid.data(), sizeof(result));
+            return result;
+        }
+    };
+
+    struct GuidEqual {
+        bool operator()(const Guid& left, const Guid& right) const noexcept {
+            return isSameGuid(left, right);
+        }
+    };
+
+    void appendUnknownTrace(const StreamRecord& record, std::string& output) const;
+
+    Options m_options;
+    std::unordered_map<Guid, std::unique_ptr<TraceFormatter>, GuidHash, GuidEqual> m_formatters;
+};
+
+}  // namespace wpp::tools
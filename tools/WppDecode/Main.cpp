@@ -0,0 +1,352 @@
+/**
+ * WppDecode - a native equivalent of scripts/decode_stream.py.
+ *
+ * Decodes trace streams written by wpp::FileTraceSink, formatting every trace the same as the
+ * python decoder: the c++ format strings are rendered directly (instead of being converted to
+ * legacy TMF formats), so every format specification is supported.
+ *
+ * The metadata of the traces is read from the inline metadata records of the streams, from a
+ * symbol store (of metadata indices written by `WppExtract --symbol-store`) and from ELF files.
+ * `{:sym}` pointers are resolved using the symbol tables of the given ELF files, whose build-ids
+ * are matched with the module indices of the pointers using the module load records.
+ *
+ * The streams are split into chunks at record boundaries, which are decoded on all the cores and
+ * written in their original order - or merged in timestamp order.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "Chunks.h"
+#include "Decoder.h"
+#include "ElfFile.h"
+#include "Index.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "Stream.h"
+#include "Symbols.h"
+#include "TraceInfo.h"
+
+using namespace wpp::tools;
+
+namespace {
+
+constexpr const char USAGE[] =
+    "Usage: WppDecode <stream>... [options]\n"
+    "\n"
+    "Decodes trace streams written by wpp::FileTraceSink (see decode_stream.py), one after the\n"
+    "other.\n"
+    "\n"
+    "Options:\n"
+    "  -m, --metadata <file>         An ELF file containing the metadata of traces which were not\n"
+    "                                traced inline (can be specified multiple times).\n"
+    "  -s, --symbol-store <dir>      A directory of metadata indices, named by the build-ids of\n"
+    "                                their binaries.\n"
+    "  -y, --symbols <file>          An ELF file (or its debug file) whose symbols are used to\n"
+    "                                resolve {:sym} pointers, in addition to the symbols of the\n"
+    "                                metadata files (can be specified multiple times).\n"
+    "  -k, --keyword <name>          Only decode the traces with the given keyword, such as\n"
+    "                                Network or WPP_FLAG_1 (can be specified multiple times).\n"
+    "  -j, --json                    Write every trace as a JSON object, including its named\n"
+    "                                arguments.\n"
+    "  -o, --output <file>           Write the traces to the given file (stdout by default).\n"
+    "  --merge                       Write the traces of all the streams in timestamp order.\n"
+    "  -t, --threads <count>         The number of threads (all the cores by default).\n"
+    "  -v, --verbose                 Display verbose output.\n";
+
+/// The size of the chunks which are decoded by every thread
+constexpr const size_t CHUNK_SIZE = 4 << 20;
+
+struct Arguments {
+    std::vector<std::string> streams;
+    std::vector<std::string> metadataFiles;
+    std::vector<std::string> symbolFiles;
+    std::optional<std::string> symbolStore;
+    std::optional<std::string> outputFile;
+    TraceDecoder::Options options;
+    bool merge = false;
+    size_t threadCount = std::max(1U, std::thread::hardware_concurrency());
+    bool verbose = false;
+};
+
+std::optional<Arguments> parseArguments(int argc, char* argv[]) {
+    Arguments result;
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if ((argument == "-m" || argument == "--metadata") && hasValue) {
+            result.metadataFiles.push_back(argv[++i]);
+        } else if ((argument == "-s" || argument == "--symbol-store") && hasValue) {
+            result.symbolStore = argv[++i];
+        } else if ((argument == "-y" || argument == "--symbols") && hasValue) {
+            result.symbolFiles.push_back(argv[++i]);
+        } else if ((argument == "-k" || argument == "--keyword") && hasValue) {
+            result.options.keywords.push_back(argv[++i]);
+        } else if (argument == "-j" || argument == "--json") {
+            result.options.json = true;
+        } else if ((argument == "-o" || argument == "--output") && hasValue) {
+            result.outputFile = argv[++i];
+        } else if (argument == "--merge") {
+            result.merge = true;
+        } else if ((argument == "-t" || argument == "--threads") && hasValue) {
+            result.threadCount = std::max(1UL, std::stoul(argv[++i]));
+        } else if (argument == "-v" || argument == "--verbose") {
+            result.verbose = true;
+        } else if (!argument.empty() && argument[0] != '-') {
+            result.streams.push_back(argument);
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    if (result.streams.empty()) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+template<typename Bytes>
+std::string formatHex(const Bytes& bytes) {
+    static constexpr const char DIGITS[] = "0123456789abcdef";
+    std::string result;
+    for (const uint8_t value : bytes) {
+        result += DIGITS[value >> 4];
+        result += DIGITS[value & 0xf];
+    }
+    return result;
+}
+
+/**
+ * Parses the inline metadata records of the chunks (collected by splitStream). Records are traced
+ * once for every trace session, so they usually appear several times - and are only parsed once.
+ */
+TraceMetadata readInlineMetadata(const std::vector<StreamChunk>& chunks, size_t threadCount) {
+    std::unordered_set<std::string_view> seen;
+    std::vector<std::string> records;
+    for (const auto& chunk : chunks) {
+        for (const auto payload : chunk.metadataRecords) {
+            if (seen.insert(payload).second) {
+                records.emplace_back(payload);
+            }
+        }
+    }
+    logInfo("Found " + std::to_string(records.size()) + " inline metadata records");
+    return parseTraceMetadata(records, threadCount);
+}
+
+/**
+ * Loads the metadata indices of the given modules from a symbol store directory.
+ */
+std::vector<TraceMetadata> loadSymbolStore(const std::string& directory,
+                                           const std::vector<StreamModuleId>& modules) {
+    std::vector<TraceMetadata> result;
+    for (const auto& module : modules) {
+        const auto path = std::filesystem::path(directory) / (formatHex(module) + ".wppidx");
+        if (!std::filesystem::is_regular_file(path)) {
+            logWarning("No metadata for module " + formatHex(module) + " in the symbol store");
+            continue;
+        }
+        logInfo("Loading " + path.string());
+        MappedFile file(path.string());
+        const wpp::MetadataIndex index(file.data(), file.size());
+        if (!index.isValid()) {
+            throw std::runtime_error("Invalid metadata index " + path.string());
+        }
+        result.push_back(readMetadataIndex(index));
+    }
+    return result;
+}
+
+/**
+ * Loads the metadata of an ELF file, checking that it's one of the given modules of the stream.
+ * Files without a build-id (such as extracted metadata sections) can't be checked.
+ */
+TraceMetadata loadElfMetadata(const std::string& path, const std::vector<StreamModuleId>& modules,
+                              size_t threadCount) {
+    MappedFile file(path);
+    if (!ElfFile::isElfFile(file.data(), file.size())) {
+        throw std::runtime_error(path + " is not an ELF file");
+    }
+    const ElfFile elf(file.data(), file.size());
+    const auto buildId = readElfBuildId(elf);
+    if (!buildId.has_value()) {
+        logWarning(path + " has no build-id, assuming it matches the stream");
+    } else if (!modules.empty() && std::find(modules.begin(), modules.end(),
+                                             makeStreamModuleId(*buildId)) == modules.end()) {
+        throw std::runtime_error(path + " (build-id " + formatHex(*buildId) +
+                                 ") does not match any module of the stream");
+    }
+    return parseTraceMetadata(readElfMetadataRecords(elf), threadCount);
+}
+
+/**
+ * Loads the symbols of the given ELF files, mapped by their build-ids. Files without a build-id
+ * can't be matched with the traced modules, and are skipped.
+ */
+std::map<StreamModuleId, ModuleSymbols> loadModuleSymbols(const std::vector<std::string>& paths) {
+    std::map<StreamModuleId, ModuleSymbols> result;
+    for (const auto& path : paths) {
+        MappedFile file(path);
+        if (!ElfFile::isElfFile(file.data(), file.size())) {
+            throw std::runtime_error(path + " is not an ELF file");
+        }
+        const ElfFile elf(file.data(), file.size());
+        const auto buildId = readElfBuildId(elf);
+        if (!buildId.has_value()) {
+            logWarning(path + " has no build-id, so its symbols are not used");
+            continue;
+        }
+        ModuleSymbols symbols(std::filesystem::path(path).filename().string(), elf);
+        logInfo("Loaded " + std::to_string(symbols.size()) + " symbols of " + path);
+        result.insert_or_assign(makeStreamModuleId(*buildId), std::move(symbols));
+    }
+    return result;
+}
+
+/**
+ * Matches the module indices of every stream with the given module symbols, using the module load
+ * records of the streams.
+ */
+std::vector<StreamSymbols> readStreamSymbols(const std::vector<StreamChunk>& chunks,
+                                             size_t streamCount,
+                                             const std::map<StreamModuleId, ModuleSymbols>& modules,
+                                             size_t threadCount) {
+    struct ModuleLoad {
+        uint32_t stream;
+        uint16_t index;
+        StreamModuleId module;
+    };
+    std::vector<std::vector<ModuleLoad>> chunkLoads(chunks.size());
+    parallelFor(chunks.size(), threadCount, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const auto& chunk = chunks[i];
+            StreamReader reader(chunk.data, chunk.size, chunk.begin, chunk.end, false);
+            StreamRecord record;
+            while (reader.next(record)) {
+                if (!isSameGuid(record.guid, MODULE_LOAD_RECORD_GUID)) {
+                    continue;
+                }
+                if (const auto load = readModuleLoadRecord(record.data); load.has_value()) {
+                    chunkLoads[i].push_back(ModuleLoad{chunk.stream, load->first, load->second});
+                }
+            }
+        }
+    });
+
+    std::vector<StreamSymbols> result(streamCount, StreamSymbols(modules));
+    for (const auto& loads : chunkLoads) {
+        for (const auto& load : loads) {
+            const auto symbols = modules.find(load.module);
+            if (symbols != modules.end()) {
+                result[load.stream].addModule(load.index, symbols->second);
+            }
+        }
+    }
+    return result;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    auto arguments = parseArguments(argc, argv);
+    if (!arguments.has_value()) {
+        std::cerr << USAGE;
+        return 2;
+    }
+    setVerbose(arguments->verbose);
+
+    FILE* output = stdout;
+    try {
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::unique_ptr<MappedFile>> streams;
+        std::vector<StreamChunk> chunks;
+        std::vector<StreamModuleId> modules;
+        size_t totalSize = 0;
+        for (const auto& path : arguments->streams) {
+            const auto& stream = *streams.emplace_back(std::make_unique<MappedFile>(path));
+            const auto header = readStreamHeader(stream.data(), stream.size());
+            for (const auto& module : header.modules) {
+                logInfo("Traced module: " + formatHex(module));
+                if (std::find(modules.begin(), modules.end(), module) == modules.end()) {
+                    modules.push_back(module);
+                }
+            }
+            for (auto& chunk :
+                 splitStream(stream.data(), stream.size(), header.size,
+                             static_cast<uint32_t>(streams.size() - 1), CHUNK_SIZE,
+                             arguments->threadCount)) {
+                chunks.push_back(std::move(chunk));
+            }
+            totalSize += stream.size();
+        }
+        logInfo("Split " + std::to_string(totalSize) + " bytes into " +
+                std::to_string(chunks.size()) + " chunks");
+
+        // Records may be traced before the metadata traced by another thread, so all the metadata
+        // is parsed before any trace is decoded. Later sources override earlier ones.
+        std::vector<TraceMetadata> metadata;
+        metadata.push_back(readInlineMetadata(chunks, arguments->threadCount));
+        if (arguments->symbolStore.has_value()) {
+            for (auto& source : loadSymbolStore(*arguments->symbolStore, modules)) {
+                metadata.push_back(std::move(source));
+            }
+        }
+        for (const auto& path : arguments->metadataFiles) {
+            metadata.push_back(loadElfMetadata(path, modules, arguments->threadCount));
+        }
+        const TraceDecoder decoder(metadata, std::move(arguments->options));
+        logInfo("Found " + std::to_string(decoder.traceCount()) + " traces in " +
+                std::to_string(secondsSince(start)) + " seconds");
+
+        // The metadata files are usually the traced binaries, so their symbols are used as well
+        auto symbolFiles = arguments->metadataFiles;
+        symbolFiles.insert(symbolFiles.end(), arguments->symbolFiles.begin(),
+                           arguments->symbolFiles.end());
+        const auto moduleSymbols = loadModuleSymbols(symbolFiles);
+        std::vector<StreamSymbols> symbols;
+        if (!moduleSymbols.empty()) {
+            symbols = readStreamSymbols(chunks, streams.size(), moduleSymbols,
+                                        arguments->threadCount);
+        }
+
+        if (arguments->outputFile.has_value()) {
+            output = std::fopen(arguments->outputFile->c_str(), "wb");
+            if (output == nullptr) {
+                throw std::runtime_error("Failed to open " + *arguments->outputFile);
+            }
+        }
+
+        if (arguments->merge) {
+            writeMergedChunks(chunks, decoder, symbols, arguments->threadCount, output);
+        } else {
+            writeChunks(chunks, decoder, symbols, arguments->threadCount, output);
+        }
+        if (std::fflush(output) != 0 || std::ferror(output)) {
+            throw std::runtime_error("Failed to write the output");
+        }
+        logInfo("Decoded " + std::to_string(totalSize) + " bytes in " +
+                std::to_string(secondsSince(start)) + " seconds");
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (output != stdout) {
+        std::fclose(output);
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include "Stream.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "Log.h"
+#include "Parallel.h"
+#include "wpp/FileTraceSink.h"
+#include "wpp/InlineMetadata.h"
+#include "wpp/SymbolItems.h"
+
+namespace wpp::tools {
+
+namespace {
+
+/**
+ * Converts a GUID (as written by the traced process) to a UUID in big-endian (textual) byte order,
+ * by swapping the bytes of its first 3 fields.
+ */
+Guid toGuid(const GUID& guid) {
+    static_assert(sizeof(Guid) == sizeof(GUID));
+    Guid result;
+    std::memcpy(result.data(), &guid, result.size());
+    std::reverse(result.begin(), result.begin() + 4);
+    std::swap(result[4], result[5]);
+    std::swap(result[6], result[7]);
+    return result;
+}
+
+/**
+ * Finds the next record magic at or after the given position, returning the size of the data if
+ * there is none.
+ */
+size_t findRecordMagic(const uint8_t* data, size_t size, size_t position) {
+    uint8_t magic[sizeof(TRACE_STREAM_RECORD_MAGIC)];
+    std::memcpy(magic, &TRACE_STREAM_RECORD_MAGIC, sizeof(magic));
+    while (position + sizeof(magic) <= size) {
+        const void* candidate = std::memchr(data + position, magic[0], size - position);
+        if (candidate == nullptr) {
+            break;
+        }
+        position = static_cast<size_t>(static_cast<const uint8_t*>(candidate) - data);
+        if (position + sizeof(magic) <= size &&
+            std::memcmp(data + position, magic, sizeof(magic)) == 0) {
+            return position;
+        }
+        ++position;
+    }
+    return size;
+}
+
+}  // namespace
+
+const Guid INLINE_METADATA_RECORD_GUID = toGuid(INLINE_METADATA_GUID);
+const Guid MODULE_LOAD_RECORD_GUID = toGuid(MODULE_LOAD_GUID);
+
+StreamModuleId makeStreamModuleId(const std::vector<uint8_t>& buildId) {
+    StreamModuleId result{};
+    std::copy_n(buildId.begin(), std::min(buildId.size(), result.size()), result.begin());
+    return result;
+}
+
+StreamHeader readStreamHeader(const uint8_t* data, size_t size) {
+    TraceStreamHeader header{};
+    if (size < sizeof(header)) {
+        throw std::runtime_error("Not a trace stream");
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != TRACE_STREAM_MAGIC) {
+        throw std::runtime_error("Not a trace stream");
+    }
+    if (header.version != 1 && header.version != TRACE_STREAM_VERSION) {
+        throw std::runtime_error("Unsupported trace stream version " +
+                                 std::to_string(header.version));
+    }
+
+    StreamHeader result{header.headerSize, {}};
+    if (header.version >= 2) {
+        size_t position = sizeof(header);
+        for (uint32_t i = 0; i < header.moduleCount; ++i) {
+            StreamModuleId module{};
+            if (position + module.size() > size) {
+                throw std::runtime_error("Truncated trace stream header");
+            }
+            std::memcpy(module.data(), data + position, module.size());
+            result.modules.push_back(module);
+            position += module.size();
+        }
+    }
+    return result;
+}
+
+bool StreamReader::next(StreamRecord& record) {
+    TraceStreamRecordHeader header;
+    while (m_position < m_limit && m_position <= m_size && m_size - m_position >= sizeof(header)) {
+        std::memcpy(&header, m_data + m_position, sizeof(header));
+        const size_t dataStart = m_position + sizeof(header);
+        if (header.magic != TRACE_STREAM_RECORD_MAGIC || m_size - dataStart < header.size) {
+            // Skip to the next record
+            if (m_logBadRecords) {
+                char offset[32];
+                std::snprintf(offset, sizeof(offset), "0x%zx", m_position);
+                logWarning(std::string("Bad record at offset ") + offset + ", skipping...");
+            }
+            m_position = findRecordMagic(m_data, m_size, m_position + 1);
+            continue;
+        }
+
+        record.timestamp = header.timestamp;
+        record.guid = toGuid(header.messageGuid);
+        record.data = TraceData{m_data + dataStart, header.size};
+        m_position = dataStart + header.size;
+        return true;
+    }
+    return false;
+}
+
+std::vector<StreamChunk> splitStream(const uint8_t* data, size_t size, size_t headerSize,
+                                     uint32_t stream, size_t chunkSize, size_t threadCount) {
+    const size_t recordsSize = size > headerSize ? size - headerSize : 0;
+    const size_t chunkCount = std::max<size_t>(1, (recordsSize + chunkSize - 1) / chunkSize);
+    std::vector<StreamChunk> chunks(chunkCount);
+    std::vector<size_t> ends(chunkCount);
+
+    // Reads the records of a chunk from its begin position, returning the position after them
+    const auto readChunk = [data, size](StreamChunk& chunk) {
+        StreamReader reader(data, size, chunk.begin, chunk.end, false);
+        StreamRecord record;
+        chunk.minTimestamp = UINT64_MAX;
+        chunk.metadataRecords.clear();
+        while (reader.next(record)) {
+            chunk.minTimestamp = std::min(chunk.minTimestamp, record.timestamp);
+            if (isSameGuid(record.guid, INLINE_METADATA_RECORD_GUID)) {
+                chunk.metadataRecords.emplace_back(
+                    reinterpret_cast<const char*>(record.data.data), record.data.size);
+            }
+        }
+        return reader.position();
+    };
+
+    // The chunks are first read from the first record magic after their nominal start, in parallel
+    parallelFor(chunkCount, threadCount, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const size_t nominalBegin = headerSize + i * chunkSize;
+            const size_t nominalEnd = i + 1 == chunkCount ? size : nominalBegin + chunkSize;
+            const size_t first = i == 0 ? headerSize : findRecordMagic(data, size, nominalBegin);
+            chunks[i] = StreamChunk{data, size, stream, first, nominalEnd, UINT64_MAX, {}};
+            ends[i] = readChunk(chunks[i]);
+        }
+    });
+
+    // A chunk which didn't start where the previous one ended (because of a magic inside a record,
+    // a bad record or a record spanning the whole chunk) is read again from there
+    for (size_t i = 1; i < chunkCount; ++i) {
+        if (chunks[i].begin != ends[i - 1]) {
+            chunks[i].begin = ends[i - 1];
+            ends[i] = readChunk(chunks[i]);
+        }
+    }
+
+    chunks.erase(std::remove_if(chunks.begin(), chunks.end(),
+                                [](const auto& chunk) { return chunk.begin >= chunk.end; }),
+                 chunks.end());
+    return chunks;
+}
+
+}  // namespace wpp::tools
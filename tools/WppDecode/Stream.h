@@ -0,0 +1,138 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+#include "TraceInfo.h"
+#include "TraceItems.h"
+
+namespace wpp::tools {
+
+/**
+ * Pads or truncates a raw build-id to the size used by the stream header.
+ */
+StreamModuleId makeStreamModuleId(const std::vector<uint8_t>& buildId);
+
+/**
+ * The header of a trace stream written by wpp::FileTraceSink (see wpp/FileTraceSink.h).
+ */
+struct StreamHeader {
+    /// The size of the header, after which the records start
+    size_t size;
+    /// The build-ids of the traced modules (version 1 streams have no modules)
+    std::vector<StreamModuleId> modules;
+};
+
+/**
+ * Reads the header of a trace stream, throwing a std::runtime_error if it's not a supported
+ * trace stream.
+ */
+StreamHeader readStreamHeader(const uint8_t* data, size_t size);
+
+/**
+ * A single record of a trace stream. The data points into the stream.
+ */
+struct StreamRecord {
+    /// The time in which the record was written, in nanoseconds since the Unix epoch
+    uint64_t timestamp;
+    Guid guid;
+    TraceData data;
+};
+
+/**
+ * Compares two GUIDs. Records are compared with several GUIDs, and comparing the arrays directly
+ * calls memcmp.
+ */
+inline bool isSameGuid(const Guid& left, const Guid& right) noexcept {
+    uint64_t leftWords[2];
+    uint64_t rightWords[2];
+    std::memcpy(leftWords, left.data(), sizeof(leftWords));
+    std::memcpy(rightWords, right.data(), sizeof(rightWords));
+    return ((leftWords[0] ^ rightWords[0]) | (leftWords[1] ^ rightWords[1])) == 0;
+}
+
+/**
+ * The message GUID of inline metadata records (wpp::INLINE_METADATA_GUID).
+ */
+extern const Guid INLINE_METADATA_RECORD_GUID;
+
+/**
+ * The message GUID of module load records (wpp::MODULE_LOAD_GUID).
+ */
+extern const Guid MODULE_LOAD_RECORD_GUID;
+
+/**
+ * Reads the records of a trace stream in order. Bad records (such as a record truncated by a crash)
+ * are skipped by searching for the next record magic, the same as scripts/decode_stream.py.
+ */
+class StreamReader {
+public:
+    /**
+     * Reads the records starting at the given position of the stream (usually the header size),
+     * and before the given limit (records may end after it). Skipped records are logged as
+     * warnings, unless `logBadRecords` is false.
+     */
+    StreamReader(const uint8_t* data, size_t size, size_t position, size_t limit,
+                 bool logBadRecords = true)
+        : m_data(data),
+          m_size(size),
+          m_position(position),
+          m_limit(limit),
+          m_logBadRecords(logBadRecords) {
+        // Intentionally left blank.
+    }
+
+    /**
+     * Reads the next record, returning false at the end of the stream (or at the limit).
+     */
+    bool next(StreamRecord& record);
+
+    /**
+     * The position of the next record, which is at or after the limit once all the records were
+     * read.
+     */
+    size_t position() const noexcept {
+        return m_position;
+    }
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_position;
+    size_t m_limit;
+    bool m_logBadRecords;
+};
+
+/**
+ * A range of records of a trace stream, which is decoded independently of the other chunks.
+ */
+struct StreamChunk {
+    /// The data of the whole stream
+    const uint8_t* data;
+    size_t size;
+    /// The index of the stream, when decoding several streams
+    uint32_t stream;
+    /// The position of the first record of the chunk
+    size_t begin;
+    /// The chunk contains the records starting before this position
+    size_t end;
+    /// The earliest timestamp of the records of the chunk (UINT64_MAX if it has no records)
+    uint64_t minTimestamp;
+    /// The payloads of the inline metadata records of the chunk, which point into the stream
+    std::vector<std::string_view> metadataRecords;
+};
+
+/**
+ * Splits the records of a trace stream (following its header) into chunks of about the given
+ * size, on the given number of threads. Every chunk starts at the record which the previous chunk
+ * ends before, so the chunks contain exactly the records read by a single StreamReader - even if
+ * the record magic appears inside the data of other records. Empty chunks are omitted.
+ *
+ * The inline metadata records are collected while splitting, so finding them doesn't take another
+ * pass over the records.
+ */
+std::vector<StreamChunk> splitStream(const uint8_t* data, size_t size, size_t headerSize,
+                                     uint32_t stream, size_t chunkSize, size_t threadCount);
+
+}  // namespace wpp::tools
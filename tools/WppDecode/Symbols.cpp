@@ -0,0 +1,105 @@
+#include "Symbols.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <tuple>
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#define WPP_HAS_CXXABI 1
+#endif
+
+namespace wpp::tools {
+
+namespace {
+
+/**
+ * Demangles a C++ symbol name the same as `c++filt`, leaving other names as they are.
+ */
+std::string demangle(std::string_view name) {
+#ifdef WPP_HAS_CXXABI
+    if (name.substr(0, 2) == "_Z") {
+        const std::string mangled(name);
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+        if (demangled != nullptr) {
+            std::string result = demangled;
+            std::free(demangled);
+            return result;
+        }
+    }
+#endif
+    return std::string(name);
+}
+
+}  // namespace
+
+ModuleSymbols::ModuleSymbols(std::string name, const ElfFile& elf) : m_name(std::move(name)) {
+    // Duplicate symbols (such as local symbols of several files) are removed, keeping the smallest
+    auto symbols = readElfSymbols(elf);
+    std::sort(symbols.begin(), symbols.end(), [](const ElfSymbol& left, const ElfSymbol& right) {
+        return std::tie(left.address, left.name, left.size) <
+               std::tie(right.address, right.name, right.size);
+    });
+    symbols.erase(std::unique(symbols.begin(), symbols.end(),
+                              [](const ElfSymbol& left, const ElfSymbol& right) {
+                                  return left.address == right.address && left.name == right.name;
+                              }),
+                  symbols.end());
+
+    m_symbols.reserve(symbols.size());
+    for (const auto& symbol : symbols) {
+        m_symbols.push_back(Symbol{symbol.address, symbol.size, demangle(symbol.name)});
+    }
+}
+
+bool ModuleSymbols::appendSymbol(uint64_t offset, std::string& output) const {
+    // Find the last symbol starting at or before the offset
+    const auto next = std::upper_bound(
+        m_symbols.begin(), m_symbols.end(), offset,
+        [](uint64_t value, const Symbol& symbol) { return value < symbol.address; });
+    if (next == m_symbols.begin()) {
+        return false;
+    }
+    const auto& symbol = *std::prev(next);
+    const uint64_t displacement = offset - symbol.address;
+    if (displacement != 0 && displacement >= symbol.size) {
+        return false;
+    }
+
+    output += m_name;
+    output += '!';
+    output += symbol.name;
+    if (displacement != 0) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "+0x%llx",
+                      static_cast<unsigned long long>(displacement));
+        output += text;
+    }
+    return true;
+}
+
+bool StreamSymbols::appendSymbol(uint16_t moduleIndex, uint64_t offset,
+                                 std::string& output) const {
+    const auto module = m_modules.find(moduleIndex);
+    return module != m_modules.end() && module->second->appendSymbol(offset, output);
+}
+
+bool StreamSymbols::appendSymbol(const StreamModuleId& module, uint64_t offset,
+                                 std::string& output) const {
+    const auto symbols = m_symbols->find(module);
+    return symbols != m_symbols->end() && symbols->second.appendSymbol(offset, output);
+}
+
+std::optional<std::pair<uint16_t, StreamModuleId>> readModuleLoadRecord(TraceData data) {
+    // A 16-bit module index, followed by the build-id as a size-prefixed buffer
+    StreamModuleId module{};
+    constexpr const size_t RECORD_SIZE = 2 * sizeof(uint16_t) + sizeof(module);
+    if (data.size != RECORD_SIZE || (data.data[2] | (data.data[3] << 8)) != sizeof(module)) {
+        return std::nullopt;
+    }
+    std::memcpy(module.data(), data.data + 2 * sizeof(uint16_t), sizeof(module));
+    return std::make_pair(static_cast<uint16_t>(data.data[0] | (data.data[1] << 8)), module);
+}
+
+}  // namespace wpp::tools
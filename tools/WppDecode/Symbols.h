@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "ElfFile.h"
+#include "Stream.h"
+#include "TraceItems.h"
+
+namespace wpp::tools {
+
+/**
+ * The function and object symbols of an ELF module (or of its separate debug file), used to resolve
+ * `{:sym}` pointers. Symbols are looked up by the address ranges of the symbol table, so pointers
+ * to global objects are resolved as well as pointers to functions.
+ */
+class ModuleSymbols {
+public:
+    /**
+     * Reads the symbols of the given ELF file, demangling their names. The symbols are printed as
+     * `name!symbol`, where the name is usually the file name of the module.
+     */
+    ModuleSymbols(std::string name, const ElfFile& elf);
+
+    const std::string& name() const noexcept {
+        return m_name;
+    }
+
+    size_t size() const noexcept {
+        return m_symbols.size();
+    }
+
+    /**
+     * Appends `name!symbol` (or `name!symbol+0x<displacement>`) for the symbol containing the
+     * given module offset, returning false if no symbol contains it.
+     */
+    bool appendSymbol(uint64_t offset, std::string& output) const;
+
+private:
+    struct Symbol {
+        uint64_t address;
+        uint64_t size;
+        std::string name;
+    };
+
+    std::string m_name;
+    /// Sorted by address, and then by the mangled name (the same as scripts/elf_parser.py)
+    std::vector<Symbol> m_symbols;
+};
+
+/**
+ * Resolves the `{:sym}` pointers and `{:stack}` frames of a single stream. Module indices are
+ * assigned by the traced process, which reports them using module load records (see
+ * wpp::internal::traceModuleLoads), while stack frames refer to the build-ids of their modules.
+ */
+class StreamSymbols : public SymbolResolver {
+public:
+    explicit StreamSymbols(const std::map<StreamModuleId, ModuleSymbols>& modules)
+        : m_symbols(&modules) {
+        // Intentionally left blank.
+    }
+
+    void addModule(uint16_t index, const ModuleSymbols& symbols) {
+        m_modules[index] = &symbols;
+    }
+
+    bool appendSymbol(uint16_t moduleIndex, uint64_t offset, std::string& output) const override;
+
+    bool appendSymbol(const StreamModuleId& module, uint64_t offset,
+                      std::string& output) const override;
+
+private:
+    const std::map<StreamModuleId, ModuleSymbols>* m_symbols;
+    std::unordered_map<uint16_t, const ModuleSymbols*> m_modules;
+};
+
+/**
+ * Reads the module index and the build-id reported by a module load record, or returns nullopt if
+ * the record is malformed.
+ */
+std::optional<std::pair<uint16_t, StreamModuleId>> readModuleLoadRecord(TraceData data);
+
+}  // namespace wpp::tools
@@ -0,0 +1,105 @@
+#include "Cache.h"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include "Index.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "wpp/Md5.h"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace wpp::tools {
+
+namespace {
+
+constexpr const char ENTRY_EXTENSION[] = ".wppidx";
+
+unsigned long getProcessId() {
+#ifdef _WIN32
+    return static_cast<unsigned long>(_getpid());
+#else
+    return static_cast<unsigned long>(getpid());
+#endif
+}
+
+}  // namespace
+
+MetadataCache::MetadataCache(std::filesystem::path directory) : m_directory(std::move(directory)) {
+    std::filesystem::create_directories(m_directory);
+}
+
+std::string MetadataCache::makeKey(const uint8_t* data, size_t size) {
+    // The index version is a part of the key, so entries of older versions are never loaded.
+    std::string content = "WPPI" + std::to_string(METADATA_INDEX_VERSION) + ":";
+    content.append(reinterpret_cast<const char*>(data), size);
+    const auto sum = internal::md5::md5Sum(content.data(), content.size());
+
+    char result[33];
+    std::snprintf(result, sizeof(result), "%08x%08x%08x%08x", sum.a, sum.b, sum.c, sum.d);
+    return result;
+}
+
+std::optional<TraceMetadata> MetadataCache::load(const std::string& key) const {
+    const auto path = entryPath(key);
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(path, error) ||
+        std::filesystem::file_size(path, error) == 0) {
+        return std::nullopt;
+    }
+
+    try {
+        MappedFile file(path.string());
+        const MetadataIndex index(file.data(), file.size());
+        if (!index.isValid()) {
+            logWarning("Ignoring the invalid cache entry " + path.string());
+            return std::nullopt;
+        }
+        return readMetadataIndex(index);
+    } catch (const std::exception& e) {
+        logWarning("Ignoring the cache entry " + path.string() + ": " + e.what());
+        return std::nullopt;
+    }
+}
+
+void MetadataCache::store(const std::string& key, const TraceMetadata& metadata) const {
+    static std::atomic<size_t> s_tempCounter{0};
+
+    const auto index = writeMetadataIndex(metadata);
+    const auto path = entryPath(key);
+    // Several processes may share the cache directory, so the temporary file is unique to the
+    // process as well as to the thread.
+    auto tempPath = path;
+    tempPath += "." + std::to_string(getProcessId()) + "." +
+                std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "." +
+                std::to_string(s_tempCounter++) + ".tmp";
+    {
+        std::ofstream output(tempPath, std::ios::binary);
+        output.write(reinterpret_cast<const char*>(index.data()),
+                     static_cast<std::streamsize>(index.size()));
+        if (!output) {
+            throw std::runtime_error("Failed to write " + tempPath.string());
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        // Another process may have stored the same entry - which is just as good.
+        std::filesystem::remove(tempPath, error);
+    }
+}
+
+std::filesystem::path MetadataCache::entryPath(const std::string& key) const {
+    return m_directory / (key + ENTRY_EXTENSION);
+}
+
+}  // namespace wpp::tools
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include "TraceInfo.h"
+
+namespace wpp::tools {
+
+/**
+ * A directory of cached trace metadata, keyed by the content of the metadata sections they were
+ * extracted from. Each entry is a metadata index (see wpp/MetadataIndex.h), so an object file is
+ * only parsed again when its metadata changes.
+ */
+class MetadataCache {
+public:
+    explicit MetadataCache(std::filesystem::path directory);
+
+    /**
+     * The cache key of the given metadata section content.
+     */
+    static std::string makeKey(const uint8_t* data, size_t size);
+
+    /**
+     * Returns the cached metadata of the given key, if there is a valid entry for it.
+     */
+    std::optional<TraceMetadata> load(const std::string& key) const;
+
+    /**
+     * Stores the metadata of the given key. The entry is written to a temporary file first, so
+     * concurrent builds never read partial entries.
+     */
+    void store(const std::string& key, const TraceMetadata& metadata) const;
+
+private:
+    std::filesystem::path entryPath(const std::string& key) const;
+
+    std::filesystem::path m_directory;
+};
+
+}  // namespace wpp::tools
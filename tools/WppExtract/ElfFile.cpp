@@ -0,0 +1,277 @@
+#include "ElfFile.h"
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include "wpp/Metadata.h"
+
+namespace wpp::tools {
+
+namespace {
+
+constexpr const uint8_t ELF_MAGIC[] = {0x7f, 'E', 'L', 'F'};
+constexpr const uint8_t ELF_CLASS_64 = 2;
+constexpr const uint8_t ELF_DATA_LITTLE_ENDIAN = 1;
+
+constexpr const uint32_t SHT_NOTE = 7;
+constexpr const uint32_t NT_GNU_BUILD_ID = 3;
+
+constexpr const uint8_t STT_OBJECT = 1;
+constexpr const uint8_t STT_FUNC = 2;
+constexpr const uint16_t SHN_UNDEF = 0;
+
+constexpr const size_t CHUNK_HEADER_WORDS = 6;
+constexpr const size_t CHUNK_WORDS = CHUNK_HEADER_WORDS + internal::METADATA_CHUNK_WORDS;
+
+std::string toHex(uint64_t value) {
+    static constexpr const char DIGITS[] = "0123456789abcdef";
+    std::string result = "0x";
+    for (int shift = 60; shift >= 0; shift -= 4) {
+        result += DIGITS[(value >> shift) & 0xf];
+    }
+    return result;
+}
+
+}  // namespace
+
+ElfFile::ElfFile(const uint8_t* data, size_t size) : m_data(data) {
+    if (!isElfFile(data, size)) {
+        throw std::runtime_error("Not an ELF file");
+    }
+
+    const bool is64 = data[4] == ELF_CLASS_64;
+    m_is64Bit = is64;
+    m_littleEndian = data[5] == ELF_DATA_LITTLE_ENDIAN;
+
+    auto read16 = [this](size_t offset) { return this->read16(m_data + offset); };
+    auto readWord = [this, is64](size_t offset) -> uint64_t {
+        return is64 ? read64(m_data + offset) : read32(m_data + offset);
+    };
+
+    const size_t headerSize = is64 ? 0x40 : 0x34;
+    if (size < headerSize) {
+        throw std::runtime_error("Truncated ELF header");
+    }
+
+    const uint64_t sectionOffset = readWord(is64 ? 0x28 : 0x20);
+    const uint16_t entrySize = read16(is64 ? 0x3a : 0x2e);
+    const uint16_t entryCount = read16(is64 ? 0x3c : 0x30);
+    const uint16_t namesIndex = read16(is64 ? 0x3e : 0x32);
+    const size_t minimalEntrySize = is64 ? 0x40 : 0x28;
+    if (entryCount == 0) {
+        return;
+    }
+    if (entrySize < minimalEntrySize || sectionOffset > size ||
+        (size - sectionOffset) / entrySize < entryCount) {
+        throw std::runtime_error("Invalid ELF section headers");
+    }
+
+    struct Header {
+        uint32_t name;
+        uint32_t type;
+        uint64_t offset;
+        uint64_t size;
+    };
+    std::vector<Header> headers;
+    headers.reserve(entryCount);
+    for (size_t i = 0; i < entryCount; ++i) {
+        const size_t entry = static_cast<size_t>(sectionOffset) + i * entrySize;
+        Header header{read32(data + entry), read32(data + entry + 4),
+                      readWord(entry + (is64 ? 0x18 : 0x10)),
+                      readWord(entry + (is64 ? 0x20 : 0x14))};
+        // Sections without data in the file (such as .bss) are treated as empty.
+        constexpr const uint32_t SHT_NOBITS = 8;
+        if (header.type == SHT_NOBITS || header.offset > size ||
+            size - header.offset < header.size) {
+            header.offset = 0;
+            header.size = 0;
+        }
+        headers.push_back(header);
+    }
+
+    std::string_view names;
+    if (namesIndex < headers.size()) {
+        names = std::string_view(reinterpret_cast<const char*>(data + headers[namesIndex].offset),
+                                 static_cast<size_t>(headers[namesIndex].size));
+    }
+
+    m_sections.reserve(headers.size());
+    for (const auto& header : headers) {
+        std::string_view name;
+        if (header.name < names.size()) {
+            name = names.substr(header.name);
+            name = name.substr(0, name.find('\0'));
+        }
+        m_sections.push_back(Section{name, header.type, data + header.offset,
+                                     static_cast<size_t>(header.size)});
+    }
+}
+
+bool ElfFile::isElfFile(const uint8_t* data, size_t size) noexcept {
+    return size >= 16 && std::memcmp(data, ELF_MAGIC, sizeof(ELF_MAGIC)) == 0;
+}
+
+const ElfFile::Section* ElfFile::findSection(std::string_view name) const noexcept {
+    for (const auto& section : m_sections) {
+        if (section.name == name) {
+            return &section;
+        }
+    }
+    return nullptr;
+}
+
+uint16_t ElfFile::read16(const uint8_t* data) const noexcept {
+    return static_cast<uint16_t>(m_littleEndian ? data[0] | (data[1] << 8)
+                                                : (data[0] << 8) | data[1]);
+}
+
+uint32_t ElfFile::read32(const uint8_t* data) const noexcept {
+    uint32_t result = 0;
+    for (size_t i = 0; i < sizeof(result); ++i) {
+        const size_t shift = m_littleEndian ? i * 8 : (sizeof(result) - 1 - i) * 8;
+        result |= static_cast<uint32_t>(data[i]) << shift;
+    }
+    return result;
+}
+
+uint64_t ElfFile::read64(const uint8_t* data) const noexcept {
+    const uint64_t first = read32(data);
+    const uint64_t second = read32(data + 4);
+    return m_littleEndian ? (first | (second << 32)) : ((first << 32) | second);
+}
+
+std::vector<std::string> readElfMetadataRecords(const ElfFile& elf) {
+    const auto* section = elf.findSection(WPP_METADATA_SECTION);
+    if (section == nullptr) {
+        throw std::runtime_error("Missing " WPP_METADATA_SECTION " section");
+    }
+
+    struct RecordInfo {
+        uint32_t size;
+        uint32_t chunkCount;
+        std::map<uint32_t, const uint8_t*> chunks;
+    };
+    // The records are kept in the order of the section.
+    std::vector<uint64_t> order;
+    std::unordered_map<uint64_t, RecordInfo> records;
+
+    const uint8_t* const end = section->data + section->size;
+    const uint8_t* position = section->data;
+    while (static_cast<size_t>(end - position) >= CHUNK_WORDS * sizeof(uint32_t)) {
+        // Skip the alignment padding between the chunks.
+        if (elf.read32(position) != internal::METADATA_MAGIC) {
+            position += sizeof(uint32_t);
+            continue;
+        }
+
+        const uint32_t size = elf.read32(position + 4);
+        const uint64_t id = elf.read32(position + 8) |
+                            (static_cast<uint64_t>(elf.read32(position + 12)) << 32);
+        const uint32_t chunkIndex = elf.read32(position + 16);
+        const uint32_t chunkCount = elf.read32(position + 20);
+        const uint8_t* data = position + CHUNK_HEADER_WORDS * sizeof(uint32_t);
+        position += CHUNK_WORDS * sizeof(uint32_t);
+
+        auto [record, isNew] = records.try_emplace(id, RecordInfo{size, chunkCount, {}});
+        if (isNew) {
+            order.push_back(id);
+        } else if (record->second.size != size || record->second.chunkCount != chunkCount) {
+            throw std::runtime_error("Record " + toHex(id) + " has conflicting sizes");
+        }
+        auto [chunk, isNewChunk] = record->second.chunks.try_emplace(chunkIndex, data);
+        if (!isNewChunk && std::memcmp(chunk->second, data, internal::METADATA_CHUNK_SIZE) != 0) {
+            throw std::runtime_error("Record " + toHex(id) + " has conflicting contents");
+        }
+    }
+
+    std::vector<std::string> result;
+    result.reserve(records.size());
+    for (const uint64_t id : order) {
+        const auto& record = records.at(id);
+        if (record.chunks.size() != record.chunkCount ||
+            record.chunks.rbegin()->first != record.chunkCount - 1) {
+            throw std::runtime_error("Record " + toHex(id) + " is incomplete");
+        }
+
+        std::string payload;
+        payload.reserve(static_cast<size_t>(record.chunkCount) * internal::METADATA_CHUNK_SIZE);
+        for (const auto& [index, data] : record.chunks) {
+            // The data words contain the payload bytes starting from the least significant byte.
+            for (size_t word = 0; word < internal::METADATA_CHUNK_WORDS; ++word) {
+                const uint32_t value = elf.read32(data + word * sizeof(uint32_t));
+                for (size_t i = 0; i < sizeof(uint32_t); ++i) {
+                    payload += static_cast<char>((value >> (i * 8)) & 0xff);
+                }
+            }
+        }
+        payload.resize(record.size);
+        result.push_back(std::move(payload));
+    }
+
+    return result;
+}
+
+std::optional<std::vector<uint8_t>> readElfBuildId(const ElfFile& elf) {
+    auto align = [](size_t size) { return (size + 3) & ~static_cast<size_t>(3); };
+    for (const auto& section : elf.sections()) {
+        if (section.type != SHT_NOTE) {
+            continue;
+        }
+
+        size_t position = 0;
+        while (position < section.size && section.size - position >= 3 * sizeof(uint32_t)) {
+            const uint32_t nameSize = elf.read32(section.data + position);
+            const uint32_t descSize = elf.read32(section.data + position + 4);
+            const uint32_t type = elf.read32(section.data + position + 8);
+            const size_t name = position + 3 * sizeof(uint32_t);
+            const size_t desc = name + align(nameSize);
+            if (desc > section.size || section.size - desc < descSize) {
+                break;
+            }
+
+            if (type == NT_GNU_BUILD_ID && nameSize == sizeof("GNU") &&
+                std::memcmp(section.data + name, "GNU", sizeof("GNU")) == 0) {
+                return std::vector<uint8_t>(section.data + desc, section.data + desc + descSize);
+            }
+            position = desc + align(descSize);
+        }
+    }
+    return std::nullopt;
+}
+
+std::vector<ElfSymbol> readElfSymbols(const ElfFile& elf) {
+    const auto* symbols = elf.findSection(".symtab");
+    const auto* names = elf.findSection(".strtab");
+    if (symbols == nullptr || symbols->size == 0) {
+        symbols = elf.findSection(".dynsym");
+        names = elf.findSection(".dynstr");
+    }
+    if (symbols == nullptr || names == nullptr) {
+        return {};
+    }
+
+    const std::string_view strings(reinterpret_cast<const char*>(names->data), names->size);
+    const bool is64 = elf.is64Bit();
+    const size_t entrySize = is64 ? 24 : 16;
+    std::vector<ElfSymbol> result;
+    for (size_t entry = 0; entry + entrySize <= symbols->size; entry += entrySize) {
+        const uint8_t* symbol = symbols->data + entry;
+        const uint32_t name = elf.read32(symbol);
+        const uint8_t type = symbol[is64 ? 4 : 12] & 0xf;
+        const uint16_t sectionIndex = elf.read16(symbol + (is64 ? 6 : 14));
+        if ((type != STT_FUNC && type != STT_OBJECT) || sectionIndex == SHN_UNDEF ||
+            name >= strings.size()) {
+            continue;
+        }
+
+        auto symbolName = strings.substr(name);
+        symbolName = symbolName.substr(0, symbolName.find('\0'));
+        const uint64_t address = is64 ? elf.read64(symbol + 8) : elf.read32(symbol + 4);
+        const uint64_t size = is64 ? elf.read64(symbol + 16) : elf.read32(symbol + 8);
+        result.push_back(ElfSymbol{address, size, symbolName});
+    }
+    return result;
+}
+
+}  // namespace wpp::tools
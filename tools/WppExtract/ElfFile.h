@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace wpp::tools {
+
+/**
+ * A minimal reader of ELF files, supporting the section headers only. The data is not copied, so
+ * it must outlive the reader.
+ */
+class ElfFile {
+public:
+    struct Section {
+        std::string_view name;
+        uint32_t type;
+        const uint8_t* data;
+        size_t size;
+    };
+
+    ElfFile(const uint8_t* data, size_t size);
+
+    static bool isElfFile(const uint8_t* data, size_t size) noexcept;
+
+    bool isLittleEndian() const noexcept {
+        return m_littleEndian;
+    }
+
+    bool is64Bit() const noexcept {
+        return m_is64Bit;
+    }
+
+    const std::vector<Section>& sections() const noexcept {
+        return m_sections;
+    }
+
+    /**
+     * Returns the section with the given name, or nullptr if there is no such section.
+     */
+    const Section* findSection(std::string_view name) const noexcept;
+
+    uint16_t read16(const uint8_t* data) const noexcept;
+    uint32_t read32(const uint8_t* data) const noexcept;
+    uint64_t read64(const uint8_t* data) const noexcept;
+
+private:
+    const uint8_t* m_data;
+    bool m_littleEndian;
+    bool m_is64Bit;
+    std::vector<Section> m_sections;
+};
+
+/**
+ * Reassembles the metadata records in the WPP_METADATA_SECTION section of the given ELF file (see
+ * wpp/Metadata.h). Each record payload is a list of null-terminated strings. Identical records
+ * emitted by several compilation units are merged.
+ */
+std::vector<std::string> readElfMetadataRecords(const ElfFile& elf);
+
+/**
+ * Reads the GNU build-id note of the given ELF file, if it has one.
+ */
+std::optional<std::vector<uint8_t>> readElfBuildId(const ElfFile& elf);
+
+/**
+ * A function or object symbol defined by an ELF file. The name points into the file data.
+ */
+struct ElfSymbol {
+    /// The virtual address of the symbol, which is also its offset from the load bias
+    uint64_t address;
+    uint64_t size;
+    std::string_view name;
+};
+
+/**
+ * Reads the defined function and object symbols of the given ELF file, from its `.symtab` section
+ * (or from its `.dynsym` section if it's stripped).
+ */
+std::vector<ElfSymbol> readElfSymbols(const ElfFile& elf);
+
+}  // namespace wpp::tools
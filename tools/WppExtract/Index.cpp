@@ -0,0 +1,99 @@
+#include "Index.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace wpp::tools {
+
+namespace {
+
+/**
+ * Converts a GUID in big-endian (textual) byte order to a GUID structure.
+ */
+GUID toGuidStruct(const Guid& guid) {
+    GUID result{};
+    result.Data1 = static_cast<uint32_t>(guid[0]) << 24 | static_cast<uint32_t>(guid[1]) << 16 |
+                   static_cast<uint32_t>(guid[2]) << 8 | guid[3];
+    result.Data2 = static_cast<uint16_t>(guid[4] << 8 | guid[5]);
+    result.Data3 = static_cast<uint16_t>(guid[6] << 8 | guid[7]);
+    std::copy(guid.begin() + 8, guid.end(), result.Data4);
+    return result;
+}
+
+/**
+ * Converts the GUID bytes of a metadata index (the GUID structure layout) to big-endian order.
+ */
+Guid fromIndexGuid(const uint8_t (&bytes)[16]) {
+    return Guid{bytes[3],  bytes[2],  bytes[1],  bytes[0],  bytes[5],  bytes[4],
+                bytes[7],  bytes[6],  bytes[8],  bytes[9],  bytes[10], bytes[11],
+                bytes[12], bytes[13], bytes[14], bytes[15]};
+}
+
+}  // namespace
+
+std::vector<uint8_t> writeMetadataIndex(const TraceMetadata& metadata) {
+    MetadataIndexWriter writer;
+    for (const auto& trace : metadata.traces) {
+        writer.addTrace({toGuidStruct(trace.guid), trace.file,
+                         static_cast<uint32_t>(std::stoul(trace.line)), trace.function, trace.flag,
+                         trace.level, trace.format, trace.args,
+                         std::vector<std::string_view>(trace.typeNames.begin(),
+                                                       trace.typeNames.end())});
+    }
+    for (const auto& [name, info] : metadata.structs) {
+        MetadataIndexWriter::Struct entry{name, static_cast<uint32_t>(info.size), {}};
+        for (const auto& field : info.fields) {
+            entry.fields.push_back({field.name, static_cast<uint32_t>(field.offset),
+                                    static_cast<uint32_t>(field.size), field.itemType});
+        }
+        writer.addStruct(entry);
+    }
+    return writer.write();
+}
+
+TraceMetadata readMetadataIndex(const MetadataIndex& index) {
+    TraceMetadata result;
+    for (size_t i = 0; i < index.structCount(); ++i) {
+        const auto& entry = index.structInfo(i);
+        const auto* fields = index.fields(entry);
+        if (fields == nullptr) {
+            throw std::runtime_error("Bad metadata index fields");
+        }
+
+        StructInfo info{std::string(index.string(entry.name)), entry.size, {}};
+        for (size_t j = 0; j < entry.fieldCount; ++j) {
+            info.fields.push_back({std::string(index.string(fields[j].name)), fields[j].offset,
+                                   fields[j].size, std::string(index.string(fields[j].type))});
+        }
+        result.structs.emplace(info.name, std::move(info));
+    }
+
+    for (size_t i = 0; i < index.traceCount(); ++i) {
+        const auto& entry = index.trace(i);
+        const auto* arguments = index.arguments(entry);
+        if (arguments == nullptr) {
+            throw std::runtime_error("Bad metadata index arguments");
+        }
+
+        TraceInfo trace{fromIndexGuid(entry.guid),
+                        std::string(index.string(entry.file)),
+                        std::to_string(entry.line),
+                        std::string(index.string(entry.function)),
+                        std::string(index.string(entry.flag)),
+                        std::string(index.string(entry.level)),
+                        std::string(index.string(entry.format)),
+                        std::string(index.string(entry.args)),
+                        {},
+                        {},
+                        {}};
+        for (size_t j = 0; j < entry.argumentCount; ++j) {
+            trace.typeNames.emplace_back(index.string(arguments[j].type));
+            trace.argTypes.push_back(makeTraceItem(trace.typeNames.back(), result.structs));
+        }
+        result.traces.push_back(std::move(trace));
+    }
+    return result;
+}
+
+}  // namespace wpp::tools
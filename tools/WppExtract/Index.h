@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "TraceInfo.h"
+#include "wpp/MetadataIndex.h"
+
+namespace wpp::tools {
+
+/**
+ * Writes the trace metadata as a binary metadata index (see wpp/MetadataIndex.h).
+ */
+std::vector<uint8_t> writeMetadataIndex(const TraceMetadata& metadata);
+
+/**
+ * Reads the trace metadata from a valid metadata index. The traces are sorted by their GUIDs.
+ */
+TraceMetadata readMetadataIndex(const MetadataIndex& index);
+
+}  // namespace wpp::tools
@@ -0,0 +1,52 @@
+#include "Log.h"
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <utility>
+
+namespace wpp::tools {
+
+namespace {
+
+std::atomic<bool> g_verbose = false;
+std::mutex g_logMutex;
+thread_local std::string t_context;
+
+void log(std::string_view level, std::string_view message) {
+    std::lock_guard lock(g_logMutex);
+    std::cerr << level;
+    if (!t_context.empty()) {
+        std::cerr << t_context << ": ";
+    }
+    std::cerr << message << std::endl;
+}
+
+}  // namespace
+
+void setVerbose(bool verbose) noexcept {
+    g_verbose = verbose;
+}
+
+void logInfo(std::string_view message) {
+    if (g_verbose) {
+        log("info: ", message);
+    }
+}
+
+void logWarning(std::string_view message) {
+    log("warning: ", message);
+}
+
+void logError(std::string_view message) {
+    log("error: ", message);
+}
+
+LogContext::LogContext(std::string context) : m_previous(std::exchange(t_context, context)) {
+    // Intentionally left blank.
+}
+
+LogContext::~LogContext() {
+    t_context = std::move(m_previous);
+}
+
+}  // namespace wpp::tools
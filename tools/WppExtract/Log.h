@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+namespace wpp::tools {
+
+/**
+ * Thread-safe logging to stderr. Info messages are only written in verbose mode.
+ */
+void setVerbose(bool verbose) noexcept;
+void logInfo(std::string_view message);
+void logWarning(std::string_view message);
+void logError(std::string_view message);
+
+/**
+ * Sets the trace logged with the warnings of the current thread, until the context is destroyed.
+ */
+class LogContext {
+public:
+    explicit LogContext(std::string context);
+    ~LogContext();
+
+    // Disallow copy operations
+    LogContext(const LogContext&) = delete;
+    LogContext& operator=(const LogContext&) = delete;
+
+    // Disallow move operations
+    LogContext(LogContext&&) = delete;
+    LogContext& operator=(LogContext&&) = delete;
+
+private:
+    std::string m_previous;
+};
+
+}  // namespace wpp::tools
@@ -0,0 +1,293 @@
+/**
+ * WppExtract - a native, multithreaded equivalent of scripts/tracepdb.py.
+ *
+ * Extracts the trace information from a PDB file (using DbgHelp, on Windows) or from the metadata
+ * section of an ELF file, and writes it as TMF files, as JSON or as a binary metadata index.
+ *
+ * Several inputs (such as the object files of a binary) may be given, in which case their metadata
+ * is merged and GUID conflicts between them are reported. The metadata of ELF inputs may be cached
+ * by content, so only the object files whose traces changed are parsed again.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Cache.h"
+#include "ElfFile.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "Output.h"
+#include "Parallel.h"
+#include "PdbFile.h"
+#include "TraceInfo.h"
+#include "wpp/Metadata.h"
+
+using namespace wpp::tools;
+
+namespace {
+
+constexpr const char USAGE[] =
+    "Usage: WppExtract <file>... (-o <directory> | -of <file> | --json <file> | --index <file> |\n"
+    "                              --symbol-store <directory>) [options]\n"
+    "\n"
+    "Extracts the trace information from a PDB file, or from the metadata section of an ELF file.\n"
+    "When several files are given (such as object files), their trace information is merged.\n"
+    "\n"
+    "Outputs:\n"
+    "  -o, --output-directory <dir>  Create a TMF file for each trace in the given directory.\n"
+    "  -of, --output-file <file>     Create a single TMF file containing all the traces.\n"
+    "  --json <file>                 Write all the trace information as JSON.\n"
+    "  --index <file>                Write all the trace information as a binary metadata index.\n"
+    "  --symbol-store <dir>          Write the metadata index to a symbol store directory, named\n"
+    "                                by the build-id of the ELF input (see decode_stream.py).\n"
+    "\n"
+    "Options:\n"
+    "  --cache <dir>                 Cache the trace information of ELF files in the given\n"
+    "                                directory, by the content of their metadata sections.\n"
+    "  -t, --threads <count>         The number of parsing threads (all the cores by default).\n"
+    "  -v, --verbose                 Display verbose output.\n";
+
+/// The size of a wpp::ModuleId, used to name the indices of symbol stores
+constexpr const size_t MODULE_ID_SIZE = 20;
+
+struct Arguments {
+    std::vector<std::string> inputs;
+    std::optional<std::string> cacheDirectory;
+    std::optional<std::string> outputDirectory;
+    std::optional<std::string> outputFile;
+    std::optional<std::string> jsonFile;
+    std::optional<std::string> indexFile;
+    std::optional<std::string> symbolStore;
+    size_t threadCount = std::max(1U, std::thread::hardware_concurrency());
+    bool verbose = false;
+};
+
+std::optional<Arguments> parseArguments(int argc, char* argv[]) {
+    Arguments result;
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if ((argument == "-o" || argument == "--output-directory") && hasValue) {
+            result.outputDirectory = argv[++i];
+        } else if ((argument == "-of" || argument == "--output-file") && hasValue) {
+            result.outputFile = argv[++i];
+        } else if (argument == "--json" && hasValue) {
+            result.jsonFile = argv[++i];
+        } else if (argument == "--index" && hasValue) {
+            result.indexFile = argv[++i];
+        } else if (argument == "--symbol-store" && hasValue) {
+            result.symbolStore = argv[++i];
+        } else if (argument == "--cache" && hasValue) {
+            result.cacheDirectory = argv[++i];
+        } else if ((argument == "-t" || argument == "--threads") && hasValue) {
+            result.threadCount = std::max(1UL, std::stoul(argv[++i]));
+        } else if (argument == "-v" || argument == "--verbose") {
+            result.verbose = true;
+        } else if (!argument.empty() && argument[0] != '-') {
+            result.inputs.push_back(argument);
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    const int outputCount = result.outputDirectory.has_value() + result.outputFile.has_value() +
+                            result.jsonFile.has_value() + result.indexFile.has_value() +
+                            result.symbolStore.has_value();
+    if (result.inputs.empty() || outputCount != 1) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+std::vector<std::string> readRecords(const std::string& path) {
+    {
+        MappedFile file(path);
+        if (ElfFile::isElfFile(file.data(), file.size())) {
+            return readElfMetadataRecords(ElfFile(file.data(), file.size()));
+        }
+    }
+    return readPdbAnnotations(path);
+}
+
+/**
+ * Extracts the trace metadata of a single input, using the cache for ELF files (if given).
+ * ELF files without trace metadata, which are common among object files, are skipped.
+ */
+std::optional<SourceMetadata> extractInput(const std::string& path, const MetadataCache* cache,
+                                           size_t threadCount, std::atomic<size_t>& cacheHits) {
+    {
+        MappedFile file(path);
+        if (ElfFile::isElfFile(file.data(), file.size())) {
+            const ElfFile elf(file.data(), file.size());
+            const auto* section = elf.findSection(WPP_METADATA_SECTION);
+            if (section == nullptr) {
+                logInfo("Skipping " + path + ", which has no trace metadata");
+                return std::nullopt;
+            }
+
+            std::string key;
+            if (cache != nullptr) {
+                key = MetadataCache::makeKey(section->data, section->size);
+                if (auto metadata = cache->load(key)) {
+                    ++cacheHits;
+                    return SourceMetadata{path, std::move(*metadata)};
+                }
+            }
+
+            auto metadata = parseTraceMetadata(readElfMetadataRecords(elf), threadCount);
+            if (cache != nullptr) {
+                cache->store(key, metadata);
+            }
+            return SourceMetadata{path, std::move(metadata)};
+        }
+    }
+    // PDB files have no per-object metadata, so they are always parsed.
+    return SourceMetadata{path, parseTraceMetadata(readPdbAnnotations(path), threadCount)};
+}
+
+/**
+ * Extracts and merges the trace metadata of all the inputs. The inputs are processed in parallel,
+ * unless there is a single input - which is parsed in parallel instead.
+ */
+TraceMetadata extractInputs(const Arguments& arguments) {
+    std::optional<MetadataCache> cache;
+    if (arguments.cacheDirectory.has_value()) {
+        cache.emplace(*arguments.cacheDirectory);
+    }
+
+    const auto& inputs = arguments.inputs;
+    const size_t innerThreadCount = inputs.size() == 1 ? arguments.threadCount : 1;
+    std::vector<std::optional<SourceMetadata>> results(inputs.size());
+    std::atomic<size_t> cacheHits{0};
+    parallelFor(inputs.size(), std::min(arguments.threadCount, inputs.size()),
+                [&](size_t, size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; ++i) {
+                        results[i] = extractInput(inputs[i], cache ? &*cache : nullptr,
+                                                  innerThreadCount, cacheHits);
+                    }
+                });
+    if (cache.has_value()) {
+        logInfo("Loaded " + std::to_string(cacheHits) + " of " + std::to_string(inputs.size()) +
+                " inputs from the cache");
+    }
+
+    std::vector<SourceMetadata> sources;
+    for (auto& result : results) {
+        if (result.has_value()) {
+            sources.push_back(std::move(*result));
+        }
+    }
+    return mergeTraceMetadata(std::move(sources));
+}
+
+/**
+ * Get the path of the metadata index of the inputs in the given symbol store. Indices are named by
+ * the build-id of the binary, padded or truncated to the size of a wpp::ModuleId (as written in
+ * trace stream headers), so exactly one of the inputs must have a build-id.
+ */
+std::filesystem::path getSymbolStorePath(const std::string& directory,
+                                         const std::vector<std::string>& inputs) {
+    std::optional<std::vector<uint8_t>> buildId;
+    for (const auto& input : inputs) {
+        MappedFile file(input);
+        if (!ElfFile::isElfFile(file.data(), file.size())) {
+            continue;
+        }
+
+        auto inputBuildId = readElfBuildId(ElfFile(file.data(), file.size()));
+        if (inputBuildId.has_value()) {
+            if (buildId.has_value() && *buildId != *inputBuildId) {
+                throw std::runtime_error("Several inputs have different build-ids");
+            }
+            buildId = std::move(inputBuildId);
+        }
+    }
+    if (!buildId.has_value()) {
+        throw std::runtime_error("None of the inputs has a build-id");
+    }
+
+    static constexpr const char DIGITS[] = "0123456789abcdef";
+    buildId->resize(MODULE_ID_SIZE, 0);
+    std::string name;
+    for (const uint8_t value : *buildId) {
+        name += DIGITS[value >> 4];
+        name += DIGITS[value & 0xf];
+    }
+    return std::filesystem::path(directory) / (name + ".wppidx");
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const auto arguments = parseArguments(argc, argv);
+    if (!arguments.has_value()) {
+        std::cerr << USAGE;
+        return 2;
+    }
+    setVerbose(arguments->verbose);
+
+    try {
+        const auto start = std::chrono::steady_clock::now();
+        TraceMetadata metadata;
+        if (arguments->inputs.size() == 1 && !arguments->cacheDirectory.has_value()) {
+            const auto records = readRecords(arguments->inputs.front());
+            logInfo("Read " + std::to_string(records.size()) + " records in " +
+                    std::to_string(secondsSince(start)) + " seconds");
+            metadata = parseTraceMetadata(records, arguments->threadCount);
+        } else {
+            metadata = extractInputs(*arguments);
+        }
+        logInfo("Found " + std::to_string(metadata.traces.size()) + " traces in " +
+                std::to_string(secondsSince(start)) + " seconds");
+
+        const auto binaryName =
+            std::filesystem::path(arguments->inputs.front()).filename().string();
+        if (arguments->outputDirectory.has_value()) {
+            writeTmfDirectory(*arguments->outputDirectory, binaryName, metadata,
+                              arguments->threadCount);
+        } else if (arguments->indexFile.has_value() || arguments->symbolStore.has_value()) {
+            std::string path;
+            if (arguments->indexFile.has_value()) {
+                path = *arguments->indexFile;
+            } else {
+                std::filesystem::create_directories(*arguments->symbolStore);
+                path = getSymbolStorePath(*arguments->symbolStore, arguments->inputs).string();
+                logInfo("Writing " + path);
+            }
+            std::ofstream output(path, std::ios::binary);
+            writeIndex(output, metadata);
+            if (!output) {
+                throw std::runtime_error("Failed to write " + path);
+            }
+        } else {
+            const auto& path = arguments->outputFile.has_value() ? *arguments->outputFile
+                                                                 : *arguments->jsonFile;
+            std::ofstream output(path);
+            if (arguments->outputFile.has_value()) {
+                writeTmfFile(output, binaryName, metadata, arguments->threadCount);
+            } else {
+                writeJson(output, metadata);
+            }
+            if (!output) {
+                throw std::runtime_error("Failed to write " + path);
+            }
+        }
+        logInfo("Done in " + std::to_string(secondsSince(start)) + " seconds");
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include "MappedFile.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace wpp::tools {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        m_file = nullptr;
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(m_file, &size)) {
+        CloseHandle(m_file);
+        throw std::runtime_error("Failed to get the size of " + path);
+    }
+    m_size = static_cast<size_t>(size.QuadPart);
+    if (m_size == 0) {
+        return;
+    }
+
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping != nullptr) {
+        m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (m_data == nullptr) {
+        if (m_mapping != nullptr) {
+            CloseHandle(m_mapping);
+        }
+        CloseHandle(m_file);
+        throw std::runtime_error("Failed to map " + path);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (m_data != nullptr) {
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+    }
+    if (m_file != nullptr) {
+        CloseHandle(m_file);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    struct stat info {};
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to get the size of " + path);
+    }
+    m_size = static_cast<size_t>(info.st_size);
+    if (m_size == 0) {
+        close(fd);
+        return;
+    }
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the file is closed.
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Failed to map " + path);
+    }
+    m_data = static_cast<const uint8_t*>(data);
+}
+
+MappedFile::~MappedFile() {
+    if (m_data != nullptr) {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+}
+
+#endif
+
+}  // namespace wpp::tools
@@ -0,0 +1,173 @@
+#include "Output.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include "Log.h"
+#include "Parallel.h"
+#include "Index.h"
+#include "Strings.h"
+
+namespace wpp::tools {
+
+namespace {
+
+/**
+ * Formats a single trace information as TMF, or returns nullopt if the trace is not supported by
+ * legacy TMF files.
+ */
+std::optional<std::string> formatTmfTrace(const std::string& binaryName, const TraceInfo& trace) {
+    LogContext context(trace.file + ":" + trace.line);
+    if (!trace.supportsLegacyFormat()) {
+        logWarning("The trace arguments are not supported by legacy tmf files, skipping...");
+        return std::nullopt;
+    }
+
+    std::string level = trace.level;
+    std::transform(level.begin(), level.end(), level.begin(),
+                   [](char c) { return static_cast<char>(std::toupper(c)); });
+    std::string function = trace.function;
+    std::replace(function.begin(), function.end(), ' ', '-');
+    std::string name = trace.fileName();
+    std::replace(name.begin(), name.end(), '.', '_');
+
+    std::ostringstream result;
+    // Real TMFs also contain a `// last updated time`
+    result << "// PDB:  "
+           << (trace.source.empty() ? binaryName
+                                    : std::filesystem::path(trace.source).filename().string())
+           << '\n';
+    result << formatGuid(trace.guid) << ' ' << trace.dirName() << " // SRC=" << trace.fileName()
+           << " MJ= MN=\n";
+    result << "#typev " << name << trace.line << " 10 " << trace.legacyFormat()
+           << " //  LEVEL=TRACE_LEVEL_" << level << " FLAGS=" << trace.flag << " FUNC=" << function
+           << '\n';
+
+    result << "{\n";
+    const auto items = trace.legacyItemNames();
+    for (size_t i = 0; i < items.size(); ++i) {
+        // `i + 10` is used as the argument id, as arguments 0..9 are reserved
+        result << "_, " << items[i] << " -- " << i + 10 << '\n';
+    }
+    result << "}\n";
+    return result.str();
+}
+
+/**
+ * The trace information of the module load records (wpp::MODULE_LOAD_GUID). They're traced without
+ * a call site, so they're added to every TMF output - legacy logs need them to resolve `{:sym}`
+ * pointers using scripts/symbolize.py.
+ */
+const TraceInfo& moduleLoadTrace() {
+    static const TraceInfo trace = [] {
+        TraceInfo result;
+        result.guid = {0x4d, 0x50, 0x50, 0x57, 0x00, 0x01, 0x30, 0x00,
+                       0x80, 0x00, 'W',  'P',  'P',  'M',  'O',  'D'};
+        result.file = "wpp/SymbolItems.h";
+        result.line = "0";
+        result.function = "wpp::internal::traceModuleLoads";
+        result.flag = "WPP_FLAG_1";
+        result.level = "None";
+        result.format = "WPP module {} loaded: {}";
+        result.args = "index, id";
+        result.typeNames = {"wpp::UInt16Item", "wpp::HexBufferItem"};
+        for (const auto& name : result.typeNames) {
+            result.argTypes.push_back(makeTraceItem(name, {}));
+        }
+        return result;
+    }();
+    return trace;
+}
+
+std::vector<std::optional<std::string>> formatTmfTraces(const std::string& binaryName,
+                                                        const TraceMetadata& metadata,
+                                                        size_t threadCount) {
+    std::vector<std::optional<std::string>> result(metadata.traces.size());
+    parallelFor(result.size(), threadCount, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            result[i] = formatTmfTrace(binaryName, metadata.traces[i]);
+        }
+    });
+    result.push_back(formatTmfTrace(binaryName, moduleLoadTrace()));
+    return result;
+}
+
+}  // namespace
+
+void writeTmfDirectory(const std::string& directory, const std::string& binaryName,
+                       const TraceMetadata& metadata, size_t threadCount) {
+    std::filesystem::create_directories(directory);
+
+    const auto traces = formatTmfTraces(binaryName, metadata, threadCount);
+    for (size_t i = 0; i < traces.size(); ++i) {
+        if (!traces[i].has_value()) {
+            continue;
+        }
+
+        const auto& guid =
+            i < metadata.traces.size() ? metadata.traces[i].guid : moduleLoadTrace().guid;
+        const auto path = std::filesystem::path(directory) / (formatGuid(guid) + ".tmf");
+        logInfo("Generating trace file: \"" + path.string() + "\"");
+        std::ofstream output(path);
+        output << *traces[i];
+        if (!output) {
+            throw std::runtime_error("Failed to write " + path.string());
+        }
+    }
+}
+
+void writeTmfFile(std::ostream& output, const std::string& binaryName,
+                  const TraceMetadata& metadata, size_t threadCount) {
+    for (const auto& trace : formatTmfTraces(binaryName, metadata, threadCount)) {
+        if (trace.has_value()) {
+            output << *trace;
+        }
+    }
+}
+
+void writeJson(std::ostream& output, const TraceMetadata& metadata) {
+    output << "{\n  \"traces\": [";
+    for (size_t i = 0; i < metadata.traces.size(); ++i) {
+        const auto& trace = metadata.traces[i];
+        output << (i == 0 ? "\n" : ",\n");
+        output << "    {\"guid\": \"" << formatGuid(trace.guid) << "\", \"file\": "
+               << quoteJson(trace.file) << ", \"line\": " << trace.line
+               << ", \"function\": " << quoteJson(trace.function)
+               << ", \"flag\": " << quoteJson(trace.flag) << ", \"level\": "
+               << quoteJson(trace.level) << ", \"format\": " << quoteJson(trace.format)
+               << ", \"args\": " << quoteJson(trace.args) << ", \"types\": [";
+        for (size_t j = 0; j < trace.typeNames.size(); ++j) {
+            output << (j == 0 ? "" : ", ") << quoteJson(trace.typeNames[j]);
+        }
+        output << "]}";
+    }
+    output << "\n  ],\n  \"structs\": [";
+
+    bool first = true;
+    for (const auto& [name, info] : metadata.structs) {
+        output << (first ? "\n" : ",\n");
+        first = false;
+        output << "    {\"name\": " << quoteJson(name) << ", \"size\": " << info.size
+               << ", \"fields\": [";
+        for (size_t j = 0; j < info.fields.size(); ++j) {
+            const auto& field = info.fields[j];
+            output << (j == 0 ? "" : ", ") << "{\"name\": " << quoteJson(field.name)
+                   << ", \"offset\": " << field.offset << ", \"size\": " << field.size
+                   << ", \"type\": " << quoteJson(field.itemType) << "}";
+        }
+        output << "]}";
+    }
+    output << "\n  ]\n}\n";
+}
+
+void writeIndex(std::ostream& output, const TraceMetadata& metadata) {
+    const auto index = writeMetadataIndex(metadata);
+    output.write(reinterpret_cast<const char*>(index.data()),
+                 static_cast<std::streamsize>(index.size()));
+}
+
+}  // namespace wpp::tools
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include "TraceInfo.h"
+
+namespace wpp::tools {
+
+/**
+ * Writes a TMF file for each trace into the given directory, named `<guid>.tmf`. Traces which are
+ * not supported by legacy TMF files are skipped. `binaryName` is the name of the PDB or ELF file,
+ * used for traces without a source (merged traces name the input which defined them).
+ */
+void writeTmfDirectory(const std::string& directory, const std::string& binaryName,
+                       const TraceMetadata& metadata, size_t threadCount);
+
+/**
+ * Writes a single TMF file containing all the traces.
+ */
+void writeTmfFile(std::ostream& output, const std::string& binaryName,
+                  const TraceMetadata& metadata, size_t threadCount);
+
+/**
+ * Writes all the trace information as JSON, including the traces which are not supported by
+ * legacy TMF files.
+ */
+void writeJson(std::ostream& output, const TraceMetadata& metadata);
+
+/**
+ * Writes all the trace information as a binary metadata index (see wpp/MetadataIndex.h).
+ */
+void writeIndex(std::ostream& output, const TraceMetadata& metadata);
+
+}  // namespace wpp::tools
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace wpp::tools {
+
+/**
+ * Calls `function(worker, begin, end)` for contiguous ranges of [0, count) on the given number of
+ * threads, where `worker` is the index of the range. Exceptions are propagated to the caller.
+ */
+template<typename Function>
+void parallelFor(size_t count, size_t threadCount, Function function) {
+    if (threadCount <= 1) {
+        function(0, 0, count);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> errors(threadCount);
+    for (size_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back([&, i]() {
+            try {
+                function(i, count * i / threadCount, count * (i + 1) / threadCount);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+}  // namespace wpp::tools
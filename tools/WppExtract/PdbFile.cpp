@@ -0,0 +1,73 @@
+#include "PdbFile.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <DbgHelp.h>
+#include <filesystem>
+
+#pragma comment(lib, "Dbghelp.lib")
+#endif
+
+namespace wpp::tools {
+
+#ifdef _WIN32
+
+namespace {
+
+/// SymTagAnnotation, from cvconst.h (which is part of the DIA SDK).
+constexpr const ULONG SYM_TAG_ANNOTATION = 8;
+
+/// The base address at which the PDB is loaded - any non-zero value will do.
+constexpr const DWORD64 DEFAULT_BASE_ADDRESS = 0x1000000;
+
+BOOL CALLBACK collectAnnotation(PSYMBOL_INFO symbolInfo, ULONG, PVOID context) {
+    auto& annotations = *static_cast<std::vector<std::string>*>(context);
+    // Each string of the annotation is null-terminated, the same as metadata record payloads.
+    annotations.emplace_back(symbolInfo->Name, symbolInfo->NameLen);
+
+    // Continue to the next annotation
+    return TRUE;
+}
+
+}  // namespace
+
+std::vector<std::string> readPdbAnnotations(const std::string& path) {
+    // DbgHelp is not thread safe, so all the annotations are collected first, and parsed later.
+    const HANDLE process = reinterpret_cast<HANDLE>(static_cast<uintptr_t>(GetCurrentThreadId()));
+    SymSetOptions(SYMOPT_CASE_INSENSITIVE | SYMOPT_UNDNAME | SYMOPT_LOAD_LINES |
+                  SYMOPT_ALLOW_ABSOLUTE_SYMBOLS | SYMOPT_AUTO_PUBLICS);
+    if (!SymInitialize(process, nullptr, FALSE)) {
+        throw std::runtime_error("Failed to initialize DbgHelp");
+    }
+
+    std::vector<std::string> annotations;
+    const auto size = static_cast<DWORD>(std::filesystem::file_size(path));
+    const auto moduleName = std::filesystem::path(path).filename().string();
+    const DWORD64 baseAddress = SymLoadModuleEx(process, nullptr, path.c_str(), moduleName.c_str(),
+                                                DEFAULT_BASE_ADDRESS, size, nullptr, 0);
+    if (baseAddress == 0) {
+        SymCleanup(process);
+        throw std::runtime_error("Failed to load " + path);
+    }
+
+    const BOOL succeeded = SymSearch(process, baseAddress, 0, SYM_TAG_ANNOTATION, nullptr, 0,
+                                     collectAnnotation, &annotations, SYMSEARCH_RECURSE);
+    SymUnloadModule64(process, baseAddress);
+    SymCleanup(process);
+    if (!succeeded) {
+        throw std::runtime_error("Failed to enumerate the annotations of " + path);
+    }
+
+    return annotations;
+}
+
+#else
+
+std::vector<std::string> readPdbAnnotations(const std::string& path) {
+    throw std::runtime_error("Reading PDB files is only supported on Windows: " + path);
+}
+
+#endif
+
+}  // namespace wpp::tools
@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace wpp::tools {
+
+/**
+ * Reads the WPP annotations of the given PDB file using DbgHelp. Each annotation is returned as a
+ * list of null-terminated strings, the same as ELF metadata record payloads.
+ *
+ * Only supported on Windows.
+ */
+std::vector<std::string> readPdbAnnotations(const std::string& path);
+
+}  // namespace wpp::tools
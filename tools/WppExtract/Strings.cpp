@@ -0,0 +1,774 @@
+#include "Strings.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace wpp::tools {
+
+namespace {
+
+constexpr const std::string_view OPEN_BRACKETS = "[({<";
+constexpr const std::string_view CLOSE_BRACKETS = "])}>";
+constexpr const std::string_view WHITESPACE = " \t\r\n";
+constexpr const std::string_view REPLACEMENT_CHARACTER = "\xef\xbf\xbd";
+
+std::string_view trim(std::string_view value) {
+    const size_t start = value.find_first_not_of(WHITESPACE);
+    if (start == std::string_view::npos) {
+        return {};
+    }
+    return value.substr(start, value.find_last_not_of(WHITESPACE) - start + 1);
+}
+
+/**
+ * Decodes a single UTF-8 code point, advancing the position. Invalid bytes are decoded as is.
+ */
+uint32_t decodeUtf8(std::string_view value, size_t& position) {
+    const auto lead = static_cast<uint8_t>(value[position++]);
+    size_t extra = 0;
+    uint32_t codePoint = lead;
+    if ((lead & 0xe0) == 0xc0) {
+        extra = 1;
+        codePoint = lead & 0x1f;
+    } else if ((lead & 0xf0) == 0xe0) {
+        extra = 2;
+        codePoint = lead & 0x0f;
+    } else if ((lead & 0xf8) == 0xf0) {
+        extra = 3;
+        codePoint = lead & 0x07;
+    }
+
+    if (position + extra > value.size()) {
+        return lead;
+    }
+    for (size_t i = 0; i < extra; ++i) {
+        const auto next = static_cast<uint8_t>(value[position + i]);
+        if ((next & 0xc0) != 0x80) {
+            return lead;
+        }
+        codePoint = (codePoint << 6) | (next & 0x3f);
+    }
+    position += extra;
+    return codePoint;
+}
+
+void appendEscape(std::string& result, uint32_t unit) {
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "\\u%04x", unit);
+    result += buffer;
+}
+
+/**
+ * Counts the code points of valid UTF-8 text, which are the bytes that don't continue a sequence.
+ */
+size_t countCodePoints(std::string_view value) {
+    return static_cast<size_t>(std::count_if(value.begin(), value.end(), [](char c) {
+        return (static_cast<uint8_t>(c) & 0xc0) != 0x80;
+    }));
+}
+
+/**
+ * Aligns the text appended to the output after `start` in the given width, where `length` is the
+ * number of code points in the text. With the `=` alignment, the padding is placed after the first
+ * `signSize` bytes of the text (its sign and base prefix).
+ */
+void align(std::string& output, size_t start, size_t length, size_t width, char fill,
+           char alignment, size_t signSize = 0) {
+    if (width <= length) {
+        return;
+    }
+
+    const size_t padding = width - length;
+    switch (alignment) {
+    case '<':
+        output.append(padding, fill);
+        break;
+    case '^':
+        output.insert(start, padding / 2, fill);
+        output.append(padding - padding / 2, fill);
+        break;
+    case '=':
+        output.insert(start + signSize, padding, fill);
+        break;
+    default:
+        output.insert(start, padding, fill);
+        break;
+    }
+}
+
+/**
+ * The fill and alignment of a number, where the `0` option sets the fill (unless given) and the `=`
+ * alignment (unless given).
+ */
+std::pair<char, char> getNumberLayout(const FormatSpec& spec) {
+    return {spec.fill != '\0' ? spec.fill : spec.zeroPadding ? '0' : ' ',
+            spec.align != '\0' ? spec.align : spec.zeroPadding ? '=' : '>'};
+}
+
+/**
+ * Groups the digits appended to the output at `start` (up to `end`), extending them with zeros up
+ * to the width when zero padding - the same as python, which groups the padding as well.
+ * `otherSize` is the size of the rest of the number (its sign and fraction).
+ */
+void groupDigits(std::string& output, size_t start, size_t end, size_t otherSize,
+                 const FormatSpec& spec, size_t groupSize) {
+    const auto [fill, alignment] = getNumberLayout(spec);
+    size_t digitCount = end - start;
+    if (fill == '0' && alignment == '=') {
+        while (otherSize + digitCount + (digitCount - 1) / groupSize < spec.width) {
+            ++digitCount;
+        }
+    }
+    output.insert(start, digitCount - (end - start), '0');
+    for (size_t i = start + digitCount; i > start + groupSize; i -= groupSize) {
+        output.insert(i - groupSize, 1, spec.grouping);
+    }
+}
+
+/**
+ * A character buffer for std::to_chars, on the stack unless a large precision requires more.
+ */
+class CharsBuffer {
+public:
+    explicit CharsBuffer(size_t size) : m_data(m_local), m_size(size) {
+        if (size > sizeof(m_local)) {
+            m_heap.resize(size);
+            m_data = m_heap.data();
+        }
+    }
+
+    template<typename... Args>
+    std::string_view convert(Args... args) {
+        const auto result = std::to_chars(m_data, m_data + m_size, args...);
+        if (result.ec != std::errc()) {
+            throw std::runtime_error("Failed to format a number");
+        }
+        return {m_data, static_cast<size_t>(result.ptr - m_data)};
+    }
+
+private:
+    char m_local[128];
+    std::vector<char> m_heap;
+    char* m_data;
+    size_t m_size;
+};
+
+/**
+ * The decimal digits of a floating point number in scientific notation, as written by
+ * std::to_chars: the leading digit, the digits following it, and the exponent of the leading digit.
+ */
+struct ScientificDigits {
+    char lead;
+    std::string_view fraction;
+    int exponent;
+};
+
+ScientificDigits splitScientific(std::string_view digits) {
+    const size_t exponentStart = digits.find('e');
+    const size_t fractionStart = digits[1] == '.' ? 2 : 1;
+    int exponent = 0;
+    std::from_chars(digits.data() + exponentStart + (digits[exponentStart + 1] == '+' ? 2 : 1),
+                    digits.data() + digits.size(), exponent);
+    return {digits[0], digits.substr(fractionStart, exponentStart - fractionStart), exponent};
+}
+
+void appendExponent(std::string& output, int exponent) {
+    output += 'e';
+    output += exponent < 0 ? '-' : '+';
+    const int magnitude = exponent < 0 ? -exponent : exponent;
+    if (magnitude < 10) {
+        output += '0';
+    }
+    char digits[8];
+    output.append(digits, std::to_chars(digits, digits + sizeof(digits), magnitude).ptr);
+}
+
+/**
+ * Appends scientific digits in python's `g` layout: fixed-point notation unless the exponent is
+ * smaller than -4 or at least `exponentLimit`. With `addDotZero`, integers in fixed-point notation
+ * are followed by `.0` (as in python's `repr`), and with `alternate` the point is always written.
+ */
+void appendGeneral(std::string& output, ScientificDigits digits, int exponentLimit,
+                   bool addDotZero, bool alternate) {
+    if (digits.exponent < -4 || digits.exponent >= exponentLimit) {
+        output += digits.lead;
+        if (!digits.fraction.empty() || alternate) {
+            output += '.';
+            output += digits.fraction;
+        }
+        appendExponent(output, digits.exponent);
+        return;
+    }
+
+    const size_t start = output.size();
+    if (digits.exponent >= 0) {
+        const auto integerSize = static_cast<size_t>(digits.exponent);
+        output += digits.lead;
+        output += digits.fraction.substr(0, integerSize);
+        if (integerSize > digits.fraction.size()) {
+            output.append(integerSize - digits.fraction.size(), '0');
+        }
+        digits.fraction.remove_prefix(std::min(integerSize, digits.fraction.size()));
+        if (!digits.fraction.empty()) {
+            output += '.';
+            output += digits.fraction;
+        }
+    } else {
+        output += "0.";
+        output.append(static_cast<size_t>(-digits.exponent - 1), '0');
+        output += digits.lead;
+        output += digits.fraction;
+    }
+
+    if (output.find('.', start) == std::string::npos) {
+        if (addDotZero) {
+            output += ".0";
+        } else if (alternate) {
+            output += '.';
+        }
+    }
+}
+
+/**
+ * Appends a finite non-negative number, using a python float format type (other than `a`).
+ */
+void appendFiniteFloat(std::string& output, double value, char type, const FormatSpec& spec) {
+    const size_t precision = spec.hasPrecision ? spec.precision : 6;
+    switch (type) {
+    case 'f':
+    case 'F': {
+        // The integer part of a double has up to 309 digits
+        CharsBuffer buffer(precision + 320);
+        output += buffer.convert(value, std::chars_format::fixed, static_cast<int>(precision));
+        if (spec.alternate && precision == 0) {
+            output += '.';
+        }
+        break;
+    }
+    case 'e':
+    case 'E': {
+        CharsBuffer buffer(precision + 16);
+        const auto digits = splitScientific(
+            buffer.convert(value, std::chars_format::scientific, static_cast<int>(precision)));
+        output += digits.lead;
+        if (!digits.fraction.empty() || spec.alternate) {
+            output += '.';
+            output += digits.fraction;
+        }
+        appendExponent(output, digits.exponent);
+        break;
+    }
+    case 'g':
+    case 'G':
+    case '\0': {
+        if (type == '\0' && !spec.hasPrecision) {
+            // The same as python's repr: the shortest digits that round-trip
+            CharsBuffer buffer(32);
+            const auto digits = buffer.convert(value, std::chars_format::scientific);
+            appendGeneral(output, splitScientific(digits), 16, true, spec.alternate);
+            break;
+        }
+
+        // Significant digits, where trailing zeros are removed unless using the alternate form.
+        // Without a type, python switches to scientific notation one digit earlier.
+        const size_t digitCount = std::max<size_t>(precision, 1);
+        CharsBuffer buffer(digitCount + 16);
+        auto digits = splitScientific(buffer.convert(value, std::chars_format::scientific,
+                                                     static_cast<int>(digitCount - 1)));
+        if (!spec.alternate) {
+            digits.fraction = digits.fraction.substr(0, digits.fraction.find_last_not_of('0') + 1);
+        }
+        appendGeneral(output, digits, static_cast<int>(digitCount) - (type == '\0' ? 1 : 0),
+                      type == '\0', spec.alternate);
+        break;
+    }
+    default:
+        throw std::runtime_error("Invalid float format type \"" + std::string(spec.type) + "\"");
+    }
+}
+
+/**
+ * Appends a number the same as python's `float.hex`.
+ */
+void appendHexFloat(std::string& output, double value, bool isUpper) {
+    static constexpr const char DIGITS[] = "0123456789abcdef";
+    const size_t start = output.size();
+    if (std::isnan(value)) {
+        output += "nan";
+    } else if (std::isinf(value)) {
+        output += value < 0 ? "-inf" : "inf";
+    } else {
+        uint64_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(bits));
+        const auto exponentBits = static_cast<int>((bits >> 52) & 0x7ff);
+        const uint64_t mantissa = bits & ((uint64_t(1) << 52) - 1);
+        if (bits >> 63) {
+            output += '-';
+        }
+        if (exponentBits == 0 && mantissa == 0) {
+            output += "0x0.0p+0";
+        } else {
+            output += exponentBits == 0 ? "0x0." : "0x1.";
+            for (int shift = 48; shift >= 0; shift -= 4) {
+                output += DIGITS[(mantissa >> shift) & 0xf];
+            }
+            // Subnormal numbers have the exponent of the smallest normal number
+            const int exponent = exponentBits == 0 ? -1022 : exponentBits - 1023;
+            output += exponent < 0 ? "p-" : "p+";
+            char digits[8];
+            output.append(digits, std::to_chars(digits, digits + sizeof(digits),
+                                                exponent < 0 ? -exponent : exponent).ptr);
+        }
+    }
+
+    if (isUpper) {
+        std::transform(output.begin() + static_cast<std::ptrdiff_t>(start), output.end(),
+                       output.begin() + static_cast<std::ptrdiff_t>(start),
+                       [](char c) { return static_cast<char>(std::toupper(c)); });
+    }
+}
+
+void appendCodePoint(std::string& output, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        output += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        output += static_cast<char>(0xc0 | (codePoint >> 6));
+        output += static_cast<char>(0x80 | (codePoint & 0x3f));
+    } else if (codePoint < 0x10000) {
+        output += static_cast<char>(0xe0 | (codePoint >> 12));
+        output += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+        output += static_cast<char>(0x80 | (codePoint & 0x3f));
+    } else {
+        output += static_cast<char>(0xf0 | (codePoint >> 18));
+        output += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+        output += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+        output += static_cast<char>(0x80 | (codePoint & 0x3f));
+    }
+}
+
+/**
+ * Returns the integer format type of the spec (without the `z` size prefix), or '\0' if the spec
+ * is not a valid integer format.
+ */
+char getIntegerType(const FormatSpec& spec) {
+    if (spec.type.empty() && spec.isValid && !spec.hasPrecision) {
+        // The common case of `{}` (or only a width or alignment)
+        return 'd';
+    }
+
+    auto type = spec.type;
+    if (!type.empty() && type[0] == 'z') {
+        type.remove_prefix(1);
+    }
+    if (!spec.isValid || type.size() > 1 || spec.hasPrecision) {
+        return '\0';
+    }
+
+    const char result = type.empty() ? 'd' : type[0];
+    if (std::string_view("dxXobB").find(result) == std::string_view::npos ||
+        (spec.grouping == ',' && result != 'd')) {
+        return '\0';
+    }
+    return result;
+}
+
+}  // namespace
+
+std::vector<std::string_view> splitArgs(std::string_view args) {
+    std::vector<std::string_view> result;
+    int depth = 0;
+    size_t start = 0;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (OPEN_BRACKETS.find(args[i]) != std::string_view::npos) {
+            ++depth;
+        } else if (CLOSE_BRACKETS.find(args[i]) != std::string_view::npos) {
+            --depth;
+        } else if (args[i] == ',' && depth == 0) {
+            result.push_back(trim(args.substr(start, i - start)));
+            start = i + 1;
+        }
+    }
+    result.push_back(trim(args.substr(start)));
+    return result;
+}
+
+std::vector<std::string_view> getTemplateArgs(std::string_view name,
+                                              std::string_view templateName) {
+    size_t start = 0;
+    if (templateName.empty()) {
+        start = name.find('<');
+    } else {
+        start = name.find(std::string(templateName) + '<');
+        if (start != std::string_view::npos) {
+            start += templateName.size();
+        }
+    }
+    if (start == std::string_view::npos) {
+        throw std::runtime_error("Missing template arguments in \"" + std::string(name) + "\"");
+    }
+    ++start;
+
+    int depth = 1;
+    for (size_t i = start; i < name.size(); ++i) {
+        if (name[i] == '<') {
+            ++depth;
+        } else if (name[i] == '>' && --depth == 0) {
+            return splitArgs(name.substr(start, i - start));
+        }
+    }
+    throw std::runtime_error("Unmatched template brackets in \"" + std::string(name) + "\"");
+}
+
+std::string_view getBaseName(std::string_view name) {
+    name = name.substr(0, name.find('<'));
+    const size_t namespaceEnd = name.rfind("wpp::");
+    if (namespaceEnd != std::string_view::npos) {
+        name = name.substr(namespaceEnd + sizeof("wpp::") - 1);
+    }
+    return name;
+}
+
+uint64_t parseInt(std::string_view value) {
+    std::string digits(trim(value));
+    while (!digits.empty() && std::string_view("uUlL").find(digits.back()) != std::string::npos) {
+        digits.pop_back();
+    }
+
+    int base = 10;
+    if (digits.size() > 2 && digits[0] == '0') {
+        switch (std::tolower(digits[1])) {
+        case 'x':
+            base = 16;
+            break;
+        case 'b':
+            base = 2;
+            break;
+        case 'o':
+            base = 8;
+            break;
+        default:
+            break;
+        }
+    }
+
+    const size_t prefix = base == 10 ? 0 : 2;
+    size_t parsed = 0;
+    uint64_t result = 0;
+    try {
+        result = std::stoull(digits.substr(prefix), &parsed, base);
+    } catch (const std::exception&) {
+        parsed = 0;
+    }
+    if (parsed == 0 || prefix + parsed != digits.size()) {
+        throw std::runtime_error("Invalid integer \"" + std::string(value) + "\"");
+    }
+    return result;
+}
+
+std::string encodeUtf8(uint32_t codePoint) {
+    std::string result;
+    appendCodePoint(result, codePoint);
+    return result;
+}
+
+void appendInteger(std::string& output, uint64_t magnitude, bool isNegative,
+                   const FormatSpec& spec) {
+    const char type = getIntegerType(spec);
+    if (type == 'd' && spec.width == 0 && spec.sign == '\0' && spec.grouping == '\0') {
+        // The common case of `{}`, formatted directly into the output
+        char digits[21];
+        char* digitsEnd = std::to_chars(digits + 1, digits + sizeof(digits), magnitude).ptr;
+        char* digitsStart = digits + 1;
+        if (isNegative) {
+            *--digitsStart = '-';
+        }
+        output.append(digitsStart, digitsEnd);
+        return;
+    }
+
+    int base = 10;
+    std::string_view prefix;
+    switch (type) {
+    case 'd':
+        break;
+    case 'x':
+    case 'X':
+        base = 16;
+        prefix = type == 'x' ? "0x" : "0X";
+        break;
+    case 'o':
+        base = 8;
+        prefix = "0o";
+        break;
+    case 'b':
+    case 'B':
+        base = 2;
+        prefix = type == 'b' ? "0b" : "0B";
+        break;
+    default:
+        throw std::runtime_error("Invalid integer format type \"" + std::string(spec.type) + "\"");
+    }
+
+    char digits[64];
+    const auto digitsEnd = std::to_chars(digits, digits + sizeof(digits), magnitude, base).ptr;
+    if (type == 'X') {
+        std::transform(digits, digitsEnd, digits,
+                       [](char c) { return static_cast<char>(std::toupper(c)); });
+    }
+
+    const size_t start = output.size();
+    if (isNegative) {
+        output += '-';
+    } else if (spec.sign == '+' || spec.sign == ' ') {
+        output += spec.sign;
+    }
+    if (spec.alternate) {
+        output += prefix;
+    }
+    const size_t signSize = output.size() - start;
+    output.append(digits, digitsEnd);
+    if (spec.grouping != '\0') {
+        groupDigits(output, start + signSize, output.size(), signSize, spec, base == 10 ? 3 : 4);
+    }
+
+    const auto [fill, alignment] = getNumberLayout(spec);
+    align(output, start, output.size() - start, spec.width, fill, alignment, signSize);
+}
+
+void appendFloat(std::string& output, double value, const FormatSpec& spec) {
+    if (!spec.isValid || spec.type.size() > 1) {
+        throw std::runtime_error("Invalid float format type \"" + std::string(spec.type) + "\"");
+    }
+
+    const char type = spec.type.empty() ? '\0' : spec.type[0];
+    if (type == 'a' || type == 'A') {
+        const size_t start = output.size();
+        appendHexFloat(output, value, type == 'A');
+        padText(output, start, spec, '>');
+        return;
+    }
+
+    const size_t start = output.size();
+    // Python ignores the sign of NaNs
+    if (std::signbit(value) && !std::isnan(value)) {
+        output += '-';
+    } else if (spec.sign == '+' || spec.sign == ' ') {
+        output += spec.sign;
+    }
+    const size_t signSize = output.size() - start;
+
+    const bool isUpper = type == 'E' || type == 'F' || type == 'G';
+    if (std::isinf(value)) {
+        output += isUpper ? "INF" : "inf";
+    } else if (std::isnan(value)) {
+        output += isUpper ? "NAN" : "nan";
+    } else {
+        appendFiniteFloat(output, std::fabs(value), type, spec);
+        if (isUpper) {
+            std::replace(output.begin() + static_cast<std::ptrdiff_t>(start), output.end(), 'e',
+                         'E');
+        }
+        if (spec.grouping != '\0') {
+            // Only the integer part is grouped
+            const size_t digitsStart = start + signSize;
+            size_t digitsEnd = digitsStart;
+            while (digitsEnd < output.size() && output[digitsEnd] >= '0' &&
+                   output[digitsEnd] <= '9') {
+                ++digitsEnd;
+            }
+            groupDigits(output, digitsStart, digitsEnd, output.size() - digitsEnd + signSize,
+                        spec, 3);
+        }
+    }
+
+    const auto [fill, alignment] = getNumberLayout(spec);
+    align(output, start, output.size() - start, spec.width, fill, alignment, signSize);
+}
+
+void appendText(std::string& output, std::string_view text, const FormatSpec& spec) {
+    if (!spec.isValid || spec.align == '=' || spec.sign != '\0' || spec.alternate ||
+        spec.grouping != '\0') {
+        throw std::runtime_error("Invalid text format");
+    }
+
+    size_t length = countCodePoints(text);
+    if (spec.hasPrecision && spec.precision < length) {
+        // Truncate the text to the given number of code points
+        size_t end = 0;
+        for (size_t count = 0; count <= spec.precision; ++end) {
+            if ((static_cast<uint8_t>(text[end]) & 0xc0) != 0x80) {
+                ++count;
+            }
+        }
+        text = text.substr(0, end - 1);
+        length = spec.precision;
+    }
+
+    const size_t start = output.size();
+    output += text;
+    const char fill = spec.fill != '\0' ? spec.fill : spec.zeroPadding ? '0' : ' ';
+    align(output, start, length, spec.width, fill, spec.align != '\0' ? spec.align : '<');
+}
+
+void padText(std::string& output, size_t start, const FormatSpec& spec, char defaultAlign) {
+    if (!spec.isValid || spec.align == '=') {
+        throw std::runtime_error("Invalid text format");
+    }
+    if (spec.width != 0) {
+        align(output, start, countCodePoints(std::string_view(output).substr(start)), spec.width,
+              spec.fill != '\0' ? spec.fill : ' ', spec.align != '\0' ? spec.align : defaultAlign);
+    }
+}
+
+void appendUtf8(std::string& output, const uint8_t* data, size_t size) {
+    // Valid sequences are copied in runs, and invalid ones are replaced by U+FFFD: either a byte
+    // which can't start a sequence, or the longest valid prefix of a sequence.
+    size_t runStart = 0;
+    size_t position = 0;
+    while (position < size) {
+        const uint8_t lead = data[position];
+        if (lead < 0x80) {
+            ++position;
+            continue;
+        }
+
+        size_t length = 0;
+        uint8_t low = 0x80;
+        uint8_t high = 0xbf;
+        if (lead >= 0xc2 && lead <= 0xdf) {
+            length = 2;
+        } else if (lead >= 0xe0 && lead <= 0xef) {
+            length = 3;
+            // Overlong sequences and surrogates
+            low = lead == 0xe0 ? 0xa0 : low;
+            high = lead == 0xed ? 0x9f : high;
+        } else if (lead >= 0xf0 && lead <= 0xf4) {
+            length = 4;
+            // Overlong sequences and code points above U+10FFFF
+            low = lead == 0xf0 ? 0x90 : low;
+            high = lead == 0xf4 ? 0x8f : high;
+        }
+
+        size_t valid = 1;
+        while (valid < length && position + valid < size) {
+            const uint8_t next = data[position + valid];
+            if (next < (valid == 1 ? low : 0x80) || next > (valid == 1 ? high : 0xbf)) {
+                break;
+            }
+            ++valid;
+        }
+        if (valid != length) {
+            output.append(reinterpret_cast<const char*>(data + runStart), position - runStart);
+            output += REPLACEMENT_CHARACTER;
+            runStart = position + valid;
+        }
+        position += valid;
+    }
+    output.append(reinterpret_cast<const char*>(data + runStart), size - runStart);
+}
+
+void appendUtf16(std::string& output, const uint8_t* data, size_t size) {
+    size_t position = 0;
+    for (; position + 1 < size; position += 2) {
+        const uint32_t unit = data[position] | (data[position + 1] << 8);
+        if (unit < 0x80) {
+            output += static_cast<char>(unit);
+        } else if (unit < 0xd800 || unit > 0xdfff) {
+            appendCodePoint(output, unit);
+        } else if (unit <= 0xdbff && position + 4 > size) {
+            // A truncated surrogate pair (including a truncated code unit)
+            output += REPLACEMENT_CHARACTER;
+            return;
+        } else if (unit <= 0xdbff && (data[position + 3] & 0xfc) == 0xdc) {
+            const uint32_t low = data[position + 2] | (data[position + 3] << 8);
+            appendCodePoint(output, 0x10000 + ((unit - 0xd800) << 10) + (low - 0xdc00));
+            position += 2;
+        } else {
+            // Unpaired surrogates
+            output += REPLACEMENT_CHARACTER;
+        }
+    }
+    if (position < size) {
+        // A truncated code unit
+        output += REPLACEMENT_CHARACTER;
+    }
+}
+
+std::string quoteJson(std::string_view value) {
+    std::string result;
+    appendQuotedJson(result, value);
+    return result;
+}
+
+void appendQuotedJson(std::string& output, std::string_view value) {
+    // The characters which are copied as is: printable ASCII characters, except quotes and
+    // backslashes
+    static constexpr const auto IS_PLAIN = []() {
+        std::array<bool, 256> result{};
+        for (size_t c = ' '; c <= '~'; ++c) {
+            result[c] = c != '"' && c != '\\';
+        }
+        return result;
+    }();
+
+    output += '"';
+    size_t position = 0;
+    while (position < value.size()) {
+        // Printable ASCII characters are copied in runs
+        size_t runEnd = position;
+        while (runEnd < value.size() && IS_PLAIN[static_cast<uint8_t>(value[runEnd])]) {
+            ++runEnd;
+        }
+        output.append(value, position, runEnd - position);
+        position = runEnd;
+        if (position == value.size()) {
+            break;
+        }
+
+        const uint32_t codePoint = decodeUtf8(value, position);
+        switch (codePoint) {
+        case '"':
+            output += "\\\"";
+            break;
+        case '\\':
+            output += "\\\\";
+            break;
+        case '\b':
+            output += "\\b";
+            break;
+        case '\f':
+            output += "\\f";
+            break;
+        case '\n':
+            output += "\\n";
+            break;
+        case '\r':
+            output += "\\r";
+            break;
+        case '\t':
+            output += "\\t";
+            break;
+        default:
+            if (codePoint < 0x20 || (codePoint >= 0x7f && codePoint < 0x10000)) {
+                appendEscape(output, codePoint);
+            } else if (codePoint >= 0x10000) {
+                // Characters outside of the BMP are escaped as UTF-16 surrogate pairs.
+                const uint32_t offset = codePoint - 0x10000;
+                appendEscape(output, 0xd800 | (offset >> 10));
+                appendEscape(output, 0xdc00 | (offset & 0x3ff));
+            } else {
+                output += static_cast<char>(codePoint);
+            }
+            break;
+        }
+    }
+    output += '"';
+}
+
+}  // namespace wpp::tools
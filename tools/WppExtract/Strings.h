@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "wpp/ParseUtils.h"
+
+/**
+ * String utilities, mostly for parsing c++ type names and function signatures as written by the
+ * compiler (matching scripts/type_names.py).
+ */
+namespace wpp::tools {
+
+/**
+ * Splits template arguments, taking into consideration (possibly nested) brackets of the given
+ * types: [], (), {}, <>. The arguments are trimmed.
+ */
+std::vector<std::string_view> splitArgs(std::string_view args);
+
+/**
+ * Returns the template arguments of the given template inside a type name or a function
+ * signature. If no template name is given, the first template in the name is used.
+ * For example, `getTemplateArgs("void f<int, A<B, C>>(void)", "f")` returns `{"int", "A<B, C>"}`.
+ */
+std::vector<std::string_view> getTemplateArgs(std::string_view name,
+                                              std::string_view templateName = {});
+
+/**
+ * Returns the unqualified name of a (possibly templated) wpp type name.
+ * For example, `struct wpp::StructItem<struct Packet>` returns `StructItem`.
+ */
+std::string_view getBaseName(std::string_view name);
+
+/**
+ * Parses an integer of an unknown base (2, 8, 10 or 16), ignoring integer suffixes such as `ul`.
+ */
+uint64_t parseInt(std::string_view value);
+
+/**
+ * Encodes a code point as UTF-8.
+ */
+std::string encodeUtf8(uint32_t codePoint);
+
+using FormatSpec = wpp::internal::FormatSpec;
+
+/**
+ * Appends an integer formatted using a c++ integer format specification, the same as python's
+ * `format` (as used by scripts/trace_items.py). The `z` size prefix is ignored, and `B` is an
+ * uppercase binary.
+ */
+void appendInteger(std::string& output, uint64_t magnitude, bool isNegative,
+                   const FormatSpec& spec);
+
+/**
+ * Appends a floating point number formatted using a parsed c++ format specification, the same as
+ * python's `format` (the `a` and `A` types are formatted as python's `float.hex`). The digits are
+ * generated by std::to_chars, which is correctly rounded - the same as python.
+ */
+void appendFloat(std::string& output, double value, const FormatSpec& spec);
+
+/**
+ * Appends UTF-8 text formatted using the layout of a format specification, the same as python's
+ * `format` of a string (which is left-aligned by default). The precision is the maximal number of
+ * code points, and the type of the spec is ignored.
+ */
+void appendText(std::string& output, std::string_view text, const FormatSpec& spec);
+
+/**
+ * Pads the text appended to the output after `start` using only the fill, alignment and width of
+ * the spec, the same as the `_pad` function of scripts/trace_items.py.
+ */
+void padText(std::string& output, size_t start, const FormatSpec& spec, char defaultAlign);
+
+/**
+ * Appends UTF-8 (or UTF-16LE) data as UTF-8, replacing invalid sequences by U+FFFD - the same as
+ * python's `decode` with `errors='replace'`.
+ */
+void appendUtf8(std::string& output, const uint8_t* data, size_t size);
+void appendUtf16(std::string& output, const uint8_t* data, size_t size);
+
+/**
+ * Quotes the given UTF-8 string as a JSON string, escaping all non-ASCII characters (the same as
+ * python's `json.dumps`).
+ */
+std::string quoteJson(std::string_view value);
+void appendQuotedJson(std::string& output, std::string_view value);
+
+}  // namespace wpp::tools
@@ -0,0 +1,587 @@
+#include "TraceInfo.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include "Log.h"
+#include "Parallel.h"
+#include "Strings.h"
+#include "wpp/Md5.h"
+
+namespace wpp::tools {
+
+namespace {
+
+/// The number of strings in the primary trace info, including the record kind.
+constexpr const size_t TRACE_INFO_SIZE = 8;
+
+constexpr const std::string_view TRACE_INFO_KIND = "TMF_NG:";
+constexpr const std::string_view TRACE_TYPES_KIND = "TMF_NG_TYPES:";
+constexpr const std::string_view TRACE_STRUCT_KIND = "TMF_NG_STRUCT:";
+
+/**
+ * Converts an md5 sum to a UUID3 value the same way as the c++ code.
+ */
+Guid md5ToUuid(const internal::md5::MD5Sum& sum) {
+    const uint32_t words[] = {sum.a, sum.b, sum.c, sum.d};
+    uint8_t digest[16];
+    for (size_t i = 0; i < 16; ++i) {
+        digest[i] = static_cast<uint8_t>(words[i / 4] >> ((i % 4) * 8));
+    }
+
+    // The first 3 fields are little-endian in the digest, and big-endian in the UUID.
+    return Guid{digest[3], digest[2], digest[1],  digest[0],  digest[5],
+                digest[4], static_cast<uint8_t>((digest[7] & 0x0f) | 0x30),
+                digest[6], digest[8], digest[9],  digest[10], digest[11],
+                digest[12], digest[13], digest[14], digest[15]};
+}
+
+std::vector<std::string_view> splitRecord(std::string_view record) {
+    std::vector<std::string_view> result;
+    size_t start = 0;
+    while (start < record.size()) {
+        const size_t end = record.find('\0', start);
+        if (end == std::string_view::npos) {
+            throw std::runtime_error("Unterminated metadata record");
+        }
+        result.push_back(record.substr(start, end - start));
+        start = end + 1;
+    }
+    return result;
+}
+
+/**
+ * Returns the path relative to its parent directory, keeping the original separator. This matches
+ * getBaseDirectoryIndex, so relative paths (such as the paths in ELF records) are kept as is.
+ */
+std::string getRelativePath(std::string_view path) {
+    const size_t nameStart = path.find_last_of("\\/");
+    if (nameStart == std::string_view::npos || nameStart == 0) {
+        return std::string(path);
+    }
+    const size_t directoryStart = path.find_last_of("\\/", nameStart - 1);
+    if (directoryStart == std::string_view::npos) {
+        return std::string(path);
+    }
+    return std::string(path.substr(directoryStart + 1));
+}
+
+StructInfo parseStructDescriptor(std::string_view signature, std::string_view fieldNames) {
+    // The signature format is:
+    // `...StructDescriptor<Type>::annotate<...StructLayout<Size, Offsets, Sizes, tuple<...>>>()`
+    const auto structName = getTemplateArgs(signature, "StructDescriptor").at(0);
+    const auto layout = getTemplateArgs(signature, "StructLayout");
+    if (layout.size() != 4) {
+        throw std::runtime_error("Bad struct layout in \"" + std::string(signature) + "\"");
+    }
+
+    // The offsets and sizes are std::integer_sequence<size_t, ...> - skip the type argument.
+    const auto offsets = getTemplateArgs(layout[1], "integer_sequence");
+    const auto sizes = getTemplateArgs(layout[2], "integer_sequence");
+    const auto items = getTemplateArgs(layout[3], "tuple");
+    const auto names = splitArgs(fieldNames);
+
+    StructInfo result{std::string(structName), parseInt(layout[0]), {}};
+    const size_t count =
+        std::min({offsets.size() - 1, sizes.size() - 1, items.size(), names.size()});
+    for (size_t i = 0; i < count; ++i) {
+        result.fields.push_back(StructInfo::Field{std::string(names[i]), parseInt(offsets[i + 1]),
+                                                  parseInt(sizes[i + 1]), std::string(items[i])});
+    }
+    return result;
+}
+
+/**
+ * The records parsed by a single thread, before they are merged.
+ */
+struct PartialMetadata {
+    std::vector<std::pair<Guid, std::vector<std::string>>> info;
+    std::vector<std::pair<Guid, std::vector<std::string>>> types;
+    std::vector<StructInfo> structs;
+};
+
+void parseRecord(std::string_view record, PartialMetadata& result) {
+    auto strings = splitRecord(record);
+    if (strings.empty()) {
+        throw std::runtime_error("Empty metadata record");
+    }
+
+    if (strings[0] == TRACE_INFO_KIND) {
+        // Primary trace info, containing the path, line, function, flag, level and arguments.
+        // ELF metadata records are followed by the types of the arguments.
+        if (strings.size() < TRACE_INFO_SIZE) {
+            throw std::runtime_error("Truncated trace info record");
+        }
+
+        // The hash uses the file directory and name (and not the full path).
+        const auto file = getRelativePath(strings[1]);
+        std::string hashed(strings[0]);
+        hashed += file;
+        for (size_t i = 2; i < TRACE_INFO_SIZE; ++i) {
+            hashed += strings[i];
+        }
+        const Guid guid = md5ToUuid(internal::md5::md5Sum(hashed.data(), hashed.size()));
+
+        std::vector<std::string> info{file};
+        info.insert(info.end(), strings.begin() + 2, strings.begin() + TRACE_INFO_SIZE);
+        result.info.emplace_back(guid, std::move(info));
+
+        if (strings.size() > TRACE_INFO_SIZE) {
+            if (strings[TRACE_INFO_SIZE] != TRACE_TYPES_KIND) {
+                throw std::runtime_error("Bad trace metadata record!");
+            }
+            std::vector<std::string> types(strings.begin() + TRACE_INFO_SIZE + 1, strings.end());
+            result.types.emplace_back(guid, std::move(types));
+        }
+    } else if (strings[0] == TRACE_TYPES_KIND && strings.size() > 1) {
+        // Secondary trace info: `...annotateArgTypes<hashA, hashB, hashC, hashD, TraceItem1, ...>`.
+        const auto args = getTemplateArgs(strings[1], "annotateArgTypes");
+        if (args.size() < 4) {
+            throw std::runtime_error("Bad type annotation \"" + std::string(strings[1]) + "\"");
+        }
+
+        // The message GUID should eventually match some primary info message hash.
+        const internal::md5::MD5Sum sum{
+            static_cast<uint32_t>(parseInt(args[0])), static_cast<uint32_t>(parseInt(args[1])),
+            static_cast<uint32_t>(parseInt(args[2])), static_cast<uint32_t>(parseInt(args[3]))};
+        result.types.emplace_back(md5ToUuid(sum),
+                                  std::vector<std::string>(args.begin() + 4, args.end()));
+    } else if (strings[0] == TRACE_STRUCT_KIND && strings.size() > 2) {
+        // The layout of a struct registered with WPP_DEFINE_STRUCT_ITEM, and its field names.
+        result.structs.push_back(parseStructDescriptor(strings[1], strings[2]));
+    } else {
+        logWarning("Skipping unexpected annotation data: " + quoteJson(record));
+    }
+}
+
+/**
+ * Parses an integer literal of a keywords expression the same as python's `int(literal, 0)`, after
+ * removing its integer suffix.
+ */
+std::optional<uint64_t> parseKeywordLiteral(std::string_view literal) {
+    const size_t suffixStart = literal.find_last_not_of("uUlL");
+    literal = literal.substr(0, suffixStart == std::string_view::npos ? 0 : suffixStart + 1);
+
+    int base = 10;
+    if (literal.size() > 2 && literal[0] == '0' &&
+        std::string_view("xXbBoO").find(literal[1]) != std::string_view::npos) {
+        base = std::tolower(literal[1]) == 'x' ? 16 : std::tolower(literal[1]) == 'b' ? 2 : 8;
+        literal.remove_prefix(2);
+    } else if (literal.size() > 1 && literal[0] == '0' &&
+               literal.find_first_not_of('0') != std::string_view::npos) {
+        // Python doesn't support octal literals without a prefix
+        return std::nullopt;
+    }
+
+    uint64_t value = 0;
+    const auto* end = literal.data() + literal.size();
+    const auto [next, error] = std::from_chars(literal.data(), end, value, base);
+    if (error != std::errc() || next != end) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+bool isIdentifierStart(char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+}
+
+bool isIdentifierChar(char c) {
+    return isIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+size_t skipSpaces(std::string_view text, size_t position) {
+    while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) {
+        ++position;
+    }
+    return position;
+}
+
+size_t skipIdentifier(std::string_view text, size_t position) {
+    while (position < text.size() && isIdentifierChar(text[position])) {
+        ++position;
+    }
+    return position;
+}
+
+/**
+ * Describes a trace for diagnostics, including the information its GUID doesn't cover.
+ */
+std::string describeTrace(const TraceInfo& trace, const std::vector<std::string>& typeNames) {
+    std::string result = trace.file + ":" + trace.line + " " + quoteJson(trace.format) + " (";
+    for (size_t i = 0; i < typeNames.size(); ++i) {
+        result += (i == 0 ? "" : ", ") + typeNames[i];
+    }
+    return result + ")";
+}
+
+std::string describeStruct(const StructInfo& info) {
+    std::string result = "size " + std::to_string(info.size) + " {";
+    for (size_t i = 0; i < info.fields.size(); ++i) {
+        const auto& field = info.fields[i];
+        result += (i == 0 ? "" : ", ") + field.name + "@" + std::to_string(field.offset) + ":" +
+                  std::to_string(field.size) + " " + field.itemType;
+    }
+    return result + "}";
+}
+
+std::string withSource(std::string_view source, const std::string& description) {
+    return source.empty() ? description : std::string(source) + ": " + description;
+}
+
+/**
+ * Merges traces and structs by their GUIDs and names. Identical definitions (such as the records of
+ * inline functions, emitted by every compilation unit using them) are merged, while conflicting
+ * definitions are reported as errors.
+ */
+class MetadataMerger {
+public:
+    void addTrace(TraceInfo trace, std::string_view source) {
+        const auto [existing, isNew] = m_traceIndices.emplace(trace.guid, m_result.traces.size());
+        if (isNew) {
+            m_result.traces.push_back(std::move(trace));
+            m_traceSources.emplace_back(source);
+            return;
+        }
+
+        const auto& other = m_result.traces[existing->second];
+        if (other.hasSameDefinition(trace)) {
+            return;
+        }
+        reportConflict("trace " + formatGuid(trace.guid),
+                       withSource(m_traceSources[existing->second],
+                                  describeTrace(other, other.typeNames)),
+                       withSource(source, describeTrace(trace, trace.typeNames)));
+    }
+
+    void addStruct(const StructInfo& info, std::string_view source) {
+        const auto [existing, isNew] = m_result.structs.emplace(info.name, info);
+        if (isNew) {
+            m_structSources.emplace(info.name, source);
+            return;
+        }
+
+        if (existing->second == info) {
+            return;
+        }
+        reportConflict("struct " + info.name,
+                       withSource(m_structSources[info.name], describeStruct(existing->second)),
+                       withSource(source, describeStruct(info)));
+    }
+
+    void reportConflict(const std::string& name, const std::string& first,
+                        const std::string& second) {
+        logError("Conflicting definitions of " + name + ":\n    " + first + "\n    " + second);
+        ++m_conflictCount;
+    }
+
+    std::vector<TraceInfo>& traces() noexcept {
+        return m_result.traces;
+    }
+
+    /**
+     * Returns the merged metadata, or throws if conflicting definitions were found.
+     */
+    TraceMetadata finish() {
+        if (m_conflictCount > 0) {
+            throw std::runtime_error("Found " + std::to_string(m_conflictCount) +
+                                     " conflicting definitions!");
+        }
+        return std::move(m_result);
+    }
+
+private:
+    TraceMetadata m_result;
+    std::map<Guid, size_t> m_traceIndices;
+    std::vector<std::string> m_traceSources;
+    std::map<std::string, std::string> m_structSources;
+    size_t m_conflictCount = 0;
+};
+
+}  // namespace
+
+std::vector<FormatPart> parseFormat(std::string_view format) {
+    std::vector<FormatPart> result;
+    std::vector<std::string_view> argNames;
+    FormatPart current;
+    for (size_t i = 0; i < format.size(); ++i) {
+        const char c = format[i];
+        if ((c == '{' || c == '}') && i + 1 < format.size() && format[i + 1] == c) {
+            current.literal += c;
+            ++i;
+        } else if (c == '}') {
+            throw std::runtime_error("Single '}' encountered in format string");
+        } else if (c == '{') {
+            const size_t end = format.find('}', i);
+            if (end == std::string_view::npos) {
+                throw std::runtime_error("Single '{' encountered in format string");
+            }
+            const auto field = format.substr(i + 1, end - i - 1);
+            const size_t specStart = field.find(':');
+            const auto name = field.substr(0, specStart);
+            if (name.find('!') != std::string_view::npos) {
+                throw std::runtime_error("Found unexpected conversion in format");
+            }
+
+            if (!name.empty() && std::all_of(name.begin(), name.end(),
+                                               [](char c) { return c >= '0' && c <= '9'; })) {
+                current.argIndex = static_cast<size_t>(parseInt(name));
+                if (current.argIndex >= argNames.size()) {
+                    argNames.resize(current.argIndex + 1);
+                }
+            } else {
+                const auto existing = std::find(argNames.begin(), argNames.end(), name);
+                current.argIndex = static_cast<size_t>(existing - argNames.begin());
+                if (name.empty() || existing == argNames.end()) {
+                    current.argIndex = argNames.size();
+                    argNames.push_back(name);
+                }
+                current.argName = std::string(name);
+            }
+            current.formatSpec = std::string(
+                specStart == std::string_view::npos ? "" : field.substr(specStart + 1));
+            result.push_back(std::move(current));
+            current = FormatPart{};
+            i = end;
+        } else {
+            current.literal += c;
+        }
+    }
+    if (!current.literal.empty()) {
+        result.push_back(std::move(current));
+    }
+    return result;
+}
+
+std::vector<std::string> getKeywordNames(std::string_view flag) {
+    std::vector<std::string> result;
+    size_t position = 0;
+    while (position < flag.size()) {
+        if (isIdentifierStart(flag[position])) {
+            // A (possibly qualified) name, which is skipped if it's followed by `(` or `<`
+            size_t nameStart = position;
+            position = skipIdentifier(flag, position);
+            size_t nameEnd = position;
+            for (;;) {
+                const size_t separator = skipSpaces(flag, nameEnd);
+                if (flag.compare(separator, 2, "::") != 0) {
+                    break;
+                }
+                const size_t next = skipSpaces(flag, separator + 2);
+                if (next == flag.size() || !isIdentifierStart(flag[next])) {
+                    break;
+                }
+                nameStart = next;
+                nameEnd = skipIdentifier(flag, next);
+            }
+            position = nameEnd;
+
+            const size_t call = skipSpaces(flag, position);
+            if (call < flag.size() && (flag[call] == '(' || flag[call] == '<')) {
+                position = call + 1;
+            } else {
+                result.emplace_back(flag.substr(nameStart, nameEnd - nameStart));
+            }
+        } else if (flag[position] >= '0' && flag[position] <= '9') {
+            const size_t end = skipIdentifier(flag, position);
+            if (const auto value = parseKeywordLiteral(flag.substr(position, end - position))) {
+                result.push_back("WPP_FLAG_" + std::to_string(*value));
+            }
+            position = end;
+        } else {
+            ++position;
+        }
+    }
+    return result;
+}
+
+std::string formatGuid(const Guid& guid) {
+    static constexpr const char DIGITS[] = "0123456789abcdef";
+    std::string result;
+    for (size_t i = 0; i < guid.size(); ++i) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) {
+            result += '-';
+        }
+        result += DIGITS[guid[i] >> 4];
+        result += DIGITS[guid[i] & 0xf];
+    }
+    return result;
+}
+
+std::string TraceInfo::fileName() const {
+    const size_t separator = file.find_last_of("\\/");
+    return separator == std::string::npos ? file : file.substr(separator + 1);
+}
+
+std::string TraceInfo::dirName() const {
+    const size_t separator = file.find_last_of("\\/");
+    return separator == std::string::npos ? std::string() : file.substr(0, separator);
+}
+
+bool TraceInfo::hasSameDefinition(const TraceInfo& other) const {
+    return guid == other.guid && file == other.file && line == other.line &&
+           function == other.function && flag == other.flag && level == other.level &&
+           format == other.format && args == other.args && typeNames == other.typeNames;
+}
+
+bool TraceInfo::supportsLegacyFormat() const {
+    return std::all_of(argTypes.begin(), argTypes.end(),
+                       [](const auto& item) { return item->supportsLegacyFormat(); });
+}
+
+std::string TraceInfo::legacyFormat() const {
+    // Legacy ids 0..9 are reserved
+    std::vector<size_t> argIds;
+    size_t argId = 10;
+    for (const auto& item : argTypes) {
+        argIds.push_back(argId);
+        argId += item->legacyItemNames().size();
+    }
+
+    std::string result = "%0 ";
+    size_t referencedCount = 0;
+    for (const auto& part : parseFormat(format)) {
+        // Escape % characters, as they are used by the legacy inserts
+        for (const char c : part.literal) {
+            result += c;
+            if (c == '%') {
+                result += c;
+            }
+        }
+        if (part.formatSpec.has_value()) {
+            if (part.argIndex >= argTypes.size()) {
+                throw std::runtime_error("Too many format specifiers!");
+            }
+            result +=
+                argTypes[part.argIndex]->legacyInsert(*part.formatSpec, argIds[part.argIndex]);
+            referencedCount = std::max(referencedCount, part.argIndex + 1);
+        }
+    }
+
+    if (referencedCount != argTypes.size()) {
+        throw std::runtime_error("Missing format specifiers!");
+    }
+
+    return quoteJson(result);
+}
+
+std::vector<std::string> TraceInfo::legacyItemNames() const {
+    std::vector<std::string> result;
+    for (const auto& item : argTypes) {
+        const auto names = item->legacyItemNames();
+        result.insert(result.end(), names.begin(), names.end());
+    }
+    return result;
+}
+
+TraceMetadata parseTraceMetadata(const std::vector<std::string>& records, size_t threadCount) {
+    threadCount = std::max<size_t>(1, std::min(threadCount, records.size()));
+    std::vector<PartialMetadata> partials(threadCount);
+    parallelFor(records.size(), threadCount, [&](size_t worker, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            parseRecord(records[i], partials[worker]);
+        }
+    });
+
+    // Merge the partial results in order, so the output doesn't depend on the number of threads.
+    MetadataMerger merger;
+    std::map<Guid, std::vector<std::vector<std::string>>> types;
+    for (auto& partial : partials) {
+        for (auto& [guid, info] : partial.info) {
+            merger.addTrace(TraceInfo{guid, std::move(info[0]), std::move(info[1]),
+                                      std::move(info[2]), std::move(info[3]), std::move(info[4]),
+                                      std::move(info[5]), std::move(info[6]), {}, {}, {}},
+                            {});
+        }
+        for (auto& [guid, typeNames] : partial.types) {
+            // The same types may be annotated by several compilation units.
+            auto& variants = types[guid];
+            if (std::find(variants.begin(), variants.end(), typeNames) == variants.end()) {
+                variants.push_back(std::move(typeNames));
+            }
+        }
+        for (const auto& info : partial.structs) {
+            merger.addStruct(info, {});
+        }
+    }
+
+    // Assert primary and secondary info was found for all the GUIDs
+    if (types.size() != merger.traces().size()) {
+        throw std::runtime_error("Bad annotations!");
+    }
+    for (auto& trace : merger.traces()) {
+        const auto variants = types.find(trace.guid);
+        if (variants == types.end()) {
+            throw std::runtime_error("Bad annotations!");
+        }
+        // Different types are annotated when the same trace is compiled with different argument
+        // types, such as in an inline function which depends on compilation flags.
+        for (size_t i = 1; i < variants->second.size(); ++i) {
+            merger.reportConflict("trace " + formatGuid(trace.guid),
+                                  describeTrace(trace, variants->second[0]),
+                                  describeTrace(trace, variants->second[i]));
+        }
+        trace.typeNames = std::move(variants->second[0]);
+    }
+    TraceMetadata result = merger.finish();
+
+    parallelFor(result.traces.size(), threadCount, [&result](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            auto& trace = result.traces[i];
+            constexpr const std::string_view FUNCTION_PREFIX = "FUNC=";
+            constexpr const std::string_view FLAG_PREFIX = "FLAG=";
+            constexpr const std::string_view LEVEL_PREFIX = "TraceLevel::";
+            if (trace.function.compare(0, FUNCTION_PREFIX.size(), FUNCTION_PREFIX) == 0) {
+                trace.function.erase(0, FUNCTION_PREFIX.size());
+            }
+            if (trace.flag.compare(0, FLAG_PREFIX.size(), FLAG_PREFIX) == 0) {
+                trace.flag.erase(0, FLAG_PREFIX.size());
+            }
+            if (!trace.flag.empty() &&
+                trace.flag.find_first_not_of("0123456789") == std::string::npos) {
+                trace.flag = "WPP_FLAG_" + trace.flag;
+            }
+            const size_t levelStart = trace.level.rfind(LEVEL_PREFIX);
+            if (levelStart != std::string::npos) {
+                trace.level.erase(0, levelStart + LEVEL_PREFIX.size());
+            }
+
+            for (const auto& typeName : trace.typeNames) {
+                trace.argTypes.push_back(makeTraceItem(typeName, result.structs));
+            }
+        }
+    });
+
+    return result;
+}
+
+TraceMetadata mergeTraceMetadata(std::vector<SourceMetadata> inputs) {
+    MetadataMerger merger;
+    for (auto& input : inputs) {
+        for (auto& trace : input.metadata.traces) {
+            trace.source = input.source;
+            merger.addTrace(std::move(trace), input.source);
+        }
+        for (const auto& [name, info] : input.metadata.structs) {
+            merger.addStruct(info, input.source);
+        }
+    }
+
+    auto result = merger.finish();
+    std::sort(result.traces.begin(), result.traces.end(),
+              [](const TraceInfo& a, const TraceInfo& b) { return a.guid < b.guid; });
+    // The struct items refer to the structs of their inputs, which are destroyed.
+    for (auto& trace : result.traces) {
+        trace.argTypes.clear();
+        for (const auto& typeName : trace.typeNames) {
+            trace.argTypes.push_back(makeTraceItem(typeName, result.structs));
+        }
+    }
+    return result;
+}
+
+}  // namespace wpp::tools
@@ -0,0 +1,122 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "TraceItems.h"
+
+namespace wpp::tools {
+
+/**
+ * A trace GUID, as a UUID in big-endian (textual) byte order.
+ */
+using Guid = std::array<uint8_t, 16>;
+
+std::string formatGuid(const Guid& guid);
+
+/**
+ * The information of a single trace.
+ */
+struct TraceInfo {
+    Guid guid;
+    /// The path of the source file, relative to its parent directory (as used in the trace hash).
+    std::string file;
+    std::string line;
+    std::string function;
+    std::string flag;
+    std::string level;
+    std::string format;
+    std::string args;
+    std::vector<std::string> typeNames;
+    std::vector<std::unique_ptr<TraceItem>> argTypes;
+    /// The input defining the trace, if it was merged from several inputs (see mergeTraceMetadata)
+    std::string source;
+
+    std::string fileName() const;
+    std::string dirName() const;
+
+    /**
+     * Checks whether both traces have the same information, including the argument types (which
+     * are not a part of the GUID).
+     */
+    bool hasSameDefinition(const TraceInfo& other) const;
+
+    bool supportsLegacyFormat() const;
+
+    /**
+     * A legacy wpp-style format string (quoted) for the trace.
+     */
+    std::string legacyFormat() const;
+
+    /**
+     * The legacy WPP item names of all the arguments of the trace.
+     */
+    std::vector<std::string> legacyItemNames() const;
+};
+
+/**
+ * A single part of a parsed format string: a literal, optionally followed by a field referencing
+ * the argument at `argIndex`.
+ */
+struct FormatPart {
+    std::string literal;
+    std::optional<std::string> formatSpec;
+    size_t argIndex = 0;
+    /// The name of the referenced argument, or empty for automatic and positional fields.
+    std::string argName;
+};
+
+/**
+ * Parses a python-style format string, the same as python's `string.Formatter().parse`, and maps
+ * its fields to argument indices. Fields reference the next argument (`{}`), a positional argument
+ * (`{0}`) or a named argument (`{name}`), which is the next argument the first time the name is
+ * used - the same as the c++ format parser. Conversions are not supported.
+ */
+std::vector<FormatPart> parseFormat(std::string_view format);
+
+/**
+ * Returns the keyword names of a trace from its keywords expression (its flag), the same as
+ * scripts/trace_info.py. Keywords are expected to be named constants (such as
+ * `Keywords::Network | Keywords::Disk`), and their names are unqualified. Integer literals are
+ * named as in the legacy WPP flag definitions, by their value (such as `WPP_FLAG_1`).
+ */
+std::vector<std::string> getKeywordNames(std::string_view flag);
+
+/**
+ * The trace information parsed from the metadata records (or PDB annotations) of a binary.
+ */
+struct TraceMetadata {
+    std::vector<TraceInfo> traces;
+    StructMap structs;
+};
+
+/**
+ * Parses the given metadata record payloads using the given number of threads.
+ * Each payload is a list of null-terminated strings, starting with the record kind.
+ *
+ * Traces and structs which are defined several times (such as in inline functions) are merged.
+ * Conflicting definitions are logged as errors, after which a std::runtime_error is thrown.
+ */
+TraceMetadata parseTraceMetadata(const std::vector<std::string>& records, size_t threadCount);
+
+/**
+ * The trace metadata of a single input, such as an object file.
+ */
+struct SourceMetadata {
+    std::string source;
+    TraceMetadata metadata;
+};
+
+/**
+ * Merges the trace metadata of several inputs, the same way as parseTraceMetadata merges the
+ * records of a single input. The conflicts are logged with the inputs defining them. The merged
+ * traces are sorted by their GUIDs, so the result doesn't depend on the order of the inputs, and
+ * every trace keeps the input which defined it first.
+ */
+TraceMetadata mergeTraceMetadata(std::vector<SourceMetadata> inputs);
+
+}  // namespace wpp::tools
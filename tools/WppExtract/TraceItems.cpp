@@ -0,0 +1,965 @@
+#include "TraceItems.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include "Log.h"
+#include "Strings.h"
+#include "wpp/ParseUtils.h"
+
+namespace wpp::tools {
+
+std::vector<std::string> TraceItem::legacyItemNames() const {
+    throw std::runtime_error(m_name + " is not supported by legacy tmf files");
+}
+
+std::string TraceItem::legacyInsert(std::string_view formatSpec, size_t argId) const {
+    const auto spec = wpp::internal::parseFormatSpec(formatSpec);
+    if (!spec.isValid) {
+        unsupportedFormat(formatSpec);
+    }
+
+    const auto layout = formatSpec.substr(0, formatSpec.size() - spec.type.size());
+    std::string flags;
+    if (!layout.empty()) {
+        const auto legacy = legacyLayout(spec.type);
+        if (legacy == LegacyLayout::Unsupported) {
+            logWarning(m_name + " does not support the legacy format layout \"" +
+                       std::string(layout) + "\", ignoring it");
+        } else {
+            const bool zeroFill = spec.fill == '0' && spec.align == '=';
+            if (spec.align == '^' || spec.grouping != '\0' ||
+                (spec.fill != '\0' && spec.fill != ' ' && !zeroFill)) {
+                logWarning("Got unsupported legacy format layout \"" + std::string(layout) +
+                           "\", ignoring some of it");
+            }
+            if (spec.align == '<' ||
+                (spec.align == '\0' && legacy == LegacyLayout::Text && spec.width != 0)) {
+                flags += '-';
+            }
+            if (spec.sign == '+' || spec.sign == ' ') {
+                flags += spec.sign;
+            }
+            if (spec.alternate) {
+                flags += '#';
+            }
+            if (spec.zeroPadding || zeroFill) {
+                flags += '0';
+            }
+            if (spec.width != 0) {
+                flags += std::to_string(spec.width);
+            }
+            if (spec.hasPrecision) {
+                flags += "." + std::to_string(spec.precision);
+            }
+        }
+    }
+
+    return "%" + std::to_string(argId) + "!" + flags + legacyFormat(spec.type) + "!";
+}
+
+size_t TraceItem::decode(TraceData, size_t, const FormatSpec&, std::string&) const {
+    throw std::runtime_error(m_name + " does not support decoding");
+}
+
+std::string TraceItem::formatConstant(uint64_t bits, std::string_view formatSpec) const {
+    uint8_t data[sizeof(bits)];
+    for (size_t i = 0; i < sizeof(bits); ++i) {
+        data[i] = static_cast<uint8_t>(bits >> (i * 8));
+    }
+
+    std::string result;
+    decode(TraceData{data, sizeof(data)}, 0, wpp::internal::parseFormatSpec(formatSpec), result);
+    return result;
+}
+
+std::string TraceItem::legacyFormat(std::string_view formatType) const {
+    unsupportedFormat(formatType);
+}
+
+TraceItem::LegacyLayout TraceItem::legacyLayout(std::string_view) const {
+    return LegacyLayout::Unsupported;
+}
+
+void TraceItem::unsupportedFormat(std::string_view formatSpec) const {
+    throw std::runtime_error(m_name + " does not support legacy format spec \"" +
+                             std::string(formatSpec) + "\"");
+}
+
+namespace {
+
+constexpr FormatSpec EMPTY_SPEC = wpp::internal::parseFormatSpec("");
+
+/**
+ * Checks that the trace data contains `size` bytes at the given offset.
+ */
+void checkSize(TraceData data, size_t offset, size_t size, const char* what) {
+    if (offset > data.size || data.size - offset < size) {
+        throw std::runtime_error(std::string("Truncated ") + what);
+    }
+}
+
+/**
+ * Reads a little-endian unsigned integer of the given size (up to 8 bytes) from the trace data.
+ */
+uint64_t readInteger(TraceData data, size_t offset, size_t size) {
+    checkSize(data, offset, size, "trace item");
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i) {
+        value |= static_cast<uint64_t>(data.data[offset + i]) << (i * 8);
+    }
+    return value;
+}
+
+/**
+ * Appends the given bytes as lowercase hex, separated by spaces.
+ */
+void appendBytes(std::string& output, const uint8_t* data, size_t size) {
+    static constexpr char DIGITS[] = "0123456789abcdef";
+    for (size_t i = 0; i < size; ++i) {
+        if (i != 0) {
+            output += ' ';
+        }
+        output += DIGITS[data[i] >> 4];
+        output += DIGITS[data[i] & 0xf];
+    }
+}
+
+/**
+ * Appends a 64-bit value as hex digits, zero-padded to the given width.
+ */
+void appendHex(std::string& output, uint64_t value, size_t width, bool isUpper) {
+    const char* digits = isUpper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char buffer[16];
+    size_t size = 0;
+    do {
+        buffer[size++] = digits[value & 0xf];
+        value >>= 4;
+    } while (value != 0);
+    for (; size < width; ++size) {
+        buffer[size] = '0';
+    }
+    std::reverse(buffer, buffer + size);
+    output.append(buffer, size);
+}
+
+/**
+ * The base class for all trace items supporting conversion to "legacy" tmf files, which are
+ * parsed using a single legacy item.
+ */
+class LegacyTraceItem : public TraceItem {
+public:
+    LegacyTraceItem(std::string_view name, std::string_view legacyItemName)
+        : TraceItem(name), m_legacyItemName(legacyItemName) {
+        // Intentionally left blank.
+    }
+
+    bool supportsLegacyFormat() const override {
+        return true;
+    }
+
+    std::vector<std::string> legacyItemNames() const override {
+        return {m_legacyItemName};
+    }
+
+private:
+    std::string m_legacyItemName;
+};
+
+class IntegralTraceItem : public LegacyTraceItem {
+public:
+    IntegralTraceItem(std::string_view name, std::string_view legacyItemName, size_t size,
+                      bool isSigned)
+        : LegacyTraceItem(name, legacyItemName), m_size(size), m_isSigned(isSigned) {
+        // Intentionally left blank.
+    }
+
+    size_t decode(TraceData data, size_t offset, const FormatSpec& spec,
+                  std::string& output) const override {
+        appendValue(readInteger(data, offset, m_size), spec, output);
+        return offset + m_size;
+    }
+
+protected:
+    /**
+     * Appends the value of the item, given its (zero-extended) wire representation.
+     */
+    virtual void appendValue(uint64_t bits, const FormatSpec& spec, std::string& output) const {
+        if (m_isSigned) {
+            // Sign-extend the value to 64 bits
+            const size_t shift = 64 - m_size * 8;
+            const auto value = static_cast<int64_t>(bits << shift) >> shift;
+            const auto magnitude = static_cast<uint64_t>(value);
+            appendInteger(output, value < 0 ? 0 - magnitude : magnitude, value < 0, spec);
+        } else {
+            appendInteger(output, bits, false, spec);
+        }
+    }
+
+    std::string legacyFormat(std::string_view formatSpec) const override {
+        const char defaultSpec = m_isSigned ? 'd' : 'u';
+        std::string spec = formatSpec.empty() ? std::string(1, defaultSpec)
+                                              : std::string(formatSpec);
+        std::replace(spec.begin(), spec.end(), 'd', defaultSpec);
+        if (spec.find_first_of("bB") != std::string::npos) {
+            logWarning("Got unsupported legacy format " + spec + ", replacing with hex version");
+            std::replace(spec.begin(), spec.end(), 'b', 'x');
+            std::replace(spec.begin(), spec.end(), 'B', 'X');
+        }
+
+        if (spec != "d" && spec != "u" && spec != "x" && spec != "X" && spec != "o") {
+            unsupportedFormat(formatSpec);
+        }
+
+        return sizePrefix() + spec;
+    }
+
+    LegacyLayout legacyLayout(std::string_view) const override {
+        return LegacyLayout::Number;
+    }
+
+private:
+    std::string sizePrefix() const {
+        switch (m_size) {
+        case 8:
+            return "I64";
+        case 4:
+            return "";
+        case 2:
+            return "h";
+        case 1:
+            return "hh";
+        default:
+            throw std::runtime_error("Bad integer type size!");
+        }
+    }
+
+    size_t m_size;
+    bool m_isSigned;
+};
+
+/**
+ * int8_t can't be printed as signed by legacy tmf files.
+ */
+class Int8Item : public IntegralTraceItem {
+public:
+    Int8Item() : IntegralTraceItem("Int8Item", "ItemChar", 1, true) {
+        // Intentionally left blank.
+    }
+
+protected:
+    std::string legacyFormat(std::string_view formatSpec) const override {
+        if (formatSpec.empty() || formatSpec == "d") {
+            logWarning("Cannot print int8_t as signed, using the unsigned form!");
+        }
+        return IntegralTraceItem::legacyFormat(formatSpec);
+    }
+};
+
+/**
+ * size_t and ptrdiff_t, which are always traced as 64-bit values and accept a `z` prefix.
+ */
+class PointerSizedItem : public IntegralTraceItem {
+public:
+    using IntegralTraceItem::IntegralTraceItem;
+
+protected:
+    std::string legacyFormat(std::string_view formatSpec) const override {
+        if (!formatSpec.empty() && formatSpec[0] == 'z') {
+            formatSpec.remove_prefix(1);
+        }
+        return IntegralTraceItem::legacyFormat(formatSpec);
+    }
+};
+
+/**
+ * Characters, printed as characters by default. Wide characters are traced as UTF-16 code units.
+ */
+class CharacterItem : public IntegralTraceItem {
+public:
+    using IntegralTraceItem::IntegralTraceItem;
+
+protected:
+    void appendValue(uint64_t bits, const FormatSpec& spec, std::string& output) const override {
+        if (spec.isValid && (spec.type.empty() || spec.type == "c")) {
+            // Narrow characters are printed as latin-1, and wide characters as UTF-16 code units
+            appendText(output, encodeUtf8(static_cast<uint32_t>(bits)), spec);
+        } else {
+            IntegralTraceItem::appendValue(bits, spec, output);
+        }
+    }
+
+    std::string legacyFormat(std::string_view formatSpec) const override {
+        if (formatSpec.empty() || formatSpec == "c") {
+            return "c";
+        }
+        return IntegralTraceItem::legacyFormat(formatSpec);
+    }
+
+    LegacyLayout legacyLayout(std::string_view formatType) const override {
+        return formatType.empty() || formatType == "c" ? LegacyLayout::Text
+                                                       : LegacyLayout::Number;
+    }
+};
+
+/**
+ * A trace item with a single legacy format, which is used by default and for the given spec.
+ */
+class FixedFormatItem : public LegacyTraceItem {
+public:
+    FixedFormatItem(std::string_view name, std::string_view legacyItemName,
+                    std::string_view legacyFormat, std::string_view spec = {},
+                    std::string_view prefix = {}, bool anySpec = false)
+        : LegacyTraceItem(name, legacyItemName),
+          m_legacyFormat(legacyFormat),
+          m_spec(spec),
+          m_prefix(prefix),
+          m_anySpec(anySpec) {
+        // Intentionally left blank.
+    }
+
+    std::string legacyInsert(std::string_view formatSpec, size_t argId) const override {
+        return m_prefix + LegacyTraceItem::legacyInsert(formatSpec, argId);
+    }
+
+protected:
+    std::string legacyFormat(std::string_view formatSpec) const override {
+        if (!m_anySpec && !formatSpec.empty() && formatSpec != m_spec) {
+            unsupportedFormat(formatSpec);
+        }
+        return m_legacyFormat;
+    }
+
+    const std::string& prefix() const {
+        return m_prefix;
+    }
+
+private:
+    std::string m_legacyFormat;
+    std::string m_spec;
+    std::string m_prefix;
+    bool m_anySpec;
+};
+
+/**
+ * Strings, which also support a precision (the maximal number of printed characters).
+ */
+class StringItem : public FixedFormatItem {
+public:
+    StringItem(std::string_view name, std::string_view legacyItemName, bool isWide)
+        : FixedFormatItem(name, legacyItemName, "s", "s"), m_isWide(isWide) {
+        // Intentionally left blank.
+    }
+
+    size_t decode(TraceData data, size_t offset, const FormatSpec& spec,
+                  std::string& output) const override {
+        checkSize(data, offset, 0, "string");
+        const uint8_t* const begin = data.data + offset;
+        const size_t available = data.size - offset;
+        size_t size = 0;
+        if (m_isWide) {
+            while (size + 2 <= available && (begin[size] != 0 || begin[size + 1] != 0)) {
+                size += 2;
+            }
+            if (size + 2 > available) {
+                throw std::runtime_error("Unterminated wide string");
+            }
+        } else {
+            const void* const end = std::memchr(begin, 0, available);
+            if (end == nullptr) {
+                throw std::runtime_error("Unterminated string");
+            }
+            size = static_cast<const uint8_t*>(end) - begin;
+        }
+
+        if (spec.isValid && spec.width == 0 && !spec.hasPrecision && !spec.hasNumericOptions()) {
+            // Without a layout, the string is decoded directly into the output
+            append(output, begin, size);
+        } else {
+            std::string text;
+            append(text, begin, size);
+            appendText(output, text, spec);
+        }
+        return offset + size + (m_isWide ? 2 : 1);
+    }
+
+protected:
+    LegacyLayout legacyLayout(std::string_view) const override {
+        return LegacyLayout::Text;
+    }
+
+private:
+    void append(std::string& output, const uint8_t* data, size_t size) const {
+        if (m_isWide) {
+            appendUtf16(output, data, size);
+        } else {
+            appendUtf8(output, data, size);
+        }
+    }
+
+    bool m_isWide;
+};
+
+/**
+ * Pointers, printed as `0x...` (right-aligned, like numbers).
+ */
+class PointerItem : public FixedFormatItem {
+public:
+    PointerItem() : FixedFormatItem("PointerItem", "ItemULongLong", "016I64X", "p") {
+        // Intentionally left blank.
+    }
+
+    size_t decode(TraceData data, size_t offset, const FormatSpec& spec,
+                  std::string& output) const override {
+        const size_t start = output.size();
+        output += "0x";
+        appendHex(output, readInteger(data, offset, 8), 0, false);
+        padText(output, start, spec, '>');
+        return offset + 8;
+    }
+};
+
+/**
+ * GUIDs, printed in their registry format (without braces) in lowercase.
+ */
+class GuidItem : public FixedFormatItem {
+public:
+    GuidItem() : FixedFormatItem("GuidItem", "ItemGuid", "GUID") {
+        // Intentionally left blank.
+    }
+
+    size_t decode(TraceData data, size_t offset, const FormatSpec& spec,
+                  std::string& output) const override {
+        checkSize(data, offset, 16, "GUID");
+        const size_t start = output.size();
+        appendHex(output, readInteger(data, offset, 4), 8, false);
+        output += '-';
+        appendHex(output, readInteger(data, offset + 4, 2), 4, false);
+        output += '-';
+        appendHex(output, readInteger(data, offset + 6, 2), 4, false);
+        output += '-';
+        for (size_t i = 8; i < 16; ++i) {
+            if (i == 10) {
+                output += '-';
+            }
+            appendHex(output, data.data[offset + i], 2, false);
+        }
+        padText(output, start, spec, '<');
+        return offset + 16;
+    }
+};
+
+/**
+ * Buffers traced as a 16-bit size followed by the data, printed as hex bytes (after the prefix).
+ */
+class HexBufferItem : public FixedFormatItem {
+public:
+    HexBufferItem(std::string_view name, std::string_view legacyItemName,
+                  std::string_view prefix = {})
+        : FixedFormatItem(name, legacyItemName, "s", "", prefix, true) {
+        // Intentionally left blank.
+    }
+
+    size_t decode(TraceData data, size_t offset, const FormatSpec& spec,
+                  std::string& output) const override {
+        const auto size = static_cast<size_t>(readInteger(data, offset, 2));
+        offset += 2;
+        checkSize(data, offset, size, "buffer");
+
+        const size_t start = output.size();
+        output += prefix();
+        appendBytes(output, data.data + offset, size);
+        padText(output, start, spec, '<');
+        return offset + size;
+    }
+};
+
+/**
+ * Stack traces, traced as a buffer of the frame count, the module count, the build-ids of the
+ * modules and the frames (each a module index and an offset). The frames are printed as
+ * `#0 module!symbol, #1 ...` if the decoder has symbols, and as hex (after the `stack:` prefix)
+ * otherwise - the same as scripts/trace_items.py.
+ */
+class StackItem : public HexBufferItem {
+public:
+    StackItem() : HexBufferItem("StackItem", "ItemHEXBytes", "stack:") {
+        // Intentionally left blank.
+    }
+
+    size_t decode(TraceData data, size_t offset, const FormatSpec& spec,
+                  std::string& output) const override {
+        constexpr const unsigned MODULE_OFFSET_BITS = 48;
+        constexpr const uint16_t UNKNOWN_MODULE_INDEX = 0xffff;
+        const auto size = static_cast<size_t>(readInteger(data, offset, 2));
+        checkSize(data, offset + 2, size, "buffer");
+        const uint8_t* stack = data.data + offset + 2;
+        if (data.symbols == nullptr || size < 2 ||
+            size != 2 + stack[1] * sizeof(StreamModuleId) + stack[0] * sizeof(uint64_t)) {
+            return HexBufferItem::decode(data, offset, spec, output);
+        }
+
+        const size_t frameCount = stack[0];
+        const size_t moduleCount = stack[1];
+        const size_t frames = offset + 4 + moduleCount * sizeof(StreamModuleId);
+        const size_t start = output.size();
+        output += prefix();
+        for (size_t i = 0; i < frameCount; ++i) {
+            const uint64_t frame = readInteger(data, frames + i * sizeof(uint64_t), 8);
+            const auto moduleIndex = static_cast<uint16_t>(frame >> MODULE_OFFSET_BITS);
+            const uint64_t moduleOffset = frame & ((uint64_t(1) << MODULE_OFFSET_BITS) - 1);
+
+            output += i == 0 ? " #" : ", #";
+            output += std::to_string(i);
+            output += ' ';
+            if (moduleIndex == UNKNOWN_MODULE_INDEX || moduleIndex >= moduleCount) {
+                output += "0x";
+                appendHex(output, moduleOffset, 0, false);
+                continue;
+            }
+            StreamModuleId module;
+            std::memcpy(module.data(), stack + 2 + moduleIndex * module.size(), module.size());
+            if (!data.symbols->appendSymbol(module, moduleOffset, output)) {
+                output += '<';
+                for (const auto byte : module) {
+                    appendHex(output, byte, 2, false);
+                }
+                output += ">+0x";
+                appendHex(output, moduleOffset, 0, false);
+            }
+        }
+        padText(output, start, spec, '<');
+        return offset + 2 + size;
+    }
+};
+
+/**
+ * Symbols, traced as a module index and an offset. They're printed as `module!symbol` if the
+ * decoder has the symbols of the module, and as hex (after the `sym:` prefix) otherwise.
+ */
+class SymbolItem : public FixedFormatItem {
+public:
+    SymbolItem() : FixedFormatItem("SymbolItem", "ItemULongLong", "016I64X", "", "sym:", true) {
+        // Intentionally left blank.
+    }
+
+    size_t decode(TraceData data, size_t offset, const FormatSpec& spec,
+                  std::string& output) const override {
+        constexpr const unsigned MODULE_OFFSET_BITS = 48;
+        const size_t start = output.size();
+        const uint64_t value = readInteger(data, offset, 8);
+        if (data.symbols == nullptr ||
+            !data.symbols->appendSymbol(static_cast<uint16_t>(value >> MODULE_OFFSET_BITS),
+                                        value & ((uint64_t(1) << MODULE_OFFSET_BITS) - 1),
+                                        output)) {
+            output += prefix();
+            appendHex(output, value, 16, true);
+        }
+        padText(output, start, spec, '<');
+        return offset + 8;
+    }
+};
+
+class FloatingPointItem : public LegacyTraceItem {
+public:
+    FloatingPointItem(std::string_view name, std::string_view legacyItemName, size_t size)
+        : LegacyTraceItem(name, legacyItemName), m_size(size) {
+        // Intentionally left blank.
+    }
+
+    size_t decode(TraceData data, size_t offset, const FormatSpec& spec,
+                  std::string& output) const override {
+        const uint64_t bits = readInteger(data, offset, m_size);
+        double value;
+        if (m_size == sizeof(float)) {
+            float narrow;
+            const auto narrowBits = static_cast<uint32_t>(bits);
+            std::memcpy(&narrow, &narrowBits, sizeof(narrow));
+            value = narrow;
+        } else {
+            std::memcpy(&value, &bits, sizeof(value));
+        }
+        appendFloat(output, value, spec);
+        return offset + m_size;
+    }
+
+protected:
+    std::string legacyFormat(std::string_view formatSpec) const override {
+        if (formatSpec.empty()) {
+            return "f";
+        }
+        if (formatSpec.size() != 1 || std::string_view("aAeEfFgG").find(formatSpec[0]) ==
+                                          std::string_view::npos) {
+            unsupportedFormat(formatSpec);
+        }
+        return std::string(formatSpec);
+    }
+
+    LegacyLayout legacyLayout(std::string_view) const override {
+        return LegacyLayout::Number;
+    }
+
+private:
+    size_t m_size;
+};
+
+/**
+ * Returns legacy item names that consume exactly `size` bytes, used to skip struct padding.
+ */
+std::vector<std::string> legacyPaddingItems(size_t size) {
+    static const std::pair<size_t, const char*> PADDING_ITEMS[] = {
+        {8, "ItemLongLong"}, {4, "ItemLong"}, {2, "ItemShort"}, {1, "ItemChar"}};
+
+    std::vector<std::string> result;
+    for (const auto& [itemSize, itemName] : PADDING_ITEMS) {
+        for (; size >= itemSize; size -= itemSize) {
+            result.emplace_back(itemName);
+        }
+    }
+    return result;
+}
+
+/**
+ * A struct traced as a single copy of its bytes, printed as `{field1=..., field2=...}`.
+ */
+class StructItem : public TraceItem {
+public:
+    StructItem(const StructInfo& info, const StructMap& structs)
+        : TraceItem("StructItem"), m_info(info) {
+        auto fields = info.fields;
+        std::stable_sort(fields.begin(), fields.end(),
+                         [](const auto& a, const auto& b) { return a.offset < b.offset; });
+        for (auto& field : fields) {
+            auto item = makeTraceItem(field.itemType, structs);
+            m_fields.push_back(Field{std::move(field), std::move(item)});
+        }
+    }
+
+    bool supportsLegacyFormat() const override {
+        return std::all_of(m_fields.begin(), m_fields.end(),
+                           [](const auto& field) { return field.item->supportsLegacyFormat(); });
+    }
+
+    std::vector<std::string> legacyItemNames() const override {
+        std::vector<std::string> result;
+        forEachLegacyField([&result](const Field*, std::vector<std::string> names) {
+            result.insert(result.end(), names.begin(), names.end());
+        });
+        return result;
+    }
+
+    std::string legacyInsert(std::string_view formatSpec, size_t argId) const override {
+        const auto spec = wpp::internal::parseFormatSpec(formatSpec);
+        if (!spec.isValid || !spec.type.empty()) {
+            unsupportedFormat(formatSpec);
+        }
+        if (!formatSpec.empty()) {
+            logWarning(name() + " does not support the legacy format layout \"" +
+                       std::string(formatSpec) + "\", ignoring it");
+        }
+
+        std::string result = "{";
+        forEachLegacyField([&](const Field* field, const std::vector<std::string>& names) {
+            if (field != nullptr) {
+                if (result.size() > 1) {
+                    result += ", ";
+                }
+                result += field->info.name + "=" + field->item->legacyInsert("", argId);
+            }
+            argId += names.size();
+        });
+        return result + "}";
+    }
+
+    size_t decode(TraceData data, size_t offset, const FormatSpec& spec,
+                  std::string& output) const override {
+        checkSize(data, offset, m_info.size, "struct");
+        const size_t start = output.size();
+        output += '{';
+        for (const auto& field : m_fields) {
+            if (output.size() > start + 1) {
+                output += ", ";
+            }
+            output += field.info.name;
+            output += '=';
+            field.item->decode(data, offset + field.info.offset, EMPTY_SPEC, output);
+        }
+        output += '}';
+        padText(output, start, spec, '<');
+        return offset + m_info.size;
+    }
+
+private:
+    struct Field {
+        StructInfo::Field info;
+        std::unique_ptr<TraceItem> item;
+    };
+
+    /**
+     * Calls the callback with each field in the struct and its legacy item names. Struct padding
+     * and fields missing from the descriptor are passed with a null field.
+     */
+    template<typename Callback>
+    void forEachLegacyField(Callback&& callback) const {
+        size_t position = 0;
+        for (const auto& field : m_fields) {
+            if (field.info.offset < position) {
+                throw std::runtime_error("Struct " + m_info.name + " has overlapping fields!");
+            }
+            if (field.info.offset > position) {
+                callback(nullptr, legacyPaddingItems(field.info.offset - position));
+            }
+            callback(&field, field.item->legacyItemNames());
+            position = field.info.offset + field.info.size;
+        }
+
+        if (position < m_info.size) {
+            callback(nullptr, legacyPaddingItems(m_info.size - position));
+        }
+    }
+
+    const StructInfo& m_info;
+    std::vector<Field> m_fields;
+};
+
+/**
+ * A trace item composed of other trace items, created from its template arguments.
+ */
+class CompositeItem : public TraceItem {
+public:
+    CompositeItem(std::string_view name, std::vector<std::unique_ptr<TraceItem>> items)
+        : TraceItem(name), m_items(std::move(items)) {
+        // Intentionally left blank.
+    }
+
+protected:
+    std::vector<std::unique_ptr<TraceItem>> m_items;
+};
+
+/**
+ * An optional value: a presence byte followed by the value, if it exists.
+ */
+class OptionalItem : public CompositeItem {
+public:
+    using CompositeItem::CompositeItem;
+
+    size_t decode(TraceData data, size_t offset, const FormatSpec& spec,
+                  std::string& output) const override {
+        if (readInteger(data, offset, 1) == 0) {
+            const size_t start = output.size();
+            output += "none";
+            padText(output, start, spec, '<');
+            return offset + 1;
+        }
+        return m_items.at(0)->decode(data, offset + 1, spec, output);
+    }
+};
+
+/**
+ * A variant: an index byte followed by the active alternative (0xff for a valueless variant).
+ */
+class VariantItem : public CompositeItem {
+public:
+    using CompositeItem::CompositeItem;
+
+    size_t decode(TraceData data, size_t offset, const FormatSpec& spec,
+                  std::string& output) const override {
+        const auto index = static_cast<size_t>(readInteger(data, offset, 1));
+        if (index == 0xff) {
+            const size_t start = output.size();
+            output += "valueless";
+            padText(output, start, spec, '<');
+            return offset + 1;
+        }
+        if (index >= m_items.size()) {
+            throw std::runtime_error("Bad variant index " + std::to_string(index));
+        }
+        return m_items[index]->decode(data, offset + 1, spec, output);
+    }
+};
+
+/**
+ * A pair or a tuple, traced as its elements in order and printed as `(element1, element2, ...)`.
+ * Optionals and variants are not supported by legacy tmf files, as their trace layout depends on
+ * the traced value.
+ */
+class TupleItem : public CompositeItem {
+public:
+    using CompositeItem::CompositeItem;
+
+    bool supportsLegacyFormat() const override {
+        return std::all_of(m_items.begin(), m_items.end(),
+                           [](const auto& item) { return item->supportsLegacyFormat(); });
+    }
+
+    std::vector<std::string> legacyItemNames() const override {
+        std::vector<std::string> result;
+        for (const auto& item : m_items) {
+            const auto names = item->legacyItemNames();
+            result.insert(result.end(), names.begin(), names.end());
+        }
+        return result;
+    }
+
+    std::string legacyInsert(std::string_view formatSpec, size_t argId) const override {
+        std::string result = "(";
+        for (const auto& item : m_items) {
+            if (result.size() > 1) {
+                result += ", ";
+            }
+            result += item->legacyInsert(formatSpec, argId);
+            argId += item->legacyItemNames().size();
+        }
+        return result + ")";
+    }
+
+    size_t decode(TraceData data, size_t offset, const FormatSpec& spec,
+                  std::string& output) const override {
+        output += '(';
+        for (size_t i = 0; i < m_items.size(); ++i) {
+            if (i != 0) {
+                output += ", ";
+            }
+            offset = m_items[i]->decode(data, offset, spec, output);
+        }
+        output += ')';
+        return offset;
+    }
+};
+
+/**
+ * A compile-time constant, formatted like its value item. The value is part of the item type, so
+ * it takes no space in the trace and no legacy items - legacy tmf files contain the formatted value
+ * instead of an insert.
+ */
+class ConstantItem : public TraceItem {
+public:
+    ConstantItem(std::unique_ptr<TraceItem> item, uint64_t bits)
+        : TraceItem("ConstantItem"), m_item(std::move(item)), m_bits(bits) {
+        for (size_t i = 0; i < sizeof(bits); ++i) {
+            m_data[i] = static_cast<uint8_t>(bits >> (i * 8));
+        }
+    }
+
+    bool supportsLegacyFormat() const override {
+        return true;
+    }
+
+    std::vector<std::string> legacyItemNames() const override {
+        return {};
+    }
+
+    std::string legacyInsert(std::string_view formatSpec, size_t) const override {
+        // Escape % characters, as they are used by the legacy inserts
+        std::string result;
+        for (const char c : m_item->formatConstant(m_bits, formatSpec)) {
+            result += c;
+            if (c == '%') {
+                result += '%';
+            }
+        }
+        return result;
+    }
+
+    size_t decode(TraceData, size_t offset, const FormatSpec& spec,
+                  std::string& output) const override {
+        m_item->decode(TraceData{m_data, sizeof(m_data)}, 0, spec, output);
+        return offset;
+    }
+
+private:
+    std::unique_ptr<TraceItem> m_item;
+    uint64_t m_bits;
+    uint8_t m_data[sizeof(uint64_t)];
+};
+
+using ItemFactory = std::function<std::unique_ptr<TraceItem>()>;
+
+template<typename Item, typename... Args>
+ItemFactory makeFactory(Args... args) {
+    return [=]() { return std::make_unique<Item>(args...); };
+}
+
+const std::unordered_map<std::string_view, ItemFactory>& simpleItemFactories() {
+    static const std::unordered_map<std::string_view, ItemFactory> FACTORIES = {
+        {"CharItem", makeFactory<CharacterItem>("CharItem", "ItemChar", 1, true)},
+        // Wide characters are always traced as UTF-16 code units
+        {"WCharItem", makeFactory<CharacterItem>("WCharItem", "ItemShort", 2, true)},
+        {"StringItem", makeFactory<StringItem>("StringItem", "ItemString", false)},
+        // Wide strings are always traced as null-terminated UTF-16 strings
+        {"WStringItem", makeFactory<StringItem>("WStringItem", "ItemWString", true)},
+        {"Int8Item", makeFactory<Int8Item>()},
+        {"Int16Item", makeFactory<IntegralTraceItem>("Int16Item", "ItemShort", 2, true)},
+        {"Int32Item", makeFactory<IntegralTraceItem>("Int32Item", "ItemLong", 4, true)},
+        {"Int64Item", makeFactory<IntegralTraceItem>("Int64Item", "ItemLongLong", 8, true)},
+        {"UInt8Item", makeFactory<IntegralTraceItem>("UInt8Item", "ItemUChar", 1, false)},
+        {"UInt16Item", makeFactory<IntegralTraceItem>("UInt16Item", "ItemShort", 2, false)},
+        {"UInt32Item", makeFactory<IntegralTraceItem>("UInt32Item", "ItemLong", 4, false)},
+        {"UInt64Item", makeFactory<IntegralTraceItem>("UInt64Item", "ItemULongLong", 8, false)},
+        // Pointer-sized values are always traced as 64-bit values
+        {"SizeTItem", makeFactory<PointerSizedItem>("SizeTItem", "ItemULongLong", 8, false)},
+        {"PtrDiffItem", makeFactory<PointerSizedItem>("PtrDiffItem", "ItemLongLong", 8, true)},
+        {"FloatItem", makeFactory<FloatingPointItem>("FloatItem", "ItemFloat", 4)},
+        {"DoubleItem", makeFactory<FloatingPointItem>("DoubleItem", "ItemDouble", 8)},
+        // Long doubles are always traced as IEEE-754 binary64 values
+        {"LongDoubleItem", makeFactory<FloatingPointItem>("LongDoubleItem", "ItemDouble", 8)},
+        // Pointers are always traced as 64-bit values, so they don't use ItemPtr
+        {"PointerItem", makeFactory<PointerItem>()},
+        {"GuidItem", makeFactory<GuidItem>()},
+        {"HexBufferItem", makeFactory<HexBufferItem>("HexBufferItem", "ItemHEXBytes")},
+        {"HexDumpItem", makeFactory<HexBufferItem>("HexDumpItem", "ItemHEXDump")},
+        // Wide strings traced as hex are always UTF-16
+        {"WHexBufferItem", makeFactory<HexBufferItem>("WHexBufferItem", "ItemHEXBytes")},
+        {"WHexDumpItem", makeFactory<HexBufferItem>("WHexDumpItem", "ItemHEXDump")},
+        // Stacks and symbols are symbolized if the decoder has symbols, or printed as hex
+        {"StackItem", makeFactory<StackItem>()},
+        {"SymbolItem", makeFactory<SymbolItem>()},
+    };
+    return FACTORIES;
+}
+
+}  // namespace
+
+std::unique_ptr<TraceItem> makeTraceItem(std::string_view typeName, const StructMap& structs) {
+    const auto name = getBaseName(typeName);
+
+    if (name == "StructItem") {
+        const auto structName = getTemplateArgs(typeName)[0];
+        const auto info = structs.find(structName);
+        if (info == structs.end()) {
+            throw std::runtime_error("Missing struct descriptor for " + std::string(structName));
+        }
+        return std::make_unique<StructItem>(info->second, structs);
+    }
+
+    if (name == "ConstantItem") {
+        const auto args = getTemplateArgs(typeName);
+        return std::make_unique<ConstantItem>(makeTraceItem(args.at(0), structs),
+                                              parseInt(args.at(1)));
+    }
+
+    if (name == "OptionalItem" || name == "TupleItem" || name == "VariantItem") {
+        std::vector<std::unique_ptr<TraceItem>> items;
+        for (const auto& arg : getTemplateArgs(typeName)) {
+            if (!arg.empty()) {
+                items.push_back(makeTraceItem(arg, structs));
+            }
+        }
+        if (name == "TupleItem") {
+            return std::make_unique<TupleItem>(name, std::move(items));
+        }
+        if (name == "OptionalItem") {
+            return std::make_unique<OptionalItem>(name, std::move(items));
+        }
+        return std::make_unique<VariantItem>(name, std::move(items));
+    }
+
+    const auto& factories = simpleItemFactories();
+    const auto factory = factories.find(name);
+    if (factory == factories.end()) {
+        throw std::runtime_error("Unknown trace item type " + std::string(typeName));
+    }
+    return factory->second();
+}
+
+}  // namespace wpp::tools
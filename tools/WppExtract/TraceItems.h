@@ -0,0 +1,171 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Strings.h"
+
+namespace wpp::tools {
+
+/**
+ * The layout of a struct registered using WPP_DEFINE_STRUCT_ITEM.
+ */
+struct StructInfo {
+    struct Field {
+        std::string name;
+        size_t offset;
+        size_t size;
+        std::string itemType;
+
+        bool operator==(const Field& other) const {
+            return name == other.name && offset == other.offset && size == other.size &&
+                   itemType == other.itemType;
+        }
+    };
+
+    std::string name;
+    size_t size;
+    std::vector<Field> fields;
+
+    bool operator==(const StructInfo& other) const {
+        return name == other.name && size == other.size && fields == other.fields;
+    }
+
+    bool operator!=(const StructInfo& other) const {
+        return !(*this == other);
+    }
+};
+
+/**
+ * Maps struct type names to their layouts.
+ */
+using StructMap = std::map<std::string, StructInfo, std::less<>>;
+
+/**
+ * The build-id of a traced module, as written in the stream header and in stack items (see
+ * wpp::ModuleId).
+ */
+using StreamModuleId = std::array<uint8_t, 20>;
+
+/**
+ * Resolves module-relative addresses (traced using the `sym` and `stack` specifications) to symbol
+ * names.
+ */
+class SymbolResolver {
+public:
+    virtual ~SymbolResolver() = default;
+
+    /**
+     * Appends the symbol containing the given offset of a module, where modules are identified by
+     * their indices in the traced process. Returns false (without appending anything) if the
+     * symbol is unknown.
+     */
+    virtual bool appendSymbol(uint16_t moduleIndex, uint64_t offset, std::string& output) const = 0;
+
+    /**
+     * Appends the symbol containing the given offset of a module identified by its build-id (as
+     * the frames of stack items are). Returns false (without appending anything) if the symbol is
+     * unknown.
+     */
+    virtual bool appendSymbol(const StreamModuleId& module, uint64_t offset,
+                              std::string& output) const = 0;
+};
+
+/**
+ * The data of a single trace: the data of all its trace items, in order.
+ */
+struct TraceData {
+    const uint8_t* data;
+    size_t size;
+    /// Resolves the `{:sym}` pointers and `{:stack}` frames of the trace (printed as hex if there's
+    /// none)
+    const SymbolResolver* symbols = nullptr;
+};
+
+/**
+ * A trace item type, which knows how to convert itself to "legacy" tmf items.
+ * This matches the trace items of scripts/trace_items.py.
+ */
+class TraceItem {
+public:
+    explicit TraceItem(std::string_view name) : m_name(name) {
+        // Intentionally left blank.
+    }
+
+    virtual ~TraceItem() = default;
+
+    /**
+     * The unqualified name of the item type (such as `Int32Item`).
+     */
+    const std::string& name() const noexcept {
+        return m_name;
+    }
+
+    /**
+     * Whether the trace item can be converted to "legacy" tmf items.
+     */
+    virtual bool supportsLegacyFormat() const {
+        return false;
+    }
+
+    /**
+     * The names of all the legacy wpp items used to parse the trace item (such as `ItemLong`).
+     */
+    virtual std::vector<std::string> legacyItemNames() const;
+
+    /**
+     * The legacy format insert (for example `%10!08x!`) for the trace item, where `argId` is the id
+     * of the first legacy item used by the trace item.
+     */
+    virtual std::string legacyInsert(std::string_view formatSpec, size_t argId) const;
+
+    /**
+     * Decodes the trace item at the given offset of the trace data, and appends its value formatted
+     * using the given format specification - the same as scripts/trace_items.py. Returns the offset
+     * following the item, or throws a std::runtime_error if the data is truncated or the format
+     * specification is not supported.
+     */
+    virtual size_t decode(TraceData data, size_t offset, const FormatSpec& spec,
+                          std::string& output) const;
+
+    /**
+     * Formats a compile-time constant traced as this item, given its wire representation
+     * (zero-extended to 64 bits), the same as the trace would be formatted by decode_stream.py.
+     */
+    std::string formatConstant(uint64_t bits, std::string_view formatSpec) const;
+
+protected:
+    /**
+     * How the layout of a format specification (everything but its type) is converted to printf
+     * flags, width and precision.
+     */
+    enum class LegacyLayout {
+        Unsupported,
+        Number,
+        // Text is left-aligned by default
+        Text,
+    };
+
+    /**
+     * The legacy format specification matching the type of the given c++ format specification.
+     */
+    virtual std::string legacyFormat(std::string_view formatType) const;
+
+    virtual LegacyLayout legacyLayout(std::string_view formatType) const;
+
+    [[noreturn]] void unsupportedFormat(std::string_view formatSpec) const;
+
+private:
+    std::string m_name;
+};
+
+/**
+ * Creates a trace item from the c++ type name of the item.
+ */
+std::unique_ptr<TraceItem> makeTraceItem(std::string_view typeName, const StructMap& structs);
+
+}  // namespace wpp::tools